@@ -0,0 +1,83 @@
+/*
+ * Host Benchmarks
+ */
+
+#include "bench.h"
+
+#include <chrono>
+#include <new>
+#include <sys/stat.h>
+
+uint64_t benchAllocations = 0;
+
+void *operator new(size_t size)
+{
+  benchAllocations++;
+  void *p = malloc(size ? size : 1);
+  if (!p)
+    throw std::bad_alloc();
+  return p;
+}
+
+void operator delete(void *p) noexcept
+{
+  free(p);
+}
+
+void operator delete(void *p, size_t) noexcept
+{
+  free(p);
+}
+
+uint64_t benchMicros()
+{
+  using namespace std::chrono;
+  return duration_cast<microseconds>(steady_clock::now().time_since_epoch()).count();
+}
+
+void benchRecord(SensorRecord &record, uint32_t i)
+{
+  record = {};
+  record.timestamp = 1700000000UL + i * 300;
+  record.temperature = 12.5f + 0.01f * (i % 700);
+  record.humidity = 55.0f + 0.02f * (i % 900);
+  record.pressure = 1013.25f - 0.001f * (i % 3000);
+  record.pressurePMSL = record.pressure + 12.3f;
+  record.air = 150.0f + 0.5f * (i % 40);
+  record.heatIndex = record.temperature - 0.4f;
+  record.dewPoint = record.temperature - 6.2f;
+  record.pm1_0 = 4 + i % 5;
+  record.pm2_5 = 7 + i % 9;
+  record.pm10_0 = 9 + i % 11;
+  record.gt0_3 = 1200 + i % 400;
+  record.gt0_5 = 380 + i % 120;
+  record.gt1_0 = 60 + i % 30;
+  record.gt2_5 = 6 + i % 4;
+  record.gt5_0 = 1 + i % 3;
+  record.gt10_0 = i % 2;
+  record.aqi = 30 + i % 20;
+  record.visible = 260 + i % 1000;
+  record.ir = 250 + i % 3000;
+  record.uv = i % 600;
+  record.uvIndex = record.uv / 100;
+  record.battery = 3.9f + 0.001f * (i % 200);
+  record.samples = 1;
+}
+
+int main(int argc, char **argv)
+{
+  const char *only = argc > 1 ? argv[1] : nullptr;
+  mkdir(nativeRoot(), 0755);
+
+  if (!only || strcmp(only, "csv") == 0)
+    benchCSVWriter();
+  if (!only || strcmp(only, "mqtt") == 0)
+    benchMQTT();
+  if (!only || strcmp(only, "encoding") == 0)
+    benchEncoding();
+  if (!only || strcmp(only, "aggregate") == 0)
+    benchAggregate();
+  if (!only || strcmp(only, "calculations") == 0)
+    benchCalculations();
+  return 0;
+}
@@ -0,0 +1,62 @@
+/*
+ * Host Benchmarks
+ *
+ * Built by the "bench" environment on top of the native stand-ins:
+ * pio run -e bench && .pio/build/bench/program [name]
+ */
+
+#ifndef _Bench_WeatherStation_H_
+#define _Bench_WeatherStation_H_
+
+#include <Arduino.h>
+#include <FS.h>
+#include <native.h>
+
+#include "record.h"
+
+/* Heap allocations (operator new) since program start */
+extern uint64_t benchAllocations;
+
+/* Wall clock in microseconds */
+uint64_t benchMicros();
+
+/* Print that counts write calls and bytes before forwarding them */
+class CountingPrint : public Print
+{
+public:
+  CountingPrint(Print &target) : target(target) {}
+
+  size_t write(uint8_t c)
+  {
+    calls++;
+    bytes++;
+    return target.write(c);
+  }
+
+  size_t write(const uint8_t *buffer, size_t size)
+  {
+    calls++;
+    bytes += size;
+    return target.write(buffer, size);
+  }
+
+  using Print::write;
+
+  uint64_t calls = 0;
+  uint64_t bytes = 0;
+
+private:
+  Print &target;
+};
+
+/* Plausible record with values changing from row to row */
+void benchRecord(SensorRecord &record, uint32_t i);
+
+/* Benchmarks */
+void benchCSVWriter();
+void benchMQTT();
+void benchEncoding();
+void benchAggregate();
+void benchCalculations();
+
+#endif /*_Bench_WeatherStation_H_*/
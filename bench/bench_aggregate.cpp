@@ -0,0 +1,110 @@
+/*
+ * Sub-sample aggregation - the streaming estimators of lib/aggregate
+ * against the exact statistics of the same samples (sorted copy, two-pass
+ * mean and variance), on synthetic Gaussian noise with occasional spikes,
+ * and the error of the median and the mean against the true value. The
+ * bounds are asserted by test/test_aggregate.
+ */
+
+#include "bench.h"
+
+#include <algorithm>
+#include <random>
+#include <vector>
+
+#include "aggregate.h"
+
+#define AGGREGATE_TRIALS 20000
+#define AGGREGATE_TRUTH 21.5   // true value, e.g. a temperature
+#define AGGREGATE_NOISE 0.05   // standard deviation of the noise
+#define AGGREGATE_SPIKE 2.0    // offset of a spike
+#define AGGREGATE_SPIKES 0.08  // probability of a spike per sample
+
+struct AggregateErrors
+{
+  double mean;   // largest difference to the exact value
+  double stddev;
+  double median; // mean absolute difference to the exact median
+  bool extremes; // minimum and maximum always exact
+  double rmsMedian; // against the true value
+  double rmsMean;
+};
+
+static AggregateErrors aggregateTrials(int samples, double spikes, std::mt19937 &rng)
+{
+  std::normal_distribution<double> noise(0.0, AGGREGATE_NOISE);
+  std::uniform_real_distribution<double> uniform(0.0, 1.0);
+  AggregateErrors errors = {0, 0, 0, true, 0, 0};
+  std::vector<float> values(samples);
+
+  for (int trial = 0; trial < AGGREGATE_TRIALS; trial++)
+  {
+    StreamingStats stats;
+    for (int i = 0; i < samples; i++)
+    {
+      double v = AGGREGATE_TRUTH + noise(rng);
+      if (uniform(rng) < spikes)
+        v += AGGREGATE_SPIKE;
+      values[i] = (float)v;
+      stats.add(values[i]);
+    }
+
+    double sum = 0;
+    for (float v : values)
+      sum += v;
+    double mean = sum / samples;
+    double squares = 0;
+    for (float v : values)
+      squares += (v - mean) * (v - mean);
+    double stddev = samples > 1 ? sqrt(squares / (samples - 1)) : 0;
+    std::sort(values.begin(), values.end());
+    double median = samples % 2 ? values[samples / 2] : (values[samples / 2 - 1] + values[samples / 2]) / 2.0;
+
+    errors.mean = std::max(errors.mean, fabs(stats.mean() - mean));
+    errors.stddev = std::max(errors.stddev, fabs(stats.stddev() - stddev));
+    errors.median += fabs(stats.median() - median);
+    errors.extremes = errors.extremes && stats.min() == values.front() && stats.max() == values.back();
+    errors.rmsMedian += (stats.median() - AGGREGATE_TRUTH) * (stats.median() - AGGREGATE_TRUTH);
+    errors.rmsMean += (stats.mean() - AGGREGATE_TRUTH) * (stats.mean() - AGGREGATE_TRUTH);
+  }
+
+  errors.median /= AGGREGATE_TRIALS;
+  errors.rmsMedian = sqrt(errors.rmsMedian / AGGREGATE_TRIALS);
+  errors.rmsMean = sqrt(errors.rmsMean / AGGREGATE_TRIALS);
+  return errors;
+}
+
+void benchAggregate()
+{
+  std::mt19937 rng(1985);
+  const int samples[] = {1, 3, 5, 8, 16, 32};
+  const double spikes[] = {0.0, AGGREGATE_SPIKES};
+
+  for (size_t s = 0; s < sizeof(spikes) / sizeof(spikes[0]); s++)
+  {
+    Serial.printf("\nStreaming statistics, %d trials, noise sd %.3f, spikes of %+.1f in %.0f%% of the samples\n",
+                  AGGREGATE_TRIALS, AGGREGATE_NOISE, AGGREGATE_SPIKE, spikes[s] * 100);
+    Serial.printf("%-8s %12s %12s %14s %8s %12s %12s\n", "samples", "mean err", "sd err", "median err",
+                  "min/max", "rms median", "rms mean");
+    for (size_t k = 0; k < sizeof(samples) / sizeof(samples[0]); k++)
+    {
+      AggregateErrors e = aggregateTrials(samples[k], spikes[s], rng);
+      Serial.printf("%-8d %12.2e %12.2e %14.2e %8s %12.4f %12.4f\n", samples[k], e.mean, e.stddev, e.median,
+                    e.extremes ? "exact" : "differ", e.rmsMedian, e.rmsMean);
+    }
+  }
+  Serial.printf("Errors against the exact statistics, median error is the mean absolute difference,\n"
+                "rms columns are the error against the true value\n");
+
+  /* Cost of a sample on the host */
+  StreamingStats stats;
+  std::normal_distribution<float> noise(AGGREGATE_TRUTH, AGGREGATE_NOISE);
+  std::vector<float> values(100000);
+  for (float &v : values)
+    v = noise(rng);
+  uint64_t start = benchMicros();
+  for (float v : values)
+    stats.add(v);
+  uint64_t elapsed = benchMicros() - start;
+  Serial.printf("add(): %.3f us per sample (median %.4f)\n", (double)elapsed / values.size(), stats.median());
+}
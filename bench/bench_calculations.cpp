@@ -0,0 +1,122 @@
+/*
+ * Derived parameters - the time per reading of the single precision
+ * kernels (scalar and batch) and the double reference. The host FPU handles
+ * double in hardware, so the times only compare the code paths, on the
+ * ESP32 the double versions run in software routines. Their accuracy is
+ * checked by test/test_calculations.
+ */
+
+#include "bench.h"
+
+#include <vector>
+
+#include "calculations.h"
+
+#define CALC_BATCH 4096
+#define CALC_ROUNDS 256
+
+static volatile double calcSink;
+
+/* Nanoseconds per reading of a kernel over the batch arrays */
+template <typename F>
+static double timed(F kernel)
+{
+  uint64_t start = benchMicros();
+  for (int r = 0; r < CALC_ROUNDS; r++)
+    kernel();
+  return (benchMicros() - start) * 1000.0 / ((double)CALC_ROUNDS * CALC_BATCH);
+}
+
+static void speed()
+{
+  std::vector<float> t(CALC_BATCH), rh(CALC_BATCH), pressure(CALC_BATCH), pm25(CALC_BATCH), pm10(CALC_BATCH);
+  std::vector<float> out(CALC_BATCH);
+  std::vector<int16_t> aqi(CALC_BATCH);
+  for (int i = 0; i < CALC_BATCH; i++)
+  {
+    t[i] = 60.0f + (i % 500) / 10.0f; // half of them above 80 F
+    rh[i] = 5.0f + (i % 190) / 2.0f;
+    pressure[i] = 950.0f + (i % 1000) / 10.0f;
+    pm25[i] = (i % 3000) / 10.0f;
+    pm10[i] = (i % 4000) / 10.0f;
+  }
+
+  Serial.printf("\n%-22s %12s %12s %12s\n", "ns/reading", "double", "float", "float batch");
+
+  double reference = timed([&] {
+    double sum = 0;
+    for (int i = 0; i < CALC_BATCH; i++)
+      sum += heatIndex((double)t[i], (double)rh[i]);
+    calcSink = sum;
+  });
+  double scalar = timed([&] {
+    float sum = 0;
+    for (int i = 0; i < CALC_BATCH; i++)
+      sum += heatIndex(t[i], rh[i]);
+    calcSink = sum;
+  });
+  double batch = timed([&] {
+    heatIndex(t.data(), rh.data(), out.data(), CALC_BATCH);
+    calcSink = out[CALC_BATCH - 1];
+  });
+  Serial.printf("%-22s %12.2f %12.2f %12.2f\n", "heat index", reference, scalar, batch);
+
+  reference = timed([&] {
+    double sum = 0;
+    for (int i = 0; i < CALC_BATCH; i++)
+      sum += dewPoint((double)t[i], (double)rh[i]);
+    calcSink = sum;
+  });
+  scalar = timed([&] {
+    float sum = 0;
+    for (int i = 0; i < CALC_BATCH; i++)
+      sum += dewPoint(t[i], rh[i]);
+    calcSink = sum;
+  });
+  batch = timed([&] {
+    dewPoint(t.data(), rh.data(), out.data(), CALC_BATCH);
+    calcSink = out[CALC_BATCH - 1];
+  });
+  Serial.printf("%-22s %12.2f %12.2f %12.2f\n", "dew point", reference, scalar, batch);
+
+  reference = timed([&] {
+    double sum = 0;
+    for (int i = 0; i < CALC_BATCH; i++)
+      sum += pressureMSL((double)pressure[i], 420.0);
+    calcSink = sum;
+  });
+  scalar = timed([&] {
+    float sum = 0;
+    for (int i = 0; i < CALC_BATCH; i++)
+      sum += pressureMSL(pressure[i], 420.0f);
+    calcSink = sum;
+  });
+  batch = timed([&] {
+    pressureMSL(pressure.data(), 420.0f, out.data(), CALC_BATCH);
+    calcSink = out[CALC_BATCH - 1];
+  });
+  Serial.printf("%-22s %12.2f %12.2f %12.2f\n", "pressure (PMSL)", reference, scalar, batch);
+
+  reference = timed([&] {
+    int sum = 0;
+    for (int i = 0; i < CALC_BATCH; i++)
+      sum += airQualityIndex((double)pm25[i], (double)pm10[i]);
+    calcSink = sum;
+  });
+  scalar = timed([&] {
+    int sum = 0;
+    for (int i = 0; i < CALC_BATCH; i++)
+      sum += airQualityIndex(pm25[i], pm10[i]);
+    calcSink = sum;
+  });
+  batch = timed([&] {
+    airQualityIndex(pm25.data(), pm10.data(), aqi.data(), CALC_BATCH);
+    calcSink = aqi[CALC_BATCH - 1];
+  });
+  Serial.printf("%-22s %12.2f %12.2f %12.2f\n", "AQI", reference, scalar, batch);
+}
+
+void benchCalculations()
+{
+  speed();
+}
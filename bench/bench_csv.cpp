@@ -0,0 +1,102 @@
+/*
+ * CSV row writer - String concatenation and one print per cell (as
+ * WriteDataToSD did before) against the fixed buffer and a single write
+ */
+
+#include "bench.h"
+
+#define CSV_ROWS 5000
+
+/* Previous implementation, reading every value back from the JSON document */
+static void legacyRow(Print &dataFile, JsonDocument &data)
+{
+  dataFile.print(String(data["data"]["created_at"].as<const char *>()) + String(","));
+  dataFile.print(String(data["data"][TEMPERATURE].as<float>()) + String(","));
+  dataFile.print(String(data["data"][REL_HUMIDITY].as<float>()) + String(","));
+  dataFile.print(String(data["data"][PRESSURE].as<float>()) + String(","));
+  dataFile.print(String(data["data"][PRESSURE_PMSL].as<float>()) + String(","));
+  dataFile.print(String(data["data"][AIR].as<float>()) + String(","));
+  dataFile.print(String(data["data"][HEAT_INDEX].as<float>()) + String(","));
+  dataFile.print(String(data["data"][DEW_POINT].as<float>()) + String(","));
+  dataFile.print(String(data["data"][PM_ENV_1].as<int>()) + String(","));
+  dataFile.print(String(data["data"][PM_ENV_25].as<int>()) + String(","));
+  dataFile.print(String(data["data"][PM_ENV_100].as<int>()) + String(","));
+  dataFile.print(String(data["data"][PARTICLE_SIZE_3].as<int>()) + String(","));
+  dataFile.print(String(data["data"][PARTICLE_SIZE_5].as<int>()) + String(","));
+  dataFile.print(String(data["data"][PARTICLE_SIZE_10].as<int>()) + String(","));
+  dataFile.print(String(data["data"][PARTICLE_SIZE_25].as<int>()) + String(","));
+  dataFile.print(String(data["data"][PARTICLE_SIZE_50].as<int>()) + String(","));
+  dataFile.print(String(data["data"][PARTICLE_SIZE_100].as<int>()) + String(","));
+  dataFile.print(String(data["data"][AQI].as<float>()) + String(","));
+  dataFile.print(String(data["data"][LIGHT_VISIBLE].as<float>()) + String(","));
+  dataFile.print(String(data["data"][LIGHT_IR].as<float>()) + String(","));
+  dataFile.print(String(data["data"][LIGHT_UV].as<float>()) + String(","));
+  dataFile.print(String(data["data"][UV_INDEX].as<float>()) + String(","));
+  dataFile.print(String(data["data"][BATTERY].as<float>()));
+  dataFile.println();
+}
+
+static void report(const char *name, const CountingPrint &out, uint64_t micros, uint64_t allocations)
+{
+  Serial.printf("%-22s %10.1f %12.1f %10.2f %12.1f\n", name,
+                (double)out.calls / CSV_ROWS, (double)out.bytes / out.calls,
+                (double)micros / CSV_ROWS, (double)allocations / CSV_ROWS);
+}
+
+void benchCSVWriter()
+{
+  fs::FS sd("bench");
+  sd.mount();
+  SensorRecord record;
+
+  Serial.printf("\nCSV row writer, %d rows appended to the SD stand-in\n", CSV_ROWS);
+  Serial.printf("%-22s %10s %12s %10s %12s\n", "", "writes/row", "bytes/write", "us/row", "allocs/row");
+
+  /* Before: JSON lookups, String cells and one print per cell */
+  {
+    File file = sd.open("/legacy.csv", FILE_WRITE);
+    CountingPrint out(file);
+    DynamicJsonDocument doc(1028);
+    uint64_t elapsed = 0;
+    uint64_t allocations = 0;
+    for (uint32_t i = 0; i < CSV_ROWS; i++)
+    {
+      benchRecord(record, i);
+      doc.clear();
+      recordToJson(record, doc.createNestedObject("data"));
+
+      uint64_t allocStart = benchAllocations;
+      uint64_t start = benchMicros();
+      legacyRow(out, doc);
+      elapsed += benchMicros() - start;
+      allocations += benchAllocations - allocStart;
+    }
+    file.close();
+    report("String + print/cell", out, elapsed, allocations);
+  }
+
+  /* After: fixed buffer and a single write */
+  {
+    File file = sd.open("/buffered.csv", FILE_WRITE);
+    CountingPrint out(file);
+    char line[CSV_BUFFER_SIZE];
+    uint64_t elapsed = 0;
+    uint64_t allocations = 0;
+    for (uint32_t i = 0; i < CSV_ROWS; i++)
+    {
+      benchRecord(record, i);
+
+      uint64_t allocStart = benchAllocations;
+      uint64_t start = benchMicros();
+      size_t len = formatCSVRow(line, sizeof(line), record);
+      out.write((const uint8_t *)line, len);
+      elapsed += benchMicros() - start;
+      allocations += benchAllocations - allocStart;
+    }
+    file.close();
+    report("buffered row", out, elapsed, allocations);
+  }
+
+  sd.remove("/legacy.csv");
+  sd.remove("/buffered.csv");
+}
@@ -0,0 +1,208 @@
+/*
+ * Upload encoding - JSON document and serializeJson (labels as keys)
+ * against the MessagePack writer (numeric field IDs) and the columnar
+ * batch (differences as varints), payload size and time to measure and
+ * write a payload like the uploads do, and time to decode a batch
+ */
+
+#include "bench.h"
+
+#include <vector>
+
+#include "columnar.h"
+#include "msgpack.h"
+
+#define ENCODING_READINGS 2304 // 8 days at 5 minute intervals
+#define ENCODING_TOKEN "0123456789abcdef0123456789abcdef"
+#define ENCODING_DEVICE "24A1600DF00D"
+
+static void jsonPayload(const SensorRecord *records, size_t count, JsonDocument &doc)
+{
+  doc.clear();
+  doc["token"] = ENCODING_TOKEN;
+  if (count == 1)
+  {
+    recordToJson(records[0], doc.createNestedObject("data"));
+    doc["data"]["device_id"] = ENCODING_DEVICE;
+    return;
+  }
+  JsonArray batch = doc.createNestedArray("data");
+  for (size_t i = 0; i < count; i++)
+  {
+    JsonObject reading = batch.createNestedObject();
+    recordToJson(records[i], reading);
+    reading["device_id"] = ENCODING_DEVICE;
+  }
+}
+
+/* Same layout as BuildMsgPack() in main.cpp, without the profile */
+static void msgpackPayload(const SensorRecord *records, size_t count, bool columnar, Print &out)
+{
+  MsgPackWriter msgpack(out);
+  msgpack.map(4);
+  msgpack.integer(0);
+  msgpack.integer(RECORD_SCHEMA_VERSION);
+  msgpack.integer(1);
+  msgpack.string(ENCODING_DEVICE);
+  msgpack.integer(2);
+  msgpack.string(ENCODING_TOKEN);
+  if (columnar && count > 1)
+  {
+    MeasurePrint batch;
+    columnarEncode(records, count, batch);
+    msgpack.integer(5);
+    msgpack.binary(batch.bytes);
+    columnarEncode(records, count, out);
+    return;
+  }
+  msgpack.integer(3);
+  msgpack.array(count);
+  for (size_t i = 0; i < count; i++)
+    recordToMsgPack(records[i], msgpack);
+}
+
+/* Collects a columnar batch for the decoder */
+class VectorPrint : public Print
+{
+public:
+  size_t write(uint8_t c)
+  {
+    data.push_back(c);
+    return 1;
+  }
+  size_t write(const uint8_t *buffer, size_t size)
+  {
+    data.insert(data.end(), buffer, buffer + size);
+    return size;
+  }
+
+  std::vector<uint8_t> data;
+};
+
+/* Decode the batches of count readings, returns false if a value differs
+   from the record by more than the rounding to the field's decimals */
+static bool decodeColumnar(const SensorRecord *records, size_t count, uint64_t &micros)
+{
+  std::vector<uint32_t> timestamps(count);
+  std::vector<float> values(count * RECORD_FIELD_COUNT);
+  for (size_t i = 0; i < ENCODING_READINGS; i += count)
+  {
+    VectorPrint batch;
+    columnarEncode(records + i, count, batch);
+
+    uint64_t start = benchMicros();
+    ColumnarHeader header;
+    if (!columnarParseHeader(batch.data.data(), batch.data.size(), header) ||
+        columnarDecode(batch.data.data(), batch.data.size(), header, timestamps.data(), values.data()) != batch.data.size())
+      return false;
+    micros += benchMicros() - start;
+
+    for (size_t r = 0; r < count; r++)
+    {
+      if (timestamps[r] != records[i + r].timestamp)
+        return false;
+      for (size_t f = 0; f < RECORD_FIELD_COUNT; f++)
+      {
+        float expected = getField(records[i + r], RECORD_FIELDS[f]);
+        if (fabs(values[r * RECORD_FIELD_COUNT + f] - expected) > 0.5 * pow(10, -header.decimals[f]) + 1e-4)
+          return false;
+      }
+    }
+  }
+  return true;
+}
+
+struct EncodingResult
+{
+  uint64_t bytes;
+  uint64_t micros;
+  uint64_t allocations;
+};
+
+static void report(const char *name, size_t perPayload, const EncodingResult &result, const EncodingResult &json)
+{
+  Serial.printf("%-8s %10d %14.1f %12.2f %12.1f %10.1fx\n", name, (int)perPayload,
+                (double)result.bytes / ENCODING_READINGS, (double)result.micros / ENCODING_READINGS,
+                (double)result.allocations / ENCODING_READINGS, (double)json.bytes / result.bytes);
+}
+
+void benchEncoding()
+{
+  static SensorRecord records[ENCODING_READINGS];
+  for (uint32_t i = 0; i < ENCODING_READINGS; i++)
+    benchRecord(records[i], i);
+
+  Serial.printf("\nUpload encoding, %d readings, length and body of every payload\n", ENCODING_READINGS);
+  Serial.printf("%-8s %10s %14s %12s %12s %11s\n", "", "per upload", "bytes/reading", "us/reading",
+                "allocs/read.", "smaller");
+
+  const size_t perPayload[] = {1, 24, 288};
+  for (size_t p = 0; p < sizeof(perPayload) / sizeof(perPayload[0]); p++)
+  {
+    size_t n = perPayload[p];
+
+    /* JSON: build the document, then measureJson() and serializeJson() */
+    EncodingResult json = {0, 0, 0};
+    {
+      DynamicJsonDocument doc(256 + n * (JSON_OBJECT_SIZE(RECORD_FIELD_COUNT + 2) + 64));
+      uint64_t allocStart = benchAllocations;
+      uint64_t start = benchMicros();
+      for (size_t i = 0; i < ENCODING_READINGS; i += n)
+      {
+        jsonPayload(records + i, n, doc);
+        MeasurePrint out;
+        size_t length = measureJson(doc);
+        serializeJson(doc, out);
+        json.bytes += length;
+      }
+      json.micros = benchMicros() - start;
+      json.allocations = benchAllocations - allocStart;
+    }
+    report("JSON", n, json, json);
+
+    /* MessagePack: encoded twice from the records, to measure and to write */
+    EncodingResult msgpack = {0, 0, 0};
+    {
+      uint64_t allocStart = benchAllocations;
+      uint64_t start = benchMicros();
+      for (size_t i = 0; i < ENCODING_READINGS; i += n)
+      {
+        MeasurePrint length, out;
+        msgpackPayload(records + i, n, false, length);
+        msgpackPayload(records + i, n, false, out);
+        msgpack.bytes += length.bytes;
+      }
+      msgpack.micros = benchMicros() - start;
+      msgpack.allocations = benchAllocations - allocStart;
+    }
+    report("MsgPack", n, msgpack, json);
+
+    /* Columnar batch in the MessagePack payload, encoded three times */
+    if (n > 1)
+    {
+      EncodingResult columnar = {0, 0, 0};
+      uint64_t allocStart = benchAllocations;
+      uint64_t start = benchMicros();
+      for (size_t i = 0; i < ENCODING_READINGS; i += n)
+      {
+        MeasurePrint length, out;
+        msgpackPayload(records + i, n, true, length);
+        msgpackPayload(records + i, n, true, out);
+        columnar.bytes += length.bytes;
+      }
+      columnar.micros = benchMicros() - start;
+      columnar.allocations = benchAllocations - allocStart;
+      report("Columnar", n, columnar, json);
+    }
+  }
+
+  /* Ingestion side */
+  Serial.printf("\nColumnar decoding (header, timestamps and %d fields)\n", (int)RECORD_FIELD_COUNT);
+  for (size_t p = 1; p < sizeof(perPayload) / sizeof(perPayload[0]); p++)
+  {
+    uint64_t micros = 0;
+    bool ok = decodeColumnar(records, perPayload[p], micros);
+    Serial.printf("%-8s %10d %12.3f us/reading %s\n", "", (int)perPayload[p], (double)micros / ENCODING_READINGS,
+                  ok ? "values match" : "VALUES DIFFER");
+  }
+}
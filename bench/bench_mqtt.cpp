@@ -0,0 +1,146 @@
+/*
+ * Upload transports - REST (HTTPS POST per batch of up to 24 readings)
+ * against MQTT (QoS 1 publishes pipelined over one connection), over the
+ * loopback network with its simulated handshake, round trip and link times
+ */
+
+#include "bench.h"
+
+#include "hal.h"
+#include "mqtt.h"
+
+#define UPLOAD_READINGS 288 // one day at 5 minute intervals
+#define UPLOAD_BATCH 24
+#define PAYLOAD_CAPACITY (256 + UPLOAD_BATCH * (JSON_OBJECT_SIZE(RECORD_FIELD_COUNT + 2) + 64))
+
+class JsonPayload : public Payload
+{
+public:
+  JsonPayload(JsonDocument &doc) : doc(doc) {}
+  size_t length() { return measureJson(doc); }
+  void writeTo(Print &out) { serializeJson(doc, out); }
+
+private:
+  JsonDocument &doc;
+};
+
+static void payload(const SensorRecord *records, size_t count, bool token, JsonDocument &doc)
+{
+  doc.clear();
+  if (token)
+    doc["token"] = "0123456789abcdef0123456789abcdef";
+  JsonArray batch = doc.createNestedArray("data");
+  for (size_t i = 0; i < count; i++)
+  {
+    JsonObject reading = batch.createNestedObject();
+    recordToJson(records[i], reading);
+    reading["device_id"] = "24A1600DF00D";
+  }
+}
+
+struct TransportResult
+{
+  uint64_t simulated; // us of radio time
+  uint64_t bytes;     // sent by the station
+  uint32_t requests;
+};
+
+/* One connection per upload, a POST per batch */
+static bool uploadREST(Network &network, const SensorRecord *records, size_t count, TransportResult &result)
+{
+  DynamicJsonDocument doc(PAYLOAD_CAPACITY);
+  JsonPayload body(doc);
+  String response;
+  for (size_t i = 0; i < count; i += UPLOAD_BATCH)
+  {
+    size_t n = count - i < UPLOAD_BATCH ? count - i : UPLOAD_BATCH;
+    payload(records + i, n, true, doc);
+    if (network.post("https://bench.local/", "application/json", body, response) != 200)
+      return false;
+    result.bytes += body.length();
+    result.requests++;
+  }
+  return true;
+}
+
+/* One connection per upload, publishes pipelined */
+static bool uploadMQTT(MQTTClient &mqtt, const SensorRecord *records, size_t count, TransportResult &result)
+{
+  uint32_t sent = mqtt.bytesSent;
+  if (!mqtt.connect("bench.local", 8883, true, "weatherstation-bench", "24A1600DF00D",
+                    "0123456789abcdef0123456789abcdef"))
+    return false;
+
+  DynamicJsonDocument doc(PAYLOAD_CAPACITY);
+  JsonPayload body(doc);
+  size_t offset = 0;
+  MQTTInflight acked;
+  while (offset < count || mqtt.inflight() > 0)
+  {
+    while (offset < count && mqtt.inflight() < MQTT_INFLIGHT_MAX)
+    {
+      size_t n = count - offset < UPLOAD_BATCH ? count - offset : UPLOAD_BATCH;
+      payload(records + offset, n, false, doc);
+      if (!mqtt.publish("weatherstation/24A1600DF00D/readings", body, n))
+        return false;
+      offset += n;
+      result.requests++;
+    }
+    if (!mqtt.waitAck(acked))
+      return false;
+  }
+  mqtt.disconnect();
+  result.bytes += mqtt.bytesSent - sent;
+  return true;
+}
+
+void benchMQTT()
+{
+  Network &network = getNetwork();
+  MQTTClient mqtt(network);
+  static SensorRecord records[UPLOAD_READINGS];
+  for (uint32_t i = 0; i < UPLOAD_READINGS; i++)
+    benchRecord(records[i], i);
+
+  Serial.printf("\nUpload transports, %d readings over TLS (resumed sessions), radio time of the loopback network\n",
+                UPLOAD_READINGS);
+  Serial.printf("%-6s %10s %10s %12s %12s %12s\n", "", "per upload", "requests", "ms/upload", "ms/reading", "bytes/reading");
+
+  const size_t perUpload[] = {1, 12, 96};
+  for (size_t p = 0; p < sizeof(perUpload) / sizeof(perUpload[0]); p++)
+  {
+    for (int transport = 0; transport < 2; transport++)
+    {
+      // A first upload establishes the TLS session, the others resume it
+      network.begin("bench", "", true);
+      network.waitConnected(30000);
+      TransportResult warmup = {0, 0, 0};
+      bool ok = transport == 0 ? uploadREST(network, records, 1, warmup) : uploadMQTT(mqtt, records, 1, warmup);
+      network.end();
+
+      TransportResult result = {0, 0, 0};
+      uint32_t uploads = 0;
+      for (size_t i = 0; ok && i < UPLOAD_READINGS; i += perUpload[p])
+      {
+        size_t n = UPLOAD_READINGS - i < perUpload[p] ? UPLOAD_READINGS - i : perUpload[p];
+        network.begin("bench", "", true);
+        network.waitConnected(30000);
+        uint64_t start = nativeSimulatedMicros();
+        ok = transport == 0 ? uploadREST(network, records + i, n, result) : uploadMQTT(mqtt, records + i, n, result);
+        result.simulated += nativeSimulatedMicros() - start;
+        network.end();
+        uploads++;
+      }
+      if (!ok)
+      {
+        Serial.printf("%-6s upload failed\n", transport == 0 ? "REST" : "MQTT");
+        continue;
+      }
+
+      Serial.printf("%-6s %10d %10u %12.1f %12.2f %12.1f\n", transport == 0 ? "REST" : "MQTT", (int)perUpload[p],
+                    result.requests, result.simulated / 1000.0 / uploads,
+                    result.simulated / 1000.0 / UPLOAD_READINGS, (double)result.bytes / UPLOAD_READINGS);
+    }
+  }
+  Serial.printf("REST bytes are request bodies only, HTTP headers add about 300 bytes per request\n");
+}
@@ -2,30 +2,50 @@
  * Parameter Labels
  */
 
-const char* TEMPERATURE         = "Temperature [C]";
-const char* REL_HUMIDITY        = "rel. Humidity [%]";
-const char* PRESSURE            = "Pressure [hPa]";
-const char* PRESSURE_PMSL       = "Pressure (PMSL) [hPa]";
-const char* AIR                 = "Air [KOhms]";
-
-const char* LIGHT_VISIBLE       = "Light (visible)";
-const char* LIGHT_IR            = "Light (IR)";
-const char* LIGHT_UV            = "Light (UV)";
-const char* UV_INDEX            = "UV-Index";
-
-const char* PM_ENV_1            = "PM1.0 [ug/m3]";
-const char* PM_ENV_25           = "PM2.5 [ug/m3]";
-const char* PM_ENV_100          = "PM10.0 [ug/m3]";
-
-const char* PARTICLE_SIZE_3     = ">0.3 [um/0.1L]";
-const char* PARTICLE_SIZE_5     = ">0.5 [um/0.1L]";
-const char* PARTICLE_SIZE_10    = ">1.0 [um/0.1L]";
-const char* PARTICLE_SIZE_25    = ">2.5 [um/0.1L]";
-const char* PARTICLE_SIZE_50    = ">5.0 [um/0.1L]";
-const char* PARTICLE_SIZE_100   = ">10.0 [um/0.1L]";
-
-const char* HEAT_INDEX          = "Heat Index [C]";
-const char* DEW_POINT           = "Dew Point [C]";
-const char* AQI                 = "AQI";
-
-const char* BATTERY             = "Battery [V]";
+#ifndef _Parameters_WeatherStation_H_
+#define _Parameters_WeatherStation_H_
+
+static constexpr char TEMPERATURE[]         = "Temperature [C]";
+static constexpr char REL_HUMIDITY[]        = "rel. Humidity [%]";
+static constexpr char PRESSURE[]            = "Pressure [hPa]";
+static constexpr char PRESSURE_PMSL[]       = "Pressure (PMSL) [hPa]";
+static constexpr char AIR[]                 = "Air [KOhms]";
+
+static constexpr char LIGHT_VISIBLE[]       = "Light (visible)";
+static constexpr char LIGHT_IR[]            = "Light (IR)";
+static constexpr char LIGHT_UV[]            = "Light (UV)";
+static constexpr char UV_INDEX[]            = "UV-Index";
+
+static constexpr char PM_ENV_1[]            = "PM1.0 [ug/m3]";
+static constexpr char PM_ENV_25[]           = "PM2.5 [ug/m3]";
+static constexpr char PM_ENV_100[]          = "PM10.0 [ug/m3]";
+
+static constexpr char PARTICLE_SIZE_3[]     = ">0.3 [um/0.1L]";
+static constexpr char PARTICLE_SIZE_5[]     = ">0.5 [um/0.1L]";
+static constexpr char PARTICLE_SIZE_10[]    = ">1.0 [um/0.1L]";
+static constexpr char PARTICLE_SIZE_25[]    = ">2.5 [um/0.1L]";
+static constexpr char PARTICLE_SIZE_50[]    = ">5.0 [um/0.1L]";
+static constexpr char PARTICLE_SIZE_100[]   = ">10.0 [um/0.1L]";
+
+static constexpr char HEAT_INDEX[]          = "Heat Index [C]";
+static constexpr char DEW_POINT[]           = "Dew Point [C]";
+static constexpr char AQI[]                 = "AQI";
+
+static constexpr char BATTERY[]             = "Battery [V]";
+
+static constexpr char SAMPLES[]             = "Samples";
+static constexpr char TEMPERATURE_SD[]      = "Temperature SD [C]";
+static constexpr char REL_HUMIDITY_SD[]     = "rel. Humidity SD [%]";
+static constexpr char PRESSURE_SD[]         = "Pressure SD [hPa]";
+static constexpr char AIR_SD[]              = "Air SD [KOhms]";
+static constexpr char PM_ENV_25_SD[]        = "PM2.5 SD [ug/m3]";
+static constexpr char PM_ENV_100_SD[]       = "PM10.0 SD [ug/m3]";
+
+static constexpr char NOWCAST_AQI[]         = "NowCast AQI";
+
+static constexpr char IAQ[]                 = "IAQ";
+static constexpr char IAQ_CATEGORY[]        = "IAQ Category";
+
+static constexpr char PARTICLE_STATUS[]     = "Particle Status";
+
+#endif /*_Parameters_WeatherStation_H_*/
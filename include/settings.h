@@ -1,17 +1,23 @@
 #ifndef SETTINGS_H_
 #define SETTINGS_H_
 
+  /* Plain data without pointers, so it can be copied as a whole into the
+     binary snapshot. Change SETTINGS_VERSION in main.cpp with the layout. */
+
   struct Settings
   {
     // WiFi credentials
-    String ssid;
-    String password;
+    char ssid[33];
+    char password[65];
+    bool wifiStaticIP; // reuse the IP address of the last connection
 
     // Server
-    String apikey;
-    String server;
+    char apikey[65];
+    char server[129];
+    char serverFingerprint[100]; // SHA-256 of the server certificate (hex)
     int port;
-    String protocol;
+    char protocol[8];
+    char encoding[12]; // JSON, MSGPACK or COLUMNAR
 
     // Station Location
     double longitude;
@@ -19,12 +25,38 @@
     double altitude;
 
     // Time and NTP Server
-    String ntpServer;
-    String timezoneStr;
+    char ntpServer[64];
+    char timezoneStr[64];
     int gmtOffset_sec;
 
     // Sample Frequency
     int sleepDuration;
+    int samplesPerWake; // sub-samples aggregated into one reading
+
+    // Adaptive Sampling (interval bounds in minutes, thresholds, battery in V)
+    int sleepMin;
+    int sleepMax;
+    double adaptPressureRate; // hPa per hour
+    double adaptPMStep;       // ug/m3 between readings
+    double batteryLow;
+    double batteryCritical;
+
+    // Particle Sensor Stabilization (tolerance in %, timeout in seconds)
+    double pmsTolerance;
+    int pmsTimeout;
+
+    // SD Log Format (CSV, BINARY or BOTH)
+    char logFormat[8];
+
+    // Upload Batching (every n wakes or when n readings are queued)
+    int uploadInterval;
+    int uploadThreshold;
+
+    // Add wake cycle statistics to uploads
+    bool uploadProfile;
+
+    // Upload the hourly and daily rollups
+    bool uploadRollups;
   };
 
 #endif
\ No newline at end of file
@@ -0,0 +1,132 @@
+/*
+ * Streaming Statistics
+ */
+
+#include "aggregate.h"
+
+/* Increments of the desired marker positions for the median */
+static const float MARKER_STEP[5] = {0.0f, 0.25f, 0.5f, 0.75f, 1.0f};
+
+static void sortFloats(float *values, uint8_t count)
+{
+  for (uint8_t i = 1; i < count; i++)
+  {
+    float v = values[i];
+    uint8_t j = i;
+    for (; j > 0 && values[j - 1] > v; j--)
+      values[j] = values[j - 1];
+    values[j] = v;
+  }
+}
+
+StreamingStats::StreamingStats() : n(0), avg(0), m2(0), lo(NAN), hi(NAN)
+{
+}
+
+void StreamingStats::add(float value)
+{
+  if (isnan(value))
+    return;
+
+  n++;
+  double delta = value - avg;
+  avg += delta / n;
+  m2 += delta * (value - avg);
+  if (n == 1 || value < lo)
+    lo = value;
+  if (n == 1 || value > hi)
+    hi = value;
+
+  /* The first five samples become the markers */
+  if (n <= 5)
+  {
+    height[n - 1] = value;
+    if (n == 5)
+    {
+      sortFloats(height, 5);
+      for (uint8_t i = 0; i < 5; i++)
+      {
+        pos[i] = i + 1;
+        desired[i] = 1 + 4 * MARKER_STEP[i];
+      }
+    }
+    return;
+  }
+
+  /* Cell of the sample, the outer markers follow the extremes */
+  uint8_t k;
+  if (value < height[0])
+  {
+    height[0] = value;
+    k = 0;
+  }
+  else if (value >= height[4])
+  {
+    height[4] = value;
+    k = 3;
+  }
+  else
+  {
+    k = 0;
+    while (k < 3 && value >= height[k + 1])
+      k++;
+  }
+
+  for (uint8_t i = k + 1; i < 5; i++)
+    pos[i]++;
+  for (uint8_t i = 0; i < 5; i++)
+    desired[i] += MARKER_STEP[i];
+  for (uint8_t i = 1; i < 4; i++)
+    adjustMarker(i);
+}
+
+/* Move a middle marker by one position if it is off, parabolic or linear */
+void StreamingStats::adjustMarker(uint8_t i)
+{
+  float d = desired[i] - pos[i];
+  if (!((d >= 1 && pos[i + 1] - pos[i] > 1) || (d <= -1 && pos[i - 1] - pos[i] < -1)))
+    return;
+
+  int8_t s = d > 0 ? 1 : -1;
+  float parabolic = height[i] + (float)s / (pos[i + 1] - pos[i - 1]) *
+                                    ((pos[i] - pos[i - 1] + s) * (height[i + 1] - height[i]) / (pos[i + 1] - pos[i]) +
+                                     (pos[i + 1] - pos[i] - s) * (height[i] - height[i - 1]) / (pos[i] - pos[i - 1]));
+  if (height[i - 1] < parabolic && parabolic < height[i + 1])
+    height[i] = parabolic;
+  else
+    height[i] += s * (height[i + s] - height[i]) / (pos[i + s] - pos[i]);
+  pos[i] += s;
+}
+
+float StreamingStats::mean() const
+{
+  return n > 0 ? avg : NAN;
+}
+
+float StreamingStats::stddev() const
+{
+  return n > 1 ? sqrt(m2 / (n - 1)) : 0.0f;
+}
+
+float StreamingStats::min() const
+{
+  return lo;
+}
+
+float StreamingStats::max() const
+{
+  return hi;
+}
+
+float StreamingStats::median() const
+{
+  if (n == 0)
+    return NAN;
+  if (n > 5)
+    return height[2];
+
+  float sorted[5];
+  memcpy(sorted, height, n * sizeof(float));
+  sortFloats(sorted, n);
+  return n % 2 ? sorted[n / 2] : (sorted[n / 2 - 1] + sorted[n / 2]) / 2;
+}
@@ -0,0 +1,45 @@
+/*
+ * Streaming Statistics
+ *
+ * Constant-memory estimators for the sub-samples taken in one wake: count,
+ * mean and standard deviation (Welford's algorithm), minimum and maximum,
+ * and the median with the P-square algorithm (Jain and Chlamtac, 1985),
+ * which moves five markers instead of keeping the samples. The median is
+ * exact for up to five samples and an estimate beyond that.
+ */
+
+#ifndef _Aggregate_WeatherStation_H_
+#define _Aggregate_WeatherStation_H_
+
+#include <Arduino.h>
+
+class StreamingStats
+{
+public:
+  StreamingStats();
+
+  /* Add a sample, NaN is ignored */
+  void add(float value);
+
+  uint32_t count() const { return n; }
+  float mean() const;
+  float stddev() const; // sample standard deviation, 0 for less than two samples
+  float min() const;
+  float max() const;
+  float median() const; // NaN without samples
+
+private:
+  void adjustMarker(uint8_t i);
+
+  uint32_t n;
+  double avg;
+  double m2; // sum of squared differences from the mean
+  float lo;
+  float hi;
+
+  float height[5];   // marker heights, the first five samples until there are five
+  int32_t pos[5];    // marker positions
+  float desired[5];  // desired marker positions
+};
+
+#endif /*_Aggregate_WeatherStation_H_*/
@@ -0,0 +1,325 @@
+/*
+ * Backlog Replay
+ */
+
+#include "backlog.h"
+#include "binlog.h"
+
+#include <RTClib.h>
+
+#define SECONDS_PER_DAY 86400UL
+
+/* Window for reading the files, holds a binary file header and more */
+#define BACKLOG_BUFFER_SIZE (2 * BINLOG_HEADER_MAX)
+
+/* CSV files without a header row use the current field order */
+#define BACKLOG_NO_HEADER UINT32_MAX
+
+/* Part of a file in the window, offset is the file position of its start */
+static uint8_t window[BACKLOG_BUFFER_SIZE];
+struct BacklogWindow
+{
+  size_t pos;
+  size_t len;
+  uint32_t offset;
+  bool eof;
+};
+
+/* Collects the readings of one call */
+struct BacklogResult
+{
+  uint32_t after;
+  uint32_t before;
+  SensorRecord *records;
+  size_t max;
+  size_t count;
+  BacklogCursor position; // of the reading passed to collect()
+  BacklogCursor *cursor;
+};
+
+/* Add a reading if it is in range, returns false once no more are needed */
+static bool collect(BacklogResult &result, const SensorRecord &record)
+{
+  if (record.timestamp >= result.before)
+    return false;
+  if (record.timestamp > result.after)
+  {
+    result.records[result.count++] = record;
+    if (result.cursor)
+    {
+      *result.cursor = result.position;
+      result.cursor->timestamp = record.timestamp;
+    }
+  }
+  return result.count < result.max;
+}
+
+/* Start reading at offset */
+static bool seekWindow(File &file, BacklogWindow &w, uint32_t offset)
+{
+  w.pos = 0;
+  w.len = 0;
+  w.offset = offset;
+  w.eof = false;
+  return file.seek(offset);
+}
+
+/* Read more once fewer than need bytes are left, returns false at the end */
+static bool fillWindow(File &file, BacklogWindow &w, size_t need)
+{
+  if (!w.eof && w.len - w.pos < need)
+  {
+    memmove(window, window + w.pos, w.len - w.pos);
+    w.offset += w.pos;
+    w.len -= w.pos;
+    w.pos = 0;
+    size_t n = file.read(window + w.len, BACKLOG_BUFFER_SIZE - w.len);
+    w.eof = n == 0;
+    w.len += n;
+  }
+  return w.pos < w.len;
+}
+
+/* Set a field found in a file, integer fields are left at 0 when invalid */
+static void setFileField(SensorRecord &record, int8_t index, float value)
+{
+  if (index < 0)
+    return;
+  const RecordField &field = RECORD_FIELDS[index];
+  if (field.type != FIELD_FLOAT && (isnan(value) || isinf(value)))
+    return;
+  setField(record, field, value);
+}
+
+/* Position of a label in RECORD_FIELDS, or -1 */
+static int8_t fieldIndex(const char *label)
+{
+  for (size_t i = 0; i < RECORD_FIELD_COUNT; i++)
+  {
+    if (strcmp(RECORD_FIELDS[i].label, label) == 0)
+      return i;
+  }
+  return -1;
+}
+
+/* Read one line without the line break and the offset it starts at,
+   returns false at the end of the file */
+static bool readLine(File &file, BacklogWindow &w, char *line, size_t size, uint32_t &offset)
+{
+  size_t len = 0;
+  bool found = false;
+  offset = w.offset + w.pos;
+  while (fillWindow(file, w, 1))
+  {
+    char c = window[w.pos++];
+    found = true;
+    if (c == '\n')
+      break;
+    if (c != '\r' && len + 1 < size)
+      line[len++] = c;
+  }
+  line[len] = 0;
+  return found;
+}
+
+/* Header row: "Time [Local]","Label",... */
+static uint8_t parseHeaderRow(char *line, int8_t *columns)
+{
+  uint8_t columnCount = 0;
+  char *cell = strtok(line, ",");
+  while ((cell = strtok(NULL, ",")) != NULL && columnCount < BINLOG_MAX_FIELDS)
+  {
+    size_t len = strlen(cell);
+    if (len >= 2 && cell[0] == '"' && cell[len - 1] == '"')
+    {
+      cell[len - 1] = 0;
+      cell++;
+    }
+    columns[columnCount++] = fieldIndex(cell);
+  }
+  return columnCount;
+}
+
+static bool readCSV(File &file, BacklogResult &result, const BacklogCursor *resume)
+{
+  static char line[CSV_BUFFER_SIZE];
+  int8_t columns[BINLOG_MAX_FIELDS];
+  BacklogWindow w;
+  uint32_t offset;
+
+  // Without a header row, the current field order is assumed
+  uint8_t columnCount = RECORD_FIELD_COUNT;
+  for (uint8_t i = 0; i < columnCount; i++)
+    columns[i] = i;
+  result.position.header = BACKLOG_NO_HEADER;
+
+  // Continue at the line of the last reading, with the header row before it
+  seekWindow(file, w, 0);
+  if (resume)
+  {
+    if (resume->header != BACKLOG_NO_HEADER)
+    {
+      if (!seekWindow(file, w, resume->header) || !readLine(file, w, line, sizeof(line), offset) || line[0] != '"')
+        return readCSV(file, result, NULL);
+      columnCount = parseHeaderRow(line, columns);
+      result.position.header = resume->header;
+    }
+    if (!seekWindow(file, w, resume->offset))
+      return readCSV(file, result, NULL);
+  }
+
+  while (readLine(file, w, line, sizeof(line), offset))
+  {
+    if (line[0] == '"')
+    {
+      columnCount = parseHeaderRow(line, columns);
+      result.position.header = offset;
+      continue;
+    }
+
+    SensorRecord record = {};
+    if (!parseTimestamp(line, record.timestamp))
+      continue;
+
+    char *cell = strchr(line, ',');
+    for (uint8_t i = 0; cell != NULL && i < columnCount; i++)
+    {
+      setFileField(record, columns[i], strtod(cell + 1, NULL));
+      cell = strchr(cell + 1, ',');
+    }
+
+    result.position.offset = offset;
+    if (!collect(result, record))
+      return false;
+  }
+  return true;
+}
+
+size_t csvLastHeader(fs::File &file, char *header, size_t size)
+{
+  static char line[CSV_BUFFER_SIZE];
+  BacklogWindow w;
+  uint32_t offset;
+  size_t found = 0;
+
+  if (!seekWindow(file, w, 0))
+    return 0;
+  while (readLine(file, w, line, sizeof(line), offset))
+  {
+    if (line[0] == '"')
+    {
+      found = strlen(line) < size ? strlen(line) : 0;
+      if (found > 0)
+        memcpy(header, line, found + 1);
+    }
+  }
+  return found;
+}
+
+static bool readBinary(File &file, BacklogResult &result, const BacklogCursor *resume)
+{
+  static BinlogSchema schema;
+  int8_t columns[BINLOG_MAX_FIELDS];
+  float values[BINLOG_MAX_FIELDS];
+  bool schemaKnown = false;
+  BacklogWindow w;
+
+  // Continue at the block of the last reading, with the header before it
+  seekWindow(file, w, 0);
+  if (resume)
+  {
+    size_t headerLen = seekWindow(file, w, resume->header) && fillWindow(file, w, BINLOG_HEADER_MAX)
+                           ? binlogParseHeader(window, w.len, schema)
+                           : 0;
+    if (headerLen == 0 || !seekWindow(file, w, resume->offset))
+      return readBinary(file, result, NULL);
+    for (uint16_t i = 0; i < schema.fieldCount; i++)
+      columns[i] = fieldIndex(schema.fields[i].label);
+    schemaKnown = true;
+    result.position.header = resume->header;
+  }
+
+  // Blocks are read through the window, corrupt blocks are skipped byte by
+  // byte. A file header sets the schema of the blocks after it.
+  while (fillWindow(file, w, BINLOG_HEADER_MAX))
+  {
+    size_t headerLen = binlogParseHeader(window + w.pos, w.len - w.pos, schema);
+    if (headerLen > 0)
+    {
+      for (uint16_t i = 0; i < schema.fieldCount; i++)
+        columns[i] = fieldIndex(schema.fields[i].label);
+      schemaKnown = true;
+      result.position.header = w.offset + w.pos;
+      w.pos += headerLen;
+      continue;
+    }
+
+    uint16_t count = 0;
+    size_t blockLen = schemaKnown ? binlogParseBlock(window + w.pos, w.len - w.pos, schema, count) : 0;
+    if (blockLen == 0)
+    {
+      w.pos++;
+      continue;
+    }
+
+    result.position.offset = w.offset + w.pos;
+    for (uint16_t r = 0; r < count; r++)
+    {
+      SensorRecord record = {};
+      binlogDecodeRecord(window + w.pos + BINLOG_BLOCK_HEADER_SIZE + (size_t)r * schema.recordSize, schema, record.timestamp, values);
+      for (uint16_t i = 0; i < schema.fieldCount; i++)
+        setFileField(record, columns[i], values[i]);
+
+      if (!collect(result, record))
+        return false;
+    }
+    w.pos += blockLen;
+  }
+  return true;
+}
+
+size_t backlogRead(fs::FS &fs, bool binary, uint32_t after, uint32_t before, SensorRecord *records, size_t max,
+                   BacklogCursor *cursor)
+{
+  BacklogResult result = {after, before, records, max, 0, {}, cursor};
+  if (max == 0 || before <= after)
+    return 0;
+
+  // Daily files from the day of the first missing reading on
+  uint32_t day = after - after % SECONDS_PER_DAY;
+  if (before > BACKLOG_MAX_DAYS * SECONDS_PER_DAY && day < before - BACKLOG_MAX_DAYS * SECONDS_PER_DAY)
+    day = before - before % SECONDS_PER_DAY - BACKLOG_MAX_DAYS * SECONDS_PER_DAY;
+
+  // The cursor is only valid where the last call stopped
+  BacklogCursor last;
+  const BacklogCursor *resume = NULL;
+  if (cursor && cursor->timestamp == after && cursor->binary == binary && cursor->day >= day)
+  {
+    last = *cursor;
+    resume = &last;
+    day = last.day;
+  }
+  result.position.binary = binary;
+
+  for (; day < before; day += SECONDS_PER_DAY)
+  {
+    char path[] = "/YYYY/MM/YYYY-MM-DD.xxx";
+    DateTime(day).toString(path);
+    strcpy(path + strlen(path) - 3, binary ? "bin" : "csv");
+
+    if (!fs.exists(path))
+      continue;
+
+    File file = fs.open(path, FILE_READ);
+    if (!file)
+      continue;
+
+    result.position.day = day;
+    const BacklogCursor *start = resume && resume->day == day ? resume : NULL;
+    bool more = binary ? readBinary(file, result, start) : readCSV(file, result, start);
+    file.close();
+    if (!more)
+      break;
+  }
+  return result.count;
+}
@@ -0,0 +1,46 @@
+/*
+ * Backlog Replay
+ *
+ * Reads readings back from the daily log files on the SD card, so readings
+ * that never reached the server, e.g. because the upload queue was lost
+ * or overflowed during a long WiFi outage, can still be uploaded later.
+ * Columns are matched by label, so files written with an older field
+ * layout are read as well. Readings are returned oldest first.
+ */
+
+#ifndef _Backlog_WeatherStation_H_
+#define _Backlog_WeatherStation_H_
+
+#include <FS.h>
+
+#include "record.h"
+
+/* Days searched back at most */
+#define BACKLOG_MAX_DAYS 31
+
+/* Where the last call stopped: the file and the block or line of the last
+   reading it returned, and the file header or header row before it */
+struct BacklogCursor
+{
+  uint32_t timestamp; // of the last reading returned, 0 if none
+  uint32_t day;
+  uint32_t header;
+  uint32_t offset;
+  bool binary;
+};
+
+/*
+ * Copy up to max logged readings with after < timestamp < before from the
+ * daily binary (.bin) or CSV (.csv) files. Returns the number of readings.
+ * With a cursor, a call with after set to the last reading returned by the
+ * call before continues where that one stopped, instead of reading the
+ * files from the start again.
+ */
+size_t backlogRead(fs::FS &fs, bool binary, uint32_t after, uint32_t before, SensorRecord *records, size_t max,
+                   BacklogCursor *cursor = NULL);
+
+/* Copy the last header row of a daily CSV file, without the line break.
+   Returns its length, 0 if the file has none or it does not fit. */
+size_t csvLastHeader(fs::File &file, char *header, size_t size);
+
+#endif /*_Backlog_WeatherStation_H_*/
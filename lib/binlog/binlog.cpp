@@ -0,0 +1,238 @@
+/*
+ * Binary Record Log
+ */
+
+#include "binlog.h"
+#include "checksum.h"
+
+/* Little-endian helpers */
+static void put16(uint8_t *p, uint16_t v)
+{
+  p[0] = v;
+  p[1] = v >> 8;
+}
+
+static void put32(uint8_t *p, uint32_t v)
+{
+  p[0] = v;
+  p[1] = v >> 8;
+  p[2] = v >> 16;
+  p[3] = v >> 24;
+}
+
+static uint16_t get16(const uint8_t *p)
+{
+  return (uint16_t)p[0] | ((uint16_t)p[1] << 8);
+}
+
+static uint32_t get32(const uint8_t *p)
+{
+  return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static uint8_t fieldSize(uint8_t type)
+{
+  return type == FIELD_FLOAT ? 4 : 2;
+}
+
+size_t binlogRecordSize(const RecordField *fields, size_t count)
+{
+  size_t size = 4;
+  for (size_t i = 0; i < count; i++)
+    size += fieldSize(fields[i].type);
+  return size;
+}
+
+size_t binlogHeader(uint8_t *buffer, size_t size, const RecordField *fields, size_t count)
+{
+  size_t len = 12;
+  for (size_t i = 0; i < count; i++)
+  {
+    const RecordField &field = fields[i];
+    size_t labelLen = strlen(field.label);
+    size_t unitLen = strlen(field.unit);
+    if (len + 4 + labelLen + unitLen + 4 > size)
+      return 0;
+
+    buffer[len++] = field.type;
+    buffer[len++] = field.precision;
+    buffer[len++] = labelLen;
+    memcpy(buffer + len, field.label, labelLen);
+    len += labelLen;
+    buffer[len++] = unitLen;
+    memcpy(buffer + len, field.unit, unitLen);
+    len += unitLen;
+  }
+
+  put32(buffer, BINLOG_MAGIC);
+  put16(buffer + 4, BINLOG_VERSION);
+  put16(buffer + 6, count);
+  put16(buffer + 8, binlogRecordSize(fields, count));
+  put16(buffer + 10, len - 12);
+  put32(buffer + len, crc32(buffer, len));
+  return len + 4;
+}
+
+size_t binlogBlock(uint8_t *buffer, size_t size, const SensorRecord *records, uint16_t count,
+                   const RecordField *fields, size_t fieldCount)
+{
+  size_t len = BINLOG_BLOCK_HEADER_SIZE + (size_t)count * binlogRecordSize(fields, fieldCount);
+  if (len > size)
+    return 0;
+
+  uint8_t *p = buffer + BINLOG_BLOCK_HEADER_SIZE;
+  for (uint16_t r = 0; r < count; r++)
+  {
+    put32(p, records[r].timestamp);
+    p += 4;
+    for (size_t i = 0; i < fieldCount; i++)
+    {
+      const RecordField &field = fields[i];
+      const uint8_t *value = (const uint8_t *)&records[r] + field.offset;
+      if (field.type == FIELD_FLOAT)
+      {
+        uint32_t bits;
+        memcpy(&bits, value, 4);
+        put32(p, bits);
+        p += 4;
+      }
+      else
+      {
+        uint16_t bits;
+        memcpy(&bits, value, 2);
+        put16(p, bits);
+        p += 2;
+      }
+    }
+  }
+
+  put16(buffer, BINLOG_SYNC);
+  put16(buffer + 2, count);
+  put32(buffer + 4, crc32(buffer + BINLOG_BLOCK_HEADER_SIZE, len - BINLOG_BLOCK_HEADER_SIZE));
+  return len;
+}
+
+size_t binlogParseHeader(const uint8_t *data, size_t len, BinlogSchema &schema)
+{
+  if (len < 16 || get32(data) != BINLOG_MAGIC)
+    return 0;
+
+  // The schema is left as it is unless the CRC matches
+  size_t schemaSize = get16(data + 10);
+  size_t headerLen = 12 + schemaSize + 4;
+  if (get16(data + 4) != BINLOG_VERSION || get16(data + 6) > BINLOG_MAX_FIELDS || headerLen > len)
+    return 0;
+  if (crc32(data, 12 + schemaSize) != get32(data + 12 + schemaSize))
+    return 0;
+
+  schema.version = get16(data + 4);
+  schema.fieldCount = get16(data + 6);
+  schema.recordSize = get16(data + 8);
+
+  const uint8_t *p = data + 12;
+  const uint8_t *end = data + 12 + schemaSize;
+  size_t recordSize = 4;
+  for (uint16_t i = 0; i < schema.fieldCount; i++)
+  {
+    BinlogSchemaField &field = schema.fields[i];
+    if (p + 3 > end)
+      return 0;
+    field.type = *p++;
+    field.precision = *p++;
+
+    uint8_t labelLen = *p++;
+    if (p + labelLen + 1 > end || labelLen >= sizeof(field.label))
+      return 0;
+    memcpy(field.label, p, labelLen);
+    field.label[labelLen] = 0;
+    p += labelLen;
+
+    uint8_t unitLen = *p++;
+    if (p + unitLen > end || unitLen >= sizeof(field.unit))
+      return 0;
+    memcpy(field.unit, p, unitLen);
+    field.unit[unitLen] = 0;
+    p += unitLen;
+
+    recordSize += fieldSize(field.type);
+  }
+  return recordSize == schema.recordSize ? headerLen : 0;
+}
+
+size_t binlogParseBlock(const uint8_t *data, size_t len, const BinlogSchema &schema, uint16_t &count)
+{
+  if (len < BINLOG_BLOCK_HEADER_SIZE || get16(data) != BINLOG_SYNC)
+    return 0;
+
+  count = get16(data + 2);
+  size_t blockLen = BINLOG_BLOCK_HEADER_SIZE + (size_t)count * schema.recordSize;
+  if (count == 0 || blockLen > len)
+    return 0;
+  if (crc32(data + BINLOG_BLOCK_HEADER_SIZE, blockLen - BINLOG_BLOCK_HEADER_SIZE) != get32(data + 4))
+    return 0;
+  return blockLen;
+}
+
+void binlogDecodeRecord(const uint8_t *record, const BinlogSchema &schema, uint32_t &timestamp, float *values)
+{
+  timestamp = get32(record);
+  const uint8_t *p = record + 4;
+  for (uint16_t i = 0; i < schema.fieldCount; i++)
+  {
+    switch (schema.fields[i].type)
+    {
+    case FIELD_FLOAT:
+    {
+      uint32_t bits = get32(p);
+      memcpy(&values[i], &bits, 4);
+      p += 4;
+      break;
+    }
+    case FIELD_INT16:
+      values[i] = (int16_t)get16(p);
+      p += 2;
+      break;
+    default:
+      values[i] = get16(p);
+      p += 2;
+      break;
+    }
+  }
+}
+
+size_t binlogLastHeader(fs::File &file, uint8_t *header, size_t size)
+{
+  static uint8_t window[2 * BINLOG_HEADER_MAX];
+  static BinlogSchema schema;
+  size_t found = 0;
+  size_t len = 0;
+  size_t pos = 0;
+  bool eof = !file.seek(0);
+
+  // Headers are found by their magic and checked by their CRC
+  while (true)
+  {
+    if (!eof && len - pos < BINLOG_HEADER_MAX)
+    {
+      memmove(window, window + pos, len - pos);
+      len -= pos;
+      pos = 0;
+      size_t n = file.read(window + len, sizeof(window) - len);
+      eof = n == 0;
+      len += n;
+    }
+    if (pos + 4 > len)
+      return found;
+
+    size_t headerLen = get32(window + pos) == BINLOG_MAGIC ? binlogParseHeader(window + pos, len - pos, schema) : 0;
+    if (headerLen > 0)
+    {
+      found = headerLen <= size ? headerLen : 0;
+      if (found > 0)
+        memcpy(header, window + pos, headerLen);
+      pos += headerLen;
+      continue;
+    }
+    pos++;
+  }
+}
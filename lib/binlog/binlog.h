@@ -0,0 +1,99 @@
+/*
+ * Binary Record Log
+ *
+ * Compact, append-only alternative to the daily CSV files. Values are
+ * stored as fixed-width little-endian fields in the order of RECORD_FIELDS.
+ * The schema (type, precision, label and unit of every field) is embedded
+ * in the file header, so files stay readable after fields are added.
+ *
+ * File header
+ *   u32 magic "WSBL", u16 version, u16 field count, u16 record size,
+ *   u16 schema size, schema, u32 CRC-32 of everything before
+ *   schema entry: u8 type, u8 precision, u8 length + label, u8 length + unit
+ *
+ * Block (one per write, usually one record per wake)
+ *   u16 sync "WB", u16 record count, u32 CRC-32 of the records, records
+ *   record: u32 timestamp, fields
+ *
+ * A torn block at the end of a file (power loss during a write) fails the
+ * CRC check and is skipped by the reader, which resynchronizes on the next
+ * sync word.
+ *
+ * When the schema changes during a day, e.g. after a firmware update, the
+ * writer appends a new file header before the next block. Readers switch
+ * to the schema of every header they find, so a day can mix schemas.
+ */
+
+#ifndef _Binlog_WeatherStation_H_
+#define _Binlog_WeatherStation_H_
+
+#include <FS.h>
+
+#include "record.h"
+
+#define BINLOG_MAGIC 0x4C425357 // "WSBL"
+#define BINLOG_VERSION 1
+#define BINLOG_SYNC 0x4257 // "WB"
+#define BINLOG_BLOCK_HEADER_SIZE 8
+#define BINLOG_HEADER_MAX 1024 // largest header that is read
+#define BINLOG_MAX_FIELDS 48
+
+/* Length of the file header for fields, the schema entries and 16 bytes */
+constexpr size_t binlogHeaderLength(const RecordField *fields = RECORD_FIELDS, size_t count = RECORD_FIELD_COUNT)
+{
+  return count == 0 ? 16 : 4 + csvLength(fields->label) + csvLength(fields->unit) + binlogHeaderLength(fields + 1, count - 1);
+}
+
+static_assert(binlogHeaderLength() <= BINLOG_HEADER_MAX, "binary log header grows past BINLOG_HEADER_MAX");
+
+/* The current schema is written with the defaults, other fields are only
+   used to write files of an older layout, e.g. in tests */
+
+/* Size of one record */
+size_t binlogRecordSize(const RecordField *fields = RECORD_FIELDS, size_t count = RECORD_FIELD_COUNT);
+
+/* File header, returns the length or 0 */
+size_t binlogHeader(uint8_t *buffer, size_t size, const RecordField *fields = RECORD_FIELDS,
+                    size_t count = RECORD_FIELD_COUNT);
+
+/* Block with count records, returns the length or 0 if it does not fit */
+size_t binlogBlock(uint8_t *buffer, size_t size, const SensorRecord *records, uint16_t count,
+                   const RecordField *fields = RECORD_FIELDS, size_t fieldCount = RECORD_FIELD_COUNT);
+
+/* Schema as read back from a file header */
+struct BinlogSchemaField
+{
+  uint8_t type;
+  uint8_t precision;
+  char label[48];
+  char unit[16];
+};
+
+struct BinlogSchema
+{
+  uint16_t version;
+  uint16_t fieldCount;
+  uint16_t recordSize;
+  BinlogSchemaField fields[BINLOG_MAX_FIELDS];
+};
+
+/* Parse a file header, returns its length or 0 if it is invalid */
+size_t binlogParseHeader(const uint8_t *data, size_t len, BinlogSchema &schema);
+
+/*
+ * Check the block at data, returns its length and the number of records,
+ * or 0 if there is no complete block with a valid CRC at this position.
+ */
+size_t binlogParseBlock(const uint8_t *data, size_t len, const BinlogSchema &schema, uint16_t &count);
+
+/* Decode one record of a valid block, values has schema.fieldCount entries */
+void binlogDecodeRecord(const uint8_t *record, const BinlogSchema &schema, uint32_t &timestamp, float *values);
+
+/*
+ * Copy the last valid file header of a file, whose schema applies to the
+ * blocks appended next. Returns its length, or 0 if there is none or it is
+ * larger than size.
+ */
+size_t binlogLastHeader(fs::File &file, uint8_t *header, size_t size);
+
+#endif /*_Binlog_WeatherStation_H_*/
@@ -81,151 +81,94 @@ float FtoC( float f ){
 }
 
 /*
- * Calculate AQI according to AirNOW.gov
- * Equations taken from javascript code on website
- * https://www.airnow.gov/aqi/aqi-calculator-concentration/
+ * NowCast for PM2.5 and PM10
+ *
+ * Source: https://document.airnow.gov/technical-assistance-document-for-the-reporting-of-daily-air-quailty.pdf
+ *
+ * The NowCast weighs the last 12 hourly averages, the newest hour the most.
+ * The weight factor follows how much the concentration changed: the lowest
+ * divided by the highest average, but not below 0.5 for particles. The
+ * result is truncated to the decimals of the pollutant's table (PM2.5 to
+ * 0.1 ug/m3, PM10 to 1 ug/m3) before the AQI is looked up.
  */
 
-float Linear(float AQIhigh, float AQIlow, float Conchigh, float Conclow, float Conc) {
-    float a = ((Conc - Conclow) / (Conchigh - Conclow)) * (AQIhigh - AQIlow) + AQIlow;
-    return (int) a;
-}
-
-// Calculate AQI for PM2.5 particles
-int AQIPM25( float conc) {
-    float c =  (10.0 * conc) / 10.0;
-    int AQI;
-    if (c >= 0 && c < 12.1) {
-        AQI = Linear(50.0, 0.0, 12.0, 0.0, c);
+float nowCast( Pollutant pollutant, const float *hourly, uint8_t hours ) {
+    if (hours > NOWCAST_HOURS) {
+        hours = NOWCAST_HOURS;
     }
-    else if (c >= 12.1 && c < 35.5) {
-        AQI = Linear(100.0, 51.0, 35.4, 12.1, c);
-    }
-    else if (c >= 35.5 && c < 55.5) {
-        AQI = Linear(150.0, 101.0, 55.4, 35.5, c);
+
+    // Two of the three newest hours are required
+    uint8_t recent = 0;
+    for (uint8_t i = 0; i < hours && i < 3; i++) {
+        recent += !isnan(hourly[i]);
     }
-    else if (c >= 55.5 && c < 150.5) {
-        AQI = Linear(200.0, 151.0, 150.4, 55.5, c);
+    if (recent < 2) {
+        return NAN;
     }
-    else if (c >= 150.5 && c < 250.5) {
-        AQI = Linear(300.0, 201.0, 250.4, 150.5, c);
+
+    float lowest = INFINITY;
+    float highest = 0;
+    for (uint8_t i = 0; i < hours; i++) {
+        if (!isnan(hourly[i])) {
+            lowest = hourly[i] < lowest ? hourly[i] : lowest;
+            highest = hourly[i] > highest ? hourly[i] : highest;
+        }
     }
-    else if (c >= 250.5 && c < 350.5) {
-        AQI = Linear(400.0, 301.0, 350.4, 250.5, c);
+    float weight = highest > 0 ? lowest / highest : 1.0f;
+    if (weight < 0.5f) {
+        weight = 0.5f;
     }
-    else if (c >= 350.5 && c < 500.5) {
-        AQI = Linear(500.0, 401.0, 500.4, 350.5, c);
+
+    float sum = 0;
+    float weights = 0;
+    float factor = 1.0f;
+    for (uint8_t i = 0; i < hours; i++) {
+        if (!isnan(hourly[i])) {
+            sum += factor * hourly[i];
+            weights += factor;
+        }
+        factor *= weight;
     }
-    else {
-        AQI = -1;
+
+    float scale = 1.0f;
+    for (uint8_t d = 0; d < AQI_TABLES[pollutant].decimals; d++) {
+        scale *= 10.0f;
     }
-    return AQI;
+    return floorf(sum / weights * scale) / scale;
 }
 
-// Calculate AQI for PM10 particles
-int AQIPM10( float c) {
-    int AQI;
-    if (c >= 0.0 && c < 55.0) {
-        AQI = Linear(50.0, 0.0, 54.0, 0.0, c);
-    }
-    else if (c >= 55.0 && c < 155.0) {
-        AQI = Linear(100.0, 51.0, 154.0, 55.0, c);
-    }
-    else if (c >= 155.0 && c < 255.0) {
-        AQI = Linear(150.0, 101.0, 254.0, 155.0, c);
-    }
-    else if (c >= 255.0 && c < 355.0) {
-        AQI = Linear(200.0, 151.0, 354.0, 255.0, c);
-    }
-    else if (c >= 355.0 && c < 425.0) {
-        AQI = Linear(300.0, 201.0, 424.0, 355.0, c);
-    }
-    else if (c >= 425.0 && c < 505.0) {
-        AQI = Linear(400.0, 301.0, 504.0, 425.0, c);
-    }
-    else if (c >= 505.0 && c < 605.0) {
-        AQI = Linear(500.0, 401.0, 604.0, 505.0, c);
-    }
-    else {
-        AQI = -1;
+int nowCastAQI( float pm25, float pm10 ) {
+    int aqi25 = isnan(pm25) ? -1 : aqiIndex(POLLUTANT_PM25, pm25);
+    int aqi10 = isnan(pm10) ? -1 : aqiIndex(POLLUTANT_PM10, pm10);
+    return aqi10 > aqi25 ? aqi10 : aqi25;
+}
+
+/*
+ * Batch versions for arrays of readings
+ */
+
+void heatIndex( const float *T, const float *RH, float *HI, size_t count ) {
+    for (size_t i = 0; i < count; i++) {
+        HI[i] = heatIndex(T[i], RH[i]);
     }
-    return AQI;
 }
 
-int calculateAQI( float PM25, float PM10 ) {
-    int AQI10 = AQIPM10( PM10 );
-    int AQI25 = AQIPM25( PM25 );
-    if( AQI10 > AQI25 ) {
-        return AQI10;
+void dewPoint( const float *T, const float *RH, float *DP, size_t count ) {
+    for (size_t i = 0; i < count; i++) {
+        DP[i] = dewPoint(T[i], RH[i]);
     }
-    else {
-        return AQI25;
-    } 
 }
 
+// The altitude factor is the same for all readings
+void pressureMSL( const float *pressure, float altitude, float *PMSL, size_t count ) {
+    float factor = 1.0f / powf(1.0f - (altitude / 44330.0f), 5.255f);
+    for (size_t i = 0; i < count; i++) {
+        PMSL[i] = pressure[i] * factor;
+    }
+}
 
-// https://github.com/G6EJD/BME680-Example
-
-// float hum_weighting = 0.25; // so hum effect is 25% of the total air quality score
-// float gas_weighting = 0.75; // so gas effect is 75% of the total air quality score
-
-// int   humidity_score, gas_score;
-// float gas_reference = 2500;
-// float hum_reference = 40;
-// int   getgasreference_count = 0;
-// int   gas_lower_limit = 10000;  // Bad air quality limit
-// int   gas_upper_limit = 300000; // Good air quality limit
-
-// void GetGasReference() {
-//   // Now run the sensor for a burn-in period, then use combination of relative humidity and gas resistance to estimate indoor air quality as a percentage.
-//   //Serial.println("Getting a new gas reference value");
-//   int readings = 10;
-//   for (int i = 1; i <= readings; i++) { // read gas for 10 x 0.150mS = 1.5secs
-//     gas_reference += bme.readGas();
-//   }
-//   gas_reference = gas_reference / readings;
-//   //Serial.println("Gas Reference = "+String(gas_reference,3));
-// }
-
-// String CalculateIAQ(int score) {
-//   String IAQ_text = "air quality is ";
-//   score = (100 - score) * 5;
-//   if      (score >= 301)                  IAQ_text += "Hazardous";
-//   else if (score >= 201 && score <= 300 ) IAQ_text += "Very Unhealthy";
-//   else if (score >= 176 && score <= 200 ) IAQ_text += "Unhealthy";
-//   else if (score >= 151 && score <= 175 ) IAQ_text += "Unhealthy for Sensitive Groups";
-//   else if (score >=  51 && score <= 150 ) IAQ_text += "Moderate";
-//   else if (score >=  00 && score <=  50 ) IAQ_text += "Good";
-//   Serial.print("IAQ Score = " + String(score) + ", ");
-//   return IAQ_text;
-// }
-
-// // Calculate humidity contribution to IAQ index
-// int GetHumidityScore(float current_humidity) {  
-//     // Humidity +/-5% around optimum
-//   if (current_humidity >= 38 && current_humidity <= 42)
-//     humidity_score = 0.25 * 100;
-//   else
-//   { // Humidity is sub-optimal
-//     if (current_humidity < 38)
-//       humidity_score = 0.25 / hum_reference * current_humidity * 100;
-//     else
-//     {
-//       humidity_score = ((-0.25 / (100 - hum_reference) * current_humidity) + 0.416666) * 100;
-//     }
-//   }
-//   return humidity_score;
-// }
-
-// int GetGasScore( float gas_reference) {
-//   //Calculate gas contribution to IAQ index
-//   gas_score = (0.75 / (gas_upper_limit - gas_lower_limit) * gas_reference - (gas_lower_limit * (0.75 / (gas_upper_limit - gas_lower_limit)))) * 100.00;
-//   if (gas_score > 75) gas_score = 75; // Sometimes gas readings can go outside of expected scale maximum
-//   if (gas_score <  0) gas_score = 0;  // Sometimes gas readings can go outside of expected scale minimum
-//   return gas_score;
-// }
-
-//   humidity_score = GetHumidityScore();
-//   gas_score      = GetGasScore();
-
-//   float air_quality_score = humidity_score(55.1) + gas_score(7.03);
+void airQualityIndex( const float *PM25, const float *PM10, int16_t *AQI, size_t count ) {
+    for (size_t i = 0; i < count; i++) {
+        AQI[i] = airQualityIndex(PM25[i], PM10[i]);
+    }
+}
@@ -1,10 +1,21 @@
 /*
  * Calculate additional parameters from measurements
+ *
+ * The double versions of heat index and dew point are the reference. The
+ * templated kernels below compute the same equations in the precision of
+ * their arguments: the ESP32 FPU only handles single precision, double
+ * math runs in software routines. Called with float arguments, heatIndex()
+ * and dewPoint() use the float kernels. The batch versions work on arrays
+ * of readings, e.g. to recalculate logged data.
  */
 
 #ifndef _Calculations_WeatherParamters_H_
 #define _Calculations_WeatherParamters_H_
 
+#include <math.h>
+#include <stddef.h>
+#include <stdint.h>
+
 /* Heat Index - Provide Temperature in F */
 double heatIndex( double T, double RH );
 
@@ -17,7 +28,141 @@ float CtoF( float c );
 /* Conversion - Provide Temperature in F */
 float FtoC( float f );
 
-/* AQI Calculation from PM2.5 and PM10 */
-int calculateAQI( float PM25, float PM10 );
+/* Math functions in the precision of the argument */
+inline float calcLog( float x ) { return logf(x); }
+inline double calcLog( double x ) { return log(x); }
+inline float calcSqrt( float x ) { return sqrtf(x); }
+inline double calcSqrt( double x ) { return sqrt(x); }
+inline float calcPow( float x, float y ) { return powf(x, y); }
+inline double calcPow( double x, double y ) { return pow(x, y); }
+inline float calcAbs( float x ) { return fabsf(x); }
+inline double calcAbs( double x ) { return fabs(x); }
+
+/* Heat Index - Provide Temperature in F, regression in Horner form */
+template <typename T>
+T heatIndex( T t, T rh )
+{
+    T hi = T(0.5) * (t + T(61.0) + ((t - T(68.0)) * T(1.2)) + (rh * T(0.094)));
+    if (hi <= T(80.0))
+        return hi;
+
+    hi = T(-42.379) + t * (T(2.04901523) - T(.00683783) * t) + rh * (T(10.14333127) - T(.05481717) * rh) +
+         t * rh * (T(-.22475541) + T(.00122874) * t + T(.00085282) * rh - T(.00000199) * t * rh);
+    if (rh < T(13.0) && t >= T(80.0) && t <= T(112.0))
+        hi -= ((T(13.0) - rh) / T(4)) * calcSqrt((T(17.0) - calcAbs(t - T(95.0))) / T(17));
+    else if (rh > T(85.0) && t >= T(80.0) && t <= T(87.0))
+        hi += ((rh - T(85)) / T(10)) * ((T(87) - t) / T(5));
+    return hi;
+}
+
+/* Dew Point - Provide Temperature in C, the Magnus term is computed once */
+template <typename T>
+T dewPoint( T t, T rh )
+{
+    T gamma = calcLog(rh / T(100)) + (T(17.625) * t) / (T(243.04) + t);
+    return T(243.04) * gamma / (T(17.625) - gamma);
+}
+
+/* Pressure at mean sea level - Provide the station pressure and altitude in meters */
+template <typename T>
+T pressureMSL( T pressure, T altitude )
+{
+    return pressure / calcPow(T(1.0) - (altitude / T(44330.0)), T(5.255));
+}
+
+/* AQI breakpoint, applies from its concentration to the next one */
+struct AQIBreakpoint
+{
+    float concLow;
+    float concHigh;
+    float aqiLow;
+    float aqiHigh;
+};
+
+/* Breakpoints of a pollutant in ascending order, concentrations from the
+   limit on have no AQI. NowCast concentrations are truncated to decimals. */
+struct AQITable
+{
+    const AQIBreakpoint *breakpoints;
+    uint8_t count;
+    float limit;
+    uint8_t decimals;
+};
+
+/* Pollutants with an AQI, index of AQI_TABLES */
+enum Pollutant
+{
+    POLLUTANT_PM25,
+    POLLUTANT_PM10,
+    POLLUTANT_COUNT
+};
+
+/* Breakpoints of the AirNow calculator,
+   https://www.airnow.gov/aqi/aqi-calculator-concentration/ */
+static constexpr AQIBreakpoint AQI_PM25[] = {
+    {  0.0f,  12.0f,   0.0f,  50.0f},
+    { 12.1f,  35.4f,  51.0f, 100.0f},
+    { 35.5f,  55.4f, 101.0f, 150.0f},
+    { 55.5f, 150.4f, 151.0f, 200.0f},
+    {150.5f, 250.4f, 201.0f, 300.0f},
+    {250.5f, 350.4f, 301.0f, 400.0f},
+    {350.5f, 500.4f, 401.0f, 500.0f},
+};
+
+static constexpr AQIBreakpoint AQI_PM10[] = {
+    {  0.0f,  54.0f,   0.0f,  50.0f},
+    { 55.0f, 154.0f,  51.0f, 100.0f},
+    {155.0f, 254.0f, 101.0f, 150.0f},
+    {255.0f, 354.0f, 151.0f, 200.0f},
+    {355.0f, 424.0f, 201.0f, 300.0f},
+    {425.0f, 504.0f, 301.0f, 400.0f},
+    {505.0f, 604.0f, 401.0f, 500.0f},
+};
+
+static constexpr AQITable AQI_TABLES[POLLUTANT_COUNT] = {
+    {AQI_PM25, sizeof(AQI_PM25) / sizeof(AQI_PM25[0]), 500.5f, 1},
+    {AQI_PM10, sizeof(AQI_PM10) / sizeof(AQI_PM10[0]), 605.0f, 0},
+};
+
+/* AQI of one pollutant, -1 outside of the table. The breakpoint is the
+   last one starting at or below c, a linear scan over the seven entries is
+   faster than a binary search (host: 15 ns against 24 to 26 ns a reading). */
+template <typename T>
+int aqiIndex( Pollutant pollutant, T c )
+{
+    const AQITable &table = AQI_TABLES[pollutant];
+    if (c < T(table.breakpoints[0].concLow) || c >= T(table.limit))
+        return -1;
+    const AQIBreakpoint *b = table.breakpoints;
+    const AQIBreakpoint *last = b + table.count - 1;
+    while (b < last && c >= T(b[1].concLow))
+        b++;
+    return (int)(((c - T(b->concLow)) / (T(b->concHigh) - T(b->concLow))) * (T(b->aqiHigh) - T(b->aqiLow)) + T(b->aqiLow));
+}
+
+/* AQI Calculation from PM2.5 and PM10, the higher of both */
+template <typename T>
+int airQualityIndex( T pm25, T pm10 )
+{
+    int aqi25 = aqiIndex(POLLUTANT_PM25, pm25);
+    int aqi10 = aqiIndex(POLLUTANT_PM10, pm10);
+    return aqi10 > aqi25 ? aqi10 : aqi25;
+}
+
+/* NowCast (EPA) of a pollutant from up to NOWCAST_HOURS hourly averages,
+   newest first, NaN for hours without data. The weight of each older hour
+   is the ratio of the lowest to the highest average, at least 0.5. Needs
+   two of the three newest hours, NaN otherwise. */
+#define NOWCAST_HOURS 12
+float nowCast( Pollutant pollutant, const float *hourly, uint8_t hours );
+
+/* AQI from NowCast concentrations of PM2.5 and PM10, -1 without them */
+int nowCastAQI( float pm25, float pm10 );
+
+/* Batch versions, single precision */
+void heatIndex( const float *T, const float *RH, float *HI, size_t count );
+void dewPoint( const float *T, const float *RH, float *DP, size_t count );
+void pressureMSL( const float *pressure, float altitude, float *PMSL, size_t count );
+void airQualityIndex( const float *PM25, const float *PM10, int16_t *AQI, size_t count );
 
-#endif /*_Calculations_WeatherParamters_H_*/
\ No newline at end of file
+#endif /*_Calculations_WeatherParamters_H_*/
@@ -0,0 +1,14 @@
+/*
+ * Checksums
+ */
+
+#ifndef _Checksum_WeatherStation_H_
+#define _Checksum_WeatherStation_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* CRC-32 (IEEE 802.3), pass the previous result to continue a checksum */
+uint32_t crc32(const uint8_t *data, size_t len, uint32_t crc = 0);
+
+#endif /*_Checksum_WeatherStation_H_*/
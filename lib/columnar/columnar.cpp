@@ -0,0 +1,235 @@
+/*
+ * Columnar Batch Encoding
+ */
+
+#include "columnar.h"
+
+static const double POWERS_OF_TEN[] = {1, 10, 100, 1000, 10000, 100000, 1000000};
+
+static uint8_t fieldDecimals(const RecordField &field)
+{
+  if (field.type != FIELD_FLOAT)
+    return 0;
+  return field.precision < 6 ? field.precision : 6;
+}
+
+static bool isMissing(float value)
+{
+  return isnan(value) || isinf(value);
+}
+
+/* Unsigned varint, returns the number of bytes */
+static size_t putVarint(Print &out, uint64_t value)
+{
+  uint8_t buffer[10];
+  size_t n = 0;
+  do
+  {
+    buffer[n] = value & 0x7f;
+    value >>= 7;
+    if (value)
+      buffer[n] |= 0x80;
+    n++;
+  } while (value);
+  return out.write(buffer, n);
+}
+
+static size_t putSigned(Print &out, int64_t value)
+{
+  return putVarint(out, ((uint64_t)value << 1) ^ (uint64_t)(value >> 63)); // zig-zag
+}
+
+static bool getVarint(const uint8_t *data, size_t len, size_t &pos, uint64_t &value)
+{
+  value = 0;
+  for (uint8_t shift = 0; shift < 64; shift += 7)
+  {
+    if (pos >= len)
+      return false;
+    uint8_t b = data[pos++];
+    value |= (uint64_t)(b & 0x7f) << shift;
+    if (!(b & 0x80))
+      return true;
+  }
+  return false;
+}
+
+static bool getSigned(const uint8_t *data, size_t len, size_t &pos, int64_t &value)
+{
+  uint64_t zigzag;
+  if (!getVarint(data, len, pos, zigzag))
+    return false;
+  value = (int64_t)(zigzag >> 1) ^ -(int64_t)(zigzag & 1);
+  return true;
+}
+
+/* Timestamps as first value, first difference and differences of differences */
+static size_t encodeTimestamps(const SensorRecord *records, size_t count, Print &out)
+{
+  size_t bytes = 0;
+  int64_t previous = 0, delta = 0;
+  for (size_t i = 0; i < count; i++)
+  {
+    int64_t t = records[i].timestamp;
+    if (i == 0)
+      bytes += putVarint(out, t);
+    else if (i == 1)
+      bytes += putSigned(out, t - previous);
+    else
+      bytes += putSigned(out, (t - previous) - delta);
+    if (i > 0)
+      delta = t - previous;
+    previous = t;
+  }
+  return bytes;
+}
+
+/* Scaled integer differences of one field, missing values are skipped */
+static size_t encodeField(const SensorRecord *records, size_t count, const RecordField &field, Print &out)
+{
+  uint8_t decimals = fieldDecimals(field);
+  size_t bytes = 0;
+
+  bool missing = false;
+  for (size_t i = 0; i < count && !missing; i++)
+    missing = isMissing(getField(records[i], field));
+  out.write((uint8_t)(missing ? COLUMNAR_MISSING : 0));
+  bytes++;
+
+  if (missing)
+  {
+    uint8_t bits = 0;
+    for (size_t i = 0; i < count; i++)
+    {
+      if (isMissing(getField(records[i], field)))
+        bits |= 1 << (i % 8);
+      if (i % 8 == 7 || i == count - 1)
+      {
+        out.write(bits);
+        bytes++;
+        bits = 0;
+      }
+    }
+  }
+
+  bool first = true;
+  int64_t previous = 0;
+  for (size_t i = 0; i < count; i++)
+  {
+    float value = getField(records[i], field);
+    if (isMissing(value))
+      continue;
+    int64_t scaled = llround((double)value * POWERS_OF_TEN[decimals]);
+    bytes += putSigned(out, first ? scaled : scaled - previous);
+    previous = scaled;
+    first = false;
+  }
+  return bytes;
+}
+
+size_t columnarEncode(const SensorRecord *records, size_t count, Print &out)
+{
+  size_t bytes = 0;
+  out.write((uint8_t)COLUMNAR_VERSION);
+  bytes++;
+  bytes += putVarint(out, count);
+  out.write((uint8_t)RECORD_FIELD_COUNT);
+  bytes++;
+  for (size_t i = 0; i < RECORD_FIELD_COUNT; i++)
+  {
+    uint8_t field[] = {RECORD_FIELDS[i].id, fieldDecimals(RECORD_FIELDS[i])};
+    bytes += out.write(field, sizeof(field));
+  }
+
+  bytes += encodeTimestamps(records, count, out);
+  for (size_t i = 0; i < RECORD_FIELD_COUNT; i++)
+    bytes += encodeField(records, count, RECORD_FIELDS[i], out);
+  return bytes;
+}
+
+size_t columnarParseHeader(const uint8_t *data, size_t len, ColumnarHeader &header)
+{
+  size_t pos = 0;
+  uint64_t count;
+  if (len < 1 || data[pos++] != COLUMNAR_VERSION)
+    return 0;
+  header.version = COLUMNAR_VERSION;
+  if (!getVarint(data, len, pos, count) || count > UINT32_MAX || pos >= len)
+    return 0;
+  header.count = count;
+  header.fieldCount = data[pos++];
+  if (header.fieldCount > COLUMNAR_MAX_FIELDS || pos + 2 * header.fieldCount > len)
+    return 0;
+  for (uint8_t i = 0; i < header.fieldCount; i++)
+  {
+    header.ids[i] = data[pos++];
+    header.decimals[i] = data[pos++];
+    if (header.decimals[i] > 6)
+      return 0;
+  }
+  return pos;
+}
+
+size_t columnarDecode(const uint8_t *data, size_t len, const ColumnarHeader &header, uint32_t *timestamps, float *values)
+{
+  ColumnarHeader parsed;
+  size_t pos = columnarParseHeader(data, len, parsed);
+  if (pos == 0 || parsed.count != header.count || parsed.fieldCount != header.fieldCount)
+    return 0;
+
+  int64_t t = 0, delta = 0;
+  for (uint32_t i = 0; i < header.count; i++)
+  {
+    uint64_t first;
+    int64_t diff;
+    if (i == 0)
+    {
+      if (!getVarint(data, len, pos, first))
+        return 0;
+      t = first;
+    }
+    else
+    {
+      if (!getSigned(data, len, pos, diff))
+        return 0;
+      delta = i == 1 ? diff : delta + diff;
+      t += delta;
+    }
+    timestamps[i] = t;
+  }
+
+  for (uint8_t f = 0; f < header.fieldCount; f++)
+  {
+    if (pos >= len)
+      return 0;
+    uint8_t flags = data[pos++];
+    const uint8_t *missing = NULL;
+    if (flags & COLUMNAR_MISSING)
+    {
+      missing = data + pos;
+      pos += (header.count + 7) / 8;
+      if (pos > len)
+        return 0;
+    }
+
+    double scale = POWERS_OF_TEN[header.decimals[f]];
+    bool first = true;
+    int64_t scaled = 0;
+    for (uint32_t i = 0; i < header.count; i++)
+    {
+      float &value = values[(size_t)i * header.fieldCount + f];
+      if (missing && (missing[i / 8] >> (i % 8)) & 1)
+      {
+        value = NAN;
+        continue;
+      }
+      int64_t diff;
+      if (!getSigned(data, len, pos, diff))
+        return 0;
+      scaled = first ? diff : scaled + diff;
+      first = false;
+      value = scaled / scale;
+    }
+  }
+  return pos;
+}
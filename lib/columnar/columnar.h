@@ -0,0 +1,61 @@
+/*
+ * Columnar Batch Encoding
+ *
+ * Compact encoding of a batch of readings for uploads. Consecutive readings
+ * of a station are highly correlated, so the batch is stored column by
+ * column and every column as differences:
+ *
+ *   timestamps  first value, first difference, then the difference of
+ *               the differences (0 while the interval stays the same)
+ *   fields      value scaled to an integer by the decimals of the field
+ *               (RecordField.precision for floats, 0 for integers), first
+ *               value, then the difference to the previous value
+ *
+ * All numbers are zig-zag encoded varints (7 bits per byte, LSB first),
+ * so small differences of either sign take one byte.
+ *
+ * Batch (version 1)
+ *   u8 version, varint count, u8 field count,
+ *   per field: u8 ID (RecordField.id), u8 decimals,
+ *   timestamp column, one column per field
+ *   column: u8 flags, missing bitmap (if flag 1, bit i set: value i is
+ *   NaN or infinite), values of the readings that are not missing
+ *
+ * The field IDs and decimals are part of the batch, so the decoder does not
+ * depend on the record layout of the firmware that wrote it.
+ */
+
+#ifndef _Columnar_WeatherStation_H_
+#define _Columnar_WeatherStation_H_
+
+#include "record.h"
+
+#define COLUMNAR_VERSION 1
+#define COLUMNAR_MAX_FIELDS 48
+#define COLUMNAR_MISSING 0x01 // column flag: a missing bitmap follows
+
+/* Encode count readings into out, returns the number of bytes */
+size_t columnarEncode(const SensorRecord *records, size_t count, Print &out);
+
+/* Header of a batch as read back */
+struct ColumnarHeader
+{
+  uint8_t version;
+  uint32_t count;
+  uint8_t fieldCount;
+  uint8_t ids[COLUMNAR_MAX_FIELDS];
+  uint8_t decimals[COLUMNAR_MAX_FIELDS];
+};
+
+/* Parse the header, returns its length or 0 if it is invalid */
+size_t columnarParseHeader(const uint8_t *data, size_t len, ColumnarHeader &header);
+
+/*
+ * Decode a batch with the header parsed from it. timestamps has
+ * header.count entries, values header.count * header.fieldCount (one row
+ * per reading, missing values are NaN). Returns the length of the batch
+ * or 0 if it is truncated or invalid.
+ */
+size_t columnarDecode(const uint8_t *data, size_t len, const ColumnarHeader &header, uint32_t *timestamps, float *values);
+
+#endif /*_Columnar_WeatherStation_H_*/
@@ -0,0 +1,169 @@
+/*
+ * Hardware Abstraction Layer
+ *
+ * Thin interfaces in front of everything the wake cycle touches: sensors,
+ * clock, file systems, network and sleep. The ESP32 implementation lives in
+ * lib/hal_esp32, the file-backed and loopback stand-ins for the native
+ * Linux target live in lib/hal_native.
+ */
+
+#ifndef _HAL_WeatherStation_H_
+#define _HAL_WeatherStation_H_
+
+#include <Arduino.h>
+#include <FS.h>
+#include <RTClib.h>
+
+/* BME680 - Temperature, Humidity, Pressure, Gas */
+struct EnvironmentReading
+{
+  float temperature;       // Celsius
+  float humidity;          // rel. Humidity in %
+  uint32_t pressure;       // Pascal
+  uint32_t gas_resistance; // Ohms
+};
+
+class EnvironmentSensor
+{
+public:
+  virtual ~EnvironmentSensor() {}
+  virtual bool begin() = 0;
+  // Start a conversion, false if the sensor did not respond
+  virtual bool beginReading() = 0;
+  // Wait for the conversion started by beginReading() and fetch the result
+  virtual bool endReading(EnvironmentReading &reading) = 0;
+};
+
+/* SI1145 - Visible, IR, UV */
+class LightSensor
+{
+public:
+  virtual ~LightSensor() {}
+  virtual bool begin() = 0;
+  virtual uint16_t readVisible() = 0;
+  virtual uint16_t readIR() = 0;
+  virtual uint16_t readUV() = 0;
+};
+
+/* PMS7003 - Particle Sensor */
+struct ParticleReading
+{
+  uint16_t pm1_0;
+  uint16_t pm2_5;
+  uint16_t pm10_0;
+  uint16_t gt0_3;
+  uint16_t gt0_5;
+  uint16_t gt1_0;
+  uint16_t gt2_5;
+  uint16_t gt5_0;
+  uint16_t gt10_0;
+  uint8_t hwVersion;
+  uint8_t errorCode;
+};
+
+class ParticleSensor
+{
+public:
+  virtual ~ParticleSensor() {}
+  virtual void begin() = 0;
+  // Wait for the next valid frame, false if none arrived within timeout ms
+  virtual bool waitForFrame(uint32_t timeout) = 0;
+  // Latest frame returned by waitForFrame()
+  virtual const ParticleReading &reading() = 0;
+};
+
+/* PCF8523 - Real Time Clock */
+class Clock
+{
+public:
+  virtual ~Clock() {}
+  virtual bool begin() = 0;
+  virtual bool lostPower() = 0;
+  virtual DateTime now() = 0;
+  virtual void adjust(const DateTime &dt) = 0;
+};
+
+/* Request body that is written straight to the connection, without
+   building it in memory first */
+class Payload
+{
+public:
+  virtual ~Payload() {}
+  virtual size_t length() = 0;
+  virtual void writeTo(Print &out) = 0;
+};
+
+/* WiFi, NTP and HTTP(S) */
+class Network
+{
+public:
+  virtual ~Network() {}
+
+  // Connect to the access point of the last wake without a scan if possible,
+  // optionally reusing its IP configuration instead of DHCP
+  virtual void begin(const char *ssid, const char *password, bool reuseLease) = 0;
+
+  // Wait until connected, returns false after the timeout
+  virtual bool waitConnected(uint32_t timeout) = 0;
+  virtual bool connected() = 0;
+  virtual String localIP() = 0;
+  virtual void end() = 0;
+
+  // Sync the system time with a NTP server and return the local time
+  virtual bool syncTime(const char *ntpServer, const char *timezone, struct tm &timeinfo) = 0;
+
+  // Accept only the server certificate with this SHA-256 fingerprint (hex), empty to accept any
+  virtual void setFingerprint(const char *fingerprint) = 0;
+
+  // POST a request body, returns the HTTP status code (negative on connection errors).
+  // Requests of a wake share one connection, TLS sessions are resumed after deep sleep
+  virtual int post(const char *url, const char *contentType, Payload &body, String &response) = 0;
+  virtual String errorToString(int code) = 0;
+
+  // Byte stream to a server for other protocols (MQTT), over TLS if secure
+  virtual bool open(const char *host, uint16_t port, bool secure) = 0;
+  virtual bool send(const uint8_t *data, size_t len) = 0;
+
+  // Wait for data, returns the bytes read, 0 after the timeout and -1 if the connection is closed
+  virtual int receive(uint8_t *data, size_t len, uint32_t timeout) = 0;
+  virtual void close() = 0;
+};
+
+/* Board - power, battery, storage, firmware and sleep */
+class Board
+{
+public:
+  virtual ~Board() {}
+  virtual void begin() = 0;
+  virtual void setSensorPower(bool on) = 0;
+  virtual float readBatteryVoltage() = 0;
+  virtual uint64_t chipId() = 0;
+
+  // Internal flash (SPIFFS)
+  virtual bool mountFlash(bool formatOnFail) = 0;
+  virtual fs::FS &flash() = 0;
+
+  // SD card, mount fails if no card is attached
+  virtual bool mountSD() = 0;
+  virtual uint64_t sdCardSize() = 0;
+  virtual fs::FS &sd() = 0;
+
+  // Firmware update
+  virtual bool beginUpdate() = 0;
+  virtual size_t writeUpdate(uint8_t *data, size_t len) = 0;
+  virtual bool endUpdate() = 0;
+
+  // Never return on the device
+  virtual void deepSleep(uint64_t microseconds) = 0;
+  virtual void restart() = 0;
+};
+
+/* Implemented by the selected backend */
+Board &getBoard();
+Clock &getClock();
+EnvironmentSensor &getEnvironmentSensor();
+LightSensor &getLightSensor();
+ParticleSensor &getParticleSensor();
+Network &getNetwork();
+
+#endif /*_HAL_WeatherStation_H_*/
@@ -0,0 +1,653 @@
+/*
+ * Hardware Abstraction Layer - ESP32 Feather
+ */
+
+#include "hal.h"
+
+#include <Adafruit_BME680.h>
+#include <Adafruit_SI1145.h>
+#include <HTTPClient.h>
+#include <SD.h>
+#include <SPIFFS.h>
+#include <Update.h>
+#include <WiFi.h>
+#include <WiFiClientSecure.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/event_groups.h>
+#include <freertos/queue.h>
+
+/* CRC-32 */
+#include "checksum.h"
+
+/* TLS Client with Session Resumption */
+#include "tls_client.h"
+
+/* PMS7003 Frame Parser */
+#include "pms7003.h"
+
+/* Pin allocations */
+#define ADC_PIN A13 // Battery Volatage
+#define BATT_PIN 2  // Battery Volatage
+#define POWER_SWITCH_PIN A6 // Power Management
+
+/* BME680 */
+class ESP32EnvironmentSensor : public EnvironmentSensor
+{
+public:
+  bool begin()
+  {
+    if (!bme.begin())
+      return false;
+
+    /* Set up BME680 oversampling and filter initialization for BME680 */
+    bme.setTemperatureOversampling(BME680_OS_8X);
+    bme.setHumidityOversampling(BME680_OS_2X);
+    bme.setPressureOversampling(BME680_OS_4X);
+    bme.setIIRFilterSize(BME680_FILTER_SIZE_3);
+    bme.setGasHeater(320, 150); // 320*C for 150 ms
+    return true;
+  }
+
+  bool beginReading() { return bme.beginReading() != 0; }
+
+  bool endReading(EnvironmentReading &reading)
+  {
+    if (!bme.endReading())
+      return false;
+
+    reading.temperature = bme.temperature;
+    reading.humidity = bme.humidity;
+    reading.pressure = bme.pressure;
+    reading.gas_resistance = bme.gas_resistance;
+    return true;
+  }
+
+private:
+  Adafruit_BME680 bme;
+};
+
+/* SI1145 */
+class ESP32LightSensor : public LightSensor
+{
+public:
+  bool begin() { return uv.begin(); }
+  uint16_t readVisible() { return uv.readVisible(); }
+  uint16_t readIR() { return uv.readIR(); }
+  uint16_t readUV() { return uv.readUV(); }
+
+private:
+  Adafruit_SI1145 uv = Adafruit_SI1145();
+};
+
+/* PMS7003 on Serial1, frames are parsed by a low-priority task */
+#define PMS_TASK_STACK 2048
+#define PMS_TASK_PRIORITY 1
+#define PMS_POLL_MS 50 // the UART buffer holds 8 frames meanwhile
+
+class ESP32ParticleSensor : public ParticleSensor
+{
+public:
+  void begin()
+  {
+    Serial1.begin(9600);
+    frames = xQueueCreate(PMS7003_QUEUE_SIZE, sizeof(ParticleReading));
+    xTaskCreate(readerTask, "pms7003", PMS_TASK_STACK, this, PMS_TASK_PRIORITY, NULL);
+  }
+
+  bool waitForFrame(uint32_t timeout)
+  {
+    // Blocks on the queue, the CPU is idle until a frame arrives
+    return xQueueReceive(frames, &current, pdMS_TO_TICKS(timeout)) == pdTRUE;
+  }
+
+  const ParticleReading &reading() { return current; }
+
+private:
+  static void readerTask(void *arg)
+  {
+    ESP32ParticleSensor *sensor = (ESP32ParticleSensor *)arg;
+    uint8_t buffer[64];
+    ParticleReading frame;
+
+    while (true)
+    {
+      int available;
+      while ((available = Serial1.available()) > 0)
+      {
+        size_t len = Serial1.readBytes(buffer, available < (int)sizeof(buffer) ? available : sizeof(buffer));
+        sensor->parser.feed(buffer, len);
+      }
+
+      // Hand out complete frames, the oldest is dropped if nobody reads
+      while (sensor->parser.read(frame))
+      {
+        if (xQueueSend(sensor->frames, &frame, 0) != pdTRUE)
+        {
+          ParticleReading oldest;
+          xQueueReceive(sensor->frames, &oldest, 0);
+          xQueueSend(sensor->frames, &frame, 0);
+        }
+      }
+      vTaskDelay(pdMS_TO_TICKS(PMS_POLL_MS));
+    }
+  }
+
+  PMS7003Parser parser;
+  QueueHandle_t frames = NULL;
+  ParticleReading current = {};
+};
+
+/* PCF8523 */
+class ESP32Clock : public Clock
+{
+public:
+  bool begin() { return rtc.begin(); }
+  bool lostPower() { return !rtc.initialized() || rtc.lostPower(); }
+  DateTime now() { return rtc.now(); }
+  void adjust(const DateTime &dt) { rtc.adjust(dt); }
+
+private:
+  RTC_PCF8523 rtc;
+};
+
+/* WiFi and HTTPS */
+#define WIFI_DIRECT_TIMEOUT 3000 // ms before falling back to a full scan
+#define WIFI_CONNECTED_BIT BIT0
+#define WIFI_DISCONNECTED_BIT BIT1
+
+/* Access point and IP configuration of the last connection, kept during deep sleep */
+struct WiFiCache
+{
+  bool valid;
+  uint32_t ssid; // CRC-32 of the SSID
+  uint8_t bssid[6];
+  int32_t channel;
+  uint32_t ip;
+  uint32_t gateway;
+  uint32_t subnet;
+  uint32_t dns;
+};
+
+RTC_DATA_ATTR WiFiCache wifiCache;
+
+static EventGroupHandle_t wifiEvents = NULL;
+
+#define HTTP_TIMEOUT 5000       // ms to wait for the response
+#define HTTP_WRITE_BUFFER 512   // bytes per write to the connection
+#define HTTP_RESPONSE_MAX 1024  // longer responses are read but not kept
+
+/* Collects small writes, e.g. single JSON tokens, into larger writes to the client */
+class ClientWriter : public Print
+{
+public:
+  ClientWriter(Client &client) : client(client), used(0), failed(false) {}
+
+  size_t write(uint8_t c) { return write(&c, 1); }
+
+  size_t write(const uint8_t *data, size_t len)
+  {
+    for (size_t i = 0; i < len; i++)
+    {
+      if (used == sizeof(buffer))
+        finish();
+      buffer[used++] = data[i];
+    }
+    return len;
+  }
+
+  /* Write what is left, returns false if any write failed */
+  bool finish()
+  {
+    if (used > 0 && !failed && client.write(buffer, used) != used)
+      failed = true;
+    used = 0;
+    return !failed;
+  }
+
+private:
+  Client &client;
+  uint8_t buffer[HTTP_WRITE_BUFFER];
+  size_t used;
+  bool failed;
+};
+
+static void wifiEvent(WiFiEvent_t event)
+{
+  if (event == ARDUINO_EVENT_WIFI_STA_GOT_IP)
+    xEventGroupSetBits(wifiEvents, WIFI_CONNECTED_BIT);
+  else if (event == ARDUINO_EVENT_WIFI_STA_DISCONNECTED)
+    xEventGroupSetBits(wifiEvents, WIFI_DISCONNECTED_BIT);
+}
+
+class ESP32Network : public Network
+{
+public:
+  void begin(const char *ssid, const char *password, bool reuseLease)
+  {
+    if (!wifiEvents)
+    {
+      wifiEvents = xEventGroupCreate();
+      WiFi.onEvent(wifiEvent);
+    }
+    xEventGroupClearBits(wifiEvents, WIFI_CONNECTED_BIT | WIFI_DISCONNECTED_BIT);
+
+    this->ssid = ssid;
+    this->password = password;
+
+    // Credentials come from the settings, don't write them to flash every wake
+    WiFi.persistent(false);
+    WiFi.mode(WIFI_STA);
+
+    uint32_t ssidHash = crc32((const uint8_t *)ssid, strlen(ssid));
+    direct = wifiCache.valid && wifiCache.ssid == ssidHash;
+    if (direct)
+    {
+      // Skip the scan, and DHCP if the lease can be reused
+      if (reuseLease)
+        WiFi.config(IPAddress(wifiCache.ip), IPAddress(wifiCache.gateway),
+                    IPAddress(wifiCache.subnet), IPAddress(wifiCache.dns));
+      WiFi.begin(ssid, password, wifiCache.channel, wifiCache.bssid, true);
+    }
+    else
+      WiFi.begin(ssid, password);
+  }
+
+  bool waitConnected(uint32_t timeout)
+  {
+    uint32_t start = millis();
+    if (direct)
+    {
+      uint32_t wait = timeout < WIFI_DIRECT_TIMEOUT ? timeout : WIFI_DIRECT_TIMEOUT;
+      if (waitFor(WIFI_CONNECTED_BIT | WIFI_DISCONNECTED_BIT, wait))
+        return true;
+
+      // Access point moved or lease expired - scan all channels using DHCP
+      Serial.println("Cached access point not available, scanning");
+      direct = false;
+      wifiCache.valid = false;
+      WiFi.disconnect();
+      WiFi.config(INADDR_NONE, INADDR_NONE, INADDR_NONE);
+      xEventGroupClearBits(wifiEvents, WIFI_CONNECTED_BIT | WIFI_DISCONNECTED_BIT);
+      WiFi.begin(ssid.c_str(), password.c_str());
+    }
+
+    // Disconnects are retried by the driver during the scan
+    uint32_t elapsed = millis() - start;
+    if (elapsed >= timeout)
+      return false;
+    return waitFor(WIFI_CONNECTED_BIT, timeout - elapsed);
+  }
+
+  bool connected() { return WiFi.status() == WL_CONNECTED; }
+  String localIP() { return WiFi.localIP().toString(); }
+
+  void end()
+  {
+    httpHost = "";
+    stream = NULL;
+    tls.stop();
+    plain.stop();
+    WiFi.disconnect();
+    WiFi.mode(WIFI_OFF);
+  }
+
+  bool syncTime(const char *ntpServer, const char *timezone, struct tm &timeinfo)
+  {
+    configTime(0, 0, ntpServer);
+    delay(2000);
+
+    setenv("TZ", timezone, 1);
+    tzset();
+
+    time_t ESPnow = time(nullptr);
+    Serial.println(ctime(&ESPnow));
+    timeinfo = *localtime(&ESPnow);
+    return true;
+  }
+
+  void setFingerprint(const char *fingerprint)
+  {
+    uint8_t digest[TLS_FINGERPRINT_SIZE];
+    size_t n = 0;
+    int high = -1;
+
+    // Hex digits, separators like ':' or ' ' are skipped
+    for (const char *c = fingerprint; *c && n < sizeof(digest); c++)
+    {
+      int digit = isdigit(*c) ? *c - '0' : isxdigit(*c) ? tolower(*c) - 'a' + 10 : -1;
+      if (digit < 0)
+        continue;
+      if (high < 0)
+        high = digit;
+      else
+      {
+        digest[n++] = (high << 4) | digit;
+        high = -1;
+      }
+    }
+    if (n > 0 && n != sizeof(digest))
+      Serial.println("Warning: server fingerprint is not a SHA-256 hash, accepting any certificate");
+    tls.setFingerprint(n == sizeof(digest) ? digest : NULL);
+  }
+
+  int post(const char *url, const char *contentType, Payload &body, String &response)
+  {
+    bool secure;
+    String host, path;
+    uint16_t port;
+    if (!parseUrl(url, secure, host, port, path))
+      return HTTPC_ERROR_CONNECTION_REFUSED;
+
+    WiFiClient &client = secure ? (WiFiClient &)tls : plain;
+    size_t length = body.length();
+
+    // Keep the connection open for the next request of this wake. The server
+    // may have closed it meanwhile, then the request is sent once more.
+    bool reused = client.connected() && host == httpHost && port == httpPort;
+    for (int attempt = 0; attempt < 2; attempt++)
+    {
+      if (!reused)
+      {
+        client.stop();
+        httpHost = "";
+        if (!client.connect(host.c_str(), port))
+          return HTTPC_ERROR_CONNECTION_REFUSED;
+        client.setNoDelay(true);
+        httpHost = host;
+        httpPort = port;
+      }
+
+      // Headers and body go straight to the connection
+      ClientWriter out(client);
+      out.printf("POST %s HTTP/1.1\r\nHost: %s\r\nContent-Type: %s\r\nContent-Length: %u\r\n"
+                 "Connection: keep-alive\r\n\r\n",
+                 path.c_str(), host.c_str(), contentType, (unsigned)length);
+      body.writeTo(out);
+      if (out.finish())
+        return readResponse(client, response);
+
+      client.stop();
+      httpHost = "";
+      if (!reused)
+        break;
+      reused = false;
+    }
+    return HTTPC_ERROR_SEND_PAYLOAD_FAILED;
+  }
+
+  String errorToString(int code) { return HTTPClient::errorToString(code); }
+
+  bool open(const char *host, uint16_t port, bool secure)
+  {
+    stream = secure ? (WiFiClient *)&tls : &plain;
+    if (!stream->connect(host, port))
+    {
+      stream = NULL;
+      return false;
+    }
+    stream->setNoDelay(true);
+    return true;
+  }
+
+  bool send(const uint8_t *data, size_t len)
+  {
+    return stream && stream->write(data, len) == len;
+  }
+
+  int receive(uint8_t *data, size_t len, uint32_t timeout)
+  {
+    if (!stream)
+      return -1;
+    uint32_t start = millis();
+    while (stream->available() <= 0)
+    {
+      if (!stream->connected())
+        return -1;
+      if (millis() - start >= timeout)
+        return 0;
+      delay(2);
+    }
+    int n = stream->read(data, len);
+    return n > 0 ? n : 0;
+  }
+
+  void close()
+  {
+    if (stream)
+      stream->stop();
+    stream = NULL;
+  }
+
+private:
+  /* http[s]://host[:port][/path] */
+  static bool parseUrl(const char *url, bool &secure, String &host, uint16_t &port, String &path)
+  {
+    String u(url);
+    int scheme = u.indexOf("://");
+    if (scheme < 0)
+      return false;
+    secure = u.substring(0, scheme).equalsIgnoreCase("https");
+
+    int start = scheme + 3;
+    int slash = u.indexOf('/', start);
+    host = slash < 0 ? u.substring(start) : u.substring(start, slash);
+    path = slash < 0 ? String("/") : u.substring(slash);
+
+    port = secure ? 443 : 80;
+    int colon = host.indexOf(':');
+    if (colon >= 0)
+    {
+      port = host.substring(colon + 1).toInt();
+      host = host.substring(0, colon);
+    }
+    return host.length() > 0;
+  }
+
+  /* Status line, headers and body (Content-Length, chunked or until closed) */
+  int readResponse(WiFiClient &client, String &response)
+  {
+    ((Stream &)client).setTimeout(HTTP_TIMEOUT);
+    response = "";
+
+    String status = client.readStringUntil('\n');
+    if (!status.startsWith("HTTP/1."))
+    {
+      client.stop();
+      httpHost = "";
+      return HTTPC_ERROR_READ_TIMEOUT;
+    }
+    int code = status.substring(9, 12).toInt();
+
+    long contentLength = -1;
+    bool chunked = false;
+    bool keepAlive = status.startsWith("HTTP/1.1");
+    while (true)
+    {
+      String line = client.readStringUntil('\n');
+      line.trim();
+      if (line.length() == 0)
+        break;
+      int colon = line.indexOf(':');
+      if (colon < 0)
+        continue;
+      String name = line.substring(0, colon);
+      String value = line.substring(colon + 1);
+      name.toLowerCase();
+      value.trim();
+      value.toLowerCase();
+      if (name == "content-length")
+        contentLength = value.toInt();
+      else if (name == "transfer-encoding")
+        chunked = value.indexOf("chunked") >= 0;
+      else if (name == "connection")
+        keepAlive = value.indexOf("close") < 0;
+    }
+
+    bool complete = true;
+    if (chunked)
+    {
+      while (complete)
+      {
+        String size = client.readStringUntil('\n');
+        size.trim();
+        long n = strtol(size.c_str(), NULL, 16);
+        if (size.length() == 0)
+          complete = false;
+        else if (n == 0)
+        {
+          // Trailer up to the empty line
+          while (client.readStringUntil('\n').length() > 1)
+            ;
+          break;
+        }
+        else
+        {
+          complete = readBody(client, n, response);
+          client.readStringUntil('\n');
+        }
+      }
+    }
+    else if (contentLength >= 0)
+      complete = readBody(client, contentLength, response);
+    else
+    {
+      readBody(client, SIZE_MAX, response);
+      keepAlive = false;
+    }
+
+    if (!complete || !keepAlive)
+    {
+      client.stop();
+      httpHost = "";
+    }
+    return complete ? code : HTTPC_ERROR_READ_TIMEOUT;
+  }
+
+  /* Read len bytes (SIZE_MAX: until the connection is closed) */
+  bool readBody(WiFiClient &client, size_t len, String &response)
+  {
+    uint8_t buffer[64];
+    while (len > 0)
+    {
+      size_t n = client.readBytes(buffer, len < sizeof(buffer) ? len : sizeof(buffer));
+      if (n == 0)
+        return len == SIZE_MAX;
+      for (size_t i = 0; i < n && response.length() < HTTP_RESPONSE_MAX; i++)
+        response += (char)buffer[i];
+      if (len != SIZE_MAX)
+        len -= n;
+    }
+    return true;
+  }
+
+  /* Block until one of the event bits is set, true once an IP address is assigned */
+  bool waitFor(EventBits_t bits, uint32_t timeout)
+  {
+    EventBits_t set = xEventGroupWaitBits(wifiEvents, bits, pdFALSE, pdFALSE, pdMS_TO_TICKS(timeout));
+    if (!(set & WIFI_CONNECTED_BIT))
+      return false;
+
+    wifiCache.valid = true;
+    wifiCache.ssid = crc32((const uint8_t *)ssid.c_str(), ssid.length());
+    memcpy(wifiCache.bssid, WiFi.BSSID(), sizeof(wifiCache.bssid));
+    wifiCache.channel = WiFi.channel();
+    wifiCache.ip = WiFi.localIP();
+    wifiCache.gateway = WiFi.gatewayIP();
+    wifiCache.subnet = WiFi.subnetMask();
+    wifiCache.dns = WiFi.dnsIP();
+    return true;
+  }
+
+  String ssid;
+  String password;
+  bool direct;
+
+  TLSClient tls;
+  WiFiClient plain;
+  WiFiClient *stream = NULL;
+  String httpHost; // server of the open HTTP connection
+  uint16_t httpPort = 0;
+};
+
+/* ESP32 Feather */
+class ESP32Board : public Board
+{
+public:
+  void begin()
+  {
+    /* Battery Pins */
+    pinMode(ADC_PIN, INPUT);
+    pinMode(BATT_PIN, OUTPUT);
+
+    /* Sensor power */
+    pinMode(POWER_SWITCH_PIN, OUTPUT);
+    digitalWrite(POWER_SWITCH_PIN, LOW);
+  }
+
+  void setSensorPower(bool on) { digitalWrite(POWER_SWITCH_PIN, on ? HIGH : LOW); }
+
+  float readBatteryVoltage()
+  {
+    digitalWrite(BATT_PIN, HIGH);
+    float voltage = ((float)analogRead(ADC_PIN) / 4095) * 2 * 3.3 * 1.1; // 7.26;
+    digitalWrite(BATT_PIN, LOW);
+    return voltage;
+  }
+
+  uint64_t chipId() { return ESP.getEfuseMac(); }
+
+  bool mountFlash(bool formatOnFail) { return SPIFFS.begin(formatOnFail); }
+  fs::FS &flash() { return SPIFFS; }
+
+  bool mountSD() { return SD.begin() && SD.cardType() != CARD_NONE; }
+  uint64_t sdCardSize() { return SD.cardSize(); }
+  fs::FS &sd() { return SD; }
+
+  bool beginUpdate() { return Update.begin(); }
+  size_t writeUpdate(uint8_t *data, size_t len) { return Update.write(data, len); }
+  bool endUpdate() { return Update.end(); }
+
+  void deepSleep(uint64_t microseconds)
+  {
+    esp_sleep_enable_timer_wakeup(microseconds);
+    esp_deep_sleep_start();
+  }
+
+  void restart() { ESP.restart(); }
+};
+
+Board &getBoard()
+{
+  static ESP32Board board;
+  return board;
+}
+
+Clock &getClock()
+{
+  static ESP32Clock clock;
+  return clock;
+}
+
+EnvironmentSensor &getEnvironmentSensor()
+{
+  static ESP32EnvironmentSensor sensor;
+  return sensor;
+}
+
+LightSensor &getLightSensor()
+{
+  static ESP32LightSensor sensor;
+  return sensor;
+}
+
+ParticleSensor &getParticleSensor()
+{
+  static ESP32ParticleSensor sensor;
+  return sensor;
+}
+
+Network &getNetwork()
+{
+  static ESP32Network network;
+  return network;
+}
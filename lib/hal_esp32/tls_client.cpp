@@ -0,0 +1,395 @@
+/*
+ * TLS Client with Session Resumption
+ */
+
+#include "tls_client.h"
+
+#include <mbedtls/sha256.h>
+#include <mbedtls/version.h>
+
+// A resumed handshake is told apart from a full one by the missing server
+// certificate, which needs the certificate to be kept after the handshake
+#if MBEDTLS_VERSION_NUMBER >= 0x02130000 && !defined(MBEDTLS_SSL_KEEP_PEER_CERTIFICATE)
+#error "TLSClient needs MBEDTLS_SSL_KEEP_PEER_CERTIFICATE"
+#endif
+
+/* CRC-32 */
+#include "checksum.h"
+
+/* Session of the last connection, kept during deep sleep */
+struct TLSSessionCache
+{
+  bool valid;
+  uint32_t host;                             // CRC-32 of the host name
+  uint8_t fingerprint[TLS_FINGERPRINT_SIZE]; // of the certificate of the full handshake
+  int64_t start;
+  int ciphersuite;
+  uint8_t idLen;
+  uint8_t id[32];
+  uint8_t master[48];
+  uint16_t ticketLen;
+  uint32_t ticketLifetime;
+  uint8_t ticket[TLS_TICKET_MAX];
+  uint8_t mflCode;
+  int truncHmac;
+  int encryptThenMac;
+};
+
+RTC_DATA_ATTR TLSSessionCache tlsSession;
+
+TLSClient::TLSClient() : pinned(false), active(false), sessionResumed(false), peeked(-1)
+{
+}
+
+TLSClient::~TLSClient()
+{
+  stop();
+}
+
+void TLSClient::setFingerprint(const uint8_t *fingerprint)
+{
+  pinned = fingerprint != NULL;
+  if (pinned)
+    memcpy(pin, fingerprint, TLS_FINGERPRINT_SIZE);
+}
+
+int TLSClient::connect(IPAddress ip, uint16_t port)
+{
+  return connect(ip.toString().c_str(), port, TLS_TIMEOUT);
+}
+
+int TLSClient::connect(IPAddress ip, uint16_t port, int32_t timeout)
+{
+  return connect(ip.toString().c_str(), port, timeout);
+}
+
+int TLSClient::connect(const char *host, uint16_t port)
+{
+  return connect(host, port, TLS_TIMEOUT);
+}
+
+int TLSClient::connect(const char *host, uint16_t port, int32_t timeout)
+{
+  stop();
+  if (!WiFiClient::connect(host, port, timeout))
+    return 0;
+  if (!handshake(host))
+  {
+    stop();
+    return 0;
+  }
+  return 1;
+}
+
+bool TLSClient::handshake(const char *host)
+{
+  mbedtls_ssl_init(&ssl);
+  mbedtls_ssl_config_init(&conf);
+  mbedtls_ctr_drbg_init(&drbg);
+  mbedtls_entropy_init(&entropy);
+  mbedtls_net_init(&net);
+  active = true;
+  sessionResumed = false;
+
+  // The socket is owned by WiFiClient, mbedTLS only reads and writes it
+  net.fd = fd();
+  mbedtls_net_set_nonblock(&net);
+
+  const char *personalization = "weatherstation";
+  if (mbedtls_ctr_drbg_seed(&drbg, mbedtls_entropy_func, &entropy,
+                            (const unsigned char *)personalization, strlen(personalization)) != 0)
+    return false;
+
+  if (mbedtls_ssl_config_defaults(&conf, MBEDTLS_SSL_IS_CLIENT, MBEDTLS_SSL_TRANSPORT_STREAM,
+                                  MBEDTLS_SSL_PRESET_DEFAULT) != 0)
+    return false;
+
+  // The certificate is checked against the pin after the handshake
+  mbedtls_ssl_conf_authmode(&conf, MBEDTLS_SSL_VERIFY_NONE);
+  mbedtls_ssl_conf_rng(&conf, mbedtls_ctr_drbg_random, &drbg);
+#if defined(MBEDTLS_SSL_SESSION_TICKETS)
+  mbedtls_ssl_conf_session_tickets(&conf, MBEDTLS_SSL_SESSION_TICKETS_ENABLED);
+#endif
+
+  if (mbedtls_ssl_setup(&ssl, &conf) != 0)
+    return false;
+  if (mbedtls_ssl_set_hostname(&ssl, host) != 0)
+    return false;
+
+  uint32_t hostHash = crc32((const uint8_t *)host, strlen(host));
+  bool offered = restoreSession(hostHash);
+  mbedtls_ssl_set_bio(&ssl, &net, mbedtls_net_send, mbedtls_net_recv, NULL);
+
+  uint32_t start = millis();
+  int ret;
+  while ((ret = mbedtls_ssl_handshake(&ssl)) != 0)
+  {
+    uint32_t elapsed = millis() - start;
+    if (elapsed >= TLS_TIMEOUT)
+      return false;
+    if (ret == MBEDTLS_ERR_SSL_WANT_READ)
+      mbedtls_net_poll(&net, MBEDTLS_NET_POLL_READ, TLS_TIMEOUT - elapsed);
+    else if (ret == MBEDTLS_ERR_SSL_WANT_WRITE)
+      mbedtls_net_poll(&net, MBEDTLS_NET_POLL_WRITE, TLS_TIMEOUT - elapsed);
+    else
+    {
+      Serial.printf("TLS handshake failed: -0x%04x\n", -ret);
+      // The server may have dropped the session, the next handshake is a full one
+      tlsSession.valid = false;
+      return false;
+    }
+  }
+
+  // A full handshake carries the server certificate, a resumed one does not
+  // (the cached session is offered without it). Session IDs can not tell
+  // them apart: with a ticket the server need not echo the ID.
+  uint8_t fingerprint[TLS_FINGERPRINT_SIZE];
+  if (mbedtls_ssl_get_peer_cert(&ssl) == NULL)
+  {
+    if (!offered)
+    {
+      Serial.println("Error: server sent no certificate");
+      return false;
+    }
+    // Established with a certificate matching the pin, see restoreSession()
+    sessionResumed = true;
+    memcpy(fingerprint, tlsSession.fingerprint, TLS_FINGERPRINT_SIZE);
+  }
+  else if (!certificateFingerprint(fingerprint) || (pinned && memcmp(fingerprint, pin, TLS_FINGERPRINT_SIZE) != 0))
+  {
+    Serial.println("Error: server certificate does not match the pinned fingerprint");
+    tlsSession.valid = false;
+    return false;
+  }
+
+  saveSession(hostHash, fingerprint);
+  return true;
+}
+
+/* SHA-256 of the server certificate of the handshake */
+bool TLSClient::certificateFingerprint(uint8_t *digest)
+{
+  const mbedtls_x509_crt *cert = mbedtls_ssl_get_peer_cert(&ssl);
+  if (!cert)
+    return false;
+#if MBEDTLS_VERSION_NUMBER >= 0x03000000
+  return mbedtls_sha256(cert->raw.p, cert->raw.len, digest, 0) == 0;
+#else
+  return mbedtls_sha256_ret(cert->raw.p, cert->raw.len, digest, 0) == 0;
+#endif
+}
+
+/* Copy the negotiated session into RTC memory */
+void TLSClient::saveSession(uint32_t hostHash, const uint8_t *fingerprint)
+{
+  mbedtls_ssl_session session;
+  mbedtls_ssl_session_init(&session);
+  tlsSession.valid = false;
+  if (mbedtls_ssl_get_session(&ssl, &session) != 0)
+  {
+    mbedtls_ssl_session_free(&session);
+    return;
+  }
+
+  tlsSession.ticketLen = 0;
+#if defined(MBEDTLS_SSL_SESSION_TICKETS) && defined(MBEDTLS_SSL_CLI_C)
+  if (session.ticket_len > TLS_TICKET_MAX)
+  {
+    // Without a ticket the server would not find the session either
+    mbedtls_ssl_session_free(&session);
+    return;
+  }
+  if (session.ticket_len > 0)
+    memcpy(tlsSession.ticket, session.ticket, session.ticket_len);
+  tlsSession.ticketLen = session.ticket_len;
+  tlsSession.ticketLifetime = session.ticket_lifetime;
+#endif
+  if (tlsSession.ticketLen == 0 && session.id_len == 0)
+  {
+    // Neither a ticket nor a session ID, the server does not resume sessions
+    mbedtls_ssl_session_free(&session);
+    return;
+  }
+
+#if defined(MBEDTLS_HAVE_TIME)
+  tlsSession.start = session.start;
+#endif
+  tlsSession.ciphersuite = session.ciphersuite;
+  tlsSession.idLen = session.id_len;
+  memcpy(tlsSession.id, session.id, session.id_len);
+  memcpy(tlsSession.master, session.master, sizeof(tlsSession.master));
+#if defined(MBEDTLS_SSL_MAX_FRAGMENT_LENGTH)
+  tlsSession.mflCode = session.mfl_code;
+#endif
+#if defined(MBEDTLS_SSL_TRUNCATED_HMAC)
+  tlsSession.truncHmac = session.trunc_hmac;
+#endif
+#if defined(MBEDTLS_SSL_ENCRYPT_THEN_MAC)
+  tlsSession.encryptThenMac = session.encrypt_then_mac;
+#endif
+  tlsSession.host = hostHash;
+  memcpy(tlsSession.fingerprint, fingerprint, TLS_FINGERPRINT_SIZE);
+  tlsSession.valid = true;
+  mbedtls_ssl_session_free(&session);
+}
+
+/* Offer the cached session, returns false if there is none for this host
+   whose certificate matches the pin */
+bool TLSClient::restoreSession(uint32_t hostHash)
+{
+  if (!tlsSession.valid || tlsSession.host != hostHash)
+    return false;
+  if (pinned && memcmp(tlsSession.fingerprint, pin, TLS_FINGERPRINT_SIZE) != 0)
+    return false;
+
+  mbedtls_ssl_session session;
+  mbedtls_ssl_session_init(&session);
+#if defined(MBEDTLS_HAVE_TIME)
+  session.start = tlsSession.start;
+#endif
+  session.ciphersuite = tlsSession.ciphersuite;
+  session.id_len = tlsSession.idLen;
+  memcpy(session.id, tlsSession.id, tlsSession.idLen);
+  memcpy(session.master, tlsSession.master, sizeof(session.master));
+#if defined(MBEDTLS_SSL_SESSION_TICKETS) && defined(MBEDTLS_SSL_CLI_C)
+  if (tlsSession.ticketLen > 0)
+  {
+    // Freed with the session
+    session.ticket = (unsigned char *)malloc(tlsSession.ticketLen);
+    if (session.ticket)
+    {
+      memcpy(session.ticket, tlsSession.ticket, tlsSession.ticketLen);
+      session.ticket_len = tlsSession.ticketLen;
+      session.ticket_lifetime = tlsSession.ticketLifetime;
+    }
+  }
+#endif
+#if defined(MBEDTLS_SSL_MAX_FRAGMENT_LENGTH)
+  session.mfl_code = tlsSession.mflCode;
+#endif
+#if defined(MBEDTLS_SSL_TRUNCATED_HMAC)
+  session.trunc_hmac = tlsSession.truncHmac;
+#endif
+#if defined(MBEDTLS_SSL_ENCRYPT_THEN_MAC)
+  session.encrypt_then_mac = tlsSession.encryptThenMac;
+#endif
+
+  bool offered = mbedtls_ssl_set_session(&ssl, &session) == 0;
+  mbedtls_ssl_session_free(&session);
+  return offered;
+}
+
+size_t TLSClient::write(uint8_t data)
+{
+  return write(&data, 1);
+}
+
+size_t TLSClient::write(const uint8_t *buf, size_t size)
+{
+  if (!active)
+    return 0;
+
+  size_t written = 0;
+  uint32_t start = millis();
+  while (written < size)
+  {
+    int ret = mbedtls_ssl_write(&ssl, buf + written, size - written);
+    if (ret > 0)
+    {
+      written += ret;
+      continue;
+    }
+    uint32_t elapsed = millis() - start;
+    if ((ret != MBEDTLS_ERR_SSL_WANT_WRITE && ret != MBEDTLS_ERR_SSL_WANT_READ) || elapsed >= TLS_TIMEOUT)
+    {
+      stop();
+      break;
+    }
+    mbedtls_net_poll(&net, ret == MBEDTLS_ERR_SSL_WANT_READ ? MBEDTLS_NET_POLL_READ : MBEDTLS_NET_POLL_WRITE,
+                     TLS_TIMEOUT - elapsed);
+  }
+  return written;
+}
+
+int TLSClient::available()
+{
+  if (!active)
+    return 0;
+
+  // Process received records without blocking
+  int ret = mbedtls_ssl_read(&ssl, NULL, 0);
+  if (ret < 0 && ret != MBEDTLS_ERR_SSL_WANT_READ && ret != MBEDTLS_ERR_SSL_WANT_WRITE)
+  {
+    int pending = peeked >= 0 ? 1 : 0;
+    if (!pending)
+      stop();
+    return pending;
+  }
+  return mbedtls_ssl_get_bytes_avail(&ssl) + (peeked >= 0 ? 1 : 0);
+}
+
+int TLSClient::read()
+{
+  uint8_t data;
+  return read(&data, 1) == 1 ? data : -1;
+}
+
+int TLSClient::read(uint8_t *buf, size_t size)
+{
+  if (size == 0)
+    return 0;
+
+  int count = 0;
+  if (peeked >= 0)
+  {
+    buf[count++] = peeked;
+    peeked = -1;
+    if (size == 1 || !active)
+      return count;
+  }
+  if (!active)
+    return -1;
+
+  int ret = mbedtls_ssl_read(&ssl, buf + count, size - count);
+  if (ret > 0)
+    return count + ret;
+  if (ret != MBEDTLS_ERR_SSL_WANT_READ && ret != MBEDTLS_ERR_SSL_WANT_WRITE)
+    stop();
+  return count > 0 ? count : -1;
+}
+
+int TLSClient::peek()
+{
+  if (peeked < 0 && available() > 0)
+    peeked = read();
+  return peeked;
+}
+
+void TLSClient::flush()
+{
+}
+
+void TLSClient::stop()
+{
+  if (active)
+  {
+    mbedtls_ssl_close_notify(&ssl);
+    mbedtls_ssl_free(&ssl);
+    mbedtls_ssl_config_free(&conf);
+    mbedtls_ctr_drbg_free(&drbg);
+    mbedtls_entropy_free(&entropy);
+    // The socket is closed by WiFiClient
+    active = false;
+  }
+  peeked = -1;
+  WiFiClient::stop();
+}
+
+uint8_t TLSClient::connected()
+{
+  if (!active)
+    return 0;
+  if (peeked >= 0 || mbedtls_ssl_get_bytes_avail(&ssl) > 0)
+    return 1;
+  return WiFiClient::connected();
+}
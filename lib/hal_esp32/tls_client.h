@@ -0,0 +1,80 @@
+/*
+ * TLS Client with Session Resumption
+ *
+ * WiFiClient over mbedTLS that keeps the TLS session (session ID or ticket
+ * and master secret) in RTC memory, so the first connection after a deep
+ * sleep resumes the session with an abbreviated handshake instead of a full
+ * one (no certificate exchange, no key exchange). The session is only
+ * resumed with the host it was established with.
+ *
+ * The server certificate can be pinned by its SHA-256 fingerprint. It is
+ * checked on every full handshake. The cache keeps the fingerprint of the
+ * certificate a session was established with, a session is only offered
+ * when it matches the pin. Without a pin any certificate is accepted, like
+ * HTTPClient without a CA certificate.
+ *
+ * The network keeps it open between the requests of a wake (keep-alive).
+ */
+
+#ifndef _TLSClient_WeatherStation_H_
+#define _TLSClient_WeatherStation_H_
+
+#include <WiFiClient.h>
+#include <mbedtls/ctr_drbg.h>
+#include <mbedtls/entropy.h>
+#include <mbedtls/net_sockets.h>
+#include <mbedtls/ssl.h>
+
+#define TLS_FINGERPRINT_SIZE 32
+#define TLS_TICKET_MAX 384   // larger session tickets are not cached
+#define TLS_TIMEOUT 5000     // ms for the handshake and reads
+
+class TLSClient : public WiFiClient
+{
+public:
+  TLSClient();
+  ~TLSClient();
+
+  /* SHA-256 fingerprint of the server certificate, NULL to accept any */
+  void setFingerprint(const uint8_t *fingerprint);
+
+  /* The last connection resumed a cached session */
+  bool resumed() const { return sessionResumed; }
+
+  int connect(IPAddress ip, uint16_t port);
+  int connect(IPAddress ip, uint16_t port, int32_t timeout);
+  int connect(const char *host, uint16_t port);
+  int connect(const char *host, uint16_t port, int32_t timeout);
+
+  size_t write(uint8_t data);
+  size_t write(const uint8_t *buf, size_t size);
+  int available();
+  int read();
+  int read(uint8_t *buf, size_t size);
+  int peek();
+  void flush();
+  void stop();
+  uint8_t connected();
+
+  operator bool() { return connected(); }
+
+private:
+  bool handshake(const char *host);
+  void saveSession(uint32_t hostHash, const uint8_t *fingerprint);
+  bool restoreSession(uint32_t hostHash);
+  bool certificateFingerprint(uint8_t *digest);
+
+  mbedtls_ssl_context ssl;
+  mbedtls_ssl_config conf;
+  mbedtls_ctr_drbg_context drbg;
+  mbedtls_entropy_context entropy;
+  mbedtls_net_context net;
+
+  uint8_t pin[TLS_FINGERPRINT_SIZE];
+  bool pinned;
+  bool active;
+  bool sessionResumed;
+  int peeked; // byte read by peek(), -1 if none
+};
+
+#endif /*_TLSClient_WeatherStation_H_*/
@@ -0,0 +1,187 @@
+/*
+ * Arduino core stand-in for the native Linux target
+ */
+
+#include "Arduino.h"
+#include "native.h"
+
+#include <chrono>
+#include <thread>
+
+HardwareSerial Serial;
+
+/* Time */
+static std::chrono::steady_clock::time_point bootTime = std::chrono::steady_clock::now();
+static uint64_t simulatedMicros = 0;
+
+unsigned long millis()
+{
+  return (unsigned long)(micros() / 1000);
+}
+
+unsigned long micros()
+{
+  auto elapsed = std::chrono::steady_clock::now() - bootTime;
+  return (unsigned long)(std::chrono::duration_cast<std::chrono::microseconds>(elapsed).count() + simulatedMicros);
+}
+
+void delay(unsigned long ms)
+{
+  if (nativeRealtime())
+    std::this_thread::sleep_for(std::chrono::milliseconds(ms));
+  else
+    simulatedMicros += (uint64_t)ms * 1000;
+}
+
+void yield() {}
+
+void nativeResetMillis()
+{
+  bootTime = std::chrono::steady_clock::now();
+  simulatedMicros = 0;
+}
+
+uint64_t nativeSimulatedMicros()
+{
+  return simulatedMicros;
+}
+
+/* Print */
+size_t Print::write(const uint8_t *buffer, size_t size)
+{
+  size_t n = 0;
+  while (size--)
+  {
+    if (!write(*buffer++))
+      break;
+    n++;
+  }
+  return n;
+}
+
+size_t Print::printf(const char *format, ...)
+{
+  char buf[256];
+  va_list args;
+  va_start(args, format);
+  int len = vsnprintf(buf, sizeof(buf), format, args);
+  va_end(args);
+  if (len < 0)
+    return 0;
+  if ((size_t)len < sizeof(buf))
+    return write((const uint8_t *)buf, len);
+
+  std::string large(len + 1, '\0');
+  va_start(args, format);
+  vsnprintf(&large[0], large.size(), format, args);
+  va_end(args);
+  return write((const uint8_t *)large.data(), len);
+}
+
+size_t Print::print(const String &s)
+{
+  return write((const uint8_t *)s.c_str(), s.length());
+}
+
+size_t Print::print(long n, int base)
+{
+  return print(String(n, base));
+}
+
+size_t Print::print(unsigned long n, int base)
+{
+  return print(String(n, base));
+}
+
+size_t Print::print(long long n, int base)
+{
+  return base == DEC ? printf("%lld", n) : print((unsigned long long)n, base);
+}
+
+size_t Print::print(unsigned long long n, int base)
+{
+  return printf(base == HEX ? "%llX" : "%llu", n);
+}
+
+size_t Print::print(double n, int digits)
+{
+  return print(String(n, digits));
+}
+
+/* Stream */
+size_t Stream::readBytes(char *buffer, size_t length)
+{
+  size_t count = 0;
+  while (count < length)
+  {
+    int c = read();
+    if (c < 0)
+      break;
+    *buffer++ = (char)c;
+    count++;
+  }
+  return count;
+}
+
+/* String */
+String::String(long value, unsigned char base)
+{
+  char buf[2 + 8 * sizeof(long)];
+  if (base == HEX)
+    snprintf(buf, sizeof(buf), "%lX", value);
+  else
+    snprintf(buf, sizeof(buf), "%ld", value);
+  s = buf;
+}
+
+String::String(unsigned long value, unsigned char base)
+{
+  char buf[1 + 8 * sizeof(unsigned long)];
+  snprintf(buf, sizeof(buf), base == HEX ? "%lX" : "%lu", value);
+  s = buf;
+}
+
+String::String(double value, unsigned int decimalPlaces)
+{
+  char buf[64];
+  if (std::isnan(value))
+    s = "nan";
+  else if (std::isinf(value))
+    s = "inf";
+  else
+  {
+    snprintf(buf, sizeof(buf), "%.*f", decimalPlaces, value);
+    s = buf;
+  }
+}
+
+int String::indexOf(char c, unsigned int from) const
+{
+  size_t pos = s.find(c, from);
+  return pos == std::string::npos ? -1 : (int)pos;
+}
+
+String String::substring(unsigned int beginIndex) const
+{
+  return beginIndex < s.length() ? String(s.substr(beginIndex)) : String();
+}
+
+String String::substring(unsigned int beginIndex, unsigned int endIndex) const
+{
+  if (beginIndex > endIndex)
+    std::swap(beginIndex, endIndex);
+  if (beginIndex >= s.length())
+    return String();
+  return String(s.substr(beginIndex, endIndex - beginIndex));
+}
+
+/* Serial port */
+size_t HardwareSerial::write(uint8_t c)
+{
+  return fputc(c, stdout) == EOF ? 0 : 1;
+}
+
+size_t HardwareSerial::write(const uint8_t *buffer, size_t size)
+{
+  return fwrite(buffer, 1, size, stdout);
+}
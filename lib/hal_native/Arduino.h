@@ -0,0 +1,197 @@
+/*
+ * Arduino core stand-in for the native Linux target
+ *
+ * Only the subset used by the firmware is provided. Serial writes to
+ * stdout, time is taken from the host clock and delay() is simulated
+ * unless real time is requested (see native.h).
+ */
+
+#ifndef _Native_Arduino_H_
+#define _Native_Arduino_H_
+
+#include <algorithm>
+#include <cmath>
+#include <cstdarg>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <string>
+
+using std::abs;
+using std::isinf;
+using std::isnan;
+using std::max;
+using std::min;
+using std::round;
+
+typedef uint8_t byte;
+typedef bool boolean;
+
+#define HIGH 0x1
+#define LOW 0x0
+#define INPUT 0x01
+#define OUTPUT 0x03
+
+#define DEC 10
+#define HEX 16
+
+/* Flash strings are regular strings on the host */
+class __FlashStringHelper;
+#define F(string_literal) (string_literal)
+#define PROGMEM
+
+/* RTC slow memory, persisted between runs by the native runtime */
+#define RTC_DATA_ATTR __attribute__((section("rtc_data")))
+
+/* Time */
+unsigned long millis();
+unsigned long micros();
+void delay(unsigned long ms);
+void yield();
+
+/* GPIO, no-ops on the host */
+inline void pinMode(uint8_t, uint8_t) {}
+inline void digitalWrite(uint8_t, uint8_t) {}
+inline int digitalRead(uint8_t) { return LOW; }
+inline uint16_t analogRead(uint8_t) { return 0; }
+
+class String;
+
+/* Print */
+class Print
+{
+public:
+  virtual ~Print() {}
+  virtual size_t write(uint8_t c) = 0;
+  virtual size_t write(const uint8_t *buffer, size_t size);
+  size_t write(const char *str) { return str ? write((const uint8_t *)str, strlen(str)) : 0; }
+  size_t write(const char *buffer, size_t size) { return write((const uint8_t *)buffer, size); }
+  virtual void flush() {}
+
+  size_t printf(const char *format, ...) __attribute__((format(printf, 2, 3)));
+
+  size_t print(const String &s);
+  size_t print(const char str[]) { return write(str); }
+  size_t print(char c) { return write((uint8_t)c); }
+  size_t print(unsigned char n, int base = DEC) { return print((unsigned long)n, base); }
+  size_t print(int n, int base = DEC) { return print((long)n, base); }
+  size_t print(unsigned int n, int base = DEC) { return print((unsigned long)n, base); }
+  size_t print(long n, int base = DEC);
+  size_t print(unsigned long n, int base = DEC);
+  size_t print(long long n, int base = DEC);
+  size_t print(unsigned long long n, int base = DEC);
+  size_t print(double n, int digits = 2);
+
+  size_t println() { return write("\r\n"); }
+  template <typename T>
+  size_t println(const T &value) { return print(value) + println(); }
+  template <typename T>
+  size_t println(const T &value, int format) { return print(value, format) + println(); }
+};
+
+/* Stream */
+class Stream : public Print
+{
+public:
+  virtual int available() = 0;
+  virtual int read() = 0;
+  virtual int peek() = 0;
+  virtual size_t readBytes(char *buffer, size_t length);
+  size_t readBytes(uint8_t *buffer, size_t length) { return readBytes((char *)buffer, length); }
+};
+
+/* String */
+class String
+{
+public:
+  String() {}
+  String(const char *cstr) : s(cstr ? cstr : "") {}
+  String(const std::string &str) : s(str) {}
+  explicit String(char c) : s(1, c) {}
+  explicit String(unsigned char value, unsigned char base = DEC) : String((unsigned long)value, base) {}
+  explicit String(int value, unsigned char base = DEC) : String((long)value, base) {}
+  explicit String(unsigned int value, unsigned char base = DEC) : String((unsigned long)value, base) {}
+  explicit String(long value, unsigned char base = DEC);
+  explicit String(unsigned long value, unsigned char base = DEC);
+  explicit String(float value, unsigned int decimalPlaces = 2) : String((double)value, decimalPlaces) {}
+  explicit String(double value, unsigned int decimalPlaces = 2);
+
+  const char *c_str() const { return s.c_str(); }
+  unsigned int length() const { return s.length(); }
+  bool reserve(unsigned int size) { s.reserve(size); return true; }
+  char operator[](unsigned int index) const { return index < s.length() ? s[index] : 0; }
+  int indexOf(char c, unsigned int from = 0) const;
+  String substring(unsigned int beginIndex) const;
+  String substring(unsigned int beginIndex, unsigned int endIndex) const;
+  int toInt() const { return atoi(s.c_str()); }
+  float toFloat() const { return atof(s.c_str()); }
+
+  bool concat(const String &str) { s += str.s; return true; }
+  bool concat(const char *cstr) { if (cstr) s += cstr; return cstr != nullptr; }
+  bool concat(const char *cstr, unsigned int length) { s.append(cstr, length); return true; }
+  bool concat(char c) { s += c; return true; }
+
+  String &operator+=(const String &rhs) { concat(rhs); return *this; }
+  String &operator+=(const char *rhs) { concat(rhs); return *this; }
+  String &operator+=(char rhs) { concat(rhs); return *this; }
+
+  bool equals(const String &rhs) const { return s == rhs.s; }
+  bool equals(const char *rhs) const { return s == (rhs ? rhs : ""); }
+  bool operator==(const String &rhs) const { return equals(rhs); }
+  bool operator==(const char *rhs) const { return equals(rhs); }
+  bool operator!=(const String &rhs) const { return !equals(rhs); }
+  bool operator!=(const char *rhs) const { return !equals(rhs); }
+
+private:
+  std::string s;
+};
+
+/* Result type of String concatenation, as in the Arduino core */
+class StringSumHelper : public String
+{
+public:
+  StringSumHelper(const String &s) : String(s) {}
+  StringSumHelper(const char *p) : String(p) {}
+};
+
+inline StringSumHelper operator+(const String &lhs, const String &rhs)
+{
+  StringSumHelper result(lhs);
+  result.concat(rhs);
+  return result;
+}
+
+inline StringSumHelper operator+(const String &lhs, const char *rhs)
+{
+  StringSumHelper result(lhs);
+  result.concat(rhs);
+  return result;
+}
+
+inline StringSumHelper operator+(const char *lhs, const String &rhs)
+{
+  StringSumHelper result(lhs);
+  result.concat(rhs);
+  return result;
+}
+
+/* Serial port, mapped to stdout */
+class HardwareSerial : public Stream
+{
+public:
+  void begin(unsigned long) {}
+  void end() {}
+  size_t write(uint8_t c);
+  size_t write(const uint8_t *buffer, size_t size);
+  using Print::write;
+  int available() { return 0; }
+  int read() { return -1; }
+  int peek() { return -1; }
+  void flush() { fflush(stdout); }
+};
+
+extern HardwareSerial Serial;
+
+#endif /*_Native_Arduino_H_*/
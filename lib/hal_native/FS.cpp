@@ -0,0 +1,272 @@
+/*
+ * File system stand-in for the native Linux target
+ *
+ * Writes go straight to the file descriptor without buffering so every
+ * File::write() costs one system call, like a SD transaction on the device.
+ * Reads are buffered.
+ */
+
+#include "FS.h"
+#include "native.h"
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace fs
+{
+
+  class FileImpl
+  {
+  public:
+    ~FileImpl() { close(); }
+
+    void close()
+    {
+      if (fd >= 0)
+        ::close(fd);
+      if (dir)
+        closedir(dir);
+      fd = -1;
+      dir = nullptr;
+    }
+
+    bool fill()
+    {
+      if (pos < len)
+        return true;
+      ssize_t n = ::read(fd, buffer, sizeof(buffer));
+      pos = 0;
+      len = n > 0 ? (size_t)n : 0;
+      return len > 0;
+    }
+
+    // Drop read-ahead so the descriptor offset matches the logical position
+    void sync()
+    {
+      if (pos < len)
+        lseek(fd, -(off_t)(len - pos), SEEK_CUR);
+      pos = len = 0;
+    }
+
+    int fd = -1;
+    DIR *dir = nullptr;
+    String path;
+    String hostPath;
+    uint8_t buffer[512];
+    size_t pos = 0;
+    size_t len = 0;
+  };
+
+  size_t File::write(uint8_t c)
+  {
+    return write(&c, 1);
+  }
+
+  size_t File::write(const uint8_t *buf, size_t size)
+  {
+    if (!_p || _p->fd < 0)
+      return 0;
+    _p->sync();
+    ssize_t n = ::write(_p->fd, buf, size);
+    return n > 0 ? (size_t)n : 0;
+  }
+
+  int File::available()
+  {
+    if (!_p || _p->fd < 0)
+      return 0;
+    size_t remaining = size() - position();
+    return remaining > 0x7FFFFFFF ? 0x7FFFFFFF : (int)remaining;
+  }
+
+  int File::read()
+  {
+    if (!_p || _p->fd < 0 || !_p->fill())
+      return -1;
+    return _p->buffer[_p->pos++];
+  }
+
+  int File::peek()
+  {
+    if (!_p || _p->fd < 0 || !_p->fill())
+      return -1;
+    return _p->buffer[_p->pos];
+  }
+
+  void File::flush()
+  {
+    if (_p && _p->fd >= 0)
+      fsync(_p->fd);
+  }
+
+  size_t File::read(uint8_t *buf, size_t size)
+  {
+    size_t count = 0;
+    while (_p && _p->fd >= 0 && count < size && _p->fill())
+    {
+      size_t n = min(size - count, _p->len - _p->pos);
+      memcpy(buf + count, _p->buffer + _p->pos, n);
+      _p->pos += n;
+      count += n;
+    }
+    return count;
+  }
+
+  bool File::seek(uint32_t pos, SeekMode mode)
+  {
+    if (!_p || _p->fd < 0)
+      return false;
+    _p->sync();
+    return lseek(_p->fd, pos, mode == SeekSet ? SEEK_SET : (mode == SeekCur ? SEEK_CUR : SEEK_END)) >= 0;
+  }
+
+  size_t File::position() const
+  {
+    if (!_p || _p->fd < 0)
+      return 0;
+    off_t offset = lseek(_p->fd, 0, SEEK_CUR);
+    return offset < 0 ? 0 : (size_t)offset - (_p->len - _p->pos);
+  }
+
+  size_t File::size() const
+  {
+    struct stat st;
+    if (!_p || _p->fd < 0 || fstat(_p->fd, &st) != 0)
+      return 0;
+    return st.st_size;
+  }
+
+  void File::close()
+  {
+    if (_p)
+      _p->close();
+    _p.reset();
+  }
+
+  File::operator bool() const
+  {
+    return _p && (_p->fd >= 0 || _p->dir);
+  }
+
+  const char *File::path() const
+  {
+    return _p ? _p->path.c_str() : nullptr;
+  }
+
+  const char *File::name() const
+  {
+    if (!_p)
+      return nullptr;
+    const char *slash = strrchr(_p->path.c_str(), '/');
+    return slash ? slash + 1 : _p->path.c_str();
+  }
+
+  bool File::isDirectory() const
+  {
+    return _p && _p->dir;
+  }
+
+  File File::openNextFile(const char *)
+  {
+    if (!_p || !_p->dir)
+      return File();
+
+    struct dirent *entry;
+    while ((entry = readdir(_p->dir)) != nullptr)
+    {
+      if (strcmp(entry->d_name, ".") == 0 || strcmp(entry->d_name, "..") == 0)
+        continue;
+
+      String host = _p->hostPath + "/" + entry->d_name;
+      String path = (_p->path == "/" ? String() : _p->path) + "/" + entry->d_name;
+
+      auto impl = std::make_shared<FileImpl>();
+      impl->path = path;
+      impl->hostPath = host;
+
+      struct stat st;
+      if (stat(host.c_str(), &st) == 0 && S_ISDIR(st.st_mode))
+        impl->dir = opendir(host.c_str());
+      else
+        impl->fd = ::open(host.c_str(), O_RDONLY);
+      return (impl->fd >= 0 || impl->dir) ? File(impl) : File();
+    }
+    return File();
+  }
+
+  void File::rewindDirectory()
+  {
+    if (_p && _p->dir)
+      rewinddir(_p->dir);
+  }
+
+  String FS::hostPath(const char *path)
+  {
+    char buf[256];
+    String host = nativePath(_mountPoint, buf, sizeof(buf));
+    if (path && path[0] != '/')
+      host += "/";
+    return host + path;
+  }
+
+  File FS::open(const char *path, const char *mode, const bool)
+  {
+    String host = hostPath(path);
+    auto impl = std::make_shared<FileImpl>();
+    impl->path = path;
+    impl->hostPath = host;
+
+    struct stat st;
+    if (strcmp(mode, FILE_READ) == 0)
+    {
+      if (stat(host.c_str(), &st) == 0 && S_ISDIR(st.st_mode))
+        impl->dir = opendir(host.c_str());
+      else
+        impl->fd = ::open(host.c_str(), O_RDONLY);
+    }
+    else if (strcmp(mode, FILE_APPEND) == 0)
+      impl->fd = ::open(host.c_str(), O_WRONLY | O_CREAT | O_APPEND, 0644);
+    else
+      impl->fd = ::open(host.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+
+    return (impl->fd >= 0 || impl->dir) ? File(impl) : File();
+  }
+
+  bool FS::exists(const char *path)
+  {
+    struct stat st;
+    return stat(hostPath(path).c_str(), &st) == 0;
+  }
+
+  bool FS::remove(const char *path)
+  {
+    return unlink(hostPath(path).c_str()) == 0;
+  }
+
+  bool FS::rename(const char *pathFrom, const char *pathTo)
+  {
+    return ::rename(hostPath(pathFrom).c_str(), hostPath(pathTo).c_str()) == 0;
+  }
+
+  bool FS::mkdir(const char *path)
+  {
+    return ::mkdir(hostPath(path).c_str(), 0755) == 0;
+  }
+
+  bool FS::rmdir(const char *path)
+  {
+    return ::rmdir(hostPath(path).c_str()) == 0;
+  }
+
+  bool FS::mount()
+  {
+    struct stat st;
+    String root = hostPath("");
+    if (stat(root.c_str(), &st) == 0)
+      return S_ISDIR(st.st_mode);
+    return ::mkdir(root.c_str(), 0755) == 0;
+  }
+
+} // namespace fs
@@ -0,0 +1,100 @@
+/*
+ * File system stand-in for the native Linux target
+ *
+ * Mirrors the fs::FS and fs::File API of the ESP32 core. Each file system
+ * is a directory below the native data root.
+ */
+
+#ifndef _Native_FS_H_
+#define _Native_FS_H_
+
+#include "Arduino.h"
+
+#include <memory>
+
+#define FILE_READ "r"
+#define FILE_WRITE "w"
+#define FILE_APPEND "a"
+
+namespace fs
+{
+
+  enum SeekMode
+  {
+    SeekSet = 0,
+    SeekCur = 1,
+    SeekEnd = 2
+  };
+
+  class FileImpl;
+
+  class File : public Stream
+  {
+  public:
+    File() {}
+    File(std::shared_ptr<FileImpl> impl) : _p(impl) {}
+
+    size_t write(uint8_t c);
+    size_t write(const uint8_t *buf, size_t size);
+    using Print::write;
+    int available();
+    int read();
+    int peek();
+    void flush();
+    size_t read(uint8_t *buf, size_t size);
+    bool seek(uint32_t pos, SeekMode mode = SeekSet);
+    size_t position() const;
+    size_t size() const;
+    void close();
+    operator bool() const;
+    const char *path() const;
+    const char *name() const;
+
+    bool isDirectory() const;
+    File openNextFile(const char *mode = FILE_READ);
+    void rewindDirectory();
+
+  private:
+    std::shared_ptr<FileImpl> _p;
+  };
+
+  class FS
+  {
+  public:
+    FS(const char *mountPoint) : _mountPoint(mountPoint) {}
+
+    File open(const char *path, const char *mode = FILE_READ, const bool create = false);
+    File open(const String &path, const char *mode = FILE_READ, const bool create = false) { return open(path.c_str(), mode, create); }
+
+    bool exists(const char *path);
+    bool exists(const String &path) { return exists(path.c_str()); }
+
+    bool remove(const char *path);
+    bool remove(const String &path) { return remove(path.c_str()); }
+
+    bool rename(const char *pathFrom, const char *pathTo);
+    bool rename(const String &pathFrom, const String &pathTo) { return rename(pathFrom.c_str(), pathTo.c_str()); }
+
+    bool mkdir(const char *path);
+    bool mkdir(const String &path) { return mkdir(path.c_str()); }
+
+    bool rmdir(const char *path);
+    bool rmdir(const String &path) { return rmdir(path.c_str()); }
+
+    // Create the backing directory, returns false if that failed
+    bool mount();
+
+  private:
+    String hostPath(const char *path);
+    const char *_mountPoint;
+  };
+
+} // namespace fs
+
+using fs::File;
+using fs::FS;
+using fs::SeekCur;
+using fs::SeekEnd;
+using fs::SeekSet;
+
+#endif /*_Native_FS_H_*/
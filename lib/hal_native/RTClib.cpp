@@ -0,0 +1,119 @@
+/*
+ * RTClib stand-in for the native Linux target
+ */
+
+#include "RTClib.h"
+
+DateTime::DateTime(uint32_t t)
+{
+  time_t tt = t;
+  struct tm tm;
+  gmtime_r(&tt, &tm);
+  yOff = tm.tm_year + 1900 >= 2000 ? tm.tm_year + 1900 - 2000 : 0;
+  m = tm.tm_mon + 1;
+  d = tm.tm_mday;
+  hh = tm.tm_hour;
+  mm = tm.tm_min;
+  ss = tm.tm_sec;
+}
+
+DateTime::DateTime(uint16_t year, uint8_t month, uint8_t day, uint8_t hour, uint8_t min, uint8_t sec)
+{
+  if (year >= 2000U)
+    year -= 2000U;
+  yOff = year;
+  m = month;
+  d = day;
+  hh = hour;
+  mm = min;
+  ss = sec;
+}
+
+/* Parses __DATE__ ("Jan  1 2024") and __TIME__ ("12:34:56") */
+DateTime::DateTime(const char *date, const char *time)
+{
+  static const char months[] = "JanFebMarAprMayJunJulAugSepOctNovDec";
+  const char *found = strstr(months, String(date).substring(0, 3).c_str());
+  yOff = atoi(date + 7) - 2000;
+  m = found ? (found - months) / 3 + 1 : 1;
+  d = atoi(date + 4);
+  hh = atoi(time);
+  mm = atoi(time + 3);
+  ss = atoi(time + 6);
+}
+
+bool DateTime::isValid() const
+{
+  if (yOff >= 100 || m < 1 || m > 12 || d < 1 || d > 31 || hh >= 24 || mm >= 60 || ss >= 60)
+    return false;
+  DateTime other(unixtime());
+  return yOff == other.yOff && m == other.m && d == other.d && hh == other.hh && mm == other.mm && ss == other.ss;
+}
+
+/* Same placeholders as RTClib: YYYY, YY, MM, DD, hh, mm, ss */
+char *DateTime::toString(char *buffer) const
+{
+  for (size_t i = 0; buffer[i] != 0; i++)
+  {
+    char c = buffer[i];
+    char next = buffer[i + 1];
+    if (c == 'h' && next == 'h')
+    {
+      buffer[i] = '0' + hh / 10;
+      buffer[++i] = '0' + hh % 10;
+    }
+    else if (c == 'm' && next == 'm')
+    {
+      buffer[i] = '0' + mm / 10;
+      buffer[++i] = '0' + mm % 10;
+    }
+    else if (c == 's' && next == 's')
+    {
+      buffer[i] = '0' + ss / 10;
+      buffer[++i] = '0' + ss % 10;
+    }
+    else if (c == 'D' && next == 'D')
+    {
+      buffer[i] = '0' + d / 10;
+      buffer[++i] = '0' + d % 10;
+    }
+    else if (c == 'M' && next == 'M')
+    {
+      buffer[i] = '0' + m / 10;
+      buffer[++i] = '0' + m % 10;
+    }
+    else if (c == 'Y' && next == 'Y')
+    {
+      if (buffer[i + 2] == 'Y' && buffer[i + 3] == 'Y')
+      {
+        buffer[i] = '2';
+        buffer[++i] = '0';
+        buffer[++i] = '0' + yOff / 10;
+        buffer[++i] = '0' + yOff % 10;
+      }
+      else
+      {
+        buffer[i] = '0' + yOff / 10;
+        buffer[++i] = '0' + yOff % 10;
+      }
+    }
+  }
+  return buffer;
+}
+
+uint8_t DateTime::dayOfTheWeek() const
+{
+  return (unixtime() / 86400L + 4) % 7; // Jan 1, 1970 was a Thursday
+}
+
+uint32_t DateTime::unixtime() const
+{
+  struct tm tm = {};
+  tm.tm_year = yOff + 100;
+  tm.tm_mon = m - 1;
+  tm.tm_mday = d;
+  tm.tm_hour = hh;
+  tm.tm_min = mm;
+  tm.tm_sec = ss;
+  return (uint32_t)timegm(&tm);
+}
@@ -0,0 +1,64 @@
+/*
+ * RTClib stand-in for the native Linux target
+ *
+ * Only DateTime and TimeSpan are provided, the clock itself is behind the
+ * Clock interface of the hardware abstraction layer.
+ */
+
+#ifndef _Native_RTClib_H_
+#define _Native_RTClib_H_
+
+#include "Arduino.h"
+
+class TimeSpan
+{
+public:
+  TimeSpan(int32_t seconds = 0) : _seconds(seconds) {}
+  TimeSpan(int16_t days, int8_t hours, int8_t minutes, int8_t seconds)
+      : _seconds((int32_t)days * 86400L + (int32_t)hours * 3600 + (int32_t)minutes * 60 + seconds) {}
+  int16_t days() const { return _seconds / 86400L; }
+  int8_t hours() const { return _seconds / 3600 % 24; }
+  int8_t minutes() const { return _seconds / 60 % 60; }
+  int8_t seconds() const { return _seconds % 60; }
+  int32_t totalseconds() const { return _seconds; }
+
+private:
+  int32_t _seconds;
+};
+
+class DateTime
+{
+public:
+  DateTime(uint32_t t = 0);
+  DateTime(uint16_t year, uint8_t month, uint8_t day, uint8_t hour = 0, uint8_t min = 0, uint8_t sec = 0);
+  DateTime(const char *date, const char *time);
+
+  bool isValid() const;
+  char *toString(char *buffer) const;
+
+  uint16_t year() const { return 2000U + yOff; }
+  uint8_t month() const { return m; }
+  uint8_t day() const { return d; }
+  uint8_t hour() const { return hh; }
+  uint8_t minute() const { return mm; }
+  uint8_t second() const { return ss; }
+  uint8_t dayOfTheWeek() const;
+
+  uint32_t unixtime() const;
+
+  DateTime operator+(const TimeSpan &span) const { return DateTime(unixtime() + span.totalseconds()); }
+  DateTime operator-(const TimeSpan &span) const { return DateTime(unixtime() - span.totalseconds()); }
+  TimeSpan operator-(const DateTime &right) const { return TimeSpan(unixtime() - right.unixtime()); }
+  bool operator<(const DateTime &right) const { return unixtime() < right.unixtime(); }
+  bool operator==(const DateTime &right) const { return unixtime() == right.unixtime(); }
+
+protected:
+  uint8_t yOff;
+  uint8_t m;
+  uint8_t d;
+  uint8_t hh;
+  uint8_t mm;
+  uint8_t ss;
+};
+
+#endif /*_Native_RTClib_H_*/
@@ -0,0 +1,784 @@
+/*
+ * Hardware Abstraction Layer - Native Linux stand-ins
+ *
+ * Sensors replay rows from <root>/sensors.csv (one row per wake cycle) or
+ * generate a synthetic diurnal cycle if the file does not exist. The
+ * particle sensor can also replay a captured byte stream instead. The clock
+ * follows the host clock plus an offset that advances with simulated
+ * delays and deep sleep. The loopback network accepts every request and
+ * appends the body to <root>/outbox.jsonl (MessagePack bodies back to back
+ * to <root>/outbox.msgpack), its MQTT broker stand-in does the same with
+ * published messages.
+ */
+
+#include "checksum.h"
+#include "hal.h"
+#include "native.h"
+#include "pms7003.h"
+
+#include <deque>
+#include <string>
+#include <vector>
+
+#include <sys/stat.h>
+
+/* Battery backed state of the external hardware (PCF8523, replay position) */
+struct HardwareState
+{
+  int64_t clockOffset; // seconds added to the host clock
+  bool clockSet;
+  uint32_t sensorRow;
+  uint32_t clockMicros; // fraction of a second carried over from the last cycle
+};
+
+static HardwareState hardware = {0, false, 0, 0};
+
+static void loadHardwareState()
+{
+  char path[256];
+  FILE *f = fopen(nativePath("hardware.state", path, sizeof(path)), "r");
+  if (!f)
+    return;
+  long long offset = 0;
+  int clockSet = 0;
+  unsigned int row = 0;
+  unsigned int micros = 0;
+  if (fscanf(f, "%lld %d %u %u", &offset, &clockSet, &row, &micros) >= 3)
+  {
+    hardware.clockOffset = offset;
+    hardware.clockSet = clockSet != 0;
+    hardware.sensorRow = row;
+    hardware.clockMicros = micros;
+  }
+  fclose(f);
+}
+
+static void saveHardwareState()
+{
+  char path[256];
+  FILE *f = fopen(nativePath("hardware.state", path, sizeof(path)), "w");
+  if (!f)
+    return;
+  fprintf(f, "%lld %d %u %u\n", (long long)hardware.clockOffset, hardware.clockSet ? 1 : 0, hardware.sensorRow,
+          hardware.clockMicros);
+  fclose(f);
+}
+
+/* Station time in seconds, including simulated time of the current cycle */
+static int64_t stationTime()
+{
+  return (int64_t)time(nullptr) + hardware.clockOffset +
+         (int64_t)((hardware.clockMicros + nativeSimulatedMicros()) / 1000000ULL);
+}
+
+/* Sensor replay */
+enum SensorColumn
+{
+  COL_TEMPERATURE,
+  COL_HUMIDITY,
+  COL_PRESSURE,
+  COL_GAS_RESISTANCE,
+  COL_VISIBLE,
+  COL_IR,
+  COL_UV,
+  COL_PM1_0,
+  COL_PM2_5,
+  COL_PM10_0,
+  COL_GT0_3,
+  COL_GT0_5,
+  COL_GT1_0,
+  COL_GT2_5,
+  COL_GT5_0,
+  COL_GT10_0,
+  COL_BATTERY,
+  COL_COUNT
+};
+
+static const char *columnNames[COL_COUNT] = {
+    "temperature", "humidity", "pressure", "gas_resistance",
+    "visible", "ir", "uv",
+    "pm1_0", "pm2_5", "pm10_0",
+    "gt0_3", "gt0_5", "gt1_0", "gt2_5", "gt5_0", "gt10_0",
+    "battery"};
+
+static double sensorRow[COL_COUNT];
+static bool sensorRowLoaded = false;
+
+static void syntheticRow()
+{
+  int64_t t = stationTime();
+  double day = 2 * M_PI * (double)(t % 86400) / 86400.0;
+  double daylight = max(0.0, -cos(day));
+  double pm = 6.0 + 4.0 * sin(2 * M_PI * (double)(t % 604800) / 604800.0);
+
+  sensorRow[COL_TEMPERATURE] = 15.0 - 8.0 * cos(day - 0.6);
+  sensorRow[COL_HUMIDITY] = 65.0 + 20.0 * cos(day - 0.6);
+  sensorRow[COL_PRESSURE] = 101325.0 + 300.0 * sin(2 * M_PI * (double)(t % 259200) / 259200.0);
+  // Clean air with a slow drift, polluted in the evening
+  double hour = (double)(t % 86400) / 3600.0;
+  double gasDrift = 150000.0 + 20000.0 * sin(2 * M_PI * (double)(t % 1209600) / 1209600.0);
+  sensorRow[COL_GAS_RESISTANCE] = gasDrift * (1.0 - 0.5 * exp(-(hour - 19.0) * (hour - 19.0) / 2.0));
+  sensorRow[COL_VISIBLE] = 260.0 + 1200.0 * daylight;
+  sensorRow[COL_IR] = 250.0 + 3000.0 * daylight;
+  sensorRow[COL_UV] = 2.0 + 600.0 * daylight;
+  sensorRow[COL_PM1_0] = round(pm * 0.7);
+  sensorRow[COL_PM2_5] = round(pm);
+  sensorRow[COL_PM10_0] = round(pm * 1.3);
+  sensorRow[COL_GT0_3] = round(pm * 180.0);
+  sensorRow[COL_GT0_5] = round(pm * 55.0);
+  sensorRow[COL_GT1_0] = round(pm * 9.0);
+  sensorRow[COL_GT2_5] = round(pm * 0.8);
+  sensorRow[COL_GT5_0] = round(pm * 0.2);
+  sensorRow[COL_GT10_0] = round(pm * 0.05);
+  sensorRow[COL_BATTERY] = 3.9 + 0.2 * daylight;
+}
+
+/* Load row number hardware.sensorRow (wrapping) of sensors.csv */
+static bool replayRow()
+{
+  char path[256];
+  FILE *f = fopen(nativePath("sensors.csv", path, sizeof(path)), "r");
+  if (!f)
+    return false;
+
+  char line[512];
+  int map[COL_COUNT];
+  for (int i = 0; i < COL_COUNT; i++)
+    map[i] = -1;
+
+  // Header row maps column names to positions
+  if (!fgets(line, sizeof(line), f))
+  {
+    fclose(f);
+    return false;
+  }
+  int position = 0;
+  for (char *token = strtok(line, ",\r\n"); token; token = strtok(nullptr, ",\r\n"), position++)
+  {
+    for (int i = 0; i < COL_COUNT; i++)
+      if (strcmp(token, columnNames[i]) == 0)
+        map[i] = position;
+  }
+
+  // Count rows, then seek to the requested one
+  long dataStart = ftell(f);
+  uint32_t rows = 0;
+  while (fgets(line, sizeof(line), f))
+    rows++;
+  if (rows == 0)
+  {
+    fclose(f);
+    return false;
+  }
+  fseek(f, dataStart, SEEK_SET);
+  for (uint32_t i = 0; i <= hardware.sensorRow % rows; i++)
+    fgets(line, sizeof(line), f);
+  fclose(f);
+
+  double values[COL_COUNT * 2] = {};
+  position = 0;
+  for (char *token = strtok(line, ",\r\n"); token && position < COL_COUNT * 2; token = strtok(nullptr, ",\r\n"))
+    values[position++] = atof(token);
+
+  syntheticRow();
+  for (int i = 0; i < COL_COUNT; i++)
+    if (map[i] >= 0 && map[i] < position)
+      sensorRow[i] = values[map[i]];
+  return true;
+}
+
+static const double *currentRow()
+{
+  if (!sensorRowLoaded)
+  {
+    if (!replayRow())
+      syntheticRow();
+    sensorRowLoaded = true;
+  }
+  return sensorRow;
+}
+
+/* BME680 */
+class NativeEnvironmentSensor : public EnvironmentSensor
+{
+public:
+  bool begin() { return true; }
+
+  bool beginReading()
+  {
+    readyAt = millis() + 190; // oversampling and 150 ms gas heater
+    return true;
+  }
+
+  bool endReading(EnvironmentReading &reading)
+  {
+    const double *row = currentRow();
+    unsigned long now = millis();
+    if (now < readyAt)
+      delay(readyAt - now);
+    reading.temperature = row[COL_TEMPERATURE];
+    reading.humidity = row[COL_HUMIDITY];
+    reading.pressure = (uint32_t)row[COL_PRESSURE];
+    reading.gas_resistance = (uint32_t)row[COL_GAS_RESISTANCE];
+    return true;
+  }
+
+private:
+  unsigned long readyAt = 0;
+};
+
+/* SI1145 */
+class NativeLightSensor : public LightSensor
+{
+public:
+  bool begin() { return true; }
+  uint16_t readVisible() { return currentRow()[COL_VISIBLE]; }
+  uint16_t readIR() { return currentRow()[COL_IR]; }
+  uint16_t readUV() { return currentRow()[COL_UV]; }
+};
+
+/* PMS7003, a new frame every second */
+/* The fan needs a moment to spin up, then the counts settle exponentially */
+#define NATIVE_PMS_SPINUP_MS 2500
+#define NATIVE_PMS_SETTLE_MS 3000.0
+#define NATIVE_PMS_BYTES_PER_SECOND 960 // 9600 baud, 8N1
+
+/*
+ * Frames go through the same parser as on the ESP32. They are either
+ * generated once per second from the sensor row, or replayed from a
+ * capture of the sensor's byte stream in <root>/pms7003.bin at UART speed.
+ */
+class NativeParticleSensor : public ParticleSensor
+{
+public:
+  void begin()
+  {
+    poweredOn = millis();
+    sent = 0;
+    parser.reset();
+
+    char path[256];
+    FILE *f = fopen(nativePath("pms7003.bin", path, sizeof(path)), "rb");
+    if (f)
+    {
+      uint8_t buffer[4096];
+      size_t n;
+      capture.clear();
+      while ((n = fread(buffer, 1, sizeof(buffer), f)) > 0)
+        capture.insert(capture.end(), buffer, buffer + n);
+      fclose(f);
+      replay = true;
+    }
+  }
+
+  bool waitForFrame(uint32_t timeout)
+  {
+    unsigned long start = millis();
+    while (true)
+    {
+      receive();
+      if (parser.read(current))
+        return true;
+      if (millis() - start >= timeout)
+        return false;
+      delay(10);
+    }
+  }
+
+  const ParticleReading &reading() { return current; }
+
+private:
+  /* Feed everything the sensor has sent until now */
+  void receive()
+  {
+    unsigned long running = millis() - poweredOn;
+    if (replay)
+    {
+      size_t due = (uint64_t)running * NATIVE_PMS_BYTES_PER_SECOND / 1000;
+      if (due > capture.size())
+        due = capture.size();
+      if (due > sent)
+        parser.feed(capture.data() + sent, due - sent);
+      sent = due;
+      return;
+    }
+
+    for (; sent < running / 1000; sent++)
+    {
+      uint8_t frame[PMS7003_FRAME_SIZE];
+      pms7003Frame(generate((sent + 1) * 1000), frame);
+      parser.feed(frame, sizeof(frame));
+    }
+  }
+
+  /* Reading of the current sensor row, running ms after power-up */
+  ParticleReading generate(unsigned long running)
+  {
+    const double *row = currentRow();
+    double settled = running < NATIVE_PMS_SPINUP_MS ? 0.0 : 1.0 - exp(-(double)(running - NATIVE_PMS_SPINUP_MS) / NATIVE_PMS_SETTLE_MS);
+    ParticleReading reading;
+    reading.pm1_0 = round(row[COL_PM1_0] * settled);
+    reading.pm2_5 = round(row[COL_PM2_5] * settled);
+    reading.pm10_0 = round(row[COL_PM10_0] * settled);
+    reading.gt0_3 = round(row[COL_GT0_3] * settled);
+    reading.gt0_5 = round(row[COL_GT0_5] * settled);
+    reading.gt1_0 = round(row[COL_GT1_0] * settled);
+    reading.gt2_5 = round(row[COL_GT2_5] * settled);
+    reading.gt5_0 = round(row[COL_GT5_0] * settled);
+    reading.gt10_0 = round(row[COL_GT10_0] * settled);
+    reading.hwVersion = 0x80;
+    reading.errorCode = 0;
+    return reading;
+  }
+
+  PMS7003Parser parser;
+  ParticleReading current = {};
+  unsigned long poweredOn = 0;
+  size_t sent = 0; // frames generated or bytes replayed
+  std::vector<uint8_t> capture;
+  bool replay = false;
+};
+
+/* PCF8523 */
+class NativeClock : public Clock
+{
+public:
+  bool begin() { return true; }
+  bool lostPower() { return !hardware.clockSet; }
+  DateTime now() { return DateTime((uint32_t)stationTime()); }
+
+  void adjust(const DateTime &dt)
+  {
+    hardware.clockOffset += (int64_t)dt.unixtime() - stationTime();
+    hardware.clockSet = true;
+  }
+};
+
+/* Loopback network, with typical association and request times */
+#define NATIVE_WIFI_CONNECT_MS 1500 // scan and DHCP
+#define NATIVE_WIFI_DIRECT_MS 300   // known channel and access point
+#define NATIVE_WIFI_STATIC_MS 150   // known access point, reused lease
+#define NATIVE_TLS_FULL_MS 450   // full handshake, certificate and key exchange
+#define NATIVE_TLS_RESUME_MS 60  // abbreviated handshake
+#define NATIVE_POST_MS 150       // request and response on an open connection
+#define NATIVE_HTTP_HEADERS 300  // bytes of request and response headers
+#define NATIVE_RTT_MS 50         // round trip on an open connection
+#define NATIVE_LINK_BYTES_PER_MS 100
+
+/* An access point was found and a TLS session established in an earlier wake */
+RTC_DATA_ATTR bool nativeWifiCached = false;
+RTC_DATA_ATTR bool nativeTlsCached = false;
+RTC_DATA_ATTR uint32_t nativeTlsPin = 0;
+
+/* Outbox for received bodies, JSON one per line, MessagePack back to back */
+static FILE *openOutbox(bool msgpack)
+{
+  char path[256];
+  return fopen(nativePath(msgpack ? "outbox.msgpack" : "outbox.jsonl", path, sizeof(path)), "ab");
+}
+
+/*
+ * MQTT broker stand-in. Sessions of clients that connect without clean
+ * session are remembered in <root>/mqtt.session, publishes are appended to
+ * the outbox and QoS 1 publishes are acknowledged.
+ */
+class NativeBroker
+{
+public:
+  void open()
+  {
+    input.clear();
+    output.clear();
+    closed = false;
+    acks = 0;
+  }
+
+  /* Handle received bytes, responses are appended to output */
+  void receive(const uint8_t *data, size_t len)
+  {
+    input.insert(input.end(), data, data + len);
+    while (!closed && input.size() >= 2)
+    {
+      size_t pos = 1;
+      size_t length = 0;
+      uint32_t multiplier = 1;
+      uint8_t digit;
+      do
+      {
+        if (pos >= input.size())
+          return;
+        digit = input[pos++];
+        length += (digit & 0x7f) * multiplier;
+        multiplier *= 128;
+      } while (digit & 0x80);
+      if (input.size() < pos + length)
+        return;
+
+      handle(input[0], input.data() + pos, length);
+      input.erase(input.begin(), input.begin() + pos + length);
+    }
+  }
+
+  std::vector<uint8_t> output;
+  bool closed = true;
+
+private:
+  static size_t getString(const uint8_t *p, std::string &s)
+  {
+    size_t len = ((size_t)p[0] << 8) | p[1];
+    s.assign((const char *)p + 2, len);
+    return len + 2;
+  }
+
+  void handle(uint8_t header, const uint8_t *body, size_t len)
+  {
+    switch (header >> 4)
+    {
+    case 1: // CONNECT
+    {
+      std::string protocol, clientId, known;
+      size_t pos = getString(body, protocol);
+      bool clean = body[pos + 1] & 0x02;
+      getString(body + pos + 4, clientId);
+
+      char path[256];
+      nativePath("mqtt.session", path, sizeof(path));
+      FILE *f = fopen(path, "r");
+      if (f)
+      {
+        char buffer[128] = "";
+        if (fgets(buffer, sizeof(buffer), f))
+          known = buffer;
+        fclose(f);
+      }
+      bool present = !clean && known == clientId;
+      if (clean)
+        remove(path);
+      else if ((f = fopen(path, "w")))
+      {
+        fputs(clientId.c_str(), f);
+        fclose(f);
+      }
+      uint8_t connack[] = {0x20, 0x02, (uint8_t)(present ? 1 : 0), 0x00};
+      output.insert(output.end(), connack, connack + sizeof(connack));
+      break;
+    }
+    case 3: // PUBLISH
+    {
+      uint8_t qos = (header >> 1) & 0x03;
+      std::string topic;
+      size_t pos = getString(body, topic);
+      uint16_t packetId = 0;
+      if (qos > 0)
+      {
+        packetId = ((uint16_t)body[pos] << 8) | body[pos + 1];
+        pos += 2;
+      }
+
+      bool msgpack = pos < len && body[pos] != '{' && body[pos] != '[';
+      FILE *f = openOutbox(msgpack);
+      if (f)
+      {
+        fwrite(body + pos, 1, len - pos, f);
+        if (!msgpack)
+          fputc('\n', f);
+        fclose(f);
+      }
+
+      // Every n-th acknowledgement is lost together with the connection
+      if (qos == 1 && nativeAckDrop() > 0 && ++acks % nativeAckDrop() == 0)
+      {
+        closed = true;
+        break;
+      }
+      if (qos == 1)
+      {
+        uint8_t puback[] = {0x40, 0x02, (uint8_t)(packetId >> 8), (uint8_t)packetId};
+        output.insert(output.end(), puback, puback + sizeof(puback));
+      }
+      break;
+    }
+    case 12: // PINGREQ
+      output.push_back(0xD0);
+      output.push_back(0x00);
+      break;
+    case 14: // DISCONNECT
+      closed = true;
+      break;
+    }
+  }
+
+  std::vector<uint8_t> input;
+  uint32_t acks = 0;
+};
+
+/* Writes a request body to a file, counting its bytes */
+class FilePrint : public Print
+{
+public:
+  FilePrint(FILE *f) : f(f) {}
+  size_t write(uint8_t c) { return write(&c, 1); }
+  size_t write(const uint8_t *data, size_t len)
+  {
+    bytes += len;
+    return fwrite(data, 1, len, f);
+  }
+  size_t bytes = 0;
+
+private:
+  FILE *f;
+};
+
+class NativeNetwork : public Network
+{
+public:
+  void begin(const char *, const char *, bool reuseLease)
+  {
+    associated = !nativeOffline();
+    if (!nativeWifiCached)
+      connectedAt = millis() + NATIVE_WIFI_CONNECT_MS;
+    else
+      connectedAt = millis() + (reuseLease ? NATIVE_WIFI_STATIC_MS : NATIVE_WIFI_DIRECT_MS);
+  }
+
+  bool waitConnected(uint32_t timeout)
+  {
+    unsigned long now = millis();
+    unsigned long wait = connectedAt > now ? connectedAt - now : 0;
+    if (!associated || wait > timeout)
+    {
+      nativeWifiCached = false;
+      delay(timeout);
+      return false;
+    }
+    delay(wait);
+    nativeWifiCached = true;
+    return true;
+  }
+
+  bool connected() { return associated && millis() >= connectedAt; }
+  String localIP() { return connected() ? "127.0.0.1" : "0.0.0.0"; }
+  void end()
+  {
+    associated = false;
+    httpOpen = false;
+    close();
+  }
+
+  bool syncTime(const char *, const char *timezone, struct tm &timeinfo)
+  {
+    setenv("TZ", timezone, 1);
+    tzset();
+    time_t hostNow = time(nullptr);
+    localtime_r(&hostNow, &timeinfo);
+    return true;
+  }
+
+  void setFingerprint(const char *fingerprint)
+  {
+    pin = crc32((const uint8_t *)fingerprint, strlen(fingerprint));
+  }
+
+  int post(const char *url, const char *contentType, Payload &body, String &response)
+  {
+    if (!connected())
+      return -1;
+
+    // One connection per wake
+    if (!httpOpen && strncmp(url, "http:", 5) != 0)
+      handshake();
+    httpOpen = true;
+
+    bool msgpack = strstr(contentType, "msgpack") != NULL;
+    FILE *f = openOutbox(msgpack);
+    if (!f)
+      return -1;
+    size_t length = body.length();
+    FilePrint out(f);
+    body.writeTo(out);
+    if (!msgpack)
+      fputc('\n', f);
+    fclose(f);
+    delay(NATIVE_POST_MS + (out.bytes + NATIVE_HTTP_HEADERS) / NATIVE_LINK_BYTES_PER_MS);
+
+    // Like a server, reject bodies that do not match their Content-Length
+    if (out.bytes != length)
+    {
+      response = "{\"status\":\"Content-Length mismatch\"}";
+      return 400;
+    }
+    response = "{\"status\":\"ok\"}";
+    return 200;
+  }
+
+  String errorToString(int code) { return code == -1 ? "connection refused" : ""; }
+
+  bool open(const char *, uint16_t, bool secure)
+  {
+    close();
+    if (!connected())
+      return false;
+    if (secure)
+      handshake();
+    else
+      delay(NATIVE_RTT_MS);
+    broker.open();
+    return true;
+  }
+
+  bool send(const uint8_t *data, size_t len)
+  {
+    if (broker.closed)
+      return false;
+    delay(len / NATIVE_LINK_BYTES_PER_MS);
+
+    // Responses arrive one round trip later
+    broker.receive(data, len);
+    if (!broker.output.empty())
+    {
+      pending.push_back({millis() + NATIVE_RTT_MS, broker.output});
+      broker.output.clear();
+    }
+    return true;
+  }
+
+  int receive(uint8_t *data, size_t len, uint32_t timeout)
+  {
+    if (pending.empty())
+    {
+      if (broker.closed)
+        return -1;
+      delay(timeout);
+      return 0;
+    }
+
+    Response &next = pending.front();
+    unsigned long now = millis();
+    if (next.readyAt > now)
+    {
+      if (next.readyAt - now > timeout)
+      {
+        delay(timeout);
+        return 0;
+      }
+      delay(next.readyAt - now);
+    }
+    size_t n = len < next.data.size() ? len : next.data.size();
+    memcpy(data, next.data.data(), n);
+    next.data.erase(next.data.begin(), next.data.begin() + n);
+    if (next.data.empty())
+      pending.pop_front();
+    return n;
+  }
+
+  void close()
+  {
+    broker.closed = true;
+    pending.clear();
+  }
+
+private:
+  /* Sessions of earlier wakes are resumed */
+  void handshake()
+  {
+    bool resume = nativeTlsCached && nativeTlsPin == pin;
+    delay(resume ? NATIVE_TLS_RESUME_MS : NATIVE_TLS_FULL_MS);
+    nativeTlsCached = true;
+    nativeTlsPin = pin;
+  }
+
+  struct Response
+  {
+    unsigned long readyAt;
+    std::vector<uint8_t> data;
+  };
+
+  bool associated = false;
+  bool httpOpen = false;
+  unsigned long connectedAt = 0;
+  uint32_t pin = 0;
+  NativeBroker broker;
+  std::deque<Response> pending;
+};
+
+/* Host machine */
+class NativeBoard : public Board
+{
+public:
+  void begin() {}
+  void setSensorPower(bool) {}
+  float readBatteryVoltage() { return currentRow()[COL_BATTERY]; }
+  uint64_t chipId() { return 0x24A1600DF00DULL; }
+
+  bool mountFlash(bool) { return spiffs.mount(); }
+  fs::FS &flash() { return spiffs; }
+
+  bool mountSD() { return sd_.mount(); }
+  uint64_t sdCardSize() { return 4ULL * 1024 * 1024 * 1024; }
+  fs::FS &sd() { return sd_; }
+
+  bool beginUpdate() { return true; }
+  size_t writeUpdate(uint8_t *, size_t len) { return len; }
+  bool endUpdate() { return true; }
+
+  void deepSleep(uint64_t microseconds) { throw NativeWakeCycleEnd{microseconds, false}; }
+  void restart() { throw NativeWakeCycleEnd{0, true}; }
+
+private:
+  fs::FS spiffs = fs::FS("spiffs");
+  fs::FS sd_ = fs::FS("sd");
+};
+
+Board &getBoard()
+{
+  static NativeBoard board;
+  return board;
+}
+
+Clock &getClock()
+{
+  static NativeClock clock;
+  return clock;
+}
+
+EnvironmentSensor &getEnvironmentSensor()
+{
+  static NativeEnvironmentSensor sensor;
+  return sensor;
+}
+
+LightSensor &getLightSensor()
+{
+  static NativeLightSensor sensor;
+  return sensor;
+}
+
+ParticleSensor &getParticleSensor()
+{
+  static NativeParticleSensor sensor;
+  return sensor;
+}
+
+Network &getNetwork()
+{
+  static NativeNetwork network;
+  return network;
+}
+
+/* Called by the runtime before and after every wake cycle */
+void nativeBeginWakeCycle()
+{
+  loadHardwareState();
+  sensorRowLoaded = false;
+}
+
+void nativeEndWakeCycle(uint64_t sleepMicros)
+{
+  // The sleep timer runs off against the PCF8523 with --sleep-drift
+  uint64_t slept = sleepMicros + (int64_t)sleepMicros * nativeSleepDrift() / 1000000LL;
+  uint64_t elapsed = hardware.clockMicros + nativeSimulatedMicros() + slept;
+  hardware.clockOffset += (int64_t)(elapsed / 1000000ULL);
+  hardware.clockMicros = elapsed % 1000000ULL;
+  hardware.sensorRow++;
+  saveHardwareState();
+}
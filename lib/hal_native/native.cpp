@@ -0,0 +1,196 @@
+/*
+ * Native runtime - runs the firmware's wake cycle as a Linux process
+ */
+
+#include "Arduino.h"
+#include "native.h"
+
+#include <string>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <vector>
+
+/* Firmware entry points (src/main.cpp) */
+void setup();
+void loop();
+
+/* Wake cycle hooks (hal_native.cpp) */
+void nativeBeginWakeCycle();
+void nativeEndWakeCycle(uint64_t sleepMicros);
+
+/* Start and end of the RTC_DATA_ATTR section, provided by the linker */
+extern uint8_t __start_rtc_data[] __attribute__((weak));
+extern uint8_t __stop_rtc_data[] __attribute__((weak));
+
+static std::string root = "native";
+static bool realtime = false;
+static bool offline = false;
+static int ackDrop = 0;
+static int sleepDrift = 0;
+
+const char *nativeRoot()
+{
+  return root.c_str();
+}
+
+bool nativeRealtime()
+{
+  return realtime;
+}
+
+bool nativeOffline()
+{
+  return offline;
+}
+
+int nativeAckDrop()
+{
+  return ackDrop;
+}
+
+int nativeSleepDrift()
+{
+  return sleepDrift;
+}
+
+const char *nativePath(const char *relative, char *buffer, unsigned int size)
+{
+  snprintf(buffer, size, "%s/%s", root.c_str(), relative);
+  return buffer;
+}
+
+#if !defined(NATIVE_NO_RUNTIME) && !defined(PIO_UNIT_TESTING)
+
+/* RTC memory image: magic, section size, section content */
+static const uint32_t RTC_IMAGE_MAGIC = 0x31435452; // "RTC1"
+
+static size_t rtcSize()
+{
+  return (__start_rtc_data && __stop_rtc_data) ? (size_t)(__stop_rtc_data - __start_rtc_data) : 0;
+}
+
+static bool loadRTCMemory()
+{
+  char path[256];
+  FILE *f = fopen(nativePath("rtc.bin", path, sizeof(path)), "rb");
+  if (!f)
+    return false;
+
+  uint32_t header[2] = {0, 0};
+  bool loaded = fread(header, sizeof(header), 1, f) == 1 && header[0] == RTC_IMAGE_MAGIC && header[1] == rtcSize() &&
+                fread(__start_rtc_data, 1, rtcSize(), f) == rtcSize();
+  fclose(f);
+  return loaded;
+}
+
+static void saveRTCMemory()
+{
+  char path[256];
+  FILE *f = fopen(nativePath("rtc.bin", path, sizeof(path)), "wb");
+  if (!f)
+    return;
+  uint32_t header[2] = {RTC_IMAGE_MAGIC, (uint32_t)rtcSize()};
+  fwrite(header, sizeof(header), 1, f);
+  fwrite(__start_rtc_data, 1, rtcSize(), f);
+  fclose(f);
+}
+
+/* One wake cycle in a forked process, so globals start fresh like after a deep sleep reset */
+static int runWakeCycle(int cycle, const std::vector<uint8_t> &rtcInitial)
+{
+  if (!loadRTCMemory())
+  {
+    std::copy(rtcInitial.begin(), rtcInitial.end(), __start_rtc_data);
+    fprintf(stderr, "native: cold boot, RTC memory initialized\n");
+  }
+
+  NativeWakeCycleEnd end = {0, false};
+  bool slept = false;
+
+  nativeResetMillis();
+  nativeBeginWakeCycle();
+  unsigned long start = micros();
+  try
+  {
+    setup();
+    loop();
+  }
+  catch (const NativeWakeCycleEnd &e)
+  {
+    end = e;
+    slept = true;
+  }
+  Serial.flush();
+  fprintf(stderr, "native: wake cycle %d took %llu us (%llu us simulated)\n", cycle + 1,
+          (unsigned long long)(micros() - start - nativeSimulatedMicros()), (unsigned long long)nativeSimulatedMicros());
+
+  // A reset re-initializes the RTC memory, deep sleep retains it
+  if (slept && end.restart)
+    std::copy(rtcInitial.begin(), rtcInitial.end(), __start_rtc_data);
+
+  nativeEndWakeCycle(end.sleepMicros);
+  saveRTCMemory();
+
+  if (!slept)
+  {
+    fprintf(stderr, "native: setup() returned without entering deep sleep\n");
+    return 1;
+  }
+  return 0;
+}
+
+int main(int argc, char **argv)
+{
+  int cycles = 1;
+  for (int i = 1; i < argc; i++)
+  {
+    if (strcmp(argv[i], "--root") == 0 && i + 1 < argc)
+      root = argv[++i];
+    else if (strcmp(argv[i], "--cycles") == 0 && i + 1 < argc)
+      cycles = atoi(argv[++i]);
+    else if (strcmp(argv[i], "--realtime") == 0)
+      realtime = true;
+    else if (strcmp(argv[i], "--offline") == 0)
+      offline = true;
+    else if (strcmp(argv[i], "--ack-drop") == 0 && i + 1 < argc)
+      ackDrop = atoi(argv[++i]);
+    else if (strcmp(argv[i], "--sleep-drift") == 0 && i + 1 < argc)
+      sleepDrift = atoi(argv[++i]);
+    else
+    {
+      fprintf(stderr, "Usage: %s [--root <dir>] [--cycles <n>] [--realtime] [--offline] [--ack-drop <n>]\n"
+                      "       [--sleep-drift <ppm>]\n", argv[0]);
+      return 2;
+    }
+  }
+  mkdir(root.c_str(), 0755);
+
+  // Initial values of the RTC memory, restored on a cold boot or reset
+  std::vector<uint8_t> rtcInitial(__start_rtc_data, __start_rtc_data + rtcSize());
+
+  for (int cycle = 0; cycle < cycles; cycle++)
+  {
+    fflush(stdout);
+    pid_t pid = fork();
+    if (pid < 0)
+    {
+      perror("native: fork");
+      return 1;
+    }
+    if (pid == 0)
+    {
+      int result = runWakeCycle(cycle, rtcInitial);
+      fflush(stdout);
+      _exit(result);
+    }
+
+    int status = 0;
+    waitpid(pid, &status, 0);
+    if (!WIFEXITED(status) || WEXITSTATUS(status) != 0)
+      return WIFEXITED(status) ? WEXITSTATUS(status) : 1;
+  }
+  return 0;
+}
+
+#endif /*NATIVE_NO_RUNTIME, PIO_UNIT_TESTING*/
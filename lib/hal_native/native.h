@@ -0,0 +1,64 @@
+/*
+ * Native runtime
+ *
+ * Every run of the native program executes one or more wake cycles. Each
+ * cycle runs in a forked process, so globals start fresh like after a deep
+ * sleep reset while RTC_DATA_ATTR variables are restored from the image.
+ * A data root directory holds the stand-ins for the hardware:
+ *
+ *   <root>/sd/          SD card
+ *   <root>/spiffs/      Internal flash
+ *   <root>/sensors.csv  Sensor readings replayed one row per wake (optional)
+ *   <root>/pms7003.bin  PMS7003 byte stream replayed every wake (optional)
+ *   <root>/outbox.jsonl Requests received by the loopback network, which
+ *                       takes 1.5 s to scan and associate (0.3 s to the
+ *                       access point of the last wake, 0.15 s without DHCP),
+ *                       0.45 s for a TLS handshake (0.06 s when the session
+ *                       of the last wake is resumed) and 0.15 s per request
+ *   <root>/outbox.msgpack
+ *                       MessagePack requests, back to back
+ *   <root>/mqtt.session Persistent session of the MQTT broker stand-in
+ *   <root>/rtc.bin      RTC slow memory, restored on every start
+ *
+ * Command line options:
+ *   --root <dir>    Data root directory (default: native)
+ *   --cycles <n>    Number of wake cycles to run (default: 1)
+ *   --realtime      delay() really waits instead of being simulated
+ *   --offline       WiFi never connects
+ *   --ack-drop <n>  The broker stand-in loses every n-th MQTT acknowledgement
+ *                   of a wake together with the connection
+ *   --sleep-drift <ppm>
+ *                   The deep sleep timer runs slow (positive) or fast
+ *                   against the PCF8523 by that many parts per million
+ *
+ * Programs with their own main() (benchmarks, tools) define
+ * NATIVE_NO_RUNTIME and only use the stand-ins, as do the unit tests in
+ * test/ (pio test -e native).
+ */
+
+#ifndef _Native_Runtime_H_
+#define _Native_Runtime_H_
+
+#include <stdint.h>
+
+/* Thrown by Board::deepSleep() and Board::restart() to end a wake cycle */
+struct NativeWakeCycleEnd
+{
+  uint64_t sleepMicros;
+  bool restart;
+};
+
+const char *nativeRoot();
+bool nativeRealtime();
+bool nativeOffline();
+int nativeAckDrop();
+int nativeSleepDrift();
+
+/* Simulated time spent in delay() and deep sleep */
+void nativeResetMillis();
+uint64_t nativeSimulatedMicros();
+
+/* Path below the data root */
+const char *nativePath(const char *relative, char *buffer, unsigned int size);
+
+#endif /*_Native_Runtime_H_*/
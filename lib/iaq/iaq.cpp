@@ -0,0 +1,135 @@
+/*
+ * Indoor Air Quality (IAQ)
+ */
+
+#include "iaq.h"
+
+#include "checksum.h"
+
+#define IAQ_MAGIC 0x51414957 // "WIAQ"
+
+struct IAQState
+{
+  uint32_t magic;
+  float baseline; // kOhms
+  uint32_t started; // first reading of the baseline
+  uint32_t updated; // last reading
+  uint32_t crc;
+};
+
+/* Baseline, kept during deep sleep */
+RTC_DATA_ATTR IAQState iaqState;
+
+static uint32_t stateCRC(const IAQState &state)
+{
+  return crc32((const uint8_t *)&state, offsetof(IAQState, crc));
+}
+
+static bool validState(const IAQState &state)
+{
+  return state.magic == IAQ_MAGIC && state.crc == stateCRC(state);
+}
+
+static void loadState(fs::FS &flash)
+{
+  IAQState saved;
+  File file = flash.open(IAQ_FILE, FILE_READ);
+  if (!file)
+    return;
+  if (file.read((uint8_t *)&saved, sizeof(saved)) == sizeof(saved) && validState(saved))
+  {
+    iaqState = saved;
+    Serial.println("IAQ baseline restored");
+  }
+  file.close();
+}
+
+static void saveState(fs::FS &flash)
+{
+  File file = flash.open(IAQ_FILE, FILE_WRITE);
+  if (file)
+    file.write((const uint8_t *)&iaqState, sizeof(iaqState));
+  file.close();
+}
+
+/* Humidity contribution, 25 at 38 to 42 % and less further away */
+static float humidityScore(float humidity)
+{
+  if (humidity >= 38 && humidity <= 42)
+    return 25;
+  if (humidity < 38)
+    return 0.25f / 40 * humidity * 100;
+  return ((-0.25f / (100 - 40) * humidity) + 0.416666f) * 100;
+}
+
+int16_t iaqUpdate(fs::FS &flash, uint32_t timestamp, float gas, float humidity)
+{
+  if (isnan(gas) || gas <= 0)
+    return -1;
+
+  if (!validState(iaqState))
+    loadState(flash);
+
+  uint32_t lastDay = iaqState.updated / 86400;
+  if (!validState(iaqState))
+  {
+    iaqState.magic = IAQ_MAGIC;
+    iaqState.baseline = gas;
+    iaqState.started = timestamp;
+    lastDay = timestamp / 86400;
+  }
+  else
+  {
+    // A long gap, e.g. a power loss, counts as one hour, not as a new baseline
+    // The clock may have been set back, that reading gets no weight
+    float hours = timestamp > iaqState.updated ? (timestamp - iaqState.updated) / 3600.0f : 0;
+    if (hours > 1)
+      hours = 1;
+    float tau = gas > iaqState.baseline ? IAQ_RISE_HOURS : IAQ_FALL_HOURS;
+    float alpha = 1.0f - expf(-hours / tau);
+    iaqState.baseline += alpha * (gas - iaqState.baseline);
+  }
+  iaqState.updated = timestamp;
+  iaqState.crc = stateCRC(iaqState);
+
+  // Saved once a day, when the first reading of the day comes in
+  if (timestamp / 86400 != lastDay)
+    saveState(flash);
+
+  if (timestamp < iaqState.started || timestamp - iaqState.started < IAQ_WARMUP_HOURS * 3600UL)
+    return -1;
+
+  float ratio = gas / iaqState.baseline;
+  float score = humidityScore(humidity) + 75 * (ratio < 1 ? ratio : 1);
+  if (score < 0)
+    score = 0;
+  return (int16_t)round((100 - score) * 5);
+}
+
+int16_t iaqCategory(int16_t iaq)
+{
+  if (iaq < 0)
+    return -1;
+  if (iaq <= 50)
+    return IAQ_GOOD;
+  if (iaq <= 100)
+    return IAQ_AVERAGE;
+  if (iaq <= 150)
+    return IAQ_LITTLE_BAD;
+  if (iaq <= 200)
+    return IAQ_BAD;
+  if (iaq <= 300)
+    return IAQ_WORSE;
+  return IAQ_VERY_BAD;
+}
+
+const char *iaqCategoryName(int16_t category)
+{
+  static const char *const names[] = {"Good", "Average", "Little Bad", "Bad", "Worse", "Very Bad"};
+  return category >= IAQ_GOOD && category <= IAQ_VERY_BAD ? names[category] : "Unknown";
+}
+
+float iaqBaseline()
+{
+  return validState(iaqState) ? iaqState.baseline : 0;
+}
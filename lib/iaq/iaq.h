@@ -0,0 +1,64 @@
+/*
+ * Indoor Air Quality (IAQ) from the BME680 Gas Resistance
+ *
+ * The gas resistance only means something relative to clean air for the
+ * individual sensor, which also drifts over time. A baseline of the gas
+ * resistance is tracked as an exponentially weighted average of the single
+ * reading taken every wake, weighted by the time between the readings:
+ * it follows higher resistance (cleaner air) within about an hour, and
+ * lower resistance only within about a day, so pollution does not become
+ * the new baseline while drift is still followed.
+ *
+ * The baseline is kept in RTC memory and saved to SPIFFS when a day ends,
+ * so it survives a power loss. It is used after IAQ_WARMUP_HOURS.
+ *
+ * The score follows the BME680 example by G6EJD: 75 % from the gas
+ * resistance relative to the baseline, 25 % from the humidity distance to
+ * 40 %, turned into an index from 0 (good) to 500 (very bad). The
+ * categories are the IAQ classes of the BME680 datasheet (Bosch Sensortec,
+ * table "Indoor air quality (IAQ) classification"), not the ones of the
+ * outdoor AQI.
+ */
+
+#ifndef _IAQ_WeatherStation_H_
+#define _IAQ_WeatherStation_H_
+
+#include <Arduino.h>
+#include <FS.h>
+
+/* Time constants of the baseline, towards higher and lower resistance */
+#define IAQ_RISE_HOURS 1
+#define IAQ_FALL_HOURS 24
+
+/* Hours of readings before the baseline is used */
+#define IAQ_WARMUP_HOURS 2
+
+/* Baseline saved on SPIFFS */
+#define IAQ_FILE "/iaq.bin"
+
+enum IAQCategory
+{
+  IAQ_GOOD,       // 0 - 50
+  IAQ_AVERAGE,    // 51 - 100
+  IAQ_LITTLE_BAD, // 101 - 150
+  IAQ_BAD,        // 151 - 200
+  IAQ_WORSE,      // 201 - 300
+  IAQ_VERY_BAD    // 301 - 500
+};
+
+/* Add the gas resistance (kOhms) and humidity (%) of a reading taken at
+   timestamp (local time). Restores the baseline from flash after a power
+   loss and saves it there on the first reading of a day. Returns the IAQ
+   index, -1 without a usable baseline or gas reading. */
+int16_t iaqUpdate(fs::FS &flash, uint32_t timestamp, float gas, float humidity);
+
+/* Category of an IAQ index, -1 for -1 */
+int16_t iaqCategory(int16_t iaq);
+
+/* "Good", "Average", ... */
+const char *iaqCategoryName(int16_t category);
+
+/* Current baseline in kOhms, 0 if none */
+float iaqBaseline();
+
+#endif /*_IAQ_WeatherStation_H_*/
@@ -0,0 +1,304 @@
+/*
+ * MQTT Client
+ */
+
+#include "mqtt.h"
+
+/* Client session state, kept during deep sleep */
+RTC_DATA_ATTR MQTTInflight mqttInflight[MQTT_INFLIGHT_MAX];
+RTC_DATA_ATTR uint8_t mqttInflightCount = 0;
+RTC_DATA_ATTR uint16_t mqttNextId = 0;
+
+/* Collects small writes, e.g. single JSON tokens, into larger sends */
+class NetworkWriter : public Print
+{
+public:
+  NetworkWriter(Network &network) : bytes(0), network(network), used(0), failed(false) {}
+
+  size_t write(uint8_t c) { return write(&c, 1); }
+
+  size_t write(const uint8_t *data, size_t len)
+  {
+    for (size_t i = 0; i < len; i++)
+    {
+      if (used == sizeof(buffer))
+        finish();
+      buffer[used++] = data[i];
+    }
+    bytes += len;
+    return len;
+  }
+
+  /* Send what is left, returns false if any send failed */
+  bool finish()
+  {
+    if (used > 0 && !failed && !network.send(buffer, used))
+      failed = true;
+    used = 0;
+    return !failed;
+  }
+
+  size_t bytes;
+
+private:
+  Network &network;
+  uint8_t buffer[MQTT_WRITE_BUFFER];
+  size_t used;
+  bool failed;
+};
+
+static size_t putString(uint8_t *p, const char *s)
+{
+  size_t len = strlen(s);
+  p[0] = len >> 8;
+  p[1] = len;
+  memcpy(p + 2, s, len);
+  return len + 2;
+}
+
+MQTTClient::MQTTClient(Network &network)
+    : bytesSent(0), bytesReceived(0), network(network), isConnected(false), present(false)
+{
+}
+
+bool MQTTClient::connect(const char *host, uint16_t port, bool secure, const char *clientId,
+                         const char *username, const char *password)
+{
+  isConnected = false;
+  present = false;
+  if (!network.open(host, port, secure))
+    return false;
+
+  // Variable header and payload: protocol, flags, keep alive, client ID, user name, password
+  size_t size = 10 + 2 + strlen(clientId) + 2 + strlen(username) + 2 + strlen(password);
+  uint8_t *packet = (uint8_t *)malloc(size);
+  if (!packet)
+  {
+    network.close();
+    return false;
+  }
+  size_t pos = putString(packet, "MQTT");
+  packet[pos++] = 4; // 3.1.1
+  uint8_t flags = 0; // clean session off
+  if (*username)
+    flags |= 0x80;
+  if (*password)
+    flags |= 0x40;
+  packet[pos++] = flags;
+  packet[pos++] = MQTT_KEEPALIVE >> 8;
+  packet[pos++] = MQTT_KEEPALIVE & 0xff;
+  pos += putString(packet + pos, clientId);
+  if (*username)
+    pos += putString(packet + pos, username);
+  if (*password)
+    pos += putString(packet + pos, password);
+
+  bool sent = sendPacket(MQTT_CONNECT << 4, packet, pos, NULL);
+  free(packet);
+
+  uint8_t header;
+  uint8_t body[4];
+  size_t len;
+  if (!sent || !readPacket(header, body, sizeof(body), len, MQTT_TIMEOUT) ||
+      header >> 4 != MQTT_CONNACK || len != 2)
+  {
+    network.close();
+    return false;
+  }
+  if (body[1] != 0)
+  {
+    Serial.printf("MQTT connection refused, code %d\n", body[1]);
+    network.close();
+    return false;
+  }
+
+  present = body[0] & 0x01;
+  isConnected = true;
+  return true;
+}
+
+uint8_t MQTTClient::inflight() const
+{
+  return mqttInflightCount;
+}
+
+const MQTTInflight &MQTTClient::inflightAt(uint8_t index) const
+{
+  return mqttInflight[index];
+}
+
+bool MQTTClient::publish(const char *topic, Payload &payload, uint16_t count)
+{
+  if (!isConnected || mqttInflightCount >= MQTT_INFLIGHT_MAX)
+    return false;
+
+  // Packet ID 0 is not allowed
+  if (++mqttNextId == 0)
+    mqttNextId = 1;
+
+  // Tracked before it is sent, it may arrive even if sending fails
+  MQTTInflight &entry = mqttInflight[mqttInflightCount++];
+  entry.packetId = mqttNextId;
+  entry.count = count;
+  return publishPacket(topic, payload, entry.packetId, false);
+}
+
+bool MQTTClient::republish(uint8_t index, const char *topic, Payload &payload)
+{
+  if (!isConnected || index >= mqttInflightCount)
+    return false;
+  return publishPacket(topic, payload, mqttInflight[index].packetId, true);
+}
+
+bool MQTTClient::publishPacket(const char *topic, Payload &payload, uint16_t packetId, bool dup)
+{
+  size_t topicLen = strlen(topic);
+  uint8_t *head = (uint8_t *)malloc(topicLen + 4);
+  if (!head)
+    return false;
+  size_t pos = putString(head, topic);
+  head[pos++] = packetId >> 8;
+  head[pos++] = packetId & 0xff;
+
+  uint8_t header = (MQTT_PUBLISH << 4) | (1 << 1); // QoS 1
+  if (dup)
+    header |= 0x08;
+  bool sent = sendPacket(header, head, pos, &payload);
+  free(head);
+  return sent;
+}
+
+bool MQTTClient::waitAck(MQTTInflight &acked, uint32_t timeout)
+{
+  uint32_t start = millis();
+  while (isConnected && mqttInflightCount > 0)
+  {
+    uint32_t elapsed = millis() - start;
+    if (elapsed >= timeout)
+      return false;
+
+    uint8_t header;
+    uint8_t body[4];
+    size_t len;
+    if (!readPacket(header, body, sizeof(body), len, timeout - elapsed))
+      return false;
+    if (header >> 4 != MQTT_PUBACK || len != 2)
+      continue;
+
+    // Acknowledgements arrive in order, others are left to the next session
+    uint16_t packetId = ((uint16_t)body[0] << 8) | body[1];
+    if (packetId != mqttInflight[0].packetId)
+      continue;
+
+    acked = mqttInflight[0];
+    mqttInflightCount--;
+    memmove(mqttInflight, mqttInflight + 1, mqttInflightCount * sizeof(MQTTInflight));
+    return true;
+  }
+  return false;
+}
+
+bool MQTTClient::publishAndWait(const char *topic, Payload &payload, uint32_t timeout)
+{
+  clearInflight();
+  MQTTInflight acked;
+  if (publish(topic, payload, 0) && waitAck(acked, timeout))
+    return true;
+  clearInflight();
+  return false;
+}
+
+void MQTTClient::clearInflight()
+{
+  mqttInflightCount = 0;
+}
+
+void MQTTClient::disconnect()
+{
+  if (isConnected)
+  {
+    sendPacket(MQTT_DISCONNECT << 4, NULL, 0, NULL);
+  }
+  network.close();
+  isConnected = false;
+}
+
+/* Fixed header with the remaining length, variable header and payload */
+bool MQTTClient::sendPacket(uint8_t header, const uint8_t *head, size_t headLen, Payload *payload)
+{
+  uint8_t fixed[5];
+  size_t pos = 0;
+  size_t payloadLen = payload ? payload->length() : 0;
+  size_t remaining = headLen + payloadLen;
+  fixed[pos++] = header;
+  do
+  {
+    uint8_t digit = remaining % 128;
+    remaining /= 128;
+    fixed[pos++] = remaining > 0 ? digit | 0x80 : digit;
+  } while (remaining > 0 && pos < sizeof(fixed));
+
+  // The payload is written straight to the connection, it must match its length
+  NetworkWriter out(network);
+  out.write(fixed, pos);
+  out.write(head, headLen);
+  if (payload)
+    payload->writeTo(out);
+  if (!out.finish() || out.bytes != pos + headLen + payloadLen)
+  {
+    network.close();
+    isConnected = false;
+    return false;
+  }
+  bytesSent += out.bytes;
+  return true;
+}
+
+bool MQTTClient::readBytes(uint8_t *data, size_t len, uint32_t timeout)
+{
+  uint32_t start = millis();
+  size_t got = 0;
+  while (got < len)
+  {
+    uint32_t elapsed = millis() - start;
+    if (elapsed >= timeout)
+      return false;
+    int n = network.receive(data + got, len - got, timeout - elapsed);
+    if (n < 0)
+    {
+      isConnected = false;
+      return false;
+    }
+    got += n;
+  }
+  bytesReceived += len;
+  return true;
+}
+
+/* Read a packet, bodies larger than max are skipped */
+bool MQTTClient::readPacket(uint8_t &header, uint8_t *body, size_t max, size_t &len, uint32_t timeout)
+{
+  if (!readBytes(&header, 1, timeout))
+    return false;
+
+  len = 0;
+  uint32_t multiplier = 1;
+  uint8_t digit;
+  do
+  {
+    if (multiplier > 128 * 128 * 128 || !readBytes(&digit, 1, timeout))
+      return false;
+    len += (digit & 0x7f) * multiplier;
+    multiplier *= 128;
+  } while (digit & 0x80);
+
+  if (len <= max)
+    return readBytes(body, len, timeout);
+
+  for (size_t i = 0; i < len; i++)
+  {
+    if (!readBytes(&digit, 1, timeout))
+      return false;
+  }
+  return true;
+}
@@ -0,0 +1,95 @@
+/*
+ * MQTT Client
+ *
+ * Minimal MQTT 3.1.1 client that publishes with QoS 1 over the stream
+ * connection of the network HAL. The session is persistent (clean session
+ * off), so the broker keeps it while the station sleeps. The client part of
+ * the session, the packet ID counter and the publishes that were not
+ * acknowledged yet, is kept in RTC memory. After the next connect those
+ * publishes are sent again with their packet ID and the DUP flag.
+ *
+ * Publishes are pipelined: up to MQTT_INFLIGHT_MAX are sent before the
+ * first acknowledgement is awaited. The broker acknowledges QoS 1 publishes
+ * in order, so they are completed oldest first. Each in-flight publish
+ * carries a count for the caller, e.g. the number of readings it holds.
+ */
+
+#ifndef _MQTT_WeatherStation_H_
+#define _MQTT_WeatherStation_H_
+
+#include "hal.h"
+
+#define MQTT_KEEPALIVE 60    // seconds
+#define MQTT_INFLIGHT_MAX 4  // unacknowledged publishes
+#define MQTT_TIMEOUT 5000    // ms to wait for CONNACK and PUBACK
+#define MQTT_WRITE_BUFFER 256 // bytes per send, payloads are written in pieces
+
+/* Packet types */
+#define MQTT_CONNECT 1
+#define MQTT_CONNACK 2
+#define MQTT_PUBLISH 3
+#define MQTT_PUBACK 4
+#define MQTT_PINGREQ 12
+#define MQTT_PINGRESP 13
+#define MQTT_DISCONNECT 14
+
+/* Publish that was not acknowledged yet */
+struct MQTTInflight
+{
+  uint16_t packetId;
+  uint16_t count;
+};
+
+class MQTTClient
+{
+public:
+  MQTTClient(Network &network);
+
+  /* Connect and resume the session of the client ID, returns false on errors */
+  bool connect(const char *host, uint16_t port, bool secure, const char *clientId,
+               const char *username, const char *password);
+  bool connected() const { return isConnected; }
+
+  /* The broker still had the session of an earlier connection */
+  bool sessionPresent() const { return present; }
+
+  /* Unacknowledged publishes, oldest first, including those of earlier wakes */
+  uint8_t inflight() const;
+  const MQTTInflight &inflightAt(uint8_t index) const;
+
+  /* Publish with QoS 1 without waiting for the acknowledgement, returns
+     false if MQTT_INFLIGHT_MAX publishes are in flight or sending failed */
+  bool publish(const char *topic, Payload &payload, uint16_t count);
+
+  /* Send an in-flight publish again, with the same packet ID and the DUP flag */
+  bool republish(uint8_t index, const char *topic, Payload &payload);
+
+  /* Wait for the acknowledgement of the oldest in-flight publish and remove it */
+  bool waitAck(MQTTInflight &acked, uint32_t timeout = MQTT_TIMEOUT);
+
+  /* Publish outside of the pipeline and wait for the acknowledgement. The
+     in-flight publishes are forgotten first, they are not sent again here
+     and their acknowledgements would never arrive. */
+  bool publishAndWait(const char *topic, Payload &payload, uint32_t timeout = MQTT_TIMEOUT);
+
+  /* Forget the in-flight publishes, e.g. when the data they carry is gone */
+  void clearInflight();
+
+  void disconnect();
+
+  /* Bytes sent and received since construction */
+  uint32_t bytesSent;
+  uint32_t bytesReceived;
+
+private:
+  bool sendPacket(uint8_t header, const uint8_t *head, size_t headLen, Payload *payload);
+  bool readPacket(uint8_t &header, uint8_t *body, size_t max, size_t &len, uint32_t timeout);
+  bool readBytes(uint8_t *data, size_t len, uint32_t timeout);
+  bool publishPacket(const char *topic, Payload &payload, uint16_t packetId, bool dup);
+
+  Network &network;
+  bool isConnected;
+  bool present;
+};
+
+#endif /*_MQTT_WeatherStation_H_*/
@@ -0,0 +1,112 @@
+/*
+ * MessagePack Writer
+ */
+
+#include "msgpack.h"
+
+/* Type byte followed by the value in big-endian order */
+void MsgPackWriter::put(uint8_t type, uint64_t value, uint8_t bytes)
+{
+  uint8_t buffer[9];
+  buffer[0] = type;
+  for (uint8_t i = 0; i < bytes; i++)
+    buffer[bytes - i] = value >> (8 * i);
+  out.write(buffer, bytes + 1);
+}
+
+/* Fix header for small sizes, else 16 or 32 bit size (type16 + 1) */
+void MsgPackWriter::header(uint8_t fix, uint8_t fixMax, uint8_t type16, uint32_t size)
+{
+  if (size <= fixMax)
+    out.write((uint8_t)(fix | size));
+  else if (size <= 0xffff)
+    put(type16, size, 2);
+  else
+    put(type16 + 1, size, 4);
+}
+
+void MsgPackWriter::map(uint32_t size)
+{
+  header(0x80, 15, 0xde, size);
+}
+
+void MsgPackWriter::array(uint32_t size)
+{
+  header(0x90, 15, 0xdc, size);
+}
+
+void MsgPackWriter::nil()
+{
+  out.write((uint8_t)0xc0);
+}
+
+void MsgPackWriter::boolean(bool value)
+{
+  out.write((uint8_t)(value ? 0xc3 : 0xc2));
+}
+
+void MsgPackWriter::integer(int64_t value)
+{
+  if (value >= 0)
+  {
+    if (value <= 0x7f)
+      out.write((uint8_t)value); // positive fixint
+    else if (value <= 0xff)
+      put(0xcc, value, 1);
+    else if (value <= 0xffff)
+      put(0xcd, value, 2);
+    else if (value <= 0xffffffffLL)
+      put(0xce, value, 4);
+    else
+      put(0xcf, value, 8);
+  }
+  else
+  {
+    if (value >= -32)
+      out.write((uint8_t)value); // negative fixint
+    else if (value >= -0x80)
+      put(0xd0, (uint64_t)value & 0xff, 1);
+    else if (value >= -0x8000)
+      put(0xd1, (uint64_t)value & 0xffff, 2);
+    else if (value >= -0x80000000LL)
+      put(0xd2, (uint64_t)value & 0xffffffff, 4);
+    else
+      put(0xd3, (uint64_t)value, 8);
+  }
+}
+
+void MsgPackWriter::real(float value)
+{
+  if (isnan(value))
+  {
+    nil();
+    return;
+  }
+  uint32_t bits;
+  memcpy(&bits, &value, sizeof(bits));
+  put(0xca, bits, 4);
+}
+
+void MsgPackWriter::binary(uint32_t size)
+{
+  if (size <= 0xff)
+    put(0xc4, size, 1);
+  else if (size <= 0xffff)
+    put(0xc5, size, 2);
+  else
+    put(0xc6, size, 4);
+}
+
+void MsgPackWriter::string(const char *value)
+{
+  size_t len = strlen(value);
+  if (len <= 31)
+    out.write((uint8_t)(0xa0 | len));
+  else if (len <= 0xff)
+    put(0xd9, len, 1);
+  else if (len <= 0xffff)
+    put(0xda, len, 2);
+  else
+    put(0xdb, len, 4);
+  out.write((const uint8_t *)value, len);
+}
@@ -0,0 +1,53 @@
+/*
+ * MessagePack Writer
+ *
+ * Encodes MessagePack (https://msgpack.org) straight into a Print, without
+ * building the message in memory. Integers use the smallest encoding that
+ * holds them, reals are written as float 32, NaN as nil. Maps and arrays
+ * are written as a header with the number of entries followed by the
+ * entries, so the caller must know the count up front. The same goes for
+ * the size of byte arrays.
+ *
+ * The length of a message is found by encoding it into a MeasurePrint
+ * first, which only counts the bytes.
+ */
+
+#ifndef _MsgPack_WeatherStation_H_
+#define _MsgPack_WeatherStation_H_
+
+#include <Arduino.h>
+
+class MsgPackWriter
+{
+public:
+  MsgPackWriter(Print &out) : out(out) {}
+
+  void map(uint32_t size);
+  void array(uint32_t size);
+  void nil();
+  void boolean(bool value);
+  void integer(int64_t value);
+  void real(float value);
+  void string(const char *value);
+
+  /* Header of a byte array, the caller writes the size bytes to the Print */
+  void binary(uint32_t size);
+
+private:
+  void header(uint8_t fix, uint8_t fixMax, uint8_t type16, uint32_t size);
+  void put(uint8_t type, uint64_t value, uint8_t bytes);
+
+  Print &out;
+};
+
+/* Print that discards everything and counts the bytes */
+class MeasurePrint : public Print
+{
+public:
+  size_t write(uint8_t) { bytes++; return 1; }
+  size_t write(const uint8_t *, size_t len) { bytes += len; return len; }
+
+  size_t bytes = 0;
+};
+
+#endif /*_MsgPack_WeatherStation_H_*/
@@ -0,0 +1,47 @@
+/*
+ * NowCast History
+ */
+
+#include "nowcast.h"
+
+/* Hourly averages, newest first, and the start of the newest hour */
+RTC_DATA_ATTR float nowcastHours[POLLUTANT_COUNT][NOWCAST_HOURS];
+RTC_DATA_ATTR uint32_t nowcastLast = 0;
+
+void nowcastAddHour(uint32_t hourStart, const float averages[POLLUTANT_COUNT])
+{
+  // Hours the history moves by, all of them after a gap or a clock set back
+  uint32_t shift = NOWCAST_HOURS;
+  if (nowcastLast != 0 && hourStart >= nowcastLast && (hourStart - nowcastLast) / 3600 < NOWCAST_HOURS)
+    shift = (hourStart - nowcastLast) / 3600;
+
+  for (uint8_t p = 0; p < POLLUTANT_COUNT; p++)
+  {
+    memmove(nowcastHours[p] + shift, nowcastHours[p], (NOWCAST_HOURS - shift) * sizeof(float));
+    for (uint32_t i = 0; i < shift; i++)
+      nowcastHours[p][i] = NAN;
+    nowcastHours[p][0] = averages[p];
+  }
+  nowcastLast = hourStart;
+}
+
+float nowcastConcentration(Pollutant pollutant, uint32_t now)
+{
+  // The hour before the current one is the newest that can be complete
+  uint32_t newest = now - now % 3600 - 3600;
+  if (nowcastLast == 0 || nowcastLast > newest)
+    return NAN;
+  uint32_t missing = (newest - nowcastLast) / 3600;
+  if (missing >= NOWCAST_HOURS)
+    return NAN;
+
+  float hourly[NOWCAST_HOURS];
+  for (uint8_t i = 0; i < NOWCAST_HOURS; i++)
+    hourly[i] = i < missing ? NAN : nowcastHours[pollutant][i - missing];
+  return nowCast(pollutant, hourly, NOWCAST_HOURS);
+}
+
+int nowcastAQI(uint32_t now)
+{
+  return nowCastAQI(nowcastConcentration(POLLUTANT_PM25, now), nowcastConcentration(POLLUTANT_PM10, now));
+}
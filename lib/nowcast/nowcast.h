@@ -0,0 +1,28 @@
+/*
+ * NowCast History
+ *
+ * Hourly PM2.5 and PM10 averages of the last NOWCAST_HOURS hours, newest
+ * first, kept in RTC memory for the NowCast AQI. An hour is added when it
+ * ends, from the closed hourly rollup; hours without readings, e.g. while
+ * the station was off, count as missing. The history is lost with the RTC
+ * memory, the NowCast is then reported again after two hours.
+ */
+
+#ifndef _NowCast_WeatherStation_H_
+#define _NowCast_WeatherStation_H_
+
+#include <Arduino.h>
+
+#include "calculations.h"
+
+/* Add the averages of the hour starting at hourStart (local time) */
+void nowcastAddHour(uint32_t hourStart, const float averages[POLLUTANT_COUNT]);
+
+/* NowCast concentration at time now, the last hour that ended is the
+   newest. NaN without enough hours. */
+float nowcastConcentration(Pollutant pollutant, uint32_t now);
+
+/* NowCast AQI at time now, -1 without enough hours */
+int nowcastAQI(uint32_t now);
+
+#endif /*_NowCast_WeatherStation_H_*/
@@ -0,0 +1,85 @@
+/*
+ * Particle Sensor Stabilization
+ */
+
+#include "particles.h"
+
+ParticleStabilizer::ParticleStabilizer(float tolerance, uint32_t timeout)
+    : tolerance(tolerance / 100.0), timeout(timeout), count(0), latest()
+{
+}
+
+void ParticleStabilizer::addFrame(const ParticleReading &frame)
+{
+  // The fan is not up to speed yet while no particles are counted
+  if (frame.gt0_3 == 0)
+    return;
+
+  uint16_t *channels = window[count % PARTICLE_STABLE_FRAMES];
+  channels[0] = frame.pm1_0;
+  channels[1] = frame.pm2_5;
+  channels[2] = frame.pm10_0;
+  channels[3] = frame.gt0_3;
+  channels[4] = frame.gt0_5;
+  channels[5] = frame.gt1_0;
+  channels[6] = frame.gt2_5;
+  channels[7] = frame.gt5_0;
+  channels[8] = frame.gt10_0;
+
+  latest = frame;
+  if (count < 0xFFFF)
+    count++;
+}
+
+bool ParticleStabilizer::converged() const
+{
+  if (count < PARTICLE_STABLE_FRAMES)
+    return false;
+
+  for (uint8_t c = 0; c < PARTICLE_CHANNELS; c++)
+  {
+    uint16_t low = window[0][c];
+    uint16_t high = window[0][c];
+    uint32_t sum = 0;
+    for (uint8_t f = 0; f < PARTICLE_STABLE_FRAMES; f++)
+    {
+      uint16_t value = window[f][c];
+      if (value < low)
+        low = value;
+      if (value > high)
+        high = value;
+      sum += value;
+    }
+
+    float allowed = tolerance * sum / PARTICLE_STABLE_FRAMES;
+    if (allowed < PARTICLE_TOLERANCE_FLOOR)
+      allowed = PARTICLE_TOLERANCE_FLOOR;
+    if (high - low > allowed)
+      return false;
+  }
+  return true;
+}
+
+ParticleStatus ParticleStabilizer::status(uint32_t elapsed) const
+{
+  if (elapsed >= PARTICLE_MIN_WARMUP && converged())
+    return PARTICLE_STABLE;
+  if (elapsed >= timeout)
+    return count > 0 ? PARTICLE_TIMEOUT : PARTICLE_NO_DATA;
+  return PARTICLE_WARMING_UP;
+}
+
+const char *particleStatusToString(ParticleStatus status)
+{
+  switch (status)
+  {
+  case PARTICLE_WARMING_UP:
+    return "warming up";
+  case PARTICLE_STABLE:
+    return "stable";
+  case PARTICLE_TIMEOUT:
+    return "not stable before timeout";
+  default:
+    return "no data";
+  }
+}
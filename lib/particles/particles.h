@@ -0,0 +1,70 @@
+/*
+ * Particle Sensor Stabilization
+ *
+ * Watches successive PMS7003 frames after power-up and decides when the
+ * readings can be used. A reading is stable once every PM and particle
+ * count channel stays within the tolerance over the last few frames,
+ * instead of always waiting for the worst-case warm-up time. A hard
+ * timeout ends the wait if the values keep drifting or no frames arrive.
+ */
+
+#ifndef _Particles_WeatherStation_H_
+#define _Particles_WeatherStation_H_
+
+#include "hal.h"
+
+/* Consecutive frames that have to agree */
+#define PARTICLE_STABLE_FRAMES 5
+
+/* Minimum time after power-up before a reading can be stable (ms) */
+#define PARTICLE_MIN_WARMUP 10000
+
+/* Time to observe frames before giving up, if observation starts late (ms) */
+#define PARTICLE_MIN_OBSERVATION 10000
+
+/* Channels may always differ by this many units (low concentrations) */
+#define PARTICLE_TOLERANCE_FLOOR 3
+
+/* Number of compared channels (PM1.0, PM2.5, PM10.0 and six sizes) */
+#define PARTICLE_CHANNELS 9
+
+enum ParticleStatus
+{
+  PARTICLE_WARMING_UP = 0,
+  PARTICLE_STABLE = 1,
+  PARTICLE_TIMEOUT = 2, // values did not converge, last frame is used
+  PARTICLE_NO_DATA = 3  // no valid frame received, e.g. UART or fan failure
+};
+
+class ParticleStabilizer
+{
+public:
+  /* Tolerance in percent of the channel mean, timeout in ms after power-up */
+  ParticleStabilizer(float tolerance, uint32_t timeout);
+
+  /* Add a frame */
+  void addFrame(const ParticleReading &frame);
+
+  /* Status elapsed ms after power-up */
+  ParticleStatus status(uint32_t elapsed) const;
+
+  /* Latest valid frame */
+  const ParticleReading &reading() const { return latest; }
+
+  /* Valid frames received so far */
+  uint16_t frames() const { return count; }
+
+private:
+  bool converged() const;
+
+  float tolerance;
+  uint32_t timeout;
+  uint16_t window[PARTICLE_STABLE_FRAMES][PARTICLE_CHANNELS];
+  uint16_t count;
+  ParticleReading latest;
+};
+
+/* Name of a status for the serial log */
+const char *particleStatusToString(ParticleStatus status);
+
+#endif /*_Particles_WeatherStation_H_*/
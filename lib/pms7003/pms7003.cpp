@@ -0,0 +1,152 @@
+/*
+ * PMS7003 Frame Parser
+ */
+
+#include "pms7003.h"
+
+static uint16_t get16(const uint8_t *p)
+{
+  return ((uint16_t)p[0] << 8) | p[1];
+}
+
+static void put16(uint8_t *p, uint16_t v)
+{
+  p[0] = v >> 8;
+  p[1] = v;
+}
+
+static uint16_t checksum(const uint8_t *frame)
+{
+  uint16_t sum = 0;
+  for (uint8_t i = 0; i < PMS7003_FRAME_SIZE - 2; i++)
+    sum += frame[i];
+  return sum;
+}
+
+PMS7003Parser::PMS7003Parser()
+    : frames(0), checksumErrors(0), skippedBytes(0), overruns(0), pos(0), head(0), queued(0)
+{
+}
+
+size_t PMS7003Parser::feed(const uint8_t *data, size_t len)
+{
+  size_t completed = 0;
+  for (size_t i = 0; i < len; i++)
+  {
+    if (push(data[i]))
+      completed++;
+  }
+  return completed;
+}
+
+bool PMS7003Parser::read(ParticleReading &frame)
+{
+  if (queued == 0)
+    return false;
+  frame = queue[head];
+  head = (head + 1) % PMS7003_QUEUE_SIZE;
+  queued--;
+  return true;
+}
+
+void PMS7003Parser::reset()
+{
+  pos = 0;
+  head = 0;
+  queued = 0;
+}
+
+/* Start sequence and length of the partial frame are plausible */
+bool PMS7003Parser::validPrefix() const
+{
+  if (pos >= 1 && buffer[0] != PMS7003_START_1)
+    return false;
+  if (pos >= 2 && buffer[1] != PMS7003_START_2)
+    return false;
+  if (pos >= 4 && get16(buffer + 2) != PMS7003_FRAME_LENGTH)
+    return false;
+  return true;
+}
+
+/* Drop bytes up to the next possible start of a frame */
+void PMS7003Parser::resync()
+{
+  do
+  {
+    uint8_t skip = 1;
+    while (skip < pos && buffer[skip] != PMS7003_START_1)
+      skip++;
+    skippedBytes += skip;
+    pos -= skip;
+    memmove(buffer, buffer + skip, pos);
+  } while (pos > 0 && !validPrefix());
+}
+
+bool PMS7003Parser::push(uint8_t byte)
+{
+  buffer[pos++] = byte;
+  if (!validPrefix())
+  {
+    resync();
+    return false;
+  }
+  if (pos < PMS7003_FRAME_SIZE)
+    return false;
+
+  if (checksum(buffer) != get16(buffer + PMS7003_FRAME_SIZE - 2))
+  {
+    checksumErrors++;
+    resync();
+    return false;
+  }
+
+  if (queued == PMS7003_QUEUE_SIZE)
+  {
+    // Keep the newest frames
+    head = (head + 1) % PMS7003_QUEUE_SIZE;
+    queued--;
+    overruns++;
+  }
+
+  ParticleReading &frame = queue[(head + queued) % PMS7003_QUEUE_SIZE];
+  frame.pm1_0 = get16(buffer + 4);
+  frame.pm2_5 = get16(buffer + 6);
+  frame.pm10_0 = get16(buffer + 8);
+  frame.gt0_3 = get16(buffer + 16);
+  frame.gt0_5 = get16(buffer + 18);
+  frame.gt1_0 = get16(buffer + 20);
+  frame.gt2_5 = get16(buffer + 22);
+  frame.gt5_0 = get16(buffer + 24);
+  frame.gt10_0 = get16(buffer + 26);
+  frame.hwVersion = buffer[28];
+  frame.errorCode = buffer[29];
+  queued++;
+  frames++;
+  pos = 0;
+  return true;
+}
+
+void pms7003Frame(const ParticleReading &reading, uint8_t *frame)
+{
+  memset(frame, 0, PMS7003_FRAME_SIZE);
+  frame[0] = PMS7003_START_1;
+  frame[1] = PMS7003_START_2;
+  put16(frame + 2, PMS7003_FRAME_LENGTH);
+
+  // The station reads the CF=1 values, atmospheric values are the same here
+  put16(frame + 4, reading.pm1_0);
+  put16(frame + 6, reading.pm2_5);
+  put16(frame + 8, reading.pm10_0);
+  put16(frame + 10, reading.pm1_0);
+  put16(frame + 12, reading.pm2_5);
+  put16(frame + 14, reading.pm10_0);
+  put16(frame + 16, reading.gt0_3);
+  put16(frame + 18, reading.gt0_5);
+  put16(frame + 20, reading.gt1_0);
+  put16(frame + 22, reading.gt2_5);
+  put16(frame + 24, reading.gt5_0);
+  put16(frame + 26, reading.gt10_0);
+  frame[28] = reading.hwVersion;
+  frame[29] = reading.errorCode;
+  put16(frame + PMS7003_FRAME_SIZE - 2, checksum(frame));
+}
@@ -0,0 +1,68 @@
+/*
+ * PMS7003 Frame Parser
+ *
+ * Incremental parser for the byte stream of the Plantower PMS7003. Bytes
+ * can be fed in any chunk size as they arrive from the UART; complete
+ * frames with a valid checksum are queued and handed out oldest first.
+ * Corrupt or torn frames are dropped and the parser resynchronizes on the
+ * next start sequence. The parser does not allocate and does not block,
+ * so it can run in a UART task on the ESP32 or replay captures on a host.
+ *
+ * Frame (32 bytes, big-endian)
+ *   0x42 0x4D, u16 length (28), 13 x u16 data, u16 sum of bytes 0-29
+ *   data: PM1.0/2.5/10 (CF=1), PM1.0/2.5/10 (atmospheric),
+ *         >0.3/0.5/1.0/2.5/5.0/10 um per 0.1L, version and error code
+ */
+
+#ifndef _PMS7003_WeatherStation_H_
+#define _PMS7003_WeatherStation_H_
+
+#include "hal.h"
+
+#define PMS7003_FRAME_SIZE 32
+#define PMS7003_FRAME_LENGTH 28 // length field: data and checksum
+#define PMS7003_START_1 0x42
+#define PMS7003_START_2 0x4D
+
+/* Frames kept until they are read, older frames are overwritten */
+#define PMS7003_QUEUE_SIZE 4
+
+class PMS7003Parser
+{
+public:
+  PMS7003Parser();
+
+  /* Parse received bytes, returns the number of frames completed */
+  size_t feed(const uint8_t *data, size_t len);
+
+  /* Oldest queued frame, returns false if there is none */
+  bool read(ParticleReading &frame);
+
+  /* Number of queued frames */
+  uint8_t available() const { return queued; }
+
+  /* Drop partial and queued frames, e.g. after power-up */
+  void reset();
+
+  /* Statistics since construction */
+  uint32_t frames;         // valid frames
+  uint32_t checksumErrors; // frames dropped because of their checksum
+  uint32_t skippedBytes;   // bytes outside of valid frames
+  uint32_t overruns;       // frames overwritten before they were read
+
+private:
+  bool push(uint8_t byte);
+  bool validPrefix() const;
+  void resync();
+
+  uint8_t buffer[PMS7003_FRAME_SIZE];
+  uint8_t pos;
+  ParticleReading queue[PMS7003_QUEUE_SIZE];
+  uint8_t head;
+  uint8_t queued;
+};
+
+/* Encode a reading as frame, e.g. to simulate the sensor */
+void pms7003Frame(const ParticleReading &reading, uint8_t *frame);
+
+#endif /*_PMS7003_WeatherStation_H_*/
@@ -0,0 +1,111 @@
+/*
+ * Wake Cycle Profiler
+ */
+
+#include "profiler.h"
+
+static const char *const PHASE_NAMES[PHASE_COUNT] = {
+    "rtc", "spiffs", "sd_mount", "settings", "sensor_init", "warmup",
+    "acquisition", "sd_write", "wifi", "ntp", "post", "sleep"};
+
+/* Rolling window per phase in RTC memory, durations as encoded by pack() */
+RTC_DATA_ATTR uint16_t profileSamples[PHASE_COUNT][PROFILE_WINDOW];
+RTC_DATA_ATTR uint8_t profileCount[PHASE_COUNT];
+RTC_DATA_ATTR uint8_t profileNext[PHASE_COUNT];
+RTC_DATA_ATTR uint32_t profileWakeCount = 0;
+
+/* Duration in microseconds as mantissa << exponent, rounded to nearest */
+static uint16_t pack(uint32_t micros)
+{
+  if (micros >= PROFILE_TIME_MAX)
+    return 0xFFFF;
+  uint8_t exponent = 0;
+  while ((micros >> exponent) > 0xFFF)
+    exponent++;
+  uint32_t mantissa = exponent > 0 ? (micros + (1UL << (exponent - 1))) >> exponent : micros;
+  if (mantissa > 0xFFF)
+  {
+    mantissa >>= 1;
+    exponent++;
+  }
+  return (exponent << 12) | mantissa;
+}
+
+static uint32_t unpack(uint16_t sample)
+{
+  return (uint32_t)(sample & 0xFFF) << (sample >> 12);
+}
+
+/* This wake */
+static uint32_t phaseStart[PHASE_COUNT];
+static uint32_t phaseTime[PHASE_COUNT];
+static bool phaseRan[PHASE_COUNT];
+
+void profileStart(Phase phase)
+{
+  phaseStart[phase] = micros();
+}
+
+void profileEnd(Phase phase)
+{
+  phaseTime[phase] += micros() - phaseStart[phase];
+  phaseRan[phase] = true;
+}
+
+void profileCommit()
+{
+  for (uint8_t p = 0; p < PHASE_COUNT; p++)
+  {
+    if (!phaseRan[p])
+      continue;
+    profileSamples[p][profileNext[p]] = pack(phaseTime[p]);
+    profileNext[p] = (profileNext[p] + 1) % PROFILE_WINDOW;
+    if (profileCount[p] < PROFILE_WINDOW)
+      profileCount[p]++;
+    phaseTime[p] = 0;
+    phaseRan[p] = false;
+  }
+  profileWakeCount++;
+}
+
+bool profileStats(Phase phase, PhaseStats &stats)
+{
+  uint8_t n = profileCount[phase];
+  stats.samples = n;
+  if (n == 0)
+    return false;
+
+  // Sorted copy of the window for the percentile
+  uint32_t sorted[PROFILE_WINDOW];
+  uint64_t sum = 0;
+  for (uint8_t i = 0; i < n; i++)
+  {
+    uint32_t value = unpack(profileSamples[phase][i]);
+    uint8_t j = i;
+    for (; j > 0 && sorted[j - 1] > value; j--)
+      sorted[j] = sorted[j - 1];
+    sorted[j] = value;
+    sum += value;
+  }
+
+  stats.min = sorted[0];
+  stats.max = sorted[n - 1];
+  stats.mean = sum / n;
+  stats.p95 = sorted[(n * 95 + 99) / 100 - 1];
+  return true;
+}
+
+uint32_t profileTime(Phase phase)
+{
+  return phaseTime[phase];
+}
+
+const char *profilePhaseName(Phase phase)
+{
+  return PHASE_NAMES[phase];
+}
+
+uint32_t profileWakes()
+{
+  return profileWakeCount;
+}
@@ -0,0 +1,72 @@
+/*
+ * Wake Cycle Profiler
+ *
+ * Measures named phases of the wake cycle. The durations of the last
+ * PROFILE_WINDOW wakes are kept per phase in RTC memory, so rolling
+ * statistics (min, max, mean, 95th percentile) survive deep sleep. Phases
+ * can be entered several times per wake (e.g. one POST per batch), their
+ * durations add up. Phases that did not run in a wake are not counted.
+ *
+ * To save RTC memory a duration is kept in 16 bits, a 12 bit mantissa and
+ * a 4 bit exponent: exact up to 4.1 ms, within 0.025% above and at most
+ * PROFILE_TIME_MAX.
+ */
+
+#ifndef _Profiler_WeatherStation_H_
+#define _Profiler_WeatherStation_H_
+
+#include <Arduino.h>
+
+/* Wakes kept per phase for the statistics */
+#define PROFILE_WINDOW 32
+
+/* Longest duration kept in microseconds, about 134 s */
+#define PROFILE_TIME_MAX (4095UL << 15)
+
+enum Phase
+{
+  PHASE_RTC_INIT,
+  PHASE_SPIFFS_MOUNT,
+  PHASE_SD_MOUNT,
+  PHASE_SETTINGS_LOAD,
+  PHASE_SENSOR_INIT,
+  PHASE_WARMUP,
+  PHASE_ACQUISITION,
+  PHASE_SD_WRITE,
+  PHASE_WIFI_ASSOCIATE,
+  PHASE_NTP,
+  PHASE_POST,
+  PHASE_SLEEP_ENTRY,
+  PHASE_COUNT
+};
+
+/* Statistics of a phase in microseconds */
+struct PhaseStats
+{
+  uint8_t samples;
+  uint32_t min;
+  uint32_t max;
+  uint32_t mean;
+  uint32_t p95;
+};
+
+/* Start and end a phase of this wake */
+void profileStart(Phase phase);
+void profileEnd(Phase phase);
+
+/* Add the phases of this wake to the statistics, once before sleep */
+void profileCommit();
+
+/* Rolling statistics, returns false if the phase has no samples yet */
+bool profileStats(Phase phase, PhaseStats &stats);
+
+/* Duration of a phase in this wake in microseconds */
+uint32_t profileTime(Phase phase);
+
+/* Short name of a phase, e.g. "wifi" */
+const char *profilePhaseName(Phase phase);
+
+/* Number of committed wakes since power-up */
+uint32_t profileWakes();
+
+#endif /*_Profiler_WeatherStation_H_*/
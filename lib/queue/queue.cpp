@@ -0,0 +1,139 @@
+/*
+ * Upload Queue
+ */
+
+#include "queue.h"
+
+/* Spill file header: magic and record size, raw records follow */
+#define QUEUE_MAGIC 0x31515357 // "WSQ1"
+
+struct QueueFileHeader
+{
+  uint32_t magic;
+  uint32_t recordSize;
+};
+
+/* Queue state in RTC memory */
+RTC_DATA_ATTR SensorRecord queueRing[QUEUE_RTC_CAPACITY];
+RTC_DATA_ATTR uint8_t queueHead = 0;
+RTC_DATA_ATTR uint8_t queueCount = 0;
+RTC_DATA_ATTR uint32_t queueSpilled = 0; // readings in the spill file
+RTC_DATA_ATTR uint32_t queueSpillSent = 0; // of those, already uploaded
+
+/* Append the RTC part of the queue to the spill file */
+static bool spill(fs::FS &fs)
+{
+  if (queueSpilled + queueCount > QUEUE_FILE_CAPACITY)
+    return false;
+
+  bool newFile = queueSpilled == 0 || !fs.exists(QUEUE_FILE);
+  File file = fs.open(QUEUE_FILE, newFile ? FILE_WRITE : FILE_APPEND);
+  if (!file)
+    return false;
+
+  if (newFile)
+  {
+    QueueFileHeader header = {QUEUE_MAGIC, sizeof(SensorRecord)};
+    file.write((const uint8_t *)&header, sizeof(header));
+    queueSpilled = 0;
+    queueSpillSent = 0;
+  }
+
+  // The ring is written in at most two contiguous pieces
+  uint8_t first = queueCount;
+  if (first > QUEUE_RTC_CAPACITY - queueHead)
+    first = QUEUE_RTC_CAPACITY - queueHead;
+  size_t written = file.write((const uint8_t *)&queueRing[queueHead], first * sizeof(SensorRecord));
+  if (queueCount > first)
+    written += file.write((const uint8_t *)&queueRing[0], (queueCount - first) * sizeof(SensorRecord));
+  file.close();
+
+  if (written != queueCount * sizeof(SensorRecord))
+    return false;
+
+  queueSpilled += queueCount;
+  queueHead = 0;
+  queueCount = 0;
+  return true;
+}
+
+bool queuePush(fs::FS &fs, const SensorRecord &record)
+{
+  if (queueCount == QUEUE_RTC_CAPACITY && !spill(fs))
+  {
+    Serial.println("Warning: Upload queue full");
+    return false;
+  }
+
+  queueRing[(queueHead + queueCount) % QUEUE_RTC_CAPACITY] = record;
+  queueCount++;
+  return true;
+}
+
+size_t queueSize()
+{
+  return (queueSpilled - queueSpillSent) + queueCount;
+}
+
+size_t queuePeek(fs::FS &fs, SensorRecord *records, size_t max, size_t skip)
+{
+  size_t count = 0;
+
+  // Oldest readings are in the spill file
+  if (queueSpilled - queueSpillSent > skip)
+  {
+    File file = fs.open(QUEUE_FILE, FILE_READ);
+    QueueFileHeader header = {0, 0};
+    if (file && file.read((uint8_t *)&header, sizeof(header)) == sizeof(header) &&
+        header.magic == QUEUE_MAGIC && header.recordSize == sizeof(SensorRecord) &&
+        file.seek(sizeof(header) + (queueSpillSent + skip) * sizeof(SensorRecord)))
+    {
+      size_t wanted = queueSpilled - queueSpillSent - skip;
+      if (wanted > max)
+        wanted = max;
+      count = file.read((uint8_t *)records, wanted * sizeof(SensorRecord)) / sizeof(SensorRecord);
+      if (count < wanted)
+        queueSpilled = queueSpillSent + skip + count; // truncated file, the rest is lost
+    }
+    else
+    {
+      Serial.println("Warning: Upload queue file invalid, discarding it");
+      queueSpilled = queueSpillSent = 0;
+    }
+    file.close();
+  }
+
+  // Followed by the readings in RTC memory
+  size_t inFile = queueSpilled - queueSpillSent;
+  size_t first = skip > inFile ? skip - inFile : 0;
+  for (size_t i = first; count < max && i < queueCount; i++)
+    records[count++] = queueRing[(queueHead + i) % QUEUE_RTC_CAPACITY];
+  return count;
+}
+
+void queuePop(fs::FS &fs, size_t count)
+{
+  size_t fromFile = queueSpilled - queueSpillSent;
+  if (fromFile > count)
+    fromFile = count;
+  queueSpillSent += fromFile;
+  count -= fromFile;
+
+  if (queueSpilled > 0 && queueSpillSent == queueSpilled)
+  {
+    fs.remove(QUEUE_FILE);
+    queueSpilled = queueSpillSent = 0;
+  }
+
+  uint8_t fromRing = count < queueCount ? count : queueCount;
+  queueHead = (queueHead + fromRing) % QUEUE_RTC_CAPACITY;
+  queueCount -= fromRing;
+}
+
+void queueClear(fs::FS &fs)
+{
+  fs.remove(QUEUE_FILE);
+  queueSpilled = queueSpillSent = 0;
+  queueHead = 0;
+  queueCount = 0;
+}
@@ -0,0 +1,44 @@
+/*
+ * Upload Queue
+ *
+ * Store-and-forward queue for readings that have not been uploaded yet.
+ * The newest readings are kept in RTC memory, which survives deep sleep.
+ * When it is full, its content is appended to a spill file on the given
+ * file system, so the queue keeps growing while the radio stays off.
+ * Readings are handed out oldest first.
+ */
+
+#ifndef _Queue_WeatherStation_H_
+#define _Queue_WeatherStation_H_
+
+#include <FS.h>
+
+#include "record.h"
+
+/* Readings kept in RTC memory before spilling */
+#define QUEUE_RTC_CAPACITY 24
+
+/* Spill file and the readings it may hold (about 256 kB) */
+#define QUEUE_FILE "/queue.bin"
+#define QUEUE_FILE_CAPACITY 4096
+
+/*
+ * Add a reading, spills the RTC part to the file system when full.
+ * Returns false if the reading did not fit anymore.
+ */
+bool queuePush(fs::FS &fs, const SensorRecord &record);
+
+/* Number of queued readings (RTC memory and spill file) */
+size_t queueSize();
+
+/* Copy up to max of the oldest readings without removing them, after
+   skipping the given number of readings (e.g. those already in flight) */
+size_t queuePeek(fs::FS &fs, SensorRecord *records, size_t max, size_t skip = 0);
+
+/* Remove the count oldest readings, e.g. after they have been uploaded */
+void queuePop(fs::FS &fs, size_t count);
+
+/* Remove all readings */
+void queueClear(fs::FS &fs);
+
+#endif /*_Queue_WeatherStation_H_*/
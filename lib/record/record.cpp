@@ -0,0 +1,185 @@
+/*
+ * Sensor Record
+ */
+
+#include "record.h"
+#include <RTClib.h>
+
+float getField(const SensorRecord &record, const RecordField &field)
+{
+  const uint8_t *p = (const uint8_t *)&record + field.offset;
+  switch (field.type)
+  {
+  case FIELD_UINT16:
+    return *(const uint16_t *)p;
+  case FIELD_INT16:
+    return *(const int16_t *)p;
+  default:
+    return *(const float *)p;
+  }
+}
+
+void setField(SensorRecord &record, const RecordField &field, float value)
+{
+  uint8_t *p = (uint8_t *)&record + field.offset;
+  switch (field.type)
+  {
+  case FIELD_UINT16:
+    *(uint16_t *)p = (uint16_t)value;
+    break;
+  case FIELD_INT16:
+    *(int16_t *)p = (int16_t)value;
+    break;
+  default:
+    *(float *)p = value;
+    break;
+  }
+}
+
+char *formatTimestamp(uint32_t timestamp, char *buffer)
+{
+  strcpy(buffer, "YYYY-MM-DDThh:mm:ss.000Z");
+  return DateTime(timestamp).toString(buffer);
+}
+
+bool parseTimestamp(const char *str, uint32_t &timestamp)
+{
+  unsigned year, month, day, hour, minute, second;
+  if (sscanf(str, "%4u-%2u-%2uT%2u:%2u:%2u", &year, &month, &day, &hour, &minute, &second) != 6)
+    return false;
+  if (year < 2000 || month < 1 || month > 12 || day < 1 || day > 31 || hour > 23 || minute > 59 || second > 59)
+    return false;
+  timestamp = DateTime(year, month, day, hour, minute, second).unixtime();
+  return true;
+}
+
+/* Append a string, returns false if it does not fit (including the terminator) */
+static bool append(char *buffer, size_t size, size_t &len, const char *str)
+{
+  size_t n = strlen(str);
+  if (len + n >= size)
+    return false;
+  memcpy(buffer + len, str, n + 1);
+  len += n;
+  return true;
+}
+
+size_t formatFixed(char *buffer, size_t size, float value, uint8_t precision)
+{
+  static const uint32_t scale[] = {1, 10, 100, 1000, 10000, 100000, 1000000};
+  char digits[32];
+  size_t len = 0;
+
+  if (isnan(value))
+    return append(buffer, size, len, "nan") ? len : 0;
+  if (isinf(value))
+    return append(buffer, size, len, value < 0 ? "-inf" : "inf") ? len : 0;
+  if (precision > 6)
+    precision = 6;
+
+  // Round once on the scaled value, then split into integer and fraction
+  double magnitude = fabs((double)value) * scale[precision] + 0.5;
+  if (magnitude >= 1.8e19)
+  {
+    // Too large for 64 bits, e.g. a broken sensor reading
+    snprintf(digits, sizeof(digits), "%.6e", (double)value);
+    return append(buffer, size, len, digits) ? len : 0;
+  }
+  uint64_t scaled = (uint64_t)magnitude;
+  uint64_t integer = scaled / scale[precision];
+  uint32_t fraction = scaled % scale[precision];
+
+  // Digits are produced backwards
+  size_t n = sizeof(digits);
+  digits[--n] = 0;
+  for (uint8_t i = 0; i < precision; i++)
+  {
+    digits[--n] = '0' + fraction % 10;
+    fraction /= 10;
+  }
+  if (precision > 0)
+    digits[--n] = '.';
+  do
+  {
+    digits[--n] = '0' + integer % 10;
+    integer /= 10;
+  } while (integer > 0);
+  if (value < 0 && scaled > 0)
+    digits[--n] = '-';
+
+  return append(buffer, size, len, digits + n) ? len : 0;
+}
+
+size_t formatCSVHeader(char *buffer, size_t size)
+{
+  size_t len = 0;
+  bool fits = append(buffer, size, len, "\"") && append(buffer, size, len, RECORD_TIME) && append(buffer, size, len, "\"");
+  for (size_t i = 0; fits && i < RECORD_FIELD_COUNT; i++)
+    fits = append(buffer, size, len, ",\"") && append(buffer, size, len, RECORD_FIELDS[i].label) && append(buffer, size, len, "\"");
+  fits = fits && append(buffer, size, len, "\r\n");
+  return fits ? len : 0;
+}
+
+size_t formatCSVRow(char *buffer, size_t size, const SensorRecord &record)
+{
+  char iso8601[25];
+  size_t len = 0;
+  bool fits = append(buffer, size, len, formatTimestamp(record.timestamp, iso8601));
+  for (size_t i = 0; fits && i < RECORD_FIELD_COUNT; i++)
+  {
+    fits = append(buffer, size, len, ",");
+    size_t n = fits ? formatFixed(buffer + len, size - len, getField(record, RECORD_FIELDS[i]), RECORD_FIELDS[i].precision) : 0;
+    fits = n > 0;
+    len += n;
+  }
+  fits = fits && append(buffer, size, len, "\r\n");
+  return fits ? len : 0;
+}
+
+void printRecord(Print &out, const SensorRecord &record)
+{
+  char iso8601[25];
+  out.println("");
+  out.println("---------------------------------------");
+  out.print(RECORD_TIME);
+  out.print(": ");
+  out.println(formatTimestamp(record.timestamp, iso8601));
+  for (size_t i = 0; i < RECORD_FIELD_COUNT; i++)
+  {
+    out.print(RECORD_FIELDS[i].label);
+    out.print(": ");
+    out.println(getField(record, RECORD_FIELDS[i]), RECORD_FIELDS[i].precision);
+  }
+  out.println("---------------------------------------");
+}
+
+void recordToJson(const SensorRecord &record, JsonObject data)
+{
+  for (size_t i = 0; i < RECORD_FIELD_COUNT; i++)
+  {
+    const RecordField &field = RECORD_FIELDS[i];
+    if (field.type == FIELD_FLOAT)
+      data[field.label] = getField(record, field);
+    else
+      data[field.label] = (int)getField(record, field);
+  }
+
+  char iso8601[25];
+  data["created_at"] = formatTimestamp(record.timestamp, iso8601);
+}
+
+void recordToMsgPack(const SensorRecord &record, MsgPackWriter &out)
+{
+  out.map(RECORD_FIELD_COUNT + 1);
+  out.integer(RECORD_ID_TIME);
+  out.integer(record.timestamp);
+  for (size_t i = 0; i < RECORD_FIELD_COUNT; i++)
+  {
+    const RecordField &field = RECORD_FIELDS[i];
+    out.integer(field.id);
+    if (field.type == FIELD_FLOAT)
+      out.real(getField(record, field));
+    else
+      out.integer((int)getField(record, field));
+  }
+}
@@ -0,0 +1,212 @@
+/*
+ * Sensor Record
+ *
+ * One fixed struct holds all values of a wake cycle. The field table below
+ * is the single definition of the record layout: the CSV header and rows,
+ * the serial log and the JSON payload are all generated from it, in table
+ * order. To add a parameter, add its label to parameters.h, a member to
+ * SensorRecord and one line to RECORD_FIELDS with the next unused ID.
+ *
+ * The ID identifies a field in the compact upload encoding (MessagePack),
+ * where readings are maps from ID to value instead of label to value. IDs
+ * are never renumbered or reused, so decoders keep working when fields are
+ * added; RECORD_SCHEMA_VERSION only changes if the meaning of an ID does.
+ */
+
+#ifndef _Record_WeatherStation_H_
+#define _Record_WeatherStation_H_
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+#include <stddef.h>
+
+#include "msgpack.h"
+#include "parameters.h"
+
+struct SensorRecord
+{
+  uint32_t timestamp; // RTC time (local) as seconds since 1970
+
+  float temperature;
+  float humidity;
+  float pressure;
+  float pressurePMSL;
+  float air;
+  float heatIndex;
+  float dewPoint;
+
+  uint16_t pm1_0;
+  uint16_t pm2_5;
+  uint16_t pm10_0;
+
+  uint16_t gt0_3;
+  uint16_t gt0_5;
+  uint16_t gt1_0;
+  uint16_t gt2_5;
+  uint16_t gt5_0;
+  uint16_t gt10_0;
+
+  int16_t aqi;
+
+  uint16_t visible;
+  uint16_t ir;
+  uint16_t uv;
+  int16_t uvIndex;
+
+  float battery;
+
+  /* Sub-samples of the wake and standard deviation of the noisy channels */
+  uint16_t samples;
+  float temperatureSD;
+  float humiditySD;
+  float pressureSD;
+  float airSD;
+  float pm2_5SD;
+  float pm10_0SD;
+
+  /* AQI from the NowCast of the hourly PM averages, -1 without enough hours */
+  int16_t nowcastAQI;
+
+  /* Indoor air quality from the gas resistance baseline, -1 while it is new */
+  int16_t iaq;
+  int16_t iaqCategory;
+
+  /* ParticleStatus of the wake (lib/particles), 0 in readings logged before
+     it was added. Without particle data the PM and count channels are 0 and
+     not measured, the AQI is -1. */
+  int16_t particleStatus;
+};
+
+enum FieldType
+{
+  FIELD_FLOAT,
+  FIELD_UINT16,
+  FIELD_INT16
+};
+
+struct RecordField
+{
+  uint8_t id;         // key in the compact upload encoding
+  const char *label;  // JSON key and CSV column
+  const char *unit;
+  FieldType type;
+  uint8_t precision;  // decimals in the CSV and serial output
+  uint16_t offset;    // position in SensorRecord
+};
+
+#define RECORD_FIELD(id, label, unit, type, precision, member) \
+  { id, label, unit, type, precision, offsetof(SensorRecord, member) }
+
+static constexpr RecordField RECORD_FIELDS[] = {
+    RECORD_FIELD( 1, TEMPERATURE,       "C",       FIELD_FLOAT,  2, temperature),
+    RECORD_FIELD( 2, REL_HUMIDITY,      "%",       FIELD_FLOAT,  2, humidity),
+    RECORD_FIELD( 3, PRESSURE,          "hPa",     FIELD_FLOAT,  2, pressure),
+    RECORD_FIELD( 4, PRESSURE_PMSL,     "hPa",     FIELD_FLOAT,  2, pressurePMSL),
+    RECORD_FIELD( 5, AIR,               "KOhms",   FIELD_FLOAT,  2, air),
+    RECORD_FIELD( 6, HEAT_INDEX,        "C",       FIELD_FLOAT,  2, heatIndex),
+    RECORD_FIELD( 7, DEW_POINT,         "C",       FIELD_FLOAT,  2, dewPoint),
+    RECORD_FIELD( 8, PM_ENV_1,          "ug/m3",   FIELD_UINT16, 0, pm1_0),
+    RECORD_FIELD( 9, PM_ENV_25,         "ug/m3",   FIELD_UINT16, 0, pm2_5),
+    RECORD_FIELD(10, PM_ENV_100,        "ug/m3",   FIELD_UINT16, 0, pm10_0),
+    RECORD_FIELD(11, PARTICLE_SIZE_3,   "um/0.1L", FIELD_UINT16, 0, gt0_3),
+    RECORD_FIELD(12, PARTICLE_SIZE_5,   "um/0.1L", FIELD_UINT16, 0, gt0_5),
+    RECORD_FIELD(13, PARTICLE_SIZE_10,  "um/0.1L", FIELD_UINT16, 0, gt1_0),
+    RECORD_FIELD(14, PARTICLE_SIZE_25,  "um/0.1L", FIELD_UINT16, 0, gt2_5),
+    RECORD_FIELD(15, PARTICLE_SIZE_50,  "um/0.1L", FIELD_UINT16, 0, gt5_0),
+    RECORD_FIELD(16, PARTICLE_SIZE_100, "um/0.1L", FIELD_UINT16, 0, gt10_0),
+    RECORD_FIELD(17, AQI,               "",        FIELD_INT16,  2, aqi),
+    RECORD_FIELD(18, LIGHT_VISIBLE,     "",        FIELD_UINT16, 2, visible),
+    RECORD_FIELD(19, LIGHT_IR,          "",        FIELD_UINT16, 2, ir),
+    RECORD_FIELD(20, LIGHT_UV,          "",        FIELD_UINT16, 2, uv),
+    RECORD_FIELD(21, UV_INDEX,          "",        FIELD_INT16,  2, uvIndex),
+    RECORD_FIELD(22, BATTERY,           "V",       FIELD_FLOAT,  2, battery),
+    RECORD_FIELD(23, SAMPLES,           "",        FIELD_UINT16, 0, samples),
+    RECORD_FIELD(24, TEMPERATURE_SD,    "C",       FIELD_FLOAT,  3, temperatureSD),
+    RECORD_FIELD(25, REL_HUMIDITY_SD,   "%",       FIELD_FLOAT,  3, humiditySD),
+    RECORD_FIELD(26, PRESSURE_SD,       "hPa",     FIELD_FLOAT,  3, pressureSD),
+    RECORD_FIELD(27, AIR_SD,            "KOhms",   FIELD_FLOAT,  3, airSD),
+    RECORD_FIELD(28, PM_ENV_25_SD,      "ug/m3",   FIELD_FLOAT,  2, pm2_5SD),
+    RECORD_FIELD(29, PM_ENV_100_SD,     "ug/m3",   FIELD_FLOAT,  2, pm10_0SD),
+    RECORD_FIELD(30, NOWCAST_AQI,       "",        FIELD_INT16,  0, nowcastAQI),
+    RECORD_FIELD(31, IAQ,               "",        FIELD_INT16,  0, iaq),
+    RECORD_FIELD(32, IAQ_CATEGORY,      "",        FIELD_INT16,  0, iaqCategory),
+    RECORD_FIELD(33, PARTICLE_STATUS,   "",        FIELD_INT16,  0, particleStatus),
+};
+
+static constexpr size_t RECORD_FIELD_COUNT = sizeof(RECORD_FIELDS) / sizeof(RECORD_FIELDS[0]);
+
+/* Column label of the record timestamp */
+static constexpr char RECORD_TIME[] = "Time [Local]";
+
+/* Compact upload encoding, the timestamp has ID 0 */
+#define RECORD_SCHEMA_VERSION 1
+#define RECORD_ID_TIME 0
+
+/* IDs of fields that are looked up elsewhere */
+#define RECORD_ID_PM2_5 9
+#define RECORD_ID_PM10_0 10
+#define RECORD_ID_AQI 17
+
+/* Generic access to a field by table entry */
+float getField(const SensorRecord &record, const RecordField &field);
+void setField(SensorRecord &record, const RecordField &field, float value);
+
+/* ISO 8601 timestamp "YYYY-MM-DDThh:mm:ss.000Z" */
+char *formatTimestamp(uint32_t timestamp, char *buffer);
+
+/* Parse a timestamp written by formatTimestamp, returns false if invalid */
+bool parseTimestamp(const char *str, uint32_t &timestamp);
+
+/* Widest value formatFixed() writes for a field: sign, digits, point and
+   decimals (floats up to 20 digits, larger ones in exponent notation) */
+constexpr size_t csvFieldWidth(const RecordField &field)
+{
+  return (field.type == FIELD_FLOAT ? 21 : field.type == FIELD_INT16 ? 6 : 5) +
+         (field.precision > 0 ? 1 + (field.precision < 6 ? field.precision : 6) : 0);
+}
+
+constexpr size_t csvLength(const char *str)
+{
+  return *str ? 1 + csvLength(str + 1) : 0;
+}
+
+/* "Time [Local]","Label",... and the line break */
+constexpr size_t csvHeaderLength(size_t i = 0)
+{
+  return i < RECORD_FIELD_COUNT ? 3 + csvLength(RECORD_FIELDS[i].label) + csvHeaderLength(i + 1)
+                                : 2 + csvLength(RECORD_TIME) + 2;
+}
+
+/* Timestamp, the widest value of every field and the line break */
+constexpr size_t csvRowLength(size_t i = 0)
+{
+  return i < RECORD_FIELD_COUNT ? 1 + csvFieldWidth(RECORD_FIELDS[i]) + csvRowLength(i + 1) : 24 + 2;
+}
+
+/* Buffer large enough for the CSV header followed by one data row, grows
+   with RECORD_FIELDS */
+static constexpr size_t CSV_BUFFER_SIZE = csvHeaderLength() + csvRowLength() + 1;
+
+/*
+ * CSV header and data row, terminated by a line break. Rendered into the
+ * caller's buffer without heap allocations, so a row can be committed to
+ * the SD card with a single write(). Returns the length, or 0 if the line
+ * does not fit into the buffer.
+ */
+size_t formatCSVHeader(char *buffer, size_t size);
+size_t formatCSVRow(char *buffer, size_t size, const SensorRecord &record);
+
+/* Fixed point number with the given decimals, in exponent notation if it
+   does not fit into 64 bits. Returns the length, 0 if the buffer is too small. */
+size_t formatFixed(char *buffer, size_t size, float value, uint8_t precision);
+
+/* Human readable listing for the serial monitor */
+void printRecord(Print &out, const SensorRecord &record);
+
+/* Add all fields and "created_at" to a JSON object */
+void recordToJson(const SensorRecord &record, JsonObject data);
+
+/* Map from field ID to value, timestamp as seconds since 1970 */
+void recordToMsgPack(const SensorRecord &record, MsgPackWriter &out);
+
+#endif /*_Record_WeatherStation_H_*/
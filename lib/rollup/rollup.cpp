@@ -0,0 +1,218 @@
+/*
+ * Hourly and Daily Rollups
+ */
+
+#include "rollup.h"
+#include "particles.h"
+
+static const uint8_t FIELD_IDS[ROLLUP_FIELD_COUNT] = ROLLUP_FIELD_IDS;
+static const uint32_t PERIOD_SECONDS[ROLLUP_PERIODS] = {3600, 86400};
+
+/* Running rollups and closed ones waiting for upload, kept during deep sleep */
+RTC_DATA_ATTR Rollup rollupRunning[ROLLUP_PERIODS];
+RTC_DATA_ATTR Rollup rollupWaiting[ROLLUP_PENDING_MAX];
+RTC_DATA_ATTR uint8_t rollupWaitingCount = 0;
+
+const RecordField &rollupField(uint8_t field)
+{
+  for (size_t i = 0; i < RECORD_FIELD_COUNT; i++)
+  {
+    if (RECORD_FIELDS[i].id == FIELD_IDS[field])
+      return RECORD_FIELDS[i];
+  }
+  return RECORD_FIELDS[0]; // not reached, the IDs are in the table
+}
+
+static void rollupStart(Rollup &rollup, uint8_t period, uint32_t start)
+{
+  memset(&rollup, 0, sizeof(rollup));
+  rollup.period = period;
+  rollup.start = start;
+}
+
+/* Particle channels, without a value in wakes without particle data */
+static bool particleField(uint8_t id)
+{
+  return id == RECORD_ID_PM2_5 || id == RECORD_ID_PM10_0 || id == RECORD_ID_AQI;
+}
+
+static void rollupUpdate(Rollup &rollup, const SensorRecord &record)
+{
+  rollup.count++;
+  for (uint8_t i = 0; i < ROLLUP_FIELD_COUNT; i++)
+  {
+    RollupStats &stats = rollup.stats[i];
+    float value = getField(record, rollupField(i));
+    if (isnan(value) || (record.particleStatus == PARTICLE_NO_DATA && particleField(FIELD_IDS[i])))
+      continue;
+
+    stats.count++;
+    float delta = value - stats.mean;
+    stats.mean += delta / stats.count;
+    stats.m2 += delta * (value - stats.mean);
+    if (stats.count == 1 || value < stats.min)
+    {
+      stats.min = value;
+      stats.minTime = record.timestamp;
+    }
+    if (stats.count == 1 || value > stats.max)
+    {
+      stats.max = value;
+      stats.maxTime = record.timestamp;
+    }
+  }
+}
+
+uint8_t rollupAdd(const SensorRecord &record, Rollup closed[ROLLUP_PERIODS])
+{
+  uint8_t count = 0;
+  for (uint8_t p = 0; p < ROLLUP_PERIODS; p++)
+  {
+    Rollup &running = rollupRunning[p];
+    uint32_t start = record.timestamp - record.timestamp % PERIOD_SECONDS[p];
+    if (running.count > 0 && running.start != start)
+      closed[count++] = running;
+    if (running.count == 0 || running.start != start)
+      rollupStart(running, p, start);
+    rollupUpdate(running, record);
+  }
+  return count;
+}
+
+const Rollup &rollupCurrent(RollupPeriod period)
+{
+  return rollupRunning[period];
+}
+
+float rollupStddev(const Rollup &rollup, uint8_t field)
+{
+  const RollupStats &stats = rollup.stats[field];
+  if (stats.count < 2)
+    return 0;
+  return sqrt(stats.m2 / (stats.count - 1));
+}
+
+float rollupMean(const Rollup &rollup, uint8_t id)
+{
+  for (uint8_t i = 0; i < ROLLUP_FIELD_COUNT; i++)
+  {
+    if (FIELD_IDS[i] == id)
+      return rollup.stats[i].count > 0 ? rollup.stats[i].mean : NAN;
+  }
+  return NAN;
+}
+
+const char *rollupPeriodName(uint8_t period)
+{
+  return period == ROLLUP_HOUR ? "hour" : "day";
+}
+
+void rollupQueue(const Rollup &rollup)
+{
+  if (rollupWaitingCount == ROLLUP_PENDING_MAX)
+  {
+    rollupWaitingCount--;
+    memmove(rollupWaiting, rollupWaiting + 1, rollupWaitingCount * sizeof(Rollup));
+  }
+  rollupWaiting[rollupWaitingCount++] = rollup;
+}
+
+uint8_t rollupPending()
+{
+  return rollupWaitingCount;
+}
+
+const Rollup &rollupPendingAt(uint8_t index)
+{
+  return rollupWaiting[index];
+}
+
+void rollupClearPending()
+{
+  rollupWaitingCount = 0;
+}
+
+/* Statistics of a field for the output, NaN if it has no values */
+static const RollupStats &valuesOf(const Rollup &rollup, uint8_t field)
+{
+  static const RollupStats NONE = {0, NAN, NAN, NAN, NAN, 0, 0};
+  return rollup.stats[field].count > 0 ? rollup.stats[field] : NONE;
+}
+
+/* Append a string, returns false if it does not fit (including the terminator) */
+static bool append(char *buffer, size_t size, size_t &len, const char *str)
+{
+  size_t n = strlen(str);
+  if (len + n >= size)
+    return false;
+  memcpy(buffer + len, str, n + 1);
+  len += n;
+  return true;
+}
+
+static bool appendFixed(char *buffer, size_t size, size_t &len, float value, uint8_t precision)
+{
+  size_t n = formatFixed(buffer + len, size - len, value, precision);
+  len += n;
+  return n > 0;
+}
+
+size_t formatRollupHeader(char *buffer, size_t size)
+{
+  size_t len = 0;
+  bool fits = append(buffer, size, len,
+                     "\"Period\",\"Start [Local]\",\"Readings\",\"Parameter\",\"Mean\",\"SD\","
+                     "\"Min\",\"Min Time [Local]\",\"Max\",\"Max Time [Local]\"\r\n");
+  return fits ? len : 0;
+}
+
+size_t formatRollupRows(char *buffer, size_t size, const Rollup &rollup)
+{
+  char start[25];
+  char iso8601[25];
+  char readings[8];
+  formatTimestamp(rollup.start, start);
+  snprintf(readings, sizeof(readings), "%u", (unsigned)rollup.count);
+
+  size_t len = 0;
+  bool fits = true;
+  for (uint8_t i = 0; fits && i < ROLLUP_FIELD_COUNT; i++)
+  {
+    const RecordField &field = rollupField(i);
+    const RollupStats &stats = valuesOf(rollup, i);
+    // Means of counts need decimals too
+    uint8_t precision = field.precision < 2 ? 2 : field.precision;
+    fits = append(buffer, size, len, rollupPeriodName(rollup.period)) && append(buffer, size, len, ",") &&
+           append(buffer, size, len, start) && append(buffer, size, len, ",") &&
+           append(buffer, size, len, readings) && append(buffer, size, len, ",\"") &&
+           append(buffer, size, len, field.label) && append(buffer, size, len, "\",") &&
+           appendFixed(buffer, size, len, stats.mean, precision) && append(buffer, size, len, ",") &&
+           appendFixed(buffer, size, len, rollupStddev(rollup, i), precision + 1) &&
+           append(buffer, size, len, ",") && appendFixed(buffer, size, len, stats.min, field.precision) &&
+           append(buffer, size, len, ",") && append(buffer, size, len, formatTimestamp(stats.minTime, iso8601)) &&
+           append(buffer, size, len, ",") && appendFixed(buffer, size, len, stats.max, field.precision) &&
+           append(buffer, size, len, ",") && append(buffer, size, len, formatTimestamp(stats.maxTime, iso8601)) &&
+           append(buffer, size, len, "\r\n");
+  }
+  return fits ? len : 0;
+}
+
+void rollupToJson(const Rollup &rollup, JsonObject data)
+{
+  char iso8601[25];
+  data["period"] = rollupPeriodName(rollup.period);
+  data["start"] = formatTimestamp(rollup.start, iso8601);
+  data["readings"] = rollup.count;
+  JsonObject fields = data.createNestedObject("fields");
+  for (uint8_t i = 0; i < ROLLUP_FIELD_COUNT; i++)
+  {
+    const RollupStats &stats = valuesOf(rollup, i);
+    JsonObject field = fields.createNestedObject(rollupField(i).label);
+    field["mean"] = stats.mean;
+    field["sd"] = rollupStddev(rollup, i);
+    field["min"] = stats.min;
+    field["min_at"] = formatTimestamp(stats.minTime, iso8601);
+    field["max"] = stats.max;
+    field["max_at"] = formatTimestamp(stats.maxTime, iso8601);
+  }
+}
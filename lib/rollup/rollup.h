@@ -0,0 +1,102 @@
+/*
+ * Hourly and Daily Rollups
+ *
+ * Running statistics of the main parameters for the current hour and day:
+ * number of readings, mean and variance (Welford's algorithm) and the
+ * extremes with the time they were measured. They are kept in RTC memory
+ * and updated in constant time per reading. The first reading of a new
+ * period closes the running one, which is then written to the summary file
+ * and can be queued for upload. Periods follow the local time of the
+ * readings, a day starts at midnight. Values that were not measured (NaN,
+ * or the particle channels of a wake without particle sensor data) are
+ * left out, so a field can cover fewer readings than its rollup.
+ *
+ * Closed rollups waiting for upload are kept in RTC memory as well, the
+ * oldest is dropped when more than ROLLUP_PENDING_MAX wait. The summary
+ * file on the SD card has all of them.
+ */
+
+#ifndef _Rollup_WeatherStation_H_
+#define _Rollup_WeatherStation_H_
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+
+#include "record.h"
+
+/* Record field IDs with rollups */
+#define ROLLUP_FIELD_IDS {1, 2, 3, 5, 9, 10, 17, 20, 22}
+#define ROLLUP_FIELD_COUNT 9
+
+/* Closed rollups kept for upload */
+#define ROLLUP_PENDING_MAX 4
+
+/* Summary file rows of a rollup, one per field */
+#define ROLLUP_BUFFER_SIZE 1536
+
+/* Document size of a rollup in JSON, including the copied timestamps */
+#define ROLLUP_JSON_SIZE \
+  (JSON_OBJECT_SIZE(4) + JSON_OBJECT_SIZE(ROLLUP_FIELD_COUNT) + ROLLUP_FIELD_COUNT * (JSON_OBJECT_SIZE(6) + 50) + 32)
+
+enum RollupPeriod
+{
+  ROLLUP_HOUR,
+  ROLLUP_DAY,
+  ROLLUP_PERIODS
+};
+
+/* Statistics of one field */
+struct RollupStats
+{
+  uint16_t count; // readings with a value
+  float mean;
+  float m2; // sum of squared differences from the mean
+  float min;
+  float max;
+  uint32_t minTime;
+  uint32_t maxTime;
+};
+
+struct Rollup
+{
+  uint8_t period;  // RollupPeriod
+  uint16_t count;  // readings
+  uint32_t start;  // local time, start of the hour or day
+  RollupStats stats[ROLLUP_FIELD_COUNT];
+};
+
+/* Add a reading to the running rollups. Returns the number of periods it
+   closed, which are copied to closed (the hour before the day). */
+uint8_t rollupAdd(const SensorRecord &record, Rollup closed[ROLLUP_PERIODS]);
+
+/* Running rollup of the current hour or day, count is 0 after power loss */
+const Rollup &rollupCurrent(RollupPeriod period);
+
+/* Sample standard deviation of a field, 0 for less than two values */
+float rollupStddev(const Rollup &rollup, uint8_t field);
+
+/* Mean of the field with the record field ID, NaN if it has no rollup or
+   no values */
+float rollupMean(const Rollup &rollup, uint8_t id);
+
+/* Record field of a rollup field */
+const RecordField &rollupField(uint8_t field);
+
+/* "hour" or "day" */
+const char *rollupPeriodName(uint8_t period);
+
+/* Closed rollups waiting for upload, oldest first */
+void rollupQueue(const Rollup &rollup);
+uint8_t rollupPending();
+const Rollup &rollupPendingAt(uint8_t index);
+void rollupClearPending();
+
+/* Summary file header and the rows of a rollup (CRLF terminated), returns
+   the length or 0 if they do not fit */
+size_t formatRollupHeader(char *buffer, size_t size);
+size_t formatRollupRows(char *buffer, size_t size, const Rollup &rollup);
+
+/* Rollup as JSON object, fields by their label */
+void rollupToJson(const Rollup &rollup, JsonObject data);
+
+#endif /*_Rollup_WeatherStation_H_*/
@@ -0,0 +1,219 @@
+/*
+ * Adaptive Sampling Scheduler
+ */
+
+#include "scheduler.h"
+#include "particles.h"
+
+/* Last reading and the interval chosen after it, kept during deep sleep */
+struct ScheduleState
+{
+  uint32_t timestamp; // 0 before the first reading
+  uint32_t interval;
+  float pressure;
+  float pressureTrend;
+  float pm2_5;
+};
+RTC_DATA_ATTR ScheduleState scheduleState = {0, 0, NAN, NAN, NAN};
+
+/* Last sleep, to compare it with the PCF8523 after the wake */
+struct WakeState
+{
+  uint32_t target;      // wake time, 0 if none
+  uint32_t sleepClock;  // PCF8523 time when the sleep started
+  float sleepSeconds;   // the sleep timer was set to, 0 if unknown
+  uint32_t bootMillis;  // from reset to the clock read of the last wake
+  uint16_t sleeps;      // compared with the PCF8523 so far
+  float drift;
+};
+RTC_DATA_ATTR WakeState wakeState = {0, 0, 0, 0, 0, 1.0f};
+
+static bool valid(float value)
+{
+  return !isnan(value) && !isinf(value);
+}
+
+/* Update the trends with a reading, returns the activity, 1 is a fast change */
+static float activity(const SchedulePolicy &policy, const SensorRecord &record, ScheduleReason &reason)
+{
+  float dt = (float)(record.timestamp - scheduleState.timestamp);
+  float result = 0;
+
+  if (valid(record.pressure) && valid(scheduleState.pressure))
+  {
+    float rate = (record.pressure - scheduleState.pressure) * 3600.0f / dt;
+    if (!valid(scheduleState.pressureTrend))
+      scheduleState.pressureTrend = rate;
+    else
+      scheduleState.pressureTrend += (1.0f - expf(-dt / SCHEDULE_TREND_TIME)) * (rate - scheduleState.pressureTrend);
+    if (policy.pressureRate > 0)
+    {
+      result = fabsf(scheduleState.pressureTrend) / policy.pressureRate;
+      reason = SCHEDULE_PRESSURE;
+    }
+  }
+
+  if (policy.pmStep > 0 && record.particleStatus != PARTICLE_NO_DATA && valid(scheduleState.pm2_5))
+  {
+    float step = fabsf(record.pm2_5 - scheduleState.pm2_5) / policy.pmStep;
+    if (step > result)
+    {
+      result = step;
+      reason = SCHEDULE_PARTICLES;
+    }
+  }
+  return result;
+}
+
+uint32_t scheduleNext(const SchedulePolicy &policy, const SensorRecord &record, ScheduleReason &reason)
+{
+  uint32_t minInterval = policy.minInterval < policy.interval ? policy.minInterval : policy.interval;
+  uint32_t maxInterval = policy.maxInterval > policy.interval ? policy.maxInterval : policy.interval;
+
+  // The first reading, after a gap or with the clock set back
+  reason = SCHEDULE_NOMINAL;
+  uint32_t interval = policy.interval;
+  if (scheduleState.timestamp == 0 || record.timestamp <= scheduleState.timestamp ||
+      record.timestamp - scheduleState.timestamp > SCHEDULE_GAP_MAX)
+  {
+    scheduleState.pressureTrend = NAN;
+  }
+  else
+  {
+    float change = activity(policy, record, reason);
+    if (change >= 1)
+    {
+      interval = minInterval;
+    }
+    else if (change < 0.5f)
+    {
+      // Grows by half per stable reading
+      interval = scheduleState.interval + scheduleState.interval / 2;
+      reason = SCHEDULE_STABLE;
+    }
+    else
+    {
+      // Still changing, the interval is kept
+      interval = scheduleState.interval;
+    }
+  }
+
+  // Battery limits come last, they override fast changes
+  if (valid(record.battery) && policy.batteryCritical > 0 && record.battery < policy.batteryCritical)
+  {
+    interval = maxInterval;
+    reason = SCHEDULE_BATTERY_CRITICAL;
+  }
+  else if (valid(record.battery) && policy.batteryLow > 0 && record.battery < policy.batteryLow &&
+           interval < policy.interval)
+  {
+    interval = policy.interval;
+    reason = SCHEDULE_BATTERY_LOW;
+  }
+
+  if (interval < minInterval)
+    interval = minInterval;
+  if (interval > maxInterval)
+    interval = maxInterval;
+
+  scheduleState.timestamp = record.timestamp;
+  scheduleState.interval = interval;
+  scheduleState.pressure = record.pressure;
+  scheduleState.pm2_5 = record.particleStatus != PARTICLE_NO_DATA ? record.pm2_5 : NAN;
+  return interval;
+}
+
+uint32_t scheduleWake(uint32_t clock, uint32_t clockMillis)
+{
+  // The sleep on the PCF8523, less the boot of this wake, against the timer
+  if (wakeState.sleepSeconds > 0 && clock > wakeState.sleepClock)
+  {
+    float requested = wakeState.sleepSeconds;
+    float ratio = ((clock - wakeState.sleepClock) - clockMillis / 1000.0f) / requested;
+
+    // Others, e.g. after the clock was set, are not the timer's drift
+    if (ratio > 1 - SCHEDULE_DRIFT_MAX && ratio < 1 + SCHEDULE_DRIFT_MAX)
+    {
+      // The mean of the first sleeps, so it is learned within a few wakes
+      float weight = requested < SCHEDULE_DRIFT_TIME ? requested / SCHEDULE_DRIFT_TIME : 1;
+      if (weight < 1.0f / (wakeState.sleeps + 1))
+        weight = 1.0f / (wakeState.sleeps + 1);
+      wakeState.drift += weight * (ratio - wakeState.drift);
+      if (wakeState.sleeps < UINT16_MAX)
+        wakeState.sleeps++;
+    }
+  }
+  wakeState.sleepSeconds = 0;
+  wakeState.bootMillis = clockMillis;
+
+  uint32_t target = wakeState.target;
+  if (target != 0 && (clock > target ? clock - target : target - clock) <= SCHEDULE_ALIGN_TOLERANCE)
+    return target;
+  return clock;
+}
+
+uint64_t scheduleSleep(const SchedulePolicy &policy, uint32_t timestamp, uint32_t interval, uint32_t clock)
+{
+  // Closest multiple of the shortest interval, the interval if that is shorter
+  uint32_t grid = policy.minInterval < policy.interval ? policy.minInterval : policy.interval;
+  if (grid == 0)
+    grid = 1;
+  if (timestamp > clock + SCHEDULE_ALIGN_TOLERANCE)
+    timestamp = clock; // the clock was set back
+  uint32_t target = timestamp + interval + grid / 2;
+  target -= target % grid;
+  if (target < clock + SCHEDULE_SLEEP_MIN)
+    target = (clock + SCHEDULE_SLEEP_MIN + grid - 1) / grid * grid;
+
+  // Wakes with the same fraction of a second, the boot ends on the wake time
+  float seconds = (target - clock) - wakeState.bootMillis / 1000.0f;
+  uint64_t micros = (uint64_t)(seconds / wakeState.drift * 1000000.0f);
+
+  wakeState.target = target;
+  wakeState.sleepClock = clock;
+  wakeState.sleepSeconds = micros / 1000000.0f;
+  return micros;
+}
+
+uint32_t scheduleTarget()
+{
+  return wakeState.target;
+}
+
+float scheduleDrift()
+{
+  return wakeState.drift;
+}
+
+float schedulePressureTrend()
+{
+  return scheduleState.pressureTrend;
+}
+
+const char *scheduleReasonName(ScheduleReason reason)
+{
+  switch (reason)
+  {
+  case SCHEDULE_PRESSURE:
+    return "pressure trend";
+  case SCHEDULE_PARTICLES:
+    return "particle change";
+  case SCHEDULE_STABLE:
+    return "stable";
+  case SCHEDULE_BATTERY_LOW:
+    return "battery low";
+  case SCHEDULE_BATTERY_CRITICAL:
+    return "battery critical";
+  default:
+    return "nominal";
+  }
+}
+
+void scheduleReset()
+{
+  scheduleState.timestamp = 0;
+  scheduleState.interval = 0;
+  scheduleState.pressure = NAN;
+  scheduleState.pressureTrend = NAN;
+  scheduleState.pm2_5 = NAN;
+}
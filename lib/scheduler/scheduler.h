@@ -0,0 +1,99 @@
+/*
+ * Adaptive Sampling Scheduler
+ *
+ * Picks the sleep interval after each reading, between a shortest and a
+ * longest interval. Fast changes, a pressure trend of pressureRate hPa per
+ * hour or a PM2.5 step of pmStep ug/m3 between readings, switch to the
+ * shortest interval. While conditions are stable the interval grows by half
+ * with every reading, up to the longest one. The pressure trend is a time
+ * weighted average over about an hour, so the noise of single readings does
+ * not count as a change.
+ *
+ * A low battery keeps the interval at or above the nominal one, a critical
+ * battery uses the longest. With equal shortest and longest intervals the
+ * station wakes at the fixed nominal interval. The state is kept in RTC
+ * memory, the first reading after a power loss uses the nominal interval.
+ *
+ * Wakes are aligned to the wall clock: the next wake is the multiple of the
+ * shortest interval closest to the last wake plus the interval, e.g. every
+ * full 5 minutes, as read from the PCF8523. The deep sleep timer of the
+ * ESP32 runs off its RC slow clock, which is off by up to a few percent.
+ * Every wake compares the time slept on the PCF8523 with the time the
+ * timer was set to, and a time weighted average of that ratio (over about
+ * SCHEDULE_DRIFT_TIME) corrects the following sleeps. Readings that start
+ * within SCHEDULE_ALIGN_TOLERANCE seconds of their wake time are stamped
+ * with it, so readings of stations with the same interval line up.
+ */
+
+#ifndef _Scheduler_WeatherStation_H_
+#define _Scheduler_WeatherStation_H_
+
+#include <Arduino.h>
+
+#include "record.h"
+
+/* Time constant of the pressure trend in seconds */
+#define SCHEDULE_TREND_TIME 3600
+
+/* Readings further apart start over, e.g. after the station was off */
+#define SCHEDULE_GAP_MAX (6 * 3600UL)
+
+/* Sleep timer drift: averaging time in seconds, largest plausible ratio error */
+#define SCHEDULE_DRIFT_TIME 3600
+#define SCHEDULE_DRIFT_MAX 0.1f
+
+/* Seconds a reading may start off its wake time and still be stamped with it */
+#define SCHEDULE_ALIGN_TOLERANCE 2
+
+/* Seconds of sleep at least, a wake time closer moves to the next multiple */
+#define SCHEDULE_SLEEP_MIN 5
+
+/* Intervals in seconds, thresholds disabled with 0 */
+struct SchedulePolicy
+{
+  uint32_t interval;
+  uint32_t minInterval;
+  uint32_t maxInterval;
+  float pressureRate;    // hPa per hour
+  float pmStep;          // ug/m3 between readings
+  float batteryLow;      // V
+  float batteryCritical; // V
+};
+
+enum ScheduleReason
+{
+  SCHEDULE_NOMINAL,
+  SCHEDULE_PRESSURE,
+  SCHEDULE_PARTICLES,
+  SCHEDULE_STABLE,
+  SCHEDULE_BATTERY_LOW,
+  SCHEDULE_BATTERY_CRITICAL
+};
+
+/* Seconds until the next reading, after the reading in record */
+uint32_t scheduleNext(const SchedulePolicy &policy, const SensorRecord &record, ScheduleReason &reason);
+
+/* Call at the start of a wake with the PCF8523 time and millis() when it
+   was read. Learns the sleep timer drift from the last sleep, returns the
+   time to stamp the reading with. */
+uint32_t scheduleWake(uint32_t clock, uint32_t clockMillis);
+
+/* Microseconds to sleep for the next reading, interval seconds after the
+   reading at timestamp, with the PCF8523 time read right before sleeping */
+uint64_t scheduleSleep(const SchedulePolicy &policy, uint32_t timestamp, uint32_t interval, uint32_t clock);
+
+/* Wake time of the next reading, set by scheduleSleep() */
+uint32_t scheduleTarget();
+
+/* Seconds of real time per second of the sleep timer, 1 until learned */
+float scheduleDrift();
+
+/* Pressure trend in hPa per hour, NaN before the second reading */
+float schedulePressureTrend();
+
+const char *scheduleReasonName(ScheduleReason reason);
+
+/* Forget the earlier readings */
+void scheduleReset();
+
+#endif /*_Scheduler_WeatherStation_H_*/
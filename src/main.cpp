@@ -47,27 +47,16 @@
 /* Dependencies */
 #include <Arduino.h>
 #include <ArduinoJson.h>
-#include <Adafruit_BME680.h>
-#include <Adafruit_SI1145.h>
-#include <HTTPClient.h>
-#include <RTClib.h>
-#include <SD.h>
-#include <SPIFFS.h>
-#include <Update.h>
-#include <WiFi.h>
-#include <WiFiClientSecure.h>
-
-/* Github Libraries */
-#include <Plantower_PMS7003.h>
-
-/* Pin allocations */
-#define ADC_PIN A13 // Battery Volatage
-#define BATT_PIN 2  // Battery Volatage
-#define POWER_SWITCH_PIN A6 // Power Management
+
+/* Hardware Abstraction (ESP32 or native stand-ins) */
+#include "hal.h"
 
 /* Set assumed Sealevel Pressure */
 #define SEALEVELPRESSURE_HPA (1013.25)
 
+/* Firmware version, e.g. to compare wake cycle profiles */
+#define FIRMWARE_VERSION "2.0.0"
+
 /* Firmware update constants */
 #define UPDATE_FILE "/firmware.bin"
 #define UPDATE_SIZE 100000
@@ -80,66 +69,294 @@
    https://github.com/me−no−dev/arduino−esp32fs−plugin */
 #define FORMAT_SPIFFS_IF_FAILED true
 
-/* Parameter Labels */
-#include "parameters.h"
+/* Sensor Record and Parameter Labels */
+#include "record.h"
+
+/* Binary Record Log */
+#include "binlog.h"
+
+/* Particle Sensor Stabilization */
+#include "particles.h"
+
+/* Wake Cycle Profiler */
+#include "profiler.h"
+
+/* Profile statistics are appended to the SD card every n wakes */
+#define PROFILE_FILE "/profile.csv"
+#define PROFILE_FILE_INTERVAL 12
+
+/* Upload Queue */
+#include "queue.h"
+
+/* Backlog Replay from the SD card */
+#include "backlog.h"
+
+/* Time in milliseconds to connect to WiFi */
+#define WIFI_TIMEOUT 30000
+
+/* Maximum number of readings per request */
+#define UPLOAD_BATCH_MAX 24
+
+/* Failed uploads double the upload interval, up to 2^n times */
+#define UPLOAD_BACKOFF_MAX 3
+
+/* Time in milliseconds spent per wake on replaying the backlog */
+#define BACKLOG_TIME_BUDGET 20000
+
+/* Newest reading accepted by the server, kept across power loss */
+#define UPLOAD_MARK_FILE "/upload.hwm"
+
+/* MessagePack and Columnar Upload Encoding */
+#include "msgpack.h"
+#include "columnar.h"
+
+/* MQTT Client */
+#include "mqtt.h"
+
+/* Topic of the readings, with the chip ID */
+#define MQTT_TOPIC "weatherstation/%s/readings"
+
+/* Topic of the hourly and daily rollups */
+#define MQTT_ROLLUP_TOPIC "weatherstation/%s/rollups"
 
 /* Additional Calculations */
 #include "calculations.h"
 
+/* Sub-samples per wake, aggregated with streaming statistics */
+#include "aggregate.h"
+#define SAMPLES_MAX 32
+
+/* Hourly and daily rollups, closed ones are appended to a yearly summary file */
+#include "rollup.h"
+
+/* NowCast AQI from the hourly PM averages of the rollups */
+#include "nowcast.h"
+
+/* Indoor air quality from the gas resistance baseline */
+#include "iaq.h"
+
+/* Sleep interval adapted to changes and the battery */
+#include "scheduler.h"
+
 /* Settings */
 #include "settings.h"
 Settings settings;
 
+/* Binary snapshot of the settings, so a wake does not parse the JSON file.
+   Kept in RTC memory and on SPIFFS for after a power loss. */
+#include "checksum.h"
+#define SETTINGS_SNAPSHOT_FILE "/settings.bin"
+#define SETTINGS_MAGIC 0x53535357 // "WSSS"
+#define SETTINGS_VERSION 4
+
+struct SettingsSnapshot
+{
+  uint32_t magic;
+  uint16_t version;
+  uint16_t size;
+  Settings settings;
+  uint32_t crc; // CRC-32 of everything before
+};
+RTC_DATA_ATTR SettingsSnapshot settingsSnapshot;
+
 /* Inital value for RTC memory */
 RTC_DATA_ATTR bool ntp_update = false;
 RTC_DATA_ATTR int ntp_last_update = 0;
-
-/* Define Sensors */
-RTC_PCF8523 rtc;
-Adafruit_SI1145 uv = Adafruit_SI1145();
-Adafruit_BME680 bme;
-Plantower_PMS7003 pms7003 = Plantower_PMS7003();
+RTC_DATA_ATTR int upload_wakes = 0;
+RTC_DATA_ATTR int upload_failures = 0;
+RTC_DATA_ATTR uint32_t upload_mark = 0;
+RTC_DATA_ATTR bool backlog_pending = false;
+RTC_DATA_ATTR uint32_t binlog_schema_day = 0; // day whose binary log ends in binlog_schema_crc
+RTC_DATA_ATTR uint32_t binlog_schema_crc = 0;
+RTC_DATA_ATTR uint32_t csv_schema_day = 0; // day whose CSV file ends in the header row with csv_schema_crc
+RTC_DATA_ATTR uint32_t csv_schema_crc = 0;
+
+/* Define Hardware */
+Board &board = getBoard();
+Clock &rtc = getClock();
+LightSensor &uv = getLightSensor();
+EnvironmentSensor &bme = getEnvironmentSensor();
+ParticleSensor &pms7003 = getParticleSensor();
+Network &network = getNetwork();
+
+/* MQTT over the network connection */
+MQTTClient mqtt(network);
 
 /* Misc Variables */
 uint64_t chipid;
 char ChipIDStr[13];
-char iso8601[] = "YYYY-MM-DDThh:mm:ss.000Z";
+char MQTTTopic[48];
+char MQTTRollupTopic[48];
+uint32_t backlogTime = 0; // milliseconds spent on the backlog this wake
 
 /* Functions */
-void loadSettings(Settings &settings);
+bool loadSettings(Settings &settings);
 void saveSettings();
+bool loadSettingsSnapshot(Settings &settings);
+void saveSettingsSnapshot(const Settings &settings);
 bool checkForUpdate();
 void startUpdate();
-void StartDeepSleep(int offset);
-void LogDataToSerial(JsonDocument &data);
-void WriteDataToSD(JsonDocument &data);
-void GetSensorData(JsonDocument &data);
-void SubmitSensorData(JsonDocument &data);
-bool HttpsPOSTRequest(WiFiClient &client, JsonDocument &data);
+SchedulePolicy schedulePolicy();
+void StartDeepSleep(uint32_t timestamp, uint32_t interval);
+void LogDataToSerial(SensorRecord &record);
+void WriteDataToSD(SensorRecord &record);
+bool NewDailyFile(DateTime &now, char *path);
+void WriteCSVToSD(DateTime &now, SensorRecord &record);
+void WriteBinaryToSD(DateTime &now, SensorRecord &record);
+void GetSensorData(SensorRecord &record, ParticleStatus particles);
+void WriteProfileToSD(DateTime &now);
+void WriteRollupToSD(const Rollup &rollup);
+void profileToJson(JsonObject profile);
+void loadUploadMark();
+void saveUploadMark();
+ParticleStatus WaitForSensors(uint32_t warmupStart);
+bool UploadDue();
+bool ConnectNetwork();
+bool UploadQueue();
+bool UploadBatch(const SensorRecord *records, size_t count);
+bool ReplayBacklog();
+bool HttpsPOSTRequest(const SensorRecord *records, size_t count);
+size_t PayloadCapacity(size_t count);
+void BuildPayload(const SensorRecord *records, size_t count, bool token, JsonDocument &data);
+void BuildMsgPack(const SensorRecord *records, size_t count, bool token, bool columnar, Print &out);
+bool MQTTConnect();
+bool MQTTPublishBatch(const SensorRecord *records, size_t count);
+bool MQTTUploadQueue();
+bool UploadRollups();
+
+/* Request body with up to maxCount readings in the configured encoding,
+   written straight to the connection and measured beforehand for the
+   length. JSON is built in a document, MessagePack (and the columnar batch
+   in it) is encoded from the records, which must stay valid until the body
+   is sent. */
+class UploadPayload : public Payload
+{
+public:
+  UploadPayload(size_t maxCount)
+      : columnar(strcmp(settings.encoding, "COLUMNAR") == 0),
+        msgpack(columnar || strcmp(settings.encoding, "MSGPACK") == 0),
+        data(msgpack ? 0 : PayloadCapacity(maxCount)), records(NULL), count(0), token(false) {}
 
-/* Program Setup */
-void setup()
+  void set(const SensorRecord *records, size_t count, bool token)
+  {
+    this->records = records;
+    this->count = count;
+    this->token = token;
+    if (!msgpack)
+      BuildPayload(records, count, token, data);
+  }
+
+  const char *contentType() { return msgpack ? "application/msgpack" : "application/json; charset=utf-8"; }
+
+  size_t length()
+  {
+    if (!msgpack)
+      return measureJson(data);
+    MeasurePrint out;
+    BuildMsgPack(records, count, token, columnar, out);
+    return out.bytes;
+  }
+
+  void writeTo(Print &out)
+  {
+    if (msgpack)
+      BuildMsgPack(records, count, token, columnar, out);
+    else
+      serializeJson(data, out);
+  }
+
+private:
+  bool columnar;
+  bool msgpack;
+  DynamicJsonDocument data;
+  const SensorRecord *records;
+  size_t count;
+  bool token;
+};
+
+/* Closed rollups waiting for upload. JSON carries them as "rollups" next
+   to the token and device ID, MessagePack under key 6 of the payload map
+   (same objects as in JSON). */
+class RollupPayload : public Payload
 {
+public:
+  RollupPayload(bool token)
+      : msgpack(strcmp(settings.encoding, "JSON") != 0), token(token),
+        data(256 + JSON_ARRAY_SIZE(ROLLUP_PENDING_MAX) + ROLLUP_PENDING_MAX * ROLLUP_JSON_SIZE)
+  {
+    if (token && !msgpack)
+    {
+      data["token"] = settings.apikey;
+    }
+    data["device_id"] = ChipIDStr;
+    JsonArray rollups = data.createNestedArray("rollups");
+    for (uint8_t i = 0; i < rollupPending(); i++)
+    {
+      rollupToJson(rollupPendingAt(i), rollups.createNestedObject());
+    }
+  }
+
+  const char *contentType() { return msgpack ? "application/msgpack" : "application/json; charset=utf-8"; }
+
+  size_t length()
+  {
+    if (!msgpack)
+      return measureJson(data);
+    MeasurePrint out;
+    writeTo(out);
+    return out.bytes;
+  }
+
+  void writeTo(Print &out)
+  {
+    if (!msgpack)
+    {
+      serializeJson(data, out);
+      return;
+    }
+    MsgPackWriter writer(out);
+    writer.map(3 + (token ? 1 : 0));
+    writer.integer(0);
+    writer.integer(RECORD_SCHEMA_VERSION);
+    writer.integer(1);
+    writer.string(ChipIDStr);
+    if (token)
+    {
+      writer.integer(2);
+      writer.string(settings.apikey);
+    }
+    writer.integer(6);
+    serializeMsgPack(data["rollups"], out);
+  }
 
-  /* Start timer for data collection */
-  uint32_t startDataCollect = millis();
+private:
+  bool msgpack;
+  bool token;
+  DynamicJsonDocument data;
+};
 
-  /* Battery Pins */
-  pinMode(ADC_PIN, INPUT);
-  pinMode(BATT_PIN, OUTPUT);
+/* Program Setup */
+void setup()
+{
 
-  /* Sensor power */
-  pinMode(POWER_SWITCH_PIN, OUTPUT);
-  digitalWrite(POWER_SWITCH_PIN, LOW);
+  /* Battery Pins and Sensor power */
+  board.begin();
 
   /* Initialize serial port */
   Serial.begin(115200);
 
   /* Initialize PMS7001 Sensor */
-  Serial1.begin(9600);
-  pms7003.init(&Serial1);
+  profileStart(PHASE_SENSOR_INIT);
+  pms7003.begin();
+
+  /* Power up Sensors, the particle sensor warms up while storage,
+     settings and the network are brought up */
+  board.setSensorPower(true);
+  uint32_t warmupStart = millis();
+  profileEnd(PHASE_SENSOR_INIT);
 
   /* Check if the RTC PCF8523 is available */
+  profileStart(PHASE_RTC_INIT);
   if (!rtc.begin())
   {
     Serial.println("Error: RTC PCF8523 not found.");
@@ -147,14 +364,16 @@ void setup()
   }
 
   /* Set the clock's time if not initialized */
-  if (!rtc.initialized() || rtc.lostPower())
+  if (rtc.lostPower())
   {
     Serial.println(F("Warning: RTC needs to be initialized"));
     rtc.adjust(DateTime(F(__DATE__), F(__TIME__)));
   }
 
-  /* Time Object */
+  /* Time Object, the wake time is the time of the reading if the wake is on time */
   DateTime now = rtc.now();
+  uint32_t wakeTime = scheduleWake(now.unixtime(), millis());
+  profileEnd(PHASE_RTC_INIT);
 
   /* Check if RTC needs to be synced with a NTP Server */
   if (now.hour() < ntp_last_update)
@@ -169,14 +388,19 @@ void setup()
   Serial.println(ntp_last_update);
 
   /* Initialize SPIFFS */
-  if (!SPIFFS.begin(FORMAT_SPIFFS_IF_FAILED))
+  profileStart(PHASE_SPIFFS_MOUNT);
+  if (!board.mountFlash(FORMAT_SPIFFS_IF_FAILED))
   {
     Serial.println("SPIFFS Mount Failed");
     return;
   }
+  profileEnd(PHASE_SPIFFS_MOUNT);
 
   /* Initialize SD card */
-  if (!SD.begin())
+  profileStart(PHASE_SD_MOUNT);
+  bool sdMounted = board.mountSD();
+  profileEnd(PHASE_SD_MOUNT);
+  if (!sdMounted)
   {
     Serial.println("SD Mount Failed");
     return;
@@ -185,16 +409,8 @@ void setup()
   {
 
     // Output SD Cad information
-    uint8_t cardType = SD.cardType();
-
-    if (cardType == CARD_NONE)
-    {
-      Serial.println("Warning: No SD card attached.");
-      return;
-    }
-
-    uint64_t cardSize = SD.cardSize() / (1024 * 1024);
-    Serial.printf("SD Card Size: %lluMB\n", cardSize);
+    uint64_t cardSize = board.sdCardSize() / (1024 * 1024);
+    Serial.printf("SD Card Size: %lluMB\n", (unsigned long long)cardSize);
   }
 
   /* Check if new fimware is on SD card */
@@ -207,26 +423,36 @@ void setup()
     startUpdate();
 
     // Reset after update
-    ESP.restart();
+    board.restart();
   }
 
   /* Check if settings file exists on SD card */
-  if (SD.exists(SETTINGS_FILE))
+  profileStart(PHASE_SETTINGS_LOAD);
+  if (board.sd().exists(SETTINGS_FILE))
   {
     Serial.println("Config file found.");
     saveSettings();
 
     // Delete JSON file on SD card
-    SD.remove(SETTINGS_FILE);
+    board.sd().remove(SETTINGS_FILE);
   }
 
-  /* Load Settings from SPIFFS */
-  loadSettings(settings);
+  /* Load Settings from the snapshot, the JSON file on SPIFFS is only parsed
+     after an import or if the snapshot is missing or of another version */
+  if (!loadSettingsSnapshot(settings) && loadSettings(settings))
+  {
+    saveSettingsSnapshot(settings);
+  }
 
-  /* Power up Sensors */
-  digitalWrite(POWER_SWITCH_PIN, HIGH);
+  /* Restore the upload high-water mark after a power loss */
+  if (upload_mark == 0)
+  {
+    loadUploadMark();
+  }
+  profileEnd(PHASE_SETTINGS_LOAD);
 
   /* Check if SI1145 is available */
+  profileStart(PHASE_SENSOR_INIT);
   if (!uv.begin())
   {
     Serial.println("Error: Si1145 not found");
@@ -242,70 +468,188 @@ void setup()
       ;
   }
 
-  /* Set up BME680 oversampling and filter initialization for BME680 */
-  bme.setTemperatureOversampling(BME680_OS_8X);
-  bme.setHumidityOversampling(BME680_OS_2X);
-  bme.setPressureOversampling(BME680_OS_4X);
-  bme.setIIRFilterSize(BME680_FILTER_SIZE_3);
-  bme.setGasHeater(320, 150); // 320*C for 150 ms
+  profileEnd(PHASE_SENSOR_INIT);
 
   /* Board Information */
-  chipid = ESP.getEfuseMac();                                      // The chip ID is essentially its MAC address(length: 6 bytes).
+  chipid = board.chipId();                                         // The chip ID is essentially its MAC address(length: 6 bytes).
   Serial.printf("ESP32 Chip ID = %04X", (uint16_t)(chipid >> 32)); // print High 2 bytes
   Serial.printf("%08X\n", (uint32_t)chipid);                       // print Low 4bytes.
   sprintf(ChipIDStr, "%04X", (uint16_t)(chipid >> 32));
   sprintf(ChipIDStr + strlen(ChipIDStr), "%08X", (uint32_t)chipid);
+  snprintf(MQTTTopic, sizeof(MQTTTopic), MQTT_TOPIC, ChipIDStr);
+  snprintf(MQTTRollupTopic, sizeof(MQTTRollupTopic), MQTT_ROLLUP_TOPIC, ChipIDStr);
 
   /* Measurement can start */
   Serial.println("Initialization done.");
 
+  /* Decide if this wake uploads, counting the reading about to be taken */
+  upload_wakes++;
+  bool upload = UploadDue();
+  bool online = false;
+  bool uploaded = true;
+  uint32_t mark = upload_mark;
+
+  /* Connect, sync the clock and send queued data during the warm-up */
+  if (upload)
+  {
+    online = ConnectNetwork();
+    uploaded = online && UploadQueue();
+  }
+
   /* Wait for the Particle sensor to reach stable conditions */
-  delay(30000);
+  profileStart(PHASE_WARMUP);
+  ParticleStatus particles = WaitForSensors(warmupStart);
+  profileEnd(PHASE_WARMUP);
 
-  /* Initiate JSON document */
-  DynamicJsonDocument doc(1028);
+  /* Initiate Sensor Record */
+  SensorRecord record = {};
+  record.timestamp = wakeTime;
 
-  /* Add Sensor Data to JSON document */
-  GetSensorData(doc);
+  /* Add Sensor Data to Record */
+  profileStart(PHASE_ACQUISITION);
+  GetSensorData(record, particles);
+  profileEnd(PHASE_ACQUISITION);
 
   /* Power down Sensors */
-  digitalWrite(POWER_SWITCH_PIN, LOW);
+  board.setSensorPower(false);
+
+  /* Update the hourly and daily rollups, a new period closes the running one */
+  Rollup closed[ROLLUP_PERIODS];
+  uint8_t closedCount = rollupAdd(record, closed);
 
-  /* Add additional information to document */
-  doc["token"] = settings.apikey;
-  doc["data"]["device_id"] = ChipIDStr;
-  doc["data"]["created_at"] = now.toString(iso8601);
+  /* A closed hour adds its PM averages to the NowCast history */
+  for (uint8_t i = 0; i < closedCount; i++)
+  {
+    if (closed[i].period == ROLLUP_HOUR)
+    {
+      float averages[POLLUTANT_COUNT] = {rollupMean(closed[i], RECORD_ID_PM2_5),
+                                             rollupMean(closed[i], RECORD_ID_PM10_0)};
+      nowcastAddHour(closed[i].start, averages);
+    }
+  }
+  record.nowcastAQI = nowcastAQI(record.timestamp);
+
+  /* Gas resistance against its long-term baseline */
+  record.iaq = iaqUpdate(board.flash(), record.timestamp, record.air, record.humidity);
+  record.iaqCategory = iaqCategory(record.iaq);
+  if (record.iaq >= 0)
+  {
+    Serial.printf("IAQ %d (%s), gas baseline %.1f KOhms\n", record.iaq, iaqCategoryName(record.iaqCategory),
+                  iaqBaseline());
+  }
 
   /* Write Data to Serial */
-  LogDataToSerial(doc);
+  LogDataToSerial(record);
 
   /* Write Data to SD File */
-  WriteDataToSD(doc);
+  profileStart(PHASE_SD_WRITE);
+  WriteDataToSD(record);
 
-  /* Send Data To Server */
-  SubmitSensorData(doc);
+  /* Closed rollups go to the summary file */
+  for (uint8_t i = 0; i < closedCount; i++)
+  {
+    WriteRollupToSD(closed[i]);
+    if (settings.uploadRollups)
+    {
+      rollupQueue(closed[i]);
+    }
+  }
+  profileEnd(PHASE_SD_WRITE);
 
-  /* End timer for data collection */
-  uint32_t endDataCollect = millis();
+  /* Write Wake Cycle Profile to SD File */
+  if (profileWakes() > 0 && profileWakes() % PROFILE_FILE_INTERVAL == 0)
+  {
+    WriteProfileToSD(now);
+  }
 
-  /* Start Sleep for time definde in Settings */
-  StartDeepSleep( (endDataCollect - startDataCollect) );
+  /* Queue Data for Upload, the SD card has it all if the queue is full */
+  if (!queuePush(board.flash(), record))
+  {
+    queueClear(board.flash());
+    queuePush(board.flash(), record);
+    mqtt.clearInflight();
+    backlog_pending = true;
+  }
+
+  /* Send the new reading over the open connection */
+  if (upload)
+  {
+    if (online && uploaded)
+    {
+      uploaded = UploadQueue();
+    }
+
+    /* Closed rollups after the readings, they stay queued if this fails */
+    if (online && uploaded && rollupPending() > 0)
+    {
+      UploadRollups();
+    }
+
+    /* Turn WiFi off, the MQTT session stays on the broker */
+    if (mqtt.connected())
+    {
+      mqtt.disconnect();
+    }
+    network.end();
+
+    /* Persist progress in case the RTC memory is lost */
+    if (upload_mark != mark)
+    {
+      saveUploadMark();
+    }
+
+    /* Back off after failed uploads */
+    if (uploaded)
+    {
+      upload_failures = 0;
+    }
+    else
+    {
+      upload_failures++;
+    }
+    upload_wakes = 0;
+  }
+  else
+  {
+    Serial.printf("Upload queued (%d readings)\n", (int)queueSize());
+  }
+
+  /* Pick the sleep interval from this reading */
+  ScheduleReason reason;
+  uint32_t interval = scheduleNext(schedulePolicy(), record, reason);
+  Serial.printf("Next reading in %.1f minutes (%s)\n", interval / 60.0, scheduleReasonName(reason));
+
+  /* Start Sleep until the wake time of the next reading */
+  StartDeepSleep(record.timestamp, interval);
 }
 
 /* Main Program Loop */
 void loop(){}
 
+/* Copy a string setting, longer values are cut off */
+void loadString(char *setting, size_t size, const char *value)
+{
+  if (strlen(value) >= size)
+  {
+    Serial.printf("Setting too long, cut to %d characters: %s\n", (int)size - 1, value);
+  }
+  snprintf(setting, size, "%s", value);
+}
+
 /* Load Settings from SPIFFS */
-void loadSettings(Settings &settings)
+bool loadSettings(Settings &settings)
 {
+  // One sample per wake also without a settings file
+  settings.samplesPerWake = 1;
+
   // Open file to read settings
-  File file = SPIFFS.open(SETTINGS_FILE, "r");
+  File file = board.flash().open(SETTINGS_FILE, "r");
 
   // If file open failed, exit
   if (!file)
   {
     Serial.println("Failed to open settings file");
-    return;
+    return false;
   }
   Serial.println("Settings found");
 
@@ -318,14 +662,17 @@ void loadSettings(Settings &settings)
     Serial.println(F("Failed to read file, using default configuration"));
 
   // WiFi credentials
-  settings.ssid = sdoc["ssid"] | "";
-  settings.password = sdoc["password"] | "";
+  loadString(settings.ssid, sizeof(settings.ssid), sdoc["ssid"] | "");
+  loadString(settings.password, sizeof(settings.password), sdoc["password"] | "");
+  settings.wifiStaticIP = sdoc["wifiStaticIP"] | false;
 
   // Server
-  settings.apikey = sdoc["apikey"] | "";
-  settings.server = sdoc["server"] | "";
+  loadString(settings.apikey, sizeof(settings.apikey), sdoc["apikey"] | "");
+  loadString(settings.server, sizeof(settings.server), sdoc["server"] | "");
+  loadString(settings.serverFingerprint, sizeof(settings.serverFingerprint), sdoc["serverFingerprint"] | "");
   settings.port = sdoc["port"] | 443;
-  settings.protocol = sdoc["protocol"] | "REST";
+  loadString(settings.protocol, sizeof(settings.protocol), sdoc["protocol"] | "REST");
+  loadString(settings.encoding, sizeof(settings.encoding), sdoc["encoding"] | "JSON");
 
   // Station Location
   settings.longitude = sdoc["longitude"] | 0.0;
@@ -333,27 +680,146 @@ void loadSettings(Settings &settings)
   settings.altitude = sdoc["altitude"] | 0.0;
 
   // Time and NTP Server
-  settings.ntpServer = sdoc["ntpServer"] | "pool.ntp.org";
-  settings.timezoneStr = sdoc["timezoneStr"] | "UTC0";
+  loadString(settings.ntpServer, sizeof(settings.ntpServer), sdoc["ntpServer"] | "pool.ntp.org");
+  loadString(settings.timezoneStr, sizeof(settings.timezoneStr), sdoc["timezoneStr"] | "UTC0");
   settings.gmtOffset_sec = sdoc["gmtOffset_sec"] | 0;
 
   // Sample Frequency
   settings.sleepDuration = sdoc["sleepDuration"] | 10;
+  settings.samplesPerWake = sdoc["samplesPerWake"] | 1;
+  if (settings.samplesPerWake < 1)
+    settings.samplesPerWake = 1;
+  if (settings.samplesPerWake > SAMPLES_MAX)
+    settings.samplesPerWake = SAMPLES_MAX;
+  if (settings.sleepDuration < 1)
+    settings.sleepDuration = 1;
+
+  // Adaptive Sampling, a fixed interval without bounds
+  settings.sleepMin = sdoc["sleepMin"] | settings.sleepDuration;
+  settings.sleepMax = sdoc["sleepMax"] | settings.sleepDuration;
+  if (settings.sleepMin < 1)
+    settings.sleepMin = 1;
+  settings.adaptPressureRate = sdoc["adaptPressureRate"] | 1.0;
+  settings.adaptPMStep = sdoc["adaptPMStep"] | 10.0;
+  settings.batteryLow = sdoc["batteryLow"] | 3.6;
+  settings.batteryCritical = sdoc["batteryCritical"] | 3.4;
+
+  // Particle Sensor Stabilization
+  settings.pmsTolerance = sdoc["pmsTolerance"] | 10.0;
+  settings.pmsTimeout = sdoc["pmsTimeout"] | 30;
+
+  // SD Log Format
+  loadString(settings.logFormat, sizeof(settings.logFormat), sdoc["logFormat"] | "CSV");
+
+  // Upload Batching
+  settings.uploadInterval = sdoc["uploadInterval"] | 1;
+  settings.uploadThreshold = sdoc["uploadThreshold"] | 1;
+
+  // Wake Cycle Profile
+  settings.uploadProfile = sdoc["uploadProfile"] | false;
+
+  // Hourly and Daily Rollups
+  settings.uploadRollups = sdoc["uploadRollups"] | false;
 
   // Close file
   file.close();
+  return true;
+}
+
+/* True if the snapshot is complete and of this firmware's settings layout */
+bool validSettingsSnapshot(const SettingsSnapshot &snapshot)
+{
+  return snapshot.magic == SETTINGS_MAGIC && snapshot.version == SETTINGS_VERSION &&
+         snapshot.size == sizeof(Settings) &&
+         snapshot.crc == crc32((const uint8_t *)&snapshot, offsetof(SettingsSnapshot, crc));
+}
+
+/* Load Settings from the snapshot in RTC memory, or from SPIFFS after a power loss */
+bool loadSettingsSnapshot(Settings &settings)
+{
+  if (!validSettingsSnapshot(settingsSnapshot))
+  {
+    File file = board.flash().open(SETTINGS_SNAPSHOT_FILE, FILE_READ);
+    if (!file)
+    {
+      return false;
+    }
+    bool read = file.read((uint8_t *)&settingsSnapshot, sizeof(settingsSnapshot)) == sizeof(settingsSnapshot);
+    file.close();
+    if (!read || !validSettingsSnapshot(settingsSnapshot))
+    {
+      Serial.println("Settings snapshot invalid");
+      settingsSnapshot.magic = 0;
+      return false;
+    }
+  }
+  memcpy(&settings, &settingsSnapshot.settings, sizeof(Settings));
+  settings.samplesPerWake = max(1, min(SAMPLES_MAX, settings.samplesPerWake));
+  return true;
+}
+
+/* Save the snapshot to RTC memory and SPIFFS */
+void saveSettingsSnapshot(const Settings &settings)
+{
+  memset(&settingsSnapshot, 0, sizeof(settingsSnapshot));
+  settingsSnapshot.magic = SETTINGS_MAGIC;
+  settingsSnapshot.version = SETTINGS_VERSION;
+  settingsSnapshot.size = sizeof(Settings);
+  memcpy(&settingsSnapshot.settings, &settings, sizeof(Settings));
+  settingsSnapshot.crc = crc32((const uint8_t *)&settingsSnapshot, offsetof(SettingsSnapshot, crc));
+
+  File file = board.flash().open(SETTINGS_SNAPSHOT_FILE, FILE_WRITE);
+  if (!file || file.write((const uint8_t *)&settingsSnapshot, sizeof(settingsSnapshot)) != sizeof(settingsSnapshot))
+  {
+    Serial.println("Failed to save settings snapshot");
+  }
+  else
+  {
+    Serial.println("Settings snapshot saved");
+  }
+  file.close();
+}
+
+/* Load the upload high-water mark from SPIFFS */
+void loadUploadMark()
+{
+  File file = board.flash().open(UPLOAD_MARK_FILE, FILE_READ);
+  if (!file)
+  {
+    return;
+  }
+  if (file.read((uint8_t *)&upload_mark, sizeof(upload_mark)) == sizeof(upload_mark) && upload_mark > 0)
+  {
+    // Queued readings may have been lost with the RTC memory
+    Serial.println("Upload mark restored, checking SD card for backlog");
+    backlog_pending = true;
+  }
+  file.close();
+}
+
+/* Save the upload high-water mark to SPIFFS */
+void saveUploadMark()
+{
+  File file = board.flash().open(UPLOAD_MARK_FILE, FILE_WRITE);
+  if (file)
+  {
+    file.write((const uint8_t *)&upload_mark, sizeof(upload_mark));
+  }
+  file.close();
 }
 
 /* Save Settings from SD to SPIFFS */
 void saveSettings()
 {
 
-  // Clean up first
-  SPIFFS.remove(SETTINGS_FILE);
+  // Clean up first, the snapshot is made again from the new file
+  board.flash().remove(SETTINGS_FILE);
+  board.flash().remove(SETTINGS_SNAPSHOT_FILE);
+  settingsSnapshot.magic = 0;
 
   // File Locations
-  File src = SD.open(SETTINGS_FILE, FILE_READ);
-  File dst = SPIFFS.open(SETTINGS_FILE, FILE_WRITE);
+  File src = board.sd().open(SETTINGS_FILE, FILE_READ);
+  File dst = board.flash().open(SETTINGS_FILE, FILE_WRITE);
 
   // Test if both files are available
   if(!src || !dst) {
@@ -361,9 +827,12 @@ void saveSettings()
     return;
   }
 
-  // Copy file
-  while(src.available()){
-    dst.write(src.read());
+  // Copy file in blocks
+  uint8_t buffer[512];
+  size_t n;
+  while ((n = src.read(buffer, sizeof(buffer))) > 0)
+  {
+    dst.write(buffer, n);
   }
 
   // close both files
@@ -378,11 +847,11 @@ bool checkForUpdate()
 {
 
   // Check if update file exists
-  if (SD.exists(UPDATE_FILE))
+  if (board.sd().exists(UPDATE_FILE))
   {
 
     // Open the file for reading
-    File updateBin = SD.open(UPDATE_FILE);
+    File updateBin = board.sd().open(UPDATE_FILE);
 
     // Check file size
     if (updateBin.size() > UPDATE_SIZE)
@@ -397,7 +866,7 @@ bool checkForUpdate()
 
       // Update file too small, remove file
       updateBin.close();
-      SD.remove(UPDATE_FILE);
+      board.sd().remove(UPDATE_FILE);
       Serial.println("Invalid update file");
       return false;
     }
@@ -411,22 +880,22 @@ void startUpdate()
 {
 
   // Open firmware file from SD card
-  File updateBin = SD.open(UPDATE_FILE);
+  File updateBin = board.sd().open(UPDATE_FILE);
 
   // Start update process
   Serial.println("Starting update");
-  Update.begin();
+  board.beginUpdate();
 
   // Feed the data to the update class
   uint8_t buf[128];
   size_t len;
   while ((len = updateBin.read(buf, sizeof(buf))) > 0)
   {
-    Update.write(buf, len);
+    board.writeUpdate(buf, len);
   }
 
   // Finalize the update
-  if (Update.end())
+  if (board.endUpdate())
   {
     Serial.println("Update Success!");
   }
@@ -439,338 +908,946 @@ void startUpdate()
   updateBin.close();
 }
 
-/* Get Sensor Data */
-void GetSensorData(JsonDocument &data)
+/* Channels that are sub-sampled in a wake */
+enum SampleChannel
+{
+  CH_TEMPERATURE,
+  CH_HUMIDITY,
+  CH_PRESSURE,
+  CH_AIR,
+  CH_VISIBLE,
+  CH_IR,
+  CH_UV,
+  CH_PM1_0,
+  CH_PM2_5,
+  CH_PM10_0,
+  CH_GT0_3,
+  CH_GT0_5,
+  CH_GT1_0,
+  CH_GT2_5,
+  CH_GT5_0,
+  CH_GT10_0,
+  CH_BATTERY,
+  CHANNEL_COUNT
+};
+
+static const char *const CHANNEL_NAMES[CHANNEL_COUNT] = {
+    "temperature", "humidity", "pressure", "air", "visible", "ir", "uv", "pm1.0", "pm2.5",
+    "pm10.0", ">0.3", ">0.5", ">1.0", ">2.5", ">5.0", ">10.0", "battery"};
+
+/* Median of a count channel, rounded, 0 without samples */
+static uint16_t medianCount(const StreamingStats &stats)
+{
+  return stats.count() > 0 ? (uint16_t)round(stats.median()) : 0;
+}
+
+/* Get Sensor Data, the particle channels only if the sensor sent frames */
+void GetSensorData(SensorRecord &record, ParticleStatus particles)
 {
-  if (!bme.performReading())
+  uint32_t startAcquisition = micros();
+
+  /* Sub-samples are aggregated as they come, median as the value */
+  StreamingStats stats[CHANNEL_COUNT];
+  int samples = max(1, min(SAMPLES_MAX, settings.samplesPerWake));
+
+  for (int sample = 0; sample < samples; sample++)
   {
-    Serial.println("Error: BME680 failed reading.");
-    return;
+    /* Start the BME680 conversion (oversampling and gas heater) */
+    bool bmeStarted = bme.beginReading();
+    if (!bmeStarted)
+    {
+      Serial.println("Error: BME680 failed reading.");
+    }
+
+    /* Collect light and particle channels meanwhile, every register once */
+    stats[CH_VISIBLE].add(uv.readVisible());
+    stats[CH_IR].add(uv.readIR());
+    stats[CH_UV].add(uv.readUV());
+
+    /* Latest frame, WaitForSensors() decided it can be used. Further
+       sub-samples use the next frames, the sensor sends about one per second */
+    if (particles != PARTICLE_NO_DATA && (sample == 0 || pms7003.waitForFrame(1000)))
+    {
+      const ParticleReading &pm = pms7003.reading();
+
+      if (pm.errorCode > 0)
+      {
+        Serial.println("Sensor: " + String(pm.hwVersion));
+        Serial.println("Error: " + String(pm.errorCode));
+      }
+
+      stats[CH_PM1_0].add(pm.pm1_0);
+      stats[CH_PM2_5].add(pm.pm2_5);
+      stats[CH_PM10_0].add(pm.pm10_0);
+
+      stats[CH_GT0_3].add(pm.gt0_3);
+      stats[CH_GT0_5].add(pm.gt0_5);
+      stats[CH_GT1_0].add(pm.gt1_0);
+      stats[CH_GT2_5].add(pm.gt2_5);
+      stats[CH_GT5_0].add(pm.gt5_0);
+      stats[CH_GT10_0].add(pm.gt10_0);
+    }
+
+    stats[CH_BATTERY].add(board.readBatteryVoltage());
+
+    /* Gather the BME680 results */
+    EnvironmentReading env;
+    if (bmeStarted && !bme.endReading(env))
+    {
+      Serial.println("Error: BME680 failed reading.");
+      bmeStarted = false;
+    }
+
+    if (bmeStarted)
+    {
+      stats[CH_TEMPERATURE].add(env.temperature);
+      stats[CH_HUMIDITY].add(env.humidity);
+      stats[CH_PRESSURE].add(env.pressure / 100.0);
+      stats[CH_AIR].add(env.gas_resistance / 1000.0);
+    }
   }
 
-  while (!pms7003.hasNewData() || pms7003.getRawGreaterThan_0_3() == 0)
+  record.samples = samples;
+
+  record.visible = medianCount(stats[CH_VISIBLE]);
+  record.ir = medianCount(stats[CH_IR]);
+  record.uv = medianCount(stats[CH_UV]);
+  record.uvIndex = (int)round(record.uv / 100.0);
+
+  record.pm1_0 = medianCount(stats[CH_PM1_0]);
+  record.pm2_5 = medianCount(stats[CH_PM2_5]);
+  record.pm10_0 = medianCount(stats[CH_PM10_0]);
+  record.pm2_5SD = stats[CH_PM2_5].stddev();
+  record.pm10_0SD = stats[CH_PM10_0].stddev();
+
+  record.gt0_3 = medianCount(stats[CH_GT0_3]);
+  record.gt0_5 = medianCount(stats[CH_GT0_5]);
+  record.gt1_0 = medianCount(stats[CH_GT1_0]);
+  record.gt2_5 = medianCount(stats[CH_GT2_5]);
+  record.gt5_0 = medianCount(stats[CH_GT5_0]);
+  record.gt10_0 = medianCount(stats[CH_GT10_0]);
+
+  /* Without a frame the particle channels stay 0, which is not a reading */
+  record.particleStatus = stats[CH_PM2_5].count() > 0 ? particles : PARTICLE_NO_DATA;
+  if (record.particleStatus == PARTICLE_NO_DATA)
   {
-    pms7003.updateFrame();
+    record.aqi = -1;
+    record.pm2_5SD = NAN;
+    record.pm10_0SD = NAN;
   }
-
-  if (pms7003.getErrorCode() > 0)
+  else
   {
-    Serial.println("Sensor: " + String(pms7003.getHWVersion()));
-    Serial.println("Error: " + String(pms7003.getHWVersion()));
+    record.aqi = airQualityIndex<float>(record.pm2_5, record.pm10_0);
   }
 
-  data["data"][TEMPERATURE] = bme.temperature;
-  data["data"][REL_HUMIDITY] = bme.humidity;
-  data["data"][PRESSURE] = bme.pressure / 100.0;
-  data["data"][PRESSURE_PMSL] = (bme.pressure / 100.0) / pow(1.0 - (settings.altitude / 44330.0), 5.255);
-  data["data"][AIR] = bme.gas_resistance / 1000.0;
-
-  data["data"][LIGHT_VISIBLE] = uv.readVisible();
-  data["data"][LIGHT_IR] = uv.readIR();
-  data["data"][LIGHT_UV] = uv.readUV();
-  data["data"][UV_INDEX] = (int)round(uv.readUV() / 100.0);
+  record.battery = stats[CH_BATTERY].median();
 
-  data["data"][PM_ENV_1] = pms7003.getPM_1_0();
-  data["data"][PM_ENV_25] = pms7003.getPM_2_5();
-  data["data"][PM_ENV_100] = pms7003.getPM_10_0();
-
-  data["data"][PARTICLE_SIZE_3] = pms7003.getRawGreaterThan_0_3();
-  data["data"][PARTICLE_SIZE_5] = pms7003.getRawGreaterThan_0_5();
-  data["data"][PARTICLE_SIZE_10] = pms7003.getRawGreaterThan_1_0();
-  data["data"][PARTICLE_SIZE_25] = pms7003.getRawGreaterThan_2_5();
-  data["data"][PARTICLE_SIZE_50] = pms7003.getRawGreaterThan_5_0();
-  data["data"][PARTICLE_SIZE_100] = pms7003.getRawGreaterThan_10_0();
+  /* Derived values from the aggregates, with the single precision kernels */
+  if (stats[CH_TEMPERATURE].count() > 0)
+  {
+    record.temperature = stats[CH_TEMPERATURE].median();
+    record.humidity = stats[CH_HUMIDITY].median();
+    record.pressure = stats[CH_PRESSURE].median();
+    record.pressurePMSL = pressureMSL<float>(record.pressure, settings.altitude);
+    record.air = stats[CH_AIR].median();
+
+    record.heatIndex = heatIndex(record.temperature, record.humidity);
+    record.dewPoint = dewPoint(record.temperature, record.humidity);
+
+    record.temperatureSD = stats[CH_TEMPERATURE].stddev();
+    record.humiditySD = stats[CH_HUMIDITY].stddev();
+    record.pressureSD = stats[CH_PRESSURE].stddev();
+    record.airSD = stats[CH_AIR].stddev();
+  }
 
-  data["data"][HEAT_INDEX] = heatIndex(bme.temperature, bme.humidity);
-  data["data"][DEW_POINT] = dewPoint(bme.temperature, bme.humidity);
-  data["data"][AQI] = calculateAQI(data["data"][PM_ENV_25].as<int>(), (float)data["data"][PM_ENV_100].as<int>());
+  if (samples > 1)
+  {
+    Serial.printf("Sub-samples: %d\n", samples);
+    Serial.printf("%-12s %3s %10s %10s %10s %10s %10s\n", "", "n", "min", "mean", "median", "max", "sd");
+    for (int i = 0; i < CHANNEL_COUNT; i++)
+    {
+      Serial.printf("%-12s %3u %10.3f %10.3f %10.3f %10.3f %10.3f\n", CHANNEL_NAMES[i],
+                    (unsigned)stats[i].count(), stats[i].min(), stats[i].mean(), stats[i].median(),
+                    stats[i].max(), stats[i].stddev());
+    }
+  }
 
-  digitalWrite(BATT_PIN, HIGH);
-  data["data"][BATTERY] = ((float)analogRead(ADC_PIN) / 4095) * 2 * 3.3 * 1.1; // 7.26;
-  digitalWrite(BATT_PIN, LOW);
+  Serial.printf("Sensor acquisition: %lu us\n", (unsigned long)(micros() - startAcquisition));
 }
 
 /* Log Data on serial */
-void LogDataToSerial(JsonDocument &data)
-{
-
-  Serial.println("");
-  Serial.println("---------------------------------------");
-
-  Serial.print(F("Temperature [ *C]: "));
-  Serial.println(data["data"][TEMPERATURE].as<float>());
-  Serial.print(F("rel. Humidity [%]: "));
-  Serial.println(data["data"][REL_HUMIDITY].as<float>());
-  Serial.print(F("Pressure [hPa]: "));
-  Serial.println(data["data"][PRESSURE].as<float>());
-  Serial.print(F("Pressure (PMSL) [hPa]: "));
-  Serial.println(data["data"][PRESSURE_PMSL].as<float>());
-  Serial.print(F("Gas [KOhms]: "));
-  Serial.println(data["data"][AIR].as<float>());
-  Serial.print(F("Heat Index [ *C]: "));
-  Serial.println(data["data"][HEAT_INDEX].as<float>());
-  Serial.print(F("Dew Point [ *C]: "));
-  Serial.println(data["data"][DEW_POINT].as<float>());
-
-  Serial.println("---------------------------------------");
-
-  Serial.print("PM 1.0: ");
-  Serial.println(data["data"][PM_ENV_1].as<int>());
-  Serial.print("PM 2.5: ");
-  Serial.println(data["data"][PM_ENV_25].as<int>());
-  Serial.print("PM 10: ");
-  Serial.println(data["data"][PM_ENV_100].as<int>());
-
-  Serial.println("---------------------------------------");
-
-  Serial.print(">0.3 um/0.1L: ");
-  Serial.println(data["data"][PARTICLE_SIZE_3].as<int>());
-  Serial.print(">0.5 um/0.1L: ");
-  Serial.println(data["data"][PARTICLE_SIZE_5].as<int>());
-  Serial.print(">1.0 um/0.1L: ");
-  Serial.println(data["data"][PARTICLE_SIZE_10].as<int>());
-  Serial.print(">2.5 um/0.1L: ");
-  Serial.println(data["data"][PARTICLE_SIZE_25].as<int>());
-  Serial.print(">5.0 um/0.1L: ");
-  Serial.println(data["data"][PARTICLE_SIZE_50].as<int>());
-  Serial.print(">10.0 um/0.1L: ");
-  Serial.println(data["data"][PARTICLE_SIZE_100].as<int>());
-  Serial.print("AQI: ");
-  Serial.println(data["data"][AQI].as<float>());
-
-  Serial.println("---------------------------------------");
-
-  Serial.print("Visible Intensity: ");
-  Serial.println(data["data"][LIGHT_VISIBLE].as<float>());
-  Serial.print("IR Intensity: ");
-  Serial.println(data["data"][LIGHT_IR].as<float>());
-  Serial.print("UV Intensity: ");
-  Serial.println(data["data"][LIGHT_UV].as<float>());
-  Serial.print("UV-Index: ");
-  Serial.println(data["data"][UV_INDEX].as<float>());
-
-  Serial.println("---------------------------------------");
-
-  Serial.print(F("Battery [V]: "));
-  Serial.println(data["data"][BATTERY].as<float>());
+void LogDataToSerial(SensorRecord &record)
+{
+  printRecord(Serial, record);
 }
 
 /* Write Data to SD */
-void WriteDataToSD(JsonDocument &data)
+void WriteDataToSD(SensorRecord &record)
 {
 
   DateTime now = rtc.now();
-  File dataFile;
+
+  /* Daily CSV file */
+  if (strcmp(settings.logFormat, "BINARY") != 0)
+  {
+    WriteCSVToSD(now, record);
+  }
+
+  /* Daily binary log */
+  if (strcmp(settings.logFormat, "CSV") != 0)
+  {
+    WriteBinaryToSD(now, record);
+  }
+}
+
+/* Check if a daily file needs to be started and create its directories */
+bool NewDailyFile(DateTime &now, char *path)
+{
 
   /* Define file structure */
   char buf1[] = "/YYYY";
   char buf2[] = "/YYYY/MM";
-  char buf3[] = "/YYYY/MM/YYYY-MM-DD.csv";
+
+  /* Directories only need to be checked when a new file is started */
+  if (board.sd().exists(now.toString(path)))
+  {
+    return false;
+  }
 
   /* Check/Create year direcory */
-  if (!SD.exists(now.toString(buf1)))
+  if (!board.sd().exists(now.toString(buf1)))
   {
-    SD.mkdir(now.toString(buf1));
+    board.sd().mkdir(now.toString(buf1));
   }
 
   /* Check/Create month direcory */
-  if (!SD.exists(now.toString(buf2)))
-  {
-    SD.mkdir(now.toString(buf2));
-  }
-
-  if (!SD.exists(now.toString(buf3)))
-  {
-    dataFile = SD.open(now.toString(buf3), FILE_WRITE);
-
-    /* File Header Row */
-    dataFile.print("\"Time [Local]\",");
-    dataFile.print(String("\"") + String(TEMPERATURE) + String("\","));
-    dataFile.print(String("\"") + String(REL_HUMIDITY) + String("\","));
-    dataFile.print(String("\"") + String(PRESSURE) + String("\","));
-    dataFile.print(String("\"") + String(PRESSURE_PMSL) + String("\","));
-    dataFile.print(String("\"") + String(AIR) + String("\","));
-    dataFile.print(String("\"") + String(HEAT_INDEX) + String("\","));
-    dataFile.print(String("\"") + String(DEW_POINT) + String("\","));
-    dataFile.print(String("\"") + String(PM_ENV_1) + String("\","));
-    dataFile.print(String("\"") + String(PM_ENV_25) + String("\","));
-    dataFile.print(String("\"") + String(PM_ENV_100) + String("\","));
-    dataFile.print(String("\"") + String(PARTICLE_SIZE_3) + String("\","));
-    dataFile.print(String("\"") + String(PARTICLE_SIZE_5) + String("\","));
-    dataFile.print(String("\"") + String(PARTICLE_SIZE_10) + String("\","));
-    dataFile.print(String("\"") + String(PARTICLE_SIZE_25) + String("\","));
-    dataFile.print(String("\"") + String(PARTICLE_SIZE_50) + String("\","));
-    dataFile.print(String("\"") + String(PARTICLE_SIZE_100) + String("\","));
-    dataFile.print(String("\"") + String(AQI) + String("\","));
-    dataFile.print(String("\"") + String(LIGHT_VISIBLE) + String("\","));
-    dataFile.print(String("\"") + String(LIGHT_IR) + String("\","));
-    dataFile.print(String("\"") + String(LIGHT_UV) + String("\","));
-    dataFile.print(String("\"") + String(UV_INDEX) + String("\","));
-    dataFile.print(String("\"") + String(BATTERY) + String("\""));
-    dataFile.println();
+  if (!board.sd().exists(now.toString(buf2)))
+  {
+    board.sd().mkdir(now.toString(buf2));
+  }
+  return true;
+}
+
+/* Append a row to the daily CSV file */
+void WriteCSVToSD(DateTime &now, SensorRecord &record)
+{
+
+  File dataFile;
+  char path[] = "/YYYY/MM/YYYY-MM-DD.csv";
+
+  /* Header row and data row are committed with a single write, the buffer
+     is static to keep it off the stack of the wake */
+  static char line[CSV_BUFFER_SIZE];
+  size_t headerLen = formatCSVHeader(line, sizeof(line));
+  uint32_t headerCRC = crc32((const uint8_t *)line, headerLen);
+  uint32_t day = now.unixtime() / 86400;
+  size_t len = 0;
+
+  /* File Header Row, for a new file or when the columns of the file are
+     others, e.g. before a firmware update. The file is only checked once a
+     day or after the RTC memory was lost. */
+  if (NewDailyFile(now, path))
+  {
+    len = headerLen;
+  }
+  else if (csv_schema_day != day || csv_schema_crc != headerCRC)
+  {
+    static char last[CSV_BUFFER_SIZE];
+    dataFile = board.sd().open(path, FILE_READ);
+    size_t lastLen = dataFile ? csvLastHeader(dataFile, last, sizeof(last)) : 0;
     dataFile.close();
+    if (lastLen != headerLen - 2 || memcmp(last, line, lastLen) != 0) // without the line break
+    {
+      Serial.println("CSV columns changed, appending a new header row");
+      len = headerLen;
+    }
   }
 
-  dataFile = SD.open(now.toString(buf3), FILE_APPEND);
-
-  if (dataFile)
-  {
-    /* Add Data as a Row */
-    dataFile.print(String(data["data"]["created_at"].as<const char *>()) + String(","));
-    dataFile.print(String(data["data"][TEMPERATURE].as<float>()) + String(","));
-    dataFile.print(String(data["data"][REL_HUMIDITY].as<float>()) + String(","));
-    dataFile.print(String(data["data"][PRESSURE].as<float>()) + String(","));
-    dataFile.print(String(data["data"][PRESSURE_PMSL].as<float>()) + String(","));
-    dataFile.print(String(data["data"][AIR].as<float>()) + String(","));
-    dataFile.print(String(data["data"][HEAT_INDEX].as<float>()) + String(","));
-    dataFile.print(String(data["data"][DEW_POINT].as<float>()) + String(","));
-    dataFile.print(String(data["data"][PM_ENV_1].as<int>()) + String(","));
-    dataFile.print(String(data["data"][PM_ENV_25].as<int>()) + String(","));
-    dataFile.print(String(data["data"][PM_ENV_100].as<int>()) + String(","));
-    dataFile.print(String(data["data"][PARTICLE_SIZE_3].as<int>()) + String(","));
-    dataFile.print(String(data["data"][PARTICLE_SIZE_5].as<int>()) + String(","));
-    dataFile.print(String(data["data"][PARTICLE_SIZE_10].as<int>()) + String(","));
-    dataFile.print(String(data["data"][PARTICLE_SIZE_25].as<int>()) + String(","));
-    dataFile.print(String(data["data"][PARTICLE_SIZE_50].as<int>()) + String(","));
-    dataFile.print(String(data["data"][PARTICLE_SIZE_100].as<int>()) + String(","));
-    dataFile.print(String(data["data"][AQI].as<float>()) + String(","));
-    dataFile.print(String(data["data"][LIGHT_VISIBLE].as<float>()) + String(","));
-    dataFile.print(String(data["data"][LIGHT_IR].as<float>()) + String(","));
-    dataFile.print(String(data["data"][LIGHT_UV].as<float>()) + String(","));
-    dataFile.print(String(data["data"][UV_INDEX].as<float>()) + String(","));
-    dataFile.print(String(data["data"][BATTERY].as<float>()));
-    dataFile.println();
+  /* Add Data as a Row */
+  size_t rowLen = formatCSVRow(line + len, sizeof(line) - len, record);
+  if (rowLen == 0)
+  {
+    // Every value has a text form, only the space can run out
+    Serial.printf("Error: CSV row does not fit into the %d bytes left in the buffer\n", (int)(sizeof(line) - len));
+    return;
+  }
+  len += rowLen;
+
+  dataFile = board.sd().open(path, FILE_APPEND);
+
+  if (dataFile && dataFile.write((const uint8_t *)line, len) == len)
+  {
+    csv_schema_day = day;
+    csv_schema_crc = headerCRC;
   }
   dataFile.close();
 }
 
-/* Submit Data via Wifi */
-void SubmitSensorData(JsonDocument &data)
+/* Append a block to the daily binary log */
+void WriteBinaryToSD(DateTime &now, SensorRecord &record)
 {
 
-  int WiFiTimeoutCounter = 0;
+  File dataFile;
+  char path[] = "/YYYY/MM/YYYY-MM-DD.bin";
+
+  /* File header and block are committed with a single write */
+  static uint8_t buffer[BINLOG_HEADER_MAX + BINLOG_BLOCK_HEADER_SIZE + sizeof(SensorRecord)];
+  size_t headerLen = binlogHeader(buffer, sizeof(buffer));
+  uint32_t headerCRC = crc32(buffer, headerLen);
+  uint32_t day = now.unixtime() / 86400;
+  size_t len = 0;
+
+  /* File Header with Schema, for a new file or when the file was written
+     with another schema, e.g. before a firmware update. The file is only
+     checked once a day or after the RTC memory was lost. */
+  if (NewDailyFile(now, path))
+  {
+    len = headerLen;
+  }
+  else if (binlog_schema_day != day || binlog_schema_crc != headerCRC)
+  {
+    static uint8_t last[BINLOG_HEADER_MAX];
+    dataFile = board.sd().open(path, FILE_READ);
+    size_t lastLen = dataFile ? binlogLastHeader(dataFile, last, sizeof(last)) : 0;
+    dataFile.close();
+    if (lastLen != headerLen || memcmp(last, buffer, headerLen) != 0)
+    {
+      Serial.println("Binary log schema changed, appending a new header");
+      len = headerLen;
+    }
+  }
 
-  /* Start up WiFi */
-  WiFi.begin(settings.ssid.c_str(), settings.password.c_str());
-  Serial.print("Connecting ");
-  WiFiTimeoutCounter = 0;
-  while (WiFi.status() != WL_CONNECTED)
+  /* Add Data as a Block */
+  size_t blockLen = binlogBlock(buffer + len, sizeof(buffer) - len, &record, 1);
+  if (blockLen == 0)
+  {
+    Serial.println("Error: Binary log block does not fit into buffer");
+    return;
+  }
+  len += blockLen;
+
+  dataFile = board.sd().open(path, FILE_APPEND);
+
+  if (dataFile && dataFile.write(buffer, len) == len)
+  {
+    binlog_schema_day = day;
+    binlog_schema_crc = headerCRC;
+  }
+  dataFile.close();
+}
+
+/* Wait until the particle sensor readings are stable or the timeout passed */
+ParticleStatus WaitForSensors(uint32_t warmupStart)
+{
+  uint32_t timeout = settings.pmsTimeout * 1000;
+  uint32_t elapsed = millis() - warmupStart;
+
+  /* Frames are only observed from now on, leave time to see a few */
+  if (timeout < elapsed + PARTICLE_MIN_OBSERVATION)
   {
-    delay(500);
-    Serial.print(".");
-    WiFiTimeoutCounter++;
-    if (WiFiTimeoutCounter >= 60)
-    { // after 30 seconds timeout - reset board
-      ESP.restart();
+    timeout = elapsed + PARTICLE_MIN_OBSERVATION;
+  }
+
+  ParticleStabilizer stabilizer(settings.pmsTolerance, timeout);
+  ParticleStatus status;
+  while ((status = stabilizer.status(millis() - warmupStart)) == PARTICLE_WARMING_UP)
+  {
+    if (pms7003.waitForFrame(1000))
+    {
+      stabilizer.addFrame(pms7003.reading());
     }
   }
+
+  elapsed = millis() - warmupStart;
+  if (status == PARTICLE_STABLE)
+  {
+    Serial.printf("Particle sensor stable after %d ms\n", (int)elapsed);
+  }
+  else
+  {
+    Serial.printf("Error: Particle sensor %s after %d ms (code %d, %d frames)\n",
+                  particleStatusToString(status), (int)elapsed, status, stabilizer.frames());
+  }
+  return status;
+}
+
+/* Upload every n wakes or when enough data is queued, less often after
+   failed uploads */
+bool UploadDue()
+{
+  int backoff = upload_failures < UPLOAD_BACKOFF_MAX ? upload_failures : UPLOAD_BACKOFF_MAX;
+  return upload_wakes >= (settings.uploadInterval << backoff) ||
+         (upload_failures == 0 && (int)queueSize() + 1 >= settings.uploadThreshold);
+}
+
+/* Connect to WiFi and sync the RTC if needed, returns false on timeout */
+bool ConnectNetwork()
+{
+
+  /* Start up WiFi */
+  profileStart(PHASE_WIFI_ASSOCIATE);
+  network.begin(settings.ssid, settings.password, settings.wifiStaticIP);
+  network.setFingerprint(settings.serverFingerprint);
+  Serial.println("Connecting");
+  if (!network.waitConnected(WIFI_TIMEOUT))
+  { // keep data queued and go back to sleep
+    Serial.println("WiFi connection failed, data stays queued");
+    profileEnd(PHASE_WIFI_ASSOCIATE);
+    return false;
+  }
+  profileEnd(PHASE_WIFI_ASSOCIATE);
   Serial.println("Connected to WiFi network with IP Address: ");
-  Serial.println(WiFi.localIP());
+  Serial.println(network.localIP());
 
   /* Update RTC using an NTP Server */
   if (ntp_update)
   {
 
     Serial.println("Start NTP Server Update");
-    configTime(0, 0, settings.ntpServer.c_str());
-    delay(2000);
+    struct tm timeinfo;
+    profileStart(PHASE_NTP);
+    network.syncTime(settings.ntpServer, settings.timezoneStr, timeinfo);
+    profileEnd(PHASE_NTP);
 
     Serial.println("Updated Time from ESP");
 
-    setenv("TZ", settings.timezoneStr.c_str(), 1);
-    tzset();
-
-    time_t ESPnow = time(nullptr);
-    Serial.println(ctime(&ESPnow));
-
-    struct tm *timeinfo;
-    time(&ESPnow);
-    timeinfo = localtime(&ESPnow);
-
-    Serial.println(timeinfo->tm_isdst);
+    Serial.println(timeinfo.tm_isdst);
 
     Serial.println("Updated Time from RTC");
-    rtc.adjust(DateTime((timeinfo->tm_year + 1900), timeinfo->tm_mon + 1, timeinfo->tm_mday, timeinfo->tm_hour, timeinfo->tm_min, timeinfo->tm_sec));
+    rtc.adjust(DateTime((timeinfo.tm_year + 1900), timeinfo.tm_mon + 1, timeinfo.tm_mday, timeinfo.tm_hour, timeinfo.tm_min, timeinfo.tm_sec));
     ntp_update = false;
   }
+  return true;
+}
+
+/* Submit queued Data, returns false if an upload failed */
+bool UploadQueue()
+{
+
+  bool success = true;
 
   /* POST data to a IoT platform */
-  if (WiFi.status() == WL_CONNECTED)
+  if (network.connected())
   {
 
-    if (strcmp(settings.protocol.c_str(), "REST") == 0)
+    if (strcmp(settings.protocol, "REST") == 0)
     {
-      byte attempts = 0;       // Count submission attempts
-      WiFiClientSecure client; // wifi client object
+      static SensorRecord batch[UPLOAD_BATCH_MAX];
+      size_t count;
+
+      /* Readings missing from the queue come first, from the SD card */
+      if (backlog_pending)
+      {
+        success = ReplayBacklog();
+      }
 
-      while (attempts < 2)
+      /* Send the queue oldest first, one batch per request */
+      while (!backlog_pending && (count = queuePeek(board.flash(), batch, UPLOAD_BATCH_MAX)) > 0)
       {
-        Serial.print("Attempt to send: ");
-        Serial.println(attempts);
-        if( HttpsPOSTRequest(client, data) )
+        /* Keep the readings queued for the next upload */
+        if (!UploadBatch(batch, count))
         {
+          success = false;
           break;
         }
-        attempts++;
+        queuePop(board.flash(), count);
       }
     }
-    if (strcmp(settings.protocol.c_str(), "MQTT") == 0)
+    if (strcmp(settings.protocol, "MQTT") == 0)
     {
-      // Add Code to use the MQTT protocol
+      if (!mqtt.connected() && !MQTTConnect())
+      {
+        success = false;
+      }
+      else
+      {
+        /* Readings missing from the queue come first, from the SD card */
+        if (backlog_pending)
+        {
+          success = ReplayBacklog();
+        }
+
+        /* Send the queue oldest first, pipelined */
+        if (!backlog_pending)
+        {
+          success = MQTTUploadQueue() && success;
+        }
+      }
     }
   }
   else
+  {
     Serial.println("WiFi Disconnected");
+    success = false;
+  }
+  return success;
+}
+
+/* Send a batch of readings, retry once */
+bool UploadBatch(const SensorRecord *records, size_t count)
+{
+  byte attempts = 0; // Count submission attempts
+
+  while (attempts < 2)
+  {
+    Serial.print("Attempt to send: ");
+    Serial.println(attempts);
+    bool sent = strcmp(settings.protocol, "MQTT") == 0 ? MQTTPublishBatch(records, count)
+                                                               : HttpsPOSTRequest(records, count);
+    if (sent)
+    {
+      if (records[count - 1].timestamp > upload_mark)
+      {
+        upload_mark = records[count - 1].timestamp;
+      }
+      return true;
+    }
+    attempts++;
+  }
+  return false;
+}
+
+/* Upload logged readings newer than the upload mark and older than the
+   queue, returns false if an upload failed */
+bool ReplayBacklog()
+{
+  static SensorRecord batch[UPLOAD_BATCH_MAX];
+  static BacklogCursor cursor = {};
+  uint32_t start = millis() - backlogTime;
+
+  /* Binary logs are read when available, they are faster to parse */
+  bool binary = strcmp(settings.logFormat, "CSV") != 0;
+
+  /* Everything from the oldest queued reading on is still in the queue */
+  SensorRecord oldest;
+  uint32_t before = queuePeek(board.flash(), &oldest, 1) > 0 ? oldest.timestamp : rtc.now().unixtime();
+
+  while (millis() - start < BACKLOG_TIME_BUDGET)
+  {
+    size_t count = backlogRead(board.sd(), binary, upload_mark, before, batch, UPLOAD_BATCH_MAX, &cursor);
+    if (count == 0)
+    {
+      Serial.println("Backlog uploaded");
+      backlog_pending = false;
+      return true;
+    }
+
+    Serial.printf("Backlog: sending %d readings\n", (int)count);
+    bool sent = UploadBatch(batch, count);
+    backlogTime = millis() - start;
+    if (!sent)
+    {
+      return false;
+    }
+  }
 
-  /* Turn WiFi off */
-  WiFi.disconnect();
-  WiFi.mode(WIFI_OFF);
+  Serial.println("Backlog time budget used up, continuing next upload");
+  return true;
 }
 
 /* HTTPS POST Request */
-bool HttpsPOSTRequest(WiFiClient &client, JsonDocument &data)
+bool HttpsPOSTRequest(const SensorRecord *records, size_t count)
 {
 
   Serial.print("connect: ");
   Serial.println(settings.server);
 
-  client.stop();
-  HTTPClient http;
-
-  http.begin(settings.server);
-  http.addHeader("Content-Type", "application/json; charset=utf-8");
+  UploadPayload requestBody(count);
+  requestBody.set(records, count, true);
 
-  String requestBody;
-  serializeJson(data, requestBody);
-
-  int httpCode = http.POST(requestBody);
+  String response;
+  profileStart(PHASE_POST);
+  int httpCode = network.post(settings.server, requestBody.contentType(), requestBody, response);
+  profileEnd(PHASE_POST);
   Serial.print("Request Code: ");
   Serial.println(httpCode);
-  if (httpCode == HTTP_CODE_OK)
+  if (httpCode == 200)
   {
-    Serial.println(http.getString());
-    client.stop();
-    http.end();
+    Serial.println(response);
     return true;
   }
   else
   {
-    Serial.printf("connection failed, error: %s", http.errorToString(httpCode).c_str());
+    Serial.printf("connection failed, error: %s", network.errorToString(httpCode).c_str());
     Serial.println();
-    client.stop();
-    http.end();
     return false;
   }
-  http.end();
+}
+
+/* Document size for a payload of count readings */
+size_t PayloadCapacity(size_t count)
+{
+  return 256 + count * (JSON_OBJECT_SIZE(RECORD_FIELD_COUNT + 2) + 64) +
+         (settings.uploadProfile ? PHASE_COUNT * JSON_OBJECT_SIZE(5) + JSON_OBJECT_SIZE(PHASE_COUNT) : 0);
+}
+
+/* JSON payload, a single reading is sent as object, a batch as array.
+   The token is left out for MQTT, which authenticates the connection */
+void BuildPayload(const SensorRecord *records, size_t count, bool token, JsonDocument &data)
+{
+  data.clear();
+  if (token)
+  {
+    data["token"] = settings.apikey;
+  }
+
+  /* Wake cycle statistics of the device */
+  if (settings.uploadProfile)
+  {
+    profileToJson(data.createNestedObject("profile"));
+  }
+  if (count == 1)
+  {
+    recordToJson(records[0], data.createNestedObject("data"));
+    data["data"]["device_id"] = ChipIDStr;
+  }
+  else
+  {
+    JsonArray batch = data.createNestedArray("data");
+    for (size_t i = 0; i < count; i++)
+    {
+      JsonObject reading = batch.createNestedObject();
+      recordToJson(records[i], reading);
+      reading["device_id"] = ChipIDStr;
+    }
+  }
+}
+
+/* MessagePack payload (schema RECORD_SCHEMA_VERSION): a map with the keys
+   0 schema version, 1 device ID, 2 token (left out for MQTT), 3 array of
+   readings (maps from field ID to value, see RECORD_FIELDS),
+   4 wake cycle statistics (optional, same keys as in JSON) and 5 the
+   readings as columnar batch (byte array, instead of 3 for batches) */
+void BuildMsgPack(const SensorRecord *records, size_t count, bool token, bool columnar, Print &out)
+{
+  MsgPackWriter msgpack(out);
+  msgpack.map(3 + (token ? 1 : 0) + (settings.uploadProfile ? 1 : 0));
+  msgpack.integer(0);
+  msgpack.integer(RECORD_SCHEMA_VERSION);
+  msgpack.integer(1);
+  msgpack.string(ChipIDStr);
+  if (token)
+  {
+    msgpack.integer(2);
+    msgpack.string(settings.apikey);
+  }
+  if (columnar && count > 1)
+  {
+    MeasurePrint batch;
+    columnarEncode(records, count, batch);
+    msgpack.integer(5);
+    msgpack.binary(batch.bytes);
+    columnarEncode(records, count, out);
+  }
+  else
+  {
+    msgpack.integer(3);
+    msgpack.array(count);
+    for (size_t i = 0; i < count; i++)
+    {
+      recordToMsgPack(records[i], msgpack);
+    }
+  }
+
+  if (settings.uploadProfile)
+  {
+    DynamicJsonDocument profile(PHASE_COUNT * JSON_OBJECT_SIZE(5) + JSON_OBJECT_SIZE(PHASE_COUNT + 1));
+    profileToJson(profile.to<JsonObject>());
+    msgpack.integer(4);
+    serializeMsgPack(profile, out);
+  }
+}
+
+/* Connect to the MQTT broker and resume the session of the station */
+bool MQTTConnect()
+{
+  /* The server is the broker's host name, optionally with mqtt:// or mqtts:// */
+  const char *host = settings.server;
+  bool secure = settings.port != 1883;
+  if (strncmp(host, "mqtts://", 8) == 0)
+  {
+    host += 8;
+    secure = true;
+  }
+  else if (strncmp(host, "mqtt://", 7) == 0)
+  {
+    host += 7;
+    secure = false;
+  }
+
+  char clientId[32];
+  snprintf(clientId, sizeof(clientId), "weatherstation-%s", ChipIDStr);
+
+  Serial.print("MQTT connect: ");
+  Serial.println(host);
+  if (!mqtt.connect(host, settings.port, secure, clientId, ChipIDStr, settings.apikey))
+  {
+    Serial.println("MQTT connection failed");
+    return false;
+  }
+  Serial.println(mqtt.sessionPresent() ? "MQTT session resumed" : "MQTT session started");
   return true;
 }
 
-/* Set Sleep Timer */
-void StartDeepSleep(int offset)
+/* Publish a batch and wait for the acknowledgement, used for the backlog */
+bool MQTTPublishBatch(const SensorRecord *records, size_t count)
+{
+  if (!mqtt.connected() && !MQTTConnect())
+  {
+    return false;
+  }
+
+  UploadPayload payload(count);
+  payload.set(records, count, false);
+
+  /* Unacknowledged publishes of earlier wakes hold queued readings, they
+     are published again from the queue after the backlog */
+  if (mqtt.inflight() > 0)
+  {
+    Serial.printf("MQTT: %d unacknowledged publishes are sent again after the backlog\n", (int)mqtt.inflight());
+  }
+
+  // The backlog is read again from the SD card if this fails, nothing to send again
+  profileStart(PHASE_POST);
+  bool sent = mqtt.publishAndWait(MQTTTopic, payload);
+  profileEnd(PHASE_POST);
+  if (!sent)
+  {
+    Serial.println("MQTT publish failed");
+  }
+  return sent;
+}
+
+/* Publish the queue oldest first with up to MQTT_INFLIGHT_MAX batches in
+   flight, readings are removed once the broker acknowledged them */
+bool MQTTUploadQueue()
+{
+  static SensorRecord batch[UPLOAD_BATCH_MAX];
+  UploadPayload payload(UPLOAD_BATCH_MAX); // reused for every batch
+  size_t offset = 0; // queued readings in flight
+  bool success = true;
+
+  profileStart(PHASE_POST);
+
+  /* Publishes of earlier wakes that were not acknowledged are sent again */
+  if (mqtt.inflight() > 0)
+  {
+    Serial.printf("MQTT: sending %d unacknowledged publishes again\n", (int)mqtt.inflight());
+  }
+  for (uint8_t i = 0; success && i < mqtt.inflight(); i++)
+  {
+    size_t count = mqtt.inflightAt(i).count;
+    if (count == 0 || count > UPLOAD_BATCH_MAX || queuePeek(board.flash(), batch, count, offset) != count)
+    {
+      // The queue changed, start over with new publishes
+      mqtt.clearInflight();
+      offset = 0;
+      break;
+    }
+    payload.set(batch, count, false);
+    success = mqtt.republish(i, MQTTTopic, payload);
+    offset += count;
+  }
+
+  while (success)
+  {
+    /* Fill the window */
+    size_t count;
+    while (mqtt.inflight() < MQTT_INFLIGHT_MAX &&
+           (count = queuePeek(board.flash(), batch, UPLOAD_BATCH_MAX, offset)) > 0)
+    {
+      payload.set(batch, count, false);
+      offset += count;
+      if (!mqtt.publish(MQTTTopic, payload, count))
+      {
+        success = false;
+        break;
+      }
+    }
+    if (!success || mqtt.inflight() == 0)
+    {
+      break;
+    }
+
+    /* The oldest batch is delivered */
+    MQTTInflight acked;
+    if (!mqtt.waitAck(acked))
+    {
+      success = false;
+      break;
+    }
+    SensorRecord last;
+    if (queuePeek(board.flash(), &last, 1, acked.count - 1) == 1 && last.timestamp > upload_mark)
+    {
+      upload_mark = last.timestamp;
+    }
+    queuePop(board.flash(), acked.count);
+    offset -= acked.count;
+  }
+
+  profileEnd(PHASE_POST);
+  if (!success)
+  {
+    Serial.printf("MQTT upload incomplete, %d publishes not acknowledged\n", (int)mqtt.inflight());
+  }
+  return success;
+}
+
+/* Send the closed rollups, returns false if they stay queued */
+bool UploadRollups()
+{
+  bool viaMQTT = strcmp(settings.protocol, "MQTT") == 0;
+  RollupPayload payload(!viaMQTT);
+  bool sent;
+
+  profileStart(PHASE_POST);
+  if (viaMQTT)
+  {
+    // Sent again from the rollups that are still queued if this fails
+    sent = (mqtt.connected() || MQTTConnect()) && mqtt.publishAndWait(MQTTRollupTopic, payload);
+  }
+  else
+  {
+    String response;
+    sent = network.post(settings.server, payload.contentType(), payload, response) == 200;
+  }
+  profileEnd(PHASE_POST);
+
+  if (sent)
+  {
+    Serial.printf("Rollups uploaded (%d)\n", (int)rollupPending());
+    rollupClearPending();
+  }
+  else
+  {
+    Serial.println("Rollup upload failed");
+  }
+  return sent;
+}
+
+/* Append the rows of a closed rollup to the summary file of its year */
+void WriteRollupToSD(const Rollup &rollup)
+{
+  unsigned year = DateTime(rollup.start).year();
+  char directory[8];
+  char path[32];
+  snprintf(directory, sizeof(directory), "/%04u", year);
+  snprintf(path, sizeof(path), "/%04u/%04u-summary.csv", year, year);
+
+  /* Header and rows are committed with a single write */
+  char buffer[ROLLUP_BUFFER_SIZE];
+  size_t len = 0;
+  if (!board.sd().exists(path))
+  {
+    if (!board.sd().exists(directory))
+    {
+      board.sd().mkdir(directory);
+    }
+    len = formatRollupHeader(buffer, sizeof(buffer));
+  }
+
+  size_t rowsLen = formatRollupRows(buffer + len, sizeof(buffer) - len, rollup);
+  if (rowsLen == 0)
+  {
+    Serial.println("Error: rollup rows do not fit into buffer");
+    return;
+  }
+  len += rowsLen;
+
+  File summaryFile = board.sd().open(path, FILE_APPEND);
+  if (summaryFile)
+  {
+    summaryFile.write((const uint8_t *)buffer, len);
+  }
+  summaryFile.close();
+  Serial.printf("Rollup of the %s written to %s\n", rollupPeriodName(rollup.period), path);
+}
+
+/* Append the rolling phase statistics to the profile file */
+void WriteProfileToSD(DateTime &now)
+{
+
+  File profileFile;
+  bool newFile = !board.sd().exists(PROFILE_FILE);
+
+  /* One row per phase, committed with a single write */
+  char buffer[64 + PHASE_COUNT * 96];
+  size_t len = 0;
+
+  if (newFile)
+  {
+    len += snprintf(buffer, sizeof(buffer), "Time [Local],Firmware,Wakes,Phase,Samples,Min [ms],Mean [ms],P95 [ms],Max [ms]\r\n");
+  }
+
+  char timestamp[] = "YYYY-MM-DDThh:mm:ss";
+  now.toString(timestamp);
+  for (int p = 0; p < PHASE_COUNT; p++)
+  {
+    PhaseStats stats;
+    if (!profileStats((Phase)p, stats))
+    {
+      continue;
+    }
+    len += snprintf(buffer + len, sizeof(buffer) - len, "%s,%s,%lu,%s,%u,%.3f,%.3f,%.3f,%.3f\r\n",
+                    timestamp, FIRMWARE_VERSION, (unsigned long)profileWakes(), profilePhaseName((Phase)p), stats.samples,
+                    stats.min / 1000.0, stats.mean / 1000.0, stats.p95 / 1000.0, stats.max / 1000.0);
+  }
+
+  profileFile = board.sd().open(PROFILE_FILE, FILE_APPEND);
+  if (profileFile)
+  {
+    profileFile.write((const uint8_t *)buffer, len);
+  }
+  profileFile.close();
+}
+
+/* Rolling phase statistics in milliseconds */
+void profileToJson(JsonObject profile)
+{
+  profile["firmware"] = FIRMWARE_VERSION;
+  for (int p = 0; p < PHASE_COUNT; p++)
+  {
+    PhaseStats stats;
+    if (!profileStats((Phase)p, stats))
+    {
+      continue;
+    }
+    JsonObject phase = profile.createNestedObject(profilePhaseName((Phase)p));
+    phase["n"] = stats.samples;
+    phase["min"] = stats.min / 1000.0;
+    phase["mean"] = stats.mean / 1000.0;
+    phase["p95"] = stats.p95 / 1000.0;
+    phase["max"] = stats.max / 1000.0;
+  }
+}
+
+/* Scheduler policy from the settings, intervals in seconds */
+SchedulePolicy schedulePolicy()
+{
+  SchedulePolicy policy;
+  policy.interval = settings.sleepDuration * 60UL;
+  policy.minInterval = settings.sleepMin * 60UL;
+  policy.maxInterval = settings.sleepMax * 60UL;
+  policy.pressureRate = settings.adaptPressureRate;
+  policy.pmStep = settings.adaptPMStep;
+  policy.batteryLow = settings.batteryLow;
+  policy.batteryCritical = settings.batteryCritical;
+  return policy;
+}
+
+/* Set Sleep Timer, to wake interval seconds after the reading at timestamp
+   on the wall clock, corrected for the drift of the sleep timer */
+void StartDeepSleep(uint32_t timestamp, uint32_t interval)
 {
-  int SleepTimer = settings.sleepDuration * 60 * 1000; // Convert sleep duration into milliseconds
-  SleepTimer -= offset;                                // Subtract millisecond offset from data collection
-  esp_sleep_enable_timer_wakeup(SleepTimer * 1000LL);
-  Serial.println("Deep-sleep for " + String(SleepTimer / 1000) + " seconds");
-  esp_deep_sleep_start();
+  profileStart(PHASE_SLEEP_ENTRY);
+  uint64_t SleepTimer = scheduleSleep(schedulePolicy(), timestamp, interval, rtc.now().unixtime());
+  DateTime wake(scheduleTarget());
+  Serial.printf("Deep-sleep for %.1f seconds, wake at %02d:%02d:%02d (sleep timer drift %+.0f ppm)\n",
+                SleepTimer / 1000000.0, wake.hour(), wake.minute(), wake.second(),
+                (scheduleDrift() - 1) * 1000000.0);
+
+  /* Sleep entry ends here, later steps are not measurable */
+  profileEnd(PHASE_SLEEP_ENTRY);
+  profileCommit();
+  board.deepSleep(SleepTimer);
 }
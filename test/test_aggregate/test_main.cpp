@@ -0,0 +1,215 @@
+/*
+ * Streaming Statistics - the estimators of lib/aggregate against the exact
+ * statistics of the same samples: the median (exact for up to five, P-square
+ * within bounds beyond), Welford's mean and standard deviation against a
+ * two-pass reference, and samples that are NaN.
+ *
+ * pio test -e native -f test_aggregate
+ */
+
+#include <Arduino.h>
+#include <unity.h>
+
+#include <algorithm>
+#include <random>
+#include <vector>
+
+#include "aggregate.h"
+
+#define TRIALS 2000
+#define TRUTH 21.5   // true value, e.g. a temperature
+#define NOISE 0.05   // standard deviation of the noise
+#define SPIKE 2.0    // offset of an outlier
+#define SPIKES 0.08  // probability of an outlier per sample
+
+/* Gaussian noise from the fully specified mt19937 (Box-Muller), the same
+   samples with every standard library */
+static double gaussian(std::mt19937 &rng)
+{
+  double u1 = (rng() + 1.0) / 4294967297.0;
+  double u2 = rng() / 4294967296.0;
+  return sqrt(-2 * log(u1)) * cos(2 * M_PI * u2);
+}
+
+static std::vector<float> samples(std::mt19937 &rng, int count, double spikes)
+{
+  std::vector<float> values(count);
+  for (float &v : values)
+  {
+    double value = TRUTH + NOISE * gaussian(rng);
+    if (rng() / 4294967296.0 < spikes)
+      value += SPIKE;
+    v = (float)value;
+  }
+  return values;
+}
+
+static StreamingStats statsOf(const std::vector<float> &values)
+{
+  StreamingStats stats;
+  for (float v : values)
+    stats.add(v);
+  return stats;
+}
+
+static double exactMedian(std::vector<float> values)
+{
+  std::sort(values.begin(), values.end());
+  size_t n = values.size();
+  return n % 2 ? values[n / 2] : (values[n / 2 - 1] + values[n / 2]) / 2.0;
+}
+
+struct MedianErrors
+{
+  double exact; // mean absolute difference to the exact median
+  double truth; // rms difference of the median to the true value
+  double mean;  // rms difference of the mean to the true value
+};
+
+static MedianErrors medianTrials(int count, double spikes)
+{
+  std::mt19937 rng(1985);
+  MedianErrors errors = {0, 0, 0};
+  for (int trial = 0; trial < TRIALS; trial++)
+  {
+    std::vector<float> values = samples(rng, count, spikes);
+    StreamingStats stats = statsOf(values);
+    float median = stats.median();
+
+    // P-square keeps the estimate between the extremes
+    TEST_ASSERT_TRUE(median >= stats.min() && median <= stats.max());
+    errors.exact += fabs(median - exactMedian(values));
+    errors.truth += (median - TRUTH) * (median - TRUTH);
+    errors.mean += (stats.mean() - TRUTH) * (stats.mean() - TRUTH);
+  }
+  errors.exact /= TRIALS;
+  errors.truth = sqrt(errors.truth / TRIALS);
+  errors.mean = sqrt(errors.mean / TRIALS);
+  return errors;
+}
+
+void setUp(void)
+{
+}
+
+void tearDown(void)
+{
+}
+
+void test_exact_median_up_to_five(void)
+{
+  const float values[] = {3.5f, -1.0f, 7.25f, 2.0f, 2.0f};
+  const float medians[] = {3.5f, 1.25f, 3.5f, 2.75f, 2.0f};
+  StreamingStats stats;
+  for (int n = 0; n < 5; n++)
+  {
+    stats.add(values[n]);
+    TEST_ASSERT_EQUAL_UINT32(n + 1, stats.count());
+    TEST_ASSERT_EQUAL_FLOAT(medians[n], stats.median());
+  }
+
+  // Against the sorted copy for every order of the samples
+  std::mt19937 rng(7);
+  for (int trial = 0; trial < 200; trial++)
+  {
+    int count = 1 + trial % 5;
+    std::vector<float> random = samples(rng, count, SPIKES);
+    TEST_ASSERT_EQUAL_FLOAT(exactMedian(random), statsOf(random).median());
+  }
+}
+
+void test_median_estimate_gaussian(void)
+{
+  // Mean difference to the exact median in standard deviations of the noise
+  const int counts[] = {8, 16, 32};
+  const double bounds[] = {0.25, 0.2, 0.15};
+  for (int k = 0; k < 3; k++)
+  {
+    MedianErrors errors = medianTrials(counts[k], 0);
+    TEST_ASSERT_LESS_THAN_FLOAT(bounds[k] * NOISE, errors.exact);
+    TEST_ASSERT_LESS_THAN_FLOAT(1.5 * NOISE / sqrt(counts[k]), errors.truth);
+  }
+}
+
+void test_median_estimate_outliers(void)
+{
+  // The median stays with the true value where outliers pull the mean away
+  const int counts[] = {8, 16, 32};
+  const double bounds[] = {0.5, 0.4, 0.3};
+  for (int k = 0; k < 3; k++)
+  {
+    MedianErrors errors = medianTrials(counts[k], SPIKES);
+    TEST_ASSERT_LESS_THAN_FLOAT(bounds[k] * NOISE, errors.exact);
+    TEST_ASSERT_LESS_THAN_FLOAT(errors.mean / 2, errors.truth);
+  }
+}
+
+void test_mean_and_stddev_two_pass(void)
+{
+  std::mt19937 rng(42);
+  const double offsets[] = {0, TRUTH, 1013.25, 1e5};
+  for (int k = 0; k < 4; k++)
+  {
+    for (int count = 1; count <= 64; count *= 2)
+    {
+      std::vector<float> values = samples(rng, count, SPIKES);
+      for (float &v : values)
+        v += offsets[k] - TRUTH;
+      StreamingStats stats = statsOf(values);
+
+      double sum = 0;
+      for (float v : values)
+        sum += v;
+      double mean = sum / count;
+      double squares = 0;
+      for (float v : values)
+        squares += (v - mean) * (v - mean);
+      double stddev = count > 1 ? sqrt(squares / (count - 1)) : 0;
+
+      TEST_ASSERT_FLOAT_WITHIN(fabs(mean) * 1e-6 + 1e-6, mean, stats.mean());
+      TEST_ASSERT_FLOAT_WITHIN(stddev * 1e-4 + 1e-6, stddev, stats.stddev());
+      TEST_ASSERT_EQUAL_FLOAT(*std::min_element(values.begin(), values.end()), stats.min());
+      TEST_ASSERT_EQUAL_FLOAT(*std::max_element(values.begin(), values.end()), stats.max());
+    }
+  }
+}
+
+void test_nan_samples(void)
+{
+  StreamingStats empty;
+  TEST_ASSERT_EQUAL_UINT32(0, empty.count());
+  TEST_ASSERT_FLOAT_IS_NAN(empty.mean());
+  TEST_ASSERT_FLOAT_IS_NAN(empty.median());
+  TEST_ASSERT_FLOAT_IS_NAN(empty.min());
+  TEST_ASSERT_FLOAT_IS_NAN(empty.max());
+  TEST_ASSERT_EQUAL_FLOAT(0.0f, empty.stddev());
+
+  // Only NaN is no sample at all
+  empty.add(NAN);
+  TEST_ASSERT_EQUAL_UINT32(0, empty.count());
+  TEST_ASSERT_FLOAT_IS_NAN(empty.median());
+
+  // NaN in between, also while the first five samples are the markers
+  const float values[] = {NAN, 4.0f, 1.0f, NAN, 3.0f, 2.0f, 5.0f, NAN, 6.0f, 7.0f};
+  StreamingStats stats;
+  for (size_t i = 0; i < sizeof(values) / sizeof(values[0]); i++)
+    stats.add(values[i]);
+  TEST_ASSERT_EQUAL_UINT32(7, stats.count());
+  TEST_ASSERT_EQUAL_FLOAT(4.0f, stats.mean());
+  TEST_ASSERT_FLOAT_WITHIN(1e-6f, 2.1602469f, stats.stddev());
+  TEST_ASSERT_EQUAL_FLOAT(1.0f, stats.min());
+  TEST_ASSERT_EQUAL_FLOAT(7.0f, stats.max());
+  TEST_ASSERT_FALSE(isnan(stats.median()));
+  TEST_ASSERT_FLOAT_WITHIN(1.0f, 4.0f, stats.median());
+}
+
+int main(int argc, char **argv)
+{
+  UNITY_BEGIN();
+  RUN_TEST(test_exact_median_up_to_five);
+  RUN_TEST(test_median_estimate_gaussian);
+  RUN_TEST(test_median_estimate_outliers);
+  RUN_TEST(test_mean_and_stddev_two_pass);
+  RUN_TEST(test_nan_samples);
+  return UNITY_END();
+}
@@ -0,0 +1,263 @@
+/*
+ * Backlog Replay - reading the daily files in batches with a cursor must
+ * return the same readings as reading them from the start every time.
+ *
+ * pio test -e native -f test_backlog
+ */
+
+#include <Arduino.h>
+#include <unity.h>
+
+#include <sys/stat.h>
+
+#include "backlog.h"
+#include "binlog.h"
+#include "native.h"
+
+#define READINGS_PER_DAY 40
+#define BATCH 7
+
+static const uint32_t DAY = 1710028800; // 2024-03-10
+static const char *DAYS[] = {"/2024/03/2024-03-10", "/2024/03/2024-03-11"};
+
+static FS sd("sd");
+
+static SensorRecord reading(uint32_t timestamp)
+{
+  SensorRecord record = {};
+  record.timestamp = timestamp;
+  record.temperature = (timestamp - DAY) / 600.0f;
+  record.pm2_5 = (timestamp - DAY) / 600 % 50;
+  record.battery = 3.9f;
+  return record;
+}
+
+static void append(const char *day, const char *ext, const void *data, size_t len)
+{
+  char path[32];
+  snprintf(path, sizeof(path), "%s.%s", day, ext);
+  File file = sd.open(path, FILE_APPEND);
+  TEST_ASSERT_TRUE(file);
+  TEST_ASSERT_EQUAL(len, file.write((const uint8_t *)data, len));
+  file.close();
+}
+
+/* Two days of readings every 10 minutes, in both formats. The CSV file of
+   the second day repeats its header row halfway, as after a restart. */
+static void writeDays()
+{
+  static uint8_t buffer[BINLOG_HEADER_MAX + BINLOG_BLOCK_HEADER_SIZE + sizeof(SensorRecord)];
+  static char line[CSV_BUFFER_SIZE];
+
+  for (int d = 0; d < 2; d++)
+  {
+    append(DAYS[d], "bin", buffer, binlogHeader(buffer, sizeof(buffer)));
+    append(DAYS[d], "csv", line, formatCSVHeader(line, sizeof(line)));
+    for (int i = 0; i < READINGS_PER_DAY; i++)
+    {
+      SensorRecord record = reading(DAY + d * 86400 + i * 600);
+      append(DAYS[d], "bin", buffer, binlogBlock(buffer, sizeof(buffer), &record, 1));
+      if (d == 1 && i == READINGS_PER_DAY / 2)
+        append(DAYS[d], "csv", line, formatCSVHeader(line, sizeof(line)));
+      append(DAYS[d], "csv", line, formatCSVRow(line, sizeof(line), record));
+    }
+  }
+}
+
+static void removeDays()
+{
+  char path[32];
+  for (int d = 0; d < 2; d++)
+  {
+    snprintf(path, sizeof(path), "%s.bin", DAYS[d]);
+    sd.remove(path);
+    snprintf(path, sizeof(path), "%s.csv", DAYS[d]);
+    sd.remove(path);
+  }
+}
+
+void setUp(void)
+{
+  mkdir(nativeRoot(), 0755);
+  sd.mount();
+  sd.mkdir("/2024");
+  sd.mkdir("/2024/03");
+  removeDays();
+  writeDays();
+}
+
+void tearDown(void)
+{
+  removeDays();
+}
+
+/* Replay in batches like ReplayBacklog(), the mark moves with every batch */
+static void replay(bool binary, BacklogCursor *cursor)
+{
+  SensorRecord batch[BATCH];
+  uint32_t mark = DAY + 1200;
+  uint32_t before = DAY + 86400 + 30 * 600;
+  uint32_t expected = mark + 600;
+  size_t count;
+
+  while ((count = backlogRead(sd, binary, mark, before, batch, BATCH, cursor)) > 0)
+  {
+    for (size_t i = 0; i < count; i++)
+    {
+      TEST_ASSERT_EQUAL_UINT32(expected, batch[i].timestamp);
+      TEST_ASSERT_FLOAT_WITHIN(0.01f, (expected - DAY) / 600.0f, batch[i].temperature);
+      TEST_ASSERT_EQUAL_UINT16((expected - DAY) / 600 % 50, batch[i].pm2_5);
+      expected += expected - DAY == 39 * 600 ? 86400 - 39 * 600 : 600;
+    }
+    mark = batch[count - 1].timestamp;
+    if (cursor)
+      TEST_ASSERT_EQUAL_UINT32(mark, cursor->timestamp);
+  }
+  TEST_ASSERT_EQUAL_UINT32(before, expected);
+}
+
+void test_binary_without_cursor(void)
+{
+  replay(true, NULL);
+}
+
+void test_binary_with_cursor(void)
+{
+  BacklogCursor cursor = {};
+  replay(true, &cursor);
+
+  // The block of the last reading, one record per block
+  size_t block = BINLOG_BLOCK_HEADER_SIZE + binlogRecordSize();
+  TEST_ASSERT_TRUE(cursor.binary);
+  TEST_ASSERT_EQUAL_UINT32(DAY + 86400, cursor.day);
+  TEST_ASSERT_EQUAL_UINT32(0, cursor.header);
+  TEST_ASSERT_EQUAL_UINT32(binlogHeaderLength() + 29 * block, cursor.offset);
+}
+
+void test_csv_without_cursor(void)
+{
+  replay(false, NULL);
+}
+
+void test_csv_with_cursor(void)
+{
+  BacklogCursor cursor = {};
+  replay(false, &cursor);
+  TEST_ASSERT_FALSE(cursor.binary);
+  TEST_ASSERT_EQUAL_UINT32(DAY + 86400, cursor.day);
+  TEST_ASSERT_GREATER_THAN(0, cursor.header); // the repeated header row
+  TEST_ASSERT_GREATER_THAN(cursor.header, cursor.offset);
+}
+
+void test_cursor_of_other_mark(void)
+{
+  // A cursor that does not belong to the mark is not used
+  BacklogCursor cursor = {DAY + 5000, DAY + 86400, 0, 12345, true};
+  SensorRecord batch[BATCH];
+  TEST_ASSERT_EQUAL(BATCH, backlogRead(sd, true, DAY, DAY + 86400, batch, BATCH, &cursor));
+  TEST_ASSERT_EQUAL_UINT32(DAY + 600, batch[0].timestamp);
+
+  // Nor one of the other format
+  cursor.binary = false;
+  cursor.timestamp = DAY;
+  TEST_ASSERT_EQUAL(BATCH, backlogRead(sd, true, DAY, DAY + 86400, batch, BATCH, &cursor));
+  TEST_ASSERT_EQUAL_UINT32(DAY + 600, batch[0].timestamp);
+}
+
+/* CSV label of a record field */
+static const char *labelOf(uint8_t id)
+{
+  for (size_t i = 0; i < RECORD_FIELD_COUNT; i++)
+  {
+    if (RECORD_FIELDS[i].id == id)
+      return RECORD_FIELDS[i].label;
+  }
+  TEST_FAIL_MESSAGE("no field with the ID");
+  return NULL;
+}
+
+void test_csv_columns_changed(void)
+{
+  // A day begun by a firmware with other columns (PM2.5 before the
+  // temperature, a field that no longer exists), continued by this one
+  removeDays();
+  char line[CSV_BUFFER_SIZE];
+  char iso8601[25];
+  int n = snprintf(line, sizeof(line), "\"%s\",\"%s\",\"Retired Field\",\"%s\"\r\n", RECORD_TIME,
+                   labelOf(RECORD_ID_PM2_5), labelOf(1));
+  append(DAYS[0], "csv", line, n);
+  for (int i = 0; i < 10; i++)
+  {
+    SensorRecord record = reading(DAY + i * 600);
+    n = snprintf(line, sizeof(line), "%s,%u,99,%.2f\r\n", formatTimestamp(record.timestamp, iso8601),
+                 record.pm2_5, record.temperature);
+    append(DAYS[0], "csv", line, n);
+  }
+  append(DAYS[0], "csv", line, formatCSVHeader(line, sizeof(line)));
+  for (int i = 10; i < 20; i++)
+  {
+    SensorRecord record = reading(DAY + i * 600);
+    append(DAYS[0], "csv", line, formatCSVRow(line, sizeof(line), record));
+  }
+
+  // The columns follow the header row before each reading, also when a
+  // batch continues after the header row changed
+  SensorRecord batch[BATCH];
+  BacklogCursor cursor = {};
+  uint32_t mark = DAY;
+  uint32_t expected = DAY + 600;
+  size_t count;
+  while ((count = backlogRead(sd, false, mark, DAY + 86400, batch, BATCH, &cursor)) > 0)
+  {
+    for (size_t i = 0; i < count; i++, expected += 600)
+    {
+      TEST_ASSERT_EQUAL_UINT32(expected, batch[i].timestamp);
+      TEST_ASSERT_FLOAT_WITHIN(0.01f, (expected - DAY) / 600.0f, batch[i].temperature);
+      TEST_ASSERT_EQUAL_UINT16((expected - DAY) / 600 % 50, batch[i].pm2_5);
+    }
+    mark = batch[count - 1].timestamp;
+  }
+  TEST_ASSERT_EQUAL_UINT32(DAY + 20 * 600, expected);
+
+  // The header row the station compares its columns with
+  char header[CSV_BUFFER_SIZE];
+  size_t headerLen = formatCSVHeader(line, sizeof(line));
+  File file = sd.open("/2024/03/2024-03-10.csv", FILE_READ);
+  TEST_ASSERT_EQUAL(headerLen - 2, csvLastHeader(file, header, sizeof(header)));
+  TEST_ASSERT_EQUAL_MEMORY(line, header, headerLen - 2);
+  TEST_ASSERT_EQUAL(0, csvLastHeader(file, header, 10));
+  file.close();
+}
+
+void test_csv_out_of_range_value(void)
+{
+  // A reading beyond 64 bit fixed point keeps its row and its other fields
+  removeDays();
+  char line[CSV_BUFFER_SIZE];
+  append(DAYS[0], "csv", line, formatCSVHeader(line, sizeof(line)));
+  SensorRecord record = reading(DAY + 600);
+  record.pressure = -3.0e38f;
+  size_t len = formatCSVRow(line, sizeof(line), record);
+  TEST_ASSERT_TRUE(len > 0);
+  append(DAYS[0], "csv", line, len);
+
+  SensorRecord batch[BATCH];
+  TEST_ASSERT_EQUAL(1, backlogRead(sd, false, DAY, DAY + 86400, batch, BATCH, NULL));
+  TEST_ASSERT_EQUAL_UINT32(DAY + 600, batch[0].timestamp);
+  TEST_ASSERT_FLOAT_WITHIN(0.01f, 1.0f, batch[0].temperature);
+  TEST_ASSERT_FLOAT_WITHIN(1e33f, -3.0e38f, batch[0].pressure);
+  TEST_ASSERT_FLOAT_WITHIN(0.01f, 3.9f, batch[0].battery);
+}
+
+int main(int argc, char **argv)
+{
+  UNITY_BEGIN();
+  RUN_TEST(test_binary_without_cursor);
+  RUN_TEST(test_binary_with_cursor);
+  RUN_TEST(test_csv_without_cursor);
+  RUN_TEST(test_csv_with_cursor);
+  RUN_TEST(test_cursor_of_other_mark);
+  RUN_TEST(test_csv_columns_changed);
+  RUN_TEST(test_csv_out_of_range_value);
+  return UNITY_END();
+}
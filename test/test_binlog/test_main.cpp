@@ -0,0 +1,143 @@
+/*
+ * Binary Record Log - a day written with two schemas, as after a firmware
+ * update that added fields, must be read back completely.
+ *
+ * pio test -e native -f test_binlog
+ */
+
+#include <Arduino.h>
+#include <unity.h>
+
+#include <sys/stat.h>
+
+#include "backlog.h"
+#include "binlog.h"
+#include "native.h"
+
+/* Layout before the sub-sample statistics, the first 22 fields */
+#define OLD_FIELD_COUNT 22
+
+static const uint32_t DAY = 1710028800; // 2024-03-10
+static const char *PATH = "/2024/03/2024-03-10.bin";
+
+static FS sd("sd");
+
+static SensorRecord reading(uint32_t timestamp, float temperature)
+{
+  SensorRecord record = {};
+  record.timestamp = timestamp;
+  record.temperature = temperature;
+  record.pm2_5 = 12;
+  record.battery = 3.9f;
+  record.samples = 5;
+  record.temperatureSD = 0.125f;
+  record.iaq = 42;
+  return record;
+}
+
+/* Append a header and a block with one record for the fields */
+static void append(const SensorRecord &record, const RecordField *fields, size_t count, bool header)
+{
+  static uint8_t buffer[BINLOG_HEADER_MAX + BINLOG_BLOCK_HEADER_SIZE + sizeof(SensorRecord)];
+  size_t len = header ? binlogHeader(buffer, sizeof(buffer), fields, count) : 0;
+  len += binlogBlock(buffer + len, sizeof(buffer) - len, &record, 1, fields, count);
+
+  File file = sd.open(PATH, FILE_APPEND);
+  TEST_ASSERT_TRUE(file);
+  TEST_ASSERT_EQUAL(len, file.write(buffer, len));
+  file.close();
+}
+
+void setUp(void)
+{
+  mkdir(nativeRoot(), 0755);
+  sd.mount();
+  sd.mkdir("/2024");
+  sd.mkdir("/2024/03");
+  sd.remove(PATH);
+}
+
+void tearDown(void)
+{
+  sd.remove(PATH);
+}
+
+void test_header_length(void)
+{
+  uint8_t buffer[BINLOG_HEADER_MAX];
+  TEST_ASSERT_EQUAL(binlogHeaderLength(), binlogHeader(buffer, sizeof(buffer)));
+  TEST_ASSERT_EQUAL(binlogHeaderLength(RECORD_FIELDS, OLD_FIELD_COUNT),
+                    binlogHeader(buffer, sizeof(buffer), RECORD_FIELDS, OLD_FIELD_COUNT));
+}
+
+void test_last_header(void)
+{
+  uint8_t current[BINLOG_HEADER_MAX];
+  uint8_t last[BINLOG_HEADER_MAX];
+  size_t currentLen = binlogHeader(current, sizeof(current));
+
+  append(reading(DAY + 600, 10.0f), RECORD_FIELDS, OLD_FIELD_COUNT, true);
+  append(reading(DAY + 900, 11.0f), RECORD_FIELDS, OLD_FIELD_COUNT, false);
+
+  // Written with the old schema, the writer has to append a new header
+  File file = sd.open(PATH, FILE_READ);
+  size_t len = binlogLastHeader(file, last, sizeof(last));
+  file.close();
+  TEST_ASSERT_EQUAL(binlogHeaderLength(RECORD_FIELDS, OLD_FIELD_COUNT), len);
+  TEST_ASSERT_FALSE(len == currentLen && memcmp(last, current, len) == 0);
+
+  // After that the current schema applies
+  append(reading(DAY + 1200, 12.0f), RECORD_FIELDS, RECORD_FIELD_COUNT, true);
+  file = sd.open(PATH, FILE_READ);
+  len = binlogLastHeader(file, last, sizeof(last));
+  file.close();
+  TEST_ASSERT_EQUAL(currentLen, len);
+  TEST_ASSERT_EQUAL_MEMORY(current, last, len);
+
+  // A header larger than the buffer is not copied
+  file = sd.open(PATH, FILE_READ);
+  TEST_ASSERT_EQUAL(0, binlogLastHeader(file, last, 64));
+  file.close();
+}
+
+void test_mixed_schema_day(void)
+{
+  append(reading(DAY + 600, 10.0f), RECORD_FIELDS, OLD_FIELD_COUNT, true);
+  append(reading(DAY + 900, 11.0f), RECORD_FIELDS, OLD_FIELD_COUNT, false);
+
+  // A torn block from a power loss right before the firmware update
+  File file = sd.open(PATH, FILE_APPEND);
+  const uint8_t torn[] = {0x57, 0x42, 0x01, 0x00, 0x12};
+  file.write(torn, sizeof(torn));
+  file.close();
+
+  append(reading(DAY + 1200, 12.0f), RECORD_FIELDS, RECORD_FIELD_COUNT, true);
+  append(reading(DAY + 1500, 13.0f), RECORD_FIELDS, RECORD_FIELD_COUNT, false);
+
+  SensorRecord records[8];
+  size_t count = backlogRead(sd, true, DAY, DAY + 3600, records, 8);
+  TEST_ASSERT_EQUAL(4, count);
+  for (size_t i = 0; i < count; i++)
+  {
+    TEST_ASSERT_EQUAL_UINT32(DAY + 600 + 300 * i, records[i].timestamp);
+    TEST_ASSERT_FLOAT_WITHIN(0.001f, 10.0f + i, records[i].temperature);
+    TEST_ASSERT_EQUAL_UINT16(12, records[i].pm2_5);
+    TEST_ASSERT_FLOAT_WITHIN(0.001f, 3.9f, records[i].battery);
+  }
+
+  // Fields the old schema did not have stay empty
+  TEST_ASSERT_EQUAL_UINT16(0, records[1].samples);
+  TEST_ASSERT_EQUAL_INT16(0, records[1].iaq);
+  TEST_ASSERT_EQUAL_UINT16(5, records[2].samples);
+  TEST_ASSERT_FLOAT_WITHIN(0.001f, 0.125f, records[2].temperatureSD);
+  TEST_ASSERT_EQUAL_INT16(42, records[3].iaq);
+}
+
+int main(int argc, char **argv)
+{
+  UNITY_BEGIN();
+  RUN_TEST(test_header_length);
+  RUN_TEST(test_last_header);
+  RUN_TEST(test_mixed_schema_day);
+  return UNITY_END();
+}
@@ -0,0 +1,211 @@
+/*
+ * Derived Parameters - the single precision kernels (scalar and batch)
+ * against the double reference over the whole input range, the AQI tables
+ * against the AirNow equations and the NowCast against worked examples.
+ *
+ * pio test -e native -f test_calculations
+ */
+
+#include <Arduino.h>
+#include <unity.h>
+
+#include <vector>
+
+#include "calculations.h"
+
+/* Largest differences allowed against the reference */
+#define HEAT_INDEX_BOUND 0.01 // F
+#define DEW_POINT_BOUND 0.001 // C
+#define PMSL_BOUND 0.01       // hPa
+
+/*
+ * AQI with the equations of the AirNow calculator, as the station used to
+ * calculate it: https://www.airnow.gov/aqi/aqi-calculator-concentration/
+ */
+static int linear(float aqiHigh, float aqiLow, float concHigh, float concLow, float c)
+{
+  return (int)(((c - concLow) / (concHigh - concLow)) * (aqiHigh - aqiLow) + aqiLow);
+}
+
+static int referencePM25(float c)
+{
+  if (c >= 0 && c < 12.1)
+    return linear(50.0, 0.0, 12.0, 0.0, c);
+  if (c >= 12.1 && c < 35.5)
+    return linear(100.0, 51.0, 35.4, 12.1, c);
+  if (c >= 35.5 && c < 55.5)
+    return linear(150.0, 101.0, 55.4, 35.5, c);
+  if (c >= 55.5 && c < 150.5)
+    return linear(200.0, 151.0, 150.4, 55.5, c);
+  if (c >= 150.5 && c < 250.5)
+    return linear(300.0, 201.0, 250.4, 150.5, c);
+  if (c >= 250.5 && c < 350.5)
+    return linear(400.0, 301.0, 350.4, 250.5, c);
+  if (c >= 350.5 && c < 500.5)
+    return linear(500.0, 401.0, 500.4, 350.5, c);
+  return -1;
+}
+
+static int referencePM10(float c)
+{
+  if (c >= 0.0 && c < 55.0)
+    return linear(50.0, 0.0, 54.0, 0.0, c);
+  if (c >= 55.0 && c < 155.0)
+    return linear(100.0, 51.0, 154.0, 55.0, c);
+  if (c >= 155.0 && c < 255.0)
+    return linear(150.0, 101.0, 254.0, 155.0, c);
+  if (c >= 255.0 && c < 355.0)
+    return linear(200.0, 151.0, 354.0, 255.0, c);
+  if (c >= 355.0 && c < 425.0)
+    return linear(300.0, 201.0, 424.0, 355.0, c);
+  if (c >= 425.0 && c < 505.0)
+    return linear(400.0, 301.0, 504.0, 425.0, c);
+  if (c >= 505.0 && c < 605.0)
+    return linear(500.0, 401.0, 604.0, 505.0, c);
+  return -1;
+}
+
+static int referenceAQI(float pm25, float pm10)
+{
+  int aqi25 = referencePM25(pm25);
+  int aqi10 = referencePM10(pm10);
+  return aqi10 > aqi25 ? aqi10 : aqi25;
+}
+
+void setUp(void)
+{
+}
+
+void tearDown(void)
+{
+}
+
+void test_heat_index(void)
+{
+  // -40 to 130 F and 0.5 to 100 %
+  std::vector<float> t, rh;
+  for (int i = -400; i <= 1300; i++)
+  {
+    for (int j = 1; j <= 200; j++)
+    {
+      t.push_back(i / 10.0f);
+      rh.push_back(j / 2.0f);
+    }
+  }
+  std::vector<float> out(t.size());
+  heatIndex(t.data(), rh.data(), out.data(), t.size());
+  for (size_t i = 0; i < t.size(); i++)
+  {
+    double reference = heatIndex((double)t[i], (double)rh[i]);
+    TEST_ASSERT_FLOAT_WITHIN(HEAT_INDEX_BOUND, reference, heatIndex(t[i], rh[i]));
+    TEST_ASSERT_FLOAT_WITHIN(HEAT_INDEX_BOUND, reference, out[i]);
+  }
+}
+
+void test_dew_point(void)
+{
+  // -40 to 60 C and 1 to 100 %
+  std::vector<float> t, rh;
+  for (int i = -400; i <= 600; i++)
+  {
+    for (int j = 2; j <= 200; j++)
+    {
+      t.push_back(i / 10.0f);
+      rh.push_back(j / 2.0f);
+    }
+  }
+  std::vector<float> out(t.size());
+  dewPoint(t.data(), rh.data(), out.data(), t.size());
+  for (size_t i = 0; i < t.size(); i++)
+  {
+    double reference = dewPoint((double)t[i], (double)rh[i]);
+    TEST_ASSERT_FLOAT_WITHIN(DEW_POINT_BOUND, reference, dewPoint(t[i], rh[i]));
+    TEST_ASSERT_FLOAT_WITHIN(DEW_POINT_BOUND, reference, out[i]);
+  }
+}
+
+void test_pressure_msl(void)
+{
+  // 300 to 1100 hPa at 0 to 4000 m
+  std::vector<float> pressure;
+  for (int i = 600; i <= 2200; i++)
+    pressure.push_back(i / 2.0f);
+  std::vector<float> out(pressure.size());
+  for (int altitude = 0; altitude <= 4000; altitude += 10)
+  {
+    pressureMSL(pressure.data(), (float)altitude, out.data(), pressure.size());
+    for (size_t i = 0; i < pressure.size(); i++)
+    {
+      double reference = pressureMSL((double)pressure[i], (double)altitude);
+      TEST_ASSERT_FLOAT_WITHIN(PMSL_BOUND, reference, pressureMSL(pressure[i], (float)altitude));
+      TEST_ASSERT_FLOAT_WITHIN(PMSL_BOUND, reference, out[i]);
+    }
+  }
+}
+
+void test_aqi(void)
+{
+  // Every 0.01 ug/m3 up to 700 for each pollutant, must be the same
+  for (int i = -100; i <= 70000; i++)
+  {
+    float c = i / 100.0f;
+    TEST_ASSERT_EQUAL_INT(referenceAQI(c, 0.0f), airQualityIndex(c, 0.0f));
+    TEST_ASSERT_EQUAL_INT(referenceAQI(0.0f, c), airQualityIndex(0.0f, c));
+    TEST_ASSERT_EQUAL_INT(referenceAQI(c, c), airQualityIndex(c, c));
+  }
+
+  float pm25[] = {-1.0f, 0.0f, 12.0f, 12.05f, 35.5f, 500.4f, 500.5f};
+  float pm10[] = {0.0f, 0.0f, 54.5f, 0.0f, 0.0f, 0.0f, 605.0f};
+  int16_t aqi[7];
+  airQualityIndex(pm25, pm10, aqi, 7);
+  for (int i = 0; i < 7; i++)
+    TEST_ASSERT_EQUAL_INT(referenceAQI(pm25[i], pm10[i]), aqi[i]);
+  TEST_ASSERT_EQUAL_INT(-1, aqi[6]);
+}
+
+void test_nowcast_examples(void)
+{
+  // Newest hour first
+  struct NowCastCase
+  {
+    Pollutant pollutant;
+    float hourly[NOWCAST_HOURS];
+    float expected; // NaN if not enough hours
+  };
+  const NowCastCase examples[] = {
+      // Steady concentration
+      {POLLUTANT_PM25, {20, 20, 20, 20, 20, 20, 20, 20, 20, 20, 20, 20}, 20.0f},
+      // Weight 57/77, 66.57 truncated to 0.1
+      {POLLUTANT_PM25, {64, 63, 72, 77, 65, 61, 70, 71, 64, 57, 58, 64}, 66.5f},
+      // Rising fast, weight limited to 0.5: (80 + 40 * 0.5 + 10 * 0.25) / 1.75
+      {POLLUTANT_PM25, {80, 40, 10, NAN, NAN, NAN, NAN, NAN, NAN, NAN, NAN, NAN}, 58.5f},
+      // PM10 truncated to integers: (100 + 0.5 * 50) / 1.5
+      {POLLUTANT_PM10, {100, 50, NAN, NAN, NAN, NAN, NAN, NAN, NAN, NAN, NAN, NAN}, 83.0f},
+      // Missing newest hour still has two of the three: (30 + 20 * 0.5) / 1.5
+      {POLLUTANT_PM25, {NAN, 30, 15, NAN, NAN, NAN, NAN, NAN, NAN, NAN, NAN, NAN}, 25.0f},
+      // Only one of the three newest hours
+      {POLLUTANT_PM25, {NAN, NAN, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15}, NAN},
+  };
+  for (size_t i = 0; i < sizeof(examples) / sizeof(examples[0]); i++)
+  {
+    float c = nowCast(examples[i].pollutant, examples[i].hourly, NOWCAST_HOURS);
+    if (isnan(examples[i].expected))
+      TEST_ASSERT_FLOAT_IS_NAN(c);
+    else
+      TEST_ASSERT_FLOAT_WITHIN(1e-4f, examples[i].expected, c);
+  }
+
+  TEST_ASSERT_EQUAL_INT(-1, nowCastAQI(NAN, NAN));
+  TEST_ASSERT_EQUAL_INT(airQualityIndex(58.5f, 83.0f), nowCastAQI(58.5f, 83.0f));
+}
+
+int main(int argc, char **argv)
+{
+  UNITY_BEGIN();
+  RUN_TEST(test_heat_index);
+  RUN_TEST(test_dew_point);
+  RUN_TEST(test_pressure_msl);
+  RUN_TEST(test_aqi);
+  RUN_TEST(test_nowcast_examples);
+  return UNITY_END();
+}
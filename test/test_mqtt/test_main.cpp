@@ -0,0 +1,112 @@
+/*
+ * MQTT Client - against the broker stand-in of the loopback network: a
+ * publish outside of the pipeline is acknowledged right away, also with
+ * unacknowledged publishes of an earlier connection still in flight.
+ *
+ * pio test -e native -f test_mqtt
+ */
+
+#include <Arduino.h>
+#include <unity.h>
+
+#include <sys/stat.h>
+
+#include "hal.h"
+#include "mqtt.h"
+#include "native.h"
+
+#define TOPIC "weatherstation/24A1600DF00D/readings"
+
+class TextPayload : public Payload
+{
+public:
+  TextPayload(const char *text) : text(text) {}
+  size_t length() { return strlen(text); }
+  void writeTo(Print &out) { out.write((const uint8_t *)text, strlen(text)); }
+
+private:
+  const char *text;
+};
+
+static Network &network = getNetwork();
+static MQTTClient mqtt(network);
+
+static void connect()
+{
+  network.begin("test", "", true);
+  TEST_ASSERT_TRUE(network.waitConnected(30000));
+  TEST_ASSERT_TRUE(mqtt.connect("test.local", 8883, true, "weatherstation-test", "24A1600DF00D", "secret"));
+}
+
+/* Publishes the broker received, one line each */
+static int published()
+{
+  char path[256];
+  FILE *f = fopen(nativePath("outbox.jsonl", path, sizeof(path)), "r");
+  if (!f)
+    return 0;
+  int lines = 0;
+  for (int c; (c = fgetc(f)) != EOF;)
+    lines += c == '\n';
+  fclose(f);
+  return lines;
+}
+
+static void clearOutbox()
+{
+  char path[256];
+  remove(nativePath("outbox.jsonl", path, sizeof(path)));
+}
+
+void setUp(void)
+{
+  mkdir(nativeRoot(), 0755);
+  clearOutbox();
+  mqtt.clearInflight();
+}
+
+void tearDown(void)
+{
+  mqtt.disconnect();
+  network.end();
+}
+
+void test_publish_and_wait(void)
+{
+  TextPayload payload("{\"data\":[]}");
+  connect();
+  uint32_t start = millis();
+  TEST_ASSERT_TRUE(mqtt.publishAndWait(TOPIC, payload));
+  TEST_ASSERT_LESS_THAN_UINT32(MQTT_TIMEOUT, millis() - start);
+  TEST_ASSERT_EQUAL_UINT8(0, mqtt.inflight());
+  TEST_ASSERT_EQUAL_INT(1, published());
+}
+
+void test_publish_and_wait_after_earlier_wake(void)
+{
+  // Two publishes whose acknowledgements are lost with the connection
+  TextPayload queued("{\"data\":[{\"queued\":1}]}");
+  connect();
+  TEST_ASSERT_TRUE(mqtt.publish(TOPIC, queued, 12));
+  TEST_ASSERT_TRUE(mqtt.publish(TOPIC, queued, 12));
+  network.end();
+  TEST_ASSERT_EQUAL_UINT8(2, mqtt.inflight());
+  clearOutbox();
+
+  // The next wake replays the backlog before the queue
+  TextPayload backlog("{\"data\":[{\"backlog\":1}]}");
+  connect();
+  uint32_t start = millis();
+  TEST_ASSERT_TRUE(mqtt.publishAndWait(TOPIC, backlog));
+  TEST_ASSERT_LESS_THAN_UINT32(MQTT_TIMEOUT, millis() - start);
+  TEST_ASSERT_EQUAL_UINT8(0, mqtt.inflight());
+  TEST_ASSERT_EQUAL_INT(1, published());
+}
+
+int main(int argc, char **argv)
+{
+  UNITY_BEGIN();
+  RUN_TEST(test_publish_and_wait);
+  RUN_TEST(test_publish_and_wait_after_earlier_wake);
+  return UNITY_END();
+}
@@ -0,0 +1,253 @@
+/*
+ * PMS7003 Frame Parser - crafted byte streams with the faults of a real
+ * UART: torn frames, bad checksums, start bytes inside the data and wrong
+ * length fields. Checks the decoded frames and the parser statistics.
+ *
+ * pio test -e native -f test_pms7003
+ */
+
+#include <Arduino.h>
+#include <unity.h>
+
+#include <vector>
+
+#include "pms7003.h"
+
+typedef std::vector<uint8_t> Bytes;
+
+/* Reading n, no byte of it is a start byte (0x42) */
+static ParticleReading reading(uint16_t n)
+{
+  ParticleReading r;
+  r.pm1_0 = n;
+  r.pm2_5 = n + 1;
+  r.pm10_0 = n + 2;
+  r.gt0_3 = 1000 + n;
+  r.gt0_5 = 500 + n;
+  r.gt1_0 = 100 + n;
+  r.gt2_5 = 10 + n;
+  r.gt5_0 = 5;
+  r.gt10_0 = 1;
+  r.hwVersion = 0x80;
+  r.errorCode = 0;
+  return r;
+}
+
+static void append(Bytes &stream, const ParticleReading &r)
+{
+  uint8_t frame[PMS7003_FRAME_SIZE];
+  pms7003Frame(r, frame);
+  stream.insert(stream.end(), frame, frame + sizeof(frame));
+}
+
+/* Feed the stream in chunks of the given size, returns the frames completed */
+static size_t feed(PMS7003Parser &parser, const Bytes &stream, size_t chunk)
+{
+  size_t completed = 0;
+  for (size_t i = 0; i < stream.size(); i += chunk)
+    completed += parser.feed(stream.data() + i, i + chunk < stream.size() ? chunk : stream.size() - i);
+  return completed;
+}
+
+static void assertReading(uint16_t n, PMS7003Parser &parser)
+{
+  ParticleReading expected = reading(n);
+  ParticleReading frame;
+  TEST_ASSERT_TRUE(parser.read(frame));
+  TEST_ASSERT_EQUAL_UINT16(expected.pm1_0, frame.pm1_0);
+  TEST_ASSERT_EQUAL_UINT16(expected.pm2_5, frame.pm2_5);
+  TEST_ASSERT_EQUAL_UINT16(expected.pm10_0, frame.pm10_0);
+  TEST_ASSERT_EQUAL_UINT16(expected.gt0_3, frame.gt0_3);
+  TEST_ASSERT_EQUAL_UINT16(expected.gt0_5, frame.gt0_5);
+  TEST_ASSERT_EQUAL_UINT16(expected.gt1_0, frame.gt1_0);
+  TEST_ASSERT_EQUAL_UINT16(expected.gt2_5, frame.gt2_5);
+  TEST_ASSERT_EQUAL_UINT16(expected.gt5_0, frame.gt5_0);
+  TEST_ASSERT_EQUAL_UINT16(expected.gt10_0, frame.gt10_0);
+  TEST_ASSERT_EQUAL_UINT8(expected.hwVersion, frame.hwVersion);
+  TEST_ASSERT_EQUAL_UINT8(expected.errorCode, frame.errorCode);
+}
+
+static void assertStatistics(PMS7003Parser &parser, uint32_t frames, uint32_t checksumErrors, uint32_t skippedBytes)
+{
+  TEST_ASSERT_EQUAL_UINT32(frames, parser.frames);
+  TEST_ASSERT_EQUAL_UINT32(checksumErrors, parser.checksumErrors);
+  TEST_ASSERT_EQUAL_UINT32(skippedBytes, parser.skippedBytes);
+  TEST_ASSERT_EQUAL_UINT32(0, parser.overruns);
+}
+
+void setUp(void)
+{
+}
+
+void tearDown(void)
+{
+}
+
+void test_clean_stream_in_any_chunks(void)
+{
+  Bytes stream;
+  for (uint16_t n = 10; n < 13; n++)
+    append(stream, reading(n));
+
+  const size_t chunks[] = {1, 2, 7, 31, 32, 33, 96};
+  for (size_t c = 0; c < sizeof(chunks) / sizeof(chunks[0]); c++)
+  {
+    PMS7003Parser parser;
+    TEST_ASSERT_EQUAL(3, feed(parser, stream, chunks[c]));
+    assertStatistics(parser, 3, 0, 0);
+    for (uint16_t n = 10; n < 13; n++)
+      assertReading(n, parser);
+    TEST_ASSERT_EQUAL(0, parser.available());
+  }
+}
+
+void test_bad_checksum(void)
+{
+  Bytes stream;
+  append(stream, reading(20));
+  stream[7] ^= 0x01; // PM2.5 of the first frame
+  append(stream, reading(21));
+
+  PMS7003Parser parser;
+  TEST_ASSERT_EQUAL(1, feed(parser, stream, 5));
+  assertStatistics(parser, 1, 1, PMS7003_FRAME_SIZE);
+  assertReading(21, parser);
+  TEST_ASSERT_EQUAL(0, parser.available());
+}
+
+void test_torn_frame(void)
+{
+  // A frame cut off after 17 bytes, e.g. the sensor lost power
+  Bytes stream;
+  append(stream, reading(30));
+  stream.resize(17);
+  append(stream, reading(31));
+  append(stream, reading(32));
+
+  // The torn frame takes the start of the next one, which is found again
+  // after its checksum failed
+  PMS7003Parser parser;
+  TEST_ASSERT_EQUAL(2, feed(parser, stream, 3));
+  assertStatistics(parser, 2, 1, 17);
+  assertReading(31, parser);
+  assertReading(32, parser);
+}
+
+void test_start_bytes_in_data(void)
+{
+  // Valid frames with the start sequence in their data
+  ParticleReading spurious = reading(40);
+  spurious.pm2_5 = (PMS7003_START_1 << 8) | PMS7003_START_2;
+  spurious.gt0_3 = PMS7003_START_1;
+  spurious.gt0_5 = PMS7003_FRAME_LENGTH;
+
+  Bytes stream;
+  append(stream, spurious);
+  append(stream, reading(41));
+
+  PMS7003Parser parser;
+  TEST_ASSERT_EQUAL(2, feed(parser, stream, 1));
+  assertStatistics(parser, 2, 0, 0);
+  ParticleReading frame;
+  TEST_ASSERT_TRUE(parser.read(frame));
+  TEST_ASSERT_EQUAL_UINT16(spurious.pm2_5, frame.pm2_5);
+  TEST_ASSERT_EQUAL_UINT16(spurious.gt0_3, frame.gt0_3);
+  assertReading(41, parser);
+}
+
+void test_start_sequence_in_corrupt_frame(void)
+{
+  // A corrupt frame with a plausible frame start (0x42 0x4D 0x00 0x1C) at
+  // byte 12. After the checksum error the parser tries it as a frame, which
+  // takes the start of the next frame and fails as well.
+  Bytes stream;
+  append(stream, reading(50));
+  stream[12] = PMS7003_START_1;
+  stream[13] = PMS7003_START_2;
+  stream[14] = 0x00;
+  stream[15] = PMS7003_FRAME_LENGTH;
+  append(stream, reading(51));
+  append(stream, reading(52));
+
+  PMS7003Parser parser;
+  TEST_ASSERT_EQUAL(2, feed(parser, stream, 4));
+  assertStatistics(parser, 2, 2, PMS7003_FRAME_SIZE);
+  assertReading(51, parser);
+  assertReading(52, parser);
+}
+
+void test_spurious_start_byte(void)
+{
+  // Noise of a single start byte in front of a frame
+  Bytes stream;
+  stream.push_back(PMS7003_START_1);
+  append(stream, reading(60));
+
+  PMS7003Parser parser;
+  TEST_ASSERT_EQUAL(1, feed(parser, stream, 1));
+  assertStatistics(parser, 1, 0, 1);
+  assertReading(60, parser);
+}
+
+void test_wrong_length(void)
+{
+  Bytes stream;
+  append(stream, reading(70));
+  stream[3] = PMS7003_FRAME_LENGTH + 1;
+  append(stream, reading(71));
+  append(stream, reading(72));
+  stream[64 + 2] = 0x01; // length 284
+  append(stream, reading(73));
+
+  // Frames with a wrong length are dropped without waiting for a checksum
+  PMS7003Parser parser;
+  TEST_ASSERT_EQUAL(2, feed(parser, stream, 6));
+  assertStatistics(parser, 2, 0, 2 * PMS7003_FRAME_SIZE);
+  assertReading(71, parser);
+  assertReading(73, parser);
+}
+
+void test_overrun_keeps_newest(void)
+{
+  Bytes stream;
+  for (uint16_t n = 80; n < 80 + PMS7003_QUEUE_SIZE + 2; n++)
+    append(stream, reading(n));
+
+  PMS7003Parser parser;
+  TEST_ASSERT_EQUAL(PMS7003_QUEUE_SIZE + 2, feed(parser, stream, 32));
+  TEST_ASSERT_EQUAL_UINT32(2, parser.overruns);
+  TEST_ASSERT_EQUAL(PMS7003_QUEUE_SIZE, parser.available());
+  for (uint16_t n = 82; n < 80 + PMS7003_QUEUE_SIZE + 2; n++)
+    assertReading(n, parser);
+  ParticleReading frame;
+  TEST_ASSERT_FALSE(parser.read(frame));
+}
+
+void test_reset_drops_partial_frame(void)
+{
+  Bytes stream;
+  append(stream, reading(90));
+  append(stream, reading(91));
+
+  PMS7003Parser parser;
+  TEST_ASSERT_EQUAL(0, parser.feed(stream.data(), 20));
+  parser.reset();
+  TEST_ASSERT_EQUAL(1, parser.feed(stream.data() + 32, 32));
+  assertReading(91, parser);
+  TEST_ASSERT_EQUAL_UINT32(0, parser.checksumErrors);
+}
+
+int main(int argc, char **argv)
+{
+  UNITY_BEGIN();
+  RUN_TEST(test_clean_stream_in_any_chunks);
+  RUN_TEST(test_bad_checksum);
+  RUN_TEST(test_torn_frame);
+  RUN_TEST(test_start_bytes_in_data);
+  RUN_TEST(test_start_sequence_in_corrupt_frame);
+  RUN_TEST(test_spurious_start_byte);
+  RUN_TEST(test_wrong_length);
+  RUN_TEST(test_overrun_keeps_newest);
+  RUN_TEST(test_reset_drops_partial_frame);
+  return UNITY_END();
+}
@@ -0,0 +1,87 @@
+/*
+ * Wake Cycle Profiler - durations are kept in 16 bits in RTC memory, the
+ * statistics must stay within the documented resolution.
+ *
+ * pio test -e native -f test_profiler
+ */
+
+#include <Arduino.h>
+#include <unity.h>
+
+#include "profiler.h"
+
+/* Commit one wake with the phase running for ms (simulated delay) */
+static void wake(Phase phase, unsigned long ms)
+{
+  profileStart(phase);
+  delay(ms);
+  profileEnd(phase);
+  profileCommit();
+}
+
+void setUp(void)
+{
+}
+
+void tearDown(void)
+{
+}
+
+void test_rolling_window(void)
+{
+  // 1 to 40 ms, the window keeps the last 32 wakes
+  for (unsigned long ms = 1; ms <= 40; ms++)
+    wake(PHASE_POST, ms);
+
+  PhaseStats stats;
+  TEST_ASSERT_TRUE(profileStats(PHASE_POST, stats));
+  TEST_ASSERT_EQUAL(PROFILE_WINDOW, stats.samples);
+  TEST_ASSERT_FLOAT_WITHIN(9000 * 0.0003f + 50, 9000, stats.min);
+  TEST_ASSERT_FLOAT_WITHIN(40000 * 0.0003f + 50, 40000, stats.max);
+  TEST_ASSERT_FLOAT_WITHIN(24500 * 0.0003f + 50, 24500, stats.mean);
+  TEST_ASSERT_FLOAT_WITHIN(39000 * 0.0003f + 50, 39000, stats.p95);
+}
+
+void test_long_phase(void)
+{
+  wake(PHASE_WARMUP, 30000);
+  PhaseStats stats;
+  TEST_ASSERT_TRUE(profileStats(PHASE_WARMUP, stats));
+  TEST_ASSERT_FLOAT_WITHIN(30e6 * 0.00025f + 50, 30e6, stats.max);
+}
+
+void test_longest_phase(void)
+{
+  wake(PHASE_NTP, 200000);
+  PhaseStats stats;
+  TEST_ASSERT_TRUE(profileStats(PHASE_NTP, stats));
+  TEST_ASSERT_EQUAL_UINT32(PROFILE_TIME_MAX, stats.max);
+}
+
+void test_short_phase(void)
+{
+  // Exact below 4.1 ms, only the real time of the call itself
+  wake(PHASE_RTC_INIT, 0);
+  PhaseStats stats;
+  TEST_ASSERT_TRUE(profileStats(PHASE_RTC_INIT, stats));
+  TEST_ASSERT_LESS_THAN(4096, stats.max);
+  TEST_ASSERT_EQUAL_UINT32(profileTime(PHASE_RTC_INIT), 0);
+}
+
+void test_phase_without_samples(void)
+{
+  PhaseStats stats;
+  TEST_ASSERT_FALSE(profileStats(PHASE_SD_MOUNT, stats));
+  TEST_ASSERT_EQUAL(0, stats.samples);
+}
+
+int main(int argc, char **argv)
+{
+  UNITY_BEGIN();
+  RUN_TEST(test_rolling_window);
+  RUN_TEST(test_long_phase);
+  RUN_TEST(test_longest_phase);
+  RUN_TEST(test_short_phase);
+  RUN_TEST(test_phase_without_samples);
+  return UNITY_END();
+}
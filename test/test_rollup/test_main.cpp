@@ -0,0 +1,121 @@
+/*
+ * Hourly and Daily Rollups - readings without particle sensor data must
+ * not pull the PM and AQI statistics towards 0.
+ *
+ * pio test -e native -f test_rollup
+ */
+
+#include <Arduino.h>
+#include <unity.h>
+
+#include "particles.h"
+#include "rollup.h"
+
+static const uint32_t HOUR = 1710028800; // 2024-03-10 00:00
+
+/* Rollup field of a record field ID */
+static uint8_t fieldOf(uint8_t id)
+{
+  for (uint8_t i = 0; i < ROLLUP_FIELD_COUNT; i++)
+  {
+    if (rollupField(i).id == id)
+      return i;
+  }
+  TEST_FAIL_MESSAGE("no rollup for the field");
+  return 0;
+}
+
+static SensorRecord reading(uint32_t timestamp, uint16_t pm2_5, int16_t status)
+{
+  SensorRecord record = {};
+  record.timestamp = timestamp;
+  record.temperature = 20.0f;
+  record.pm2_5 = pm2_5;
+  record.pm10_0 = pm2_5 + 5;
+  record.aqi = status == PARTICLE_NO_DATA ? -1 : 50;
+  record.battery = 3.9f;
+  record.particleStatus = status;
+  return record;
+}
+
+/* Close the running hour with a reading of the next one */
+static Rollup closeHour(uint32_t start)
+{
+  Rollup closed[ROLLUP_PERIODS];
+  uint8_t count = rollupAdd(reading(start + 3600, 1, PARTICLE_STABLE), closed);
+  TEST_ASSERT_GREATER_OR_EQUAL(1, count);
+  TEST_ASSERT_EQUAL(ROLLUP_HOUR, closed[0].period);
+  return closed[0];
+}
+
+void setUp(void)
+{
+}
+
+void tearDown(void)
+{
+}
+
+void test_particles_without_data(void)
+{
+  Rollup closed[ROLLUP_PERIODS];
+  uint32_t start = HOUR + 10 * 3600;
+  rollupAdd(reading(start + 300, 10, PARTICLE_STABLE), closed);
+  rollupAdd(reading(start + 600, 0, PARTICLE_NO_DATA), closed);
+  rollupAdd(reading(start + 900, 20, PARTICLE_TIMEOUT), closed);
+  rollupAdd(reading(start + 1200, 0, PARTICLE_NO_DATA), closed);
+
+  Rollup hour = closeHour(start);
+  TEST_ASSERT_EQUAL(4, hour.count);
+  TEST_ASSERT_EQUAL(4, hour.stats[fieldOf(1)].count);
+  TEST_ASSERT_FLOAT_WITHIN(0.001f, 20.0f, rollupMean(hour, 1));
+
+  // Only the two readings with particle data
+  uint8_t pm = fieldOf(RECORD_ID_PM2_5);
+  TEST_ASSERT_EQUAL(2, hour.stats[pm].count);
+  TEST_ASSERT_FLOAT_WITHIN(0.001f, 15.0f, rollupMean(hour, RECORD_ID_PM2_5));
+  TEST_ASSERT_FLOAT_WITHIN(0.001f, 20.0f, rollupMean(hour, RECORD_ID_PM10_0));
+  TEST_ASSERT_FLOAT_WITHIN(0.001f, 10.0f, hour.stats[pm].min);
+  TEST_ASSERT_FLOAT_WITHIN(0.001f, 20.0f, hour.stats[pm].max);
+  TEST_ASSERT_FLOAT_WITHIN(0.001f, 7.0711f, rollupStddev(hour, pm));
+  TEST_ASSERT_FLOAT_WITHIN(0.001f, 50.0f, rollupMean(hour, RECORD_ID_AQI));
+}
+
+void test_hour_without_particle_data(void)
+{
+  Rollup closed[ROLLUP_PERIODS];
+  uint32_t start = HOUR + 12 * 3600;
+  rollupAdd(reading(start + 300, 0, PARTICLE_NO_DATA), closed);
+  rollupAdd(reading(start + 600, 0, PARTICLE_NO_DATA), closed);
+
+  // No average for the NowCast instead of 0
+  Rollup hour = closeHour(start);
+  TEST_ASSERT_EQUAL(2, hour.count);
+  TEST_ASSERT_FLOAT_IS_NAN(rollupMean(hour, RECORD_ID_PM2_5));
+  TEST_ASSERT_FLOAT_IS_NAN(rollupMean(hour, RECORD_ID_AQI));
+  TEST_ASSERT_FLOAT_WITHIN(0.001f, 3.9f, rollupMean(hour, 22));
+
+  // The summary rows leave the field empty
+  char buffer[ROLLUP_BUFFER_SIZE];
+  TEST_ASSERT_GREATER_THAN(0, formatRollupRows(buffer, sizeof(buffer), hour));
+  TEST_ASSERT_NOT_NULL(strstr(buffer, "\"PM2.5 [ug/m3]\",nan,"));
+}
+
+void test_older_readings(void)
+{
+  // Readings from before the status was logged have particle data
+  Rollup closed[ROLLUP_PERIODS];
+  uint32_t start = HOUR + 14 * 3600;
+  rollupAdd(reading(start + 300, 12, 0), closed);
+  Rollup hour = closeHour(start);
+  TEST_ASSERT_FLOAT_WITHIN(0.001f, 12.0f, rollupMean(hour, RECORD_ID_PM2_5));
+}
+
+int main(int argc, char **argv)
+{
+  UNITY_BEGIN();
+  RUN_TEST(test_particles_without_data);
+  RUN_TEST(test_hour_without_particle_data);
+  RUN_TEST(test_older_readings);
+  return UNITY_END();
+}
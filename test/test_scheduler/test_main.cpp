@@ -0,0 +1,69 @@
+/*
+ * Adaptive Sampling Scheduler - the sleep timer drift is learned from the
+ * time slept on the PCF8523, for short sleeps as well as for sleeps of more
+ * than 71 minutes, whose microseconds do not fit into 32 bits.
+ *
+ * pio test -e native -f test_scheduler
+ */
+
+#include <Arduino.h>
+#include <unity.h>
+
+#include "scheduler.h"
+
+#define DRIFT 1.03       // real seconds per second of the sleep timer
+#define BOOT_MILLIS 500  // from reset to the clock read
+
+static const uint32_t START = 1710028800; // 2024-03-10 00:00
+
+/* Sleep for the interval and wake again, returns the clock of the wake */
+static uint32_t sleepAndWake(uint32_t interval, uint32_t clock)
+{
+  SchedulePolicy policy = {interval, interval, interval, 0, 0, 0, 0};
+  uint32_t timestamp = scheduleWake(clock, BOOT_MILLIS);
+  uint64_t micros = scheduleSleep(policy, timestamp, interval, clock + 1);
+  double slept = micros / 1e6 * DRIFT;
+  return (uint32_t)(clock + 1 + slept + BOOT_MILLIS / 1000.0);
+}
+
+static void learnDrift(uint32_t interval)
+{
+  uint32_t clock = START;
+  for (int wake = 0; wake < 6; wake++)
+    clock = sleepAndWake(interval, clock);
+  scheduleWake(clock, BOOT_MILLIS);
+
+  // The wake is on the grid of the interval
+  TEST_ASSERT_EQUAL_UINT32(0, scheduleTarget() % interval);
+  TEST_ASSERT_UINT32_WITHIN(1, scheduleTarget(), clock);
+}
+
+void setUp(void)
+{
+}
+
+void tearDown(void)
+{
+}
+
+void test_long_sleeps(void)
+{
+  // 2 hours, 7.2e9 microseconds
+  TEST_ASSERT_EQUAL_FLOAT(1.0f, scheduleDrift());
+  learnDrift(7200);
+  TEST_ASSERT_FLOAT_WITHIN(0.002f, DRIFT, scheduleDrift());
+}
+
+void test_short_sleeps(void)
+{
+  learnDrift(300);
+  TEST_ASSERT_FLOAT_WITHIN(0.005f, DRIFT, scheduleDrift());
+}
+
+int main(int argc, char **argv)
+{
+  UNITY_BEGIN();
+  RUN_TEST(test_long_sleeps);
+  RUN_TEST(test_short_sleeps);
+  return UNITY_END();
+}
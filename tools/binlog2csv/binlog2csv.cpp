@@ -0,0 +1,167 @@
+/*
+ * Binary Record Log Exporter
+ *
+ * Converts binary daily logs (/YYYY/MM/YYYY-MM-DD.bin) back into the CSV
+ * layout of the daily .csv files, or into JSON lines for analysis tools.
+ * Output goes to stdout, so a year of data can be streamed with
+ *
+ *   binlog2csv $(find /sdcard/2024 -name "*.bin" | sort) > 2024.csv
+ *
+ * pio run -e binlog2csv && .pio/build/binlog2csv/program [--jsonl] <file.bin>...
+ */
+
+#include <Arduino.h>
+
+#include <vector>
+
+#include "binlog.h"
+
+static bool readFile(const char *path, std::vector<uint8_t> &data)
+{
+  FILE *f = fopen(path, "rb");
+  if (!f)
+    return false;
+  uint8_t buffer[4096];
+  size_t n;
+  while ((n = fread(buffer, 1, sizeof(buffer), f)) > 0)
+    data.insert(data.end(), buffer, buffer + n);
+  fclose(f);
+  return true;
+}
+
+static void writeCSVHeader(const BinlogSchema &schema)
+{
+  printf("\"%s\"", RECORD_TIME);
+  for (uint16_t i = 0; i < schema.fieldCount; i++)
+    printf(",\"%s\"", schema.fields[i].label);
+  printf("\r\n");
+}
+
+/* Same columns, a CSV header is written again when they change */
+static bool sameSchema(const BinlogSchema &a, const BinlogSchema &b)
+{
+  if (a.fieldCount != b.fieldCount)
+    return false;
+  for (uint16_t i = 0; i < a.fieldCount; i++)
+  {
+    if (strcmp(a.fields[i].label, b.fields[i].label) != 0)
+      return false;
+  }
+  return true;
+}
+
+static void writeCSVRow(const BinlogSchema &schema, uint32_t timestamp, const float *values)
+{
+  char iso8601[25];
+  char number[32];
+  fputs(formatTimestamp(timestamp, iso8601), stdout);
+  for (uint16_t i = 0; i < schema.fieldCount; i++)
+  {
+    formatFixed(number, sizeof(number), values[i], schema.fields[i].precision);
+    putchar(',');
+    fputs(number, stdout);
+  }
+  printf("\r\n");
+}
+
+static void writeJSONLine(const BinlogSchema &schema, uint32_t timestamp, const float *values)
+{
+  char iso8601[25];
+  printf("{\"created_at\":\"%s\",\"timestamp\":%lu", formatTimestamp(timestamp, iso8601), (unsigned long)timestamp);
+  for (uint16_t i = 0; i < schema.fieldCount; i++)
+  {
+    if (isnan(values[i]) || isinf(values[i]))
+      printf(",\"%s\":null", schema.fields[i].label);
+    else
+      printf(",\"%s\":%.*f", schema.fields[i].label, schema.fields[i].precision, values[i]);
+  }
+  printf("}\n");
+}
+
+int main(int argc, char **argv)
+{
+  bool jsonl = false;
+  static BinlogSchema written;
+  int errors = 0;
+
+  for (int a = 1; a < argc; a++)
+  {
+    if (strcmp(argv[a], "--jsonl") == 0)
+    {
+      jsonl = true;
+      continue;
+    }
+
+    std::vector<uint8_t> data;
+    if (!readFile(argv[a], data))
+    {
+      fprintf(stderr, "%s: cannot read file\n", argv[a]);
+      errors++;
+      continue;
+    }
+
+    // A file starts with a header, a new one follows when the schema changed
+    static BinlogSchema schema;
+    size_t pos = binlogParseHeader(data.data(), data.size(), schema);
+    if (pos == 0)
+    {
+      fprintf(stderr, "%s: not a binary log or unsupported version\n", argv[a]);
+      errors++;
+      continue;
+    }
+
+    float values[BINLOG_MAX_FIELDS];
+    size_t skipped = 0;
+    while (true)
+    {
+      if (!jsonl && !sameSchema(schema, written))
+      {
+        writeCSVHeader(schema);
+        written = schema;
+      }
+
+      while (pos < data.size())
+      {
+        size_t headerLen = binlogParseHeader(data.data() + pos, data.size() - pos, schema);
+        if (headerLen > 0)
+        {
+          pos += headerLen;
+          break;
+        }
+
+        uint16_t count = 0;
+        size_t blockLen = binlogParseBlock(data.data() + pos, data.size() - pos, schema, count);
+        if (blockLen == 0)
+        {
+          // Corrupt or torn block, resynchronize on the next sync word
+          pos++;
+          skipped++;
+          continue;
+        }
+
+        for (uint16_t r = 0; r < count; r++)
+        {
+          uint32_t timestamp;
+          binlogDecodeRecord(data.data() + pos + BINLOG_BLOCK_HEADER_SIZE + (size_t)r * schema.recordSize, schema, timestamp, values);
+          if (jsonl)
+            writeJSONLine(schema, timestamp, values);
+          else
+            writeCSVRow(schema, timestamp, values);
+        }
+        pos += blockLen;
+      }
+      if (pos >= data.size())
+        break;
+    }
+
+    if (skipped > 0)
+      fprintf(stderr, "%s: skipped %lu bytes of corrupt data\n", argv[a], (unsigned long)skipped);
+  }
+
+  if (argc < 2)
+  {
+    fprintf(stderr, "Usage: %s [--jsonl] <file.bin>...\n", argv[0]);
+    return 2;
+  }
+  return errors > 0 ? 1 : 0;
+}
@@ -0,0 +1,262 @@
+#!/usr/bin/env python3
+"""
+MessagePack Upload Decoder
+
+Decodes the compact uploads of the station ("encoding": "MSGPACK" or
+"COLUMNAR") into the same layout as the JSON uploads, so a server can
+accept all of them. Uses only the standard library; import it or run it
+on a file of concatenated payloads (like outbox.msgpack of the native
+build) to get JSON lines:
+
+  python3 tools/msgpackdecode/msgpackdecode.py outbox.msgpack
+
+  from msgpackdecode import decode_upload
+  upload = decode_upload(request_body)   # {"token": ..., "data": [...]}
+
+Payload (schema version 1), a map with the keys
+  0  schema version
+  1  device ID
+  2  API token (REST only)
+  3  array of readings, maps from field ID to value, 0 is the timestamp
+  4  wake cycle statistics (optional, same keys as in JSON)
+  5  readings as columnar batch ("encoding": "COLUMNAR", instead of 3),
+     see lib/columnar/columnar.h
+  6  hourly and daily rollups (instead of readings, same objects as in JSON)
+
+Field IDs are never renumbered, IDs this decoder does not know yet are
+passed on as "field <id>". Keep FIELDS in sync with RECORD_FIELDS in
+lib/record/record.h.
+"""
+
+import datetime
+import json
+import struct
+import sys
+
+SCHEMA_VERSION = 1
+
+FIELDS = {
+    1: "Temperature [C]",
+    2: "rel. Humidity [%]",
+    3: "Pressure [hPa]",
+    4: "Pressure (PMSL) [hPa]",
+    5: "Air [KOhms]",
+    6: "Heat Index [C]",
+    7: "Dew Point [C]",
+    8: "PM1.0 [ug/m3]",
+    9: "PM2.5 [ug/m3]",
+    10: "PM10.0 [ug/m3]",
+    11: ">0.3 [um/0.1L]",
+    12: ">0.5 [um/0.1L]",
+    13: ">1.0 [um/0.1L]",
+    14: ">2.5 [um/0.1L]",
+    15: ">5.0 [um/0.1L]",
+    16: ">10.0 [um/0.1L]",
+    17: "AQI",
+    18: "Light (visible)",
+    19: "Light (IR)",
+    20: "Light (UV)",
+    21: "UV-Index",
+    22: "Battery [V]",
+    23: "Samples",
+    24: "Temperature SD [C]",
+    25: "rel. Humidity SD [%]",
+    26: "Pressure SD [hPa]",
+    27: "Air SD [KOhms]",
+    28: "PM2.5 SD [ug/m3]",
+    29: "PM10.0 SD [ug/m3]",
+    30: "NowCast AQI",
+    31: "IAQ",
+    32: "IAQ Category",
+    33: "Particle Status",
+}
+
+
+class DecodeError(ValueError):
+    pass
+
+
+class Reader:
+    """MessagePack decoder for the types the station writes (no ext types)"""
+
+    def __init__(self, data, pos=0):
+        self.data = data
+        self.pos = pos
+
+    def take(self, n):
+        if self.pos + n > len(self.data):
+            raise DecodeError("truncated at byte %d" % self.pos)
+        chunk = self.data[self.pos:self.pos + n]
+        self.pos += n
+        return chunk
+
+    def unpack(self, fmt):
+        return struct.unpack(">" + fmt, self.take(struct.calcsize(">" + fmt)))[0]
+
+    def value(self):
+        b = self.take(1)[0]
+        if b <= 0x7f:
+            return b
+        if b >= 0xe0:
+            return b - 0x100
+        if 0x80 <= b <= 0x8f:
+            return self.map(b & 0x0f)
+        if 0x90 <= b <= 0x9f:
+            return [self.value() for _ in range(b & 0x0f)]
+        if 0xa0 <= b <= 0xbf:
+            return self.take(b & 0x1f).decode("utf-8")
+        simple = {0xc0: None, 0xc2: False, 0xc3: True}
+        if b in simple:
+            return simple[b]
+        numbers = {0xca: "f", 0xcb: "d", 0xcc: "B", 0xcd: "H", 0xce: "I", 0xcf: "Q",
+                   0xd0: "b", 0xd1: "h", 0xd2: "i", 0xd3: "q"}
+        if b in numbers:
+            return self.unpack(numbers[b])
+        sizes = {0xd9: "B", 0xda: "H", 0xdb: "I", 0xc4: "B", 0xc5: "H", 0xc6: "I"}
+        if b in sizes:
+            raw = self.take(self.unpack(sizes[b]))
+            return raw.decode("utf-8") if b >= 0xd9 else raw
+        if b in (0xdc, 0xdd):
+            return [self.value() for _ in range(self.unpack("H" if b == 0xdc else "I"))]
+        if b in (0xde, 0xdf):
+            return self.map(self.unpack("H" if b == 0xde else "I"))
+        raise DecodeError("unsupported type 0x%02x at byte %d" % (b, self.pos - 1))
+
+    def map(self, size):
+        result = {}
+        for _ in range(size):
+            key = self.value()
+            result[key] = self.value()
+        return result
+
+
+def varint(data, pos):
+    value = shift = 0
+    while True:
+        if pos >= len(data):
+            raise DecodeError("truncated columnar batch")
+        b = data[pos]
+        pos += 1
+        value |= (b & 0x7f) << shift
+        shift += 7
+        if not b & 0x80:
+            return value, pos
+
+
+def signed(data, pos):
+    value, pos = varint(data, pos)
+    return (value >> 1) ^ -(value & 1), pos
+
+
+def decode_columnar(data):
+    """Columnar batch to a list of maps from field ID to value"""
+    if not data or data[0] != 1:
+        raise DecodeError("unknown columnar version")
+    count, pos = varint(data, 1)
+    field_count = data[pos]
+    pos += 1
+    fields = [(data[pos + 2 * i], data[pos + 2 * i + 1]) for i in range(field_count)]
+    pos += 2 * field_count
+    rows = [{} for _ in range(count)]
+
+    t = delta = 0
+    for i in range(count):
+        if i == 0:
+            t, pos = varint(data, pos)
+        else:
+            diff, pos = signed(data, pos)
+            delta = diff if i == 1 else delta + diff
+            t += delta
+        rows[i][0] = t
+
+    for field, decimals in fields:
+        flags = data[pos]
+        pos += 1
+        missing = None
+        if flags & 1:
+            missing = data[pos:pos + (count + 7) // 8]
+            pos += (count + 7) // 8
+        scaled = None
+        for i in range(count):
+            if missing is not None and (missing[i // 8] >> (i % 8)) & 1:
+                rows[i][field] = None
+                continue
+            diff, pos = signed(data, pos)
+            scaled = diff if scaled is None else scaled + diff
+            rows[i][field] = scaled if decimals == 0 else round(scaled / 10 ** decimals, decimals)
+    if pos != len(data):
+        raise DecodeError("%d bytes after the columnar batch" % (len(data) - pos))
+    return rows
+
+
+def timestamp(seconds):
+    """Same format as the JSON "created_at" (the station clock is local time)"""
+    t = datetime.datetime(1970, 1, 1) + datetime.timedelta(seconds=seconds)
+    return t.strftime("%Y-%m-%dT%H:%M:%S.000Z")
+
+
+def reading(fields, device):
+    data = {}
+    for key, value in fields.items():
+        if key != 0:
+            data[FIELDS.get(key, "field %s" % key)] = value
+    if 0 in fields:
+        data["created_at"] = timestamp(fields[0])
+    data["device_id"] = device
+    return data
+
+
+def convert(payload):
+    """Decoded payload map to the layout of the JSON upload"""
+    if not isinstance(payload, dict) or payload.get(0) != SCHEMA_VERSION:
+        raise DecodeError("unknown schema version %r" % (payload.get(0) if isinstance(payload, dict) else None))
+    device = payload.get(1, "")
+    upload = {}
+    if 2 in payload:
+        upload["token"] = payload[2]
+    if 4 in payload:
+        upload["profile"] = payload[4]
+    if 6 in payload:
+        upload["device_id"] = device
+        upload["rollups"] = payload[6]
+        return upload
+    rows = decode_columnar(payload[5]) if 5 in payload else payload.get(3, [])
+    readings = [reading(r, device) for r in rows]
+    upload["data"] = readings[0] if len(readings) == 1 else readings
+    return upload
+
+
+def decode_upload(body):
+    """Decode one request body or MQTT message"""
+    reader = Reader(body)
+    upload = convert(reader.value())
+    if reader.pos != len(body):
+        raise DecodeError("%d bytes after the payload" % (len(body) - reader.pos))
+    return upload
+
+
+def decode_stream(data):
+    """Decode payloads written back to back"""
+    reader = Reader(data)
+    while reader.pos < len(data):
+        yield convert(reader.value())
+
+
+def main():
+    if len(sys.argv) < 2:
+        print("usage: msgpackdecode.py <file>...", file=sys.stderr)
+        return 2
+    for path in sys.argv[1:]:
+        with open(path, "rb") as f:
+            data = f.read()
+        try:
+            for upload in decode_stream(data):
+                print(json.dumps(upload))
+        except DecodeError as e:
+            print("%s: %s" % (path, e), file=sys.stderr)
+            return 1
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
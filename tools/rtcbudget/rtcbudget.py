@@ -0,0 +1,70 @@
+"""
+RTC Memory Budget
+
+PlatformIO post-build script. Sums the sections of the firmware that are
+kept in RTC slow memory during deep sleep (RTC_DATA_ATTR) and fails the
+build when they grow past custom_rtc_budget bytes of the environment.
+The ESP32 has 8 KB of RTC slow memory, part of it is reserved for the ULP
+coprocessor; the linker only fails once all of it is used up.
+
+  extra_scripts = post:tools/rtcbudget/rtcbudget.py
+  custom_rtc_budget = 7168
+
+The native build keeps RTC_DATA_ATTR variables in its rtc_data section,
+which is checked the same way. Run on an ELF file it prints the sections:
+
+  python3 tools/rtcbudget/rtcbudget.py .pio/build/featheresp32/firmware.elf
+"""
+
+import subprocess
+import sys
+
+# Output sections in RTC slow memory (ESP32) and of the native build
+RTC_SECTIONS = (".rtc.data", ".rtc.bss", ".rtc_noinit", ".rtc.force_slow", "rtc_data")
+
+
+def rtc_sections(size_tool, elf):
+    """Sizes of the RTC sections of an ELF file, by name"""
+    output = subprocess.check_output([size_tool, "-A", elf], universal_newlines=True)
+    sections = {}
+    for line in output.splitlines():
+        fields = line.split()
+        if len(fields) >= 2 and fields[0] in RTC_SECTIONS and fields[1].isdigit():
+            sections[fields[0]] = int(fields[1])
+    return sections
+
+
+def report(sections, budget=None):
+    """Print the usage, returns False if it is over the budget"""
+    used = sum(sections.values())
+    detail = ", ".join("%s %d" % item for item in sorted(sections.items()))
+    if budget is None:
+        print("RTC memory: %d bytes (%s)" % (used, detail or "no RTC sections"))
+        return True
+    print("RTC memory: %d of %d bytes (%s)" % (used, budget, detail or "no RTC sections"))
+    if used > budget:
+        sys.stderr.write("Error: RTC memory over budget by %d bytes, see custom_rtc_budget\n" % (used - budget))
+        return False
+    return True
+
+
+def check_rtc_budget(source, target, env):
+    budget = int(env.GetProjectOption("custom_rtc_budget", "7168"))
+    size_tool = env.subst("$SIZETOOL") or "size"
+    if not report(rtc_sections(size_tool, str(target[0])), budget):
+        env.Exit(1)
+
+
+try:
+    Import("env")  # noqa: F821 - defined when PlatformIO runs the script
+except NameError:
+    env = None
+
+if env is not None:
+    env.AddPostAction("$PROGPATH", check_rtc_budget)
+else:
+    if len(sys.argv) < 2:
+        sys.stderr.write("Usage: %s <firmware.elf> [budget]\n" % sys.argv[0])
+        sys.exit(2)
+    ok = report(rtc_sections("size", sys.argv[1]), int(sys.argv[2]) if len(sys.argv) > 2 else None)
+    sys.exit(0 if ok else 1)
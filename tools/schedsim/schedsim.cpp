@@ -0,0 +1,273 @@
+/*
+ * Sampling Scheduler Simulator
+ *
+ * Replays daily CSV files of the station (/YYYY/MM/YYYY-MM-DD.csv) as the
+ * ground truth and samples them like the station would, with fixed
+ * intervals and with the adaptive scheduler of lib/scheduler. For every
+ * policy it prints the readings and the energy per day, and how well the
+ * readings capture the logged data: the readings are interpolated linearly
+ * and compared with every logged row (RMS and largest error). The logs
+ * should be written at a shorter interval than the shortest one simulated.
+ *
+ * A wake takes the logged rows interpolated to its time. The energy model is a
+ * wake of --wake-seconds at --wake-ma and deep sleep at --sleep-ma, the
+ * battery voltage is taken from the logs unless --battery is given.
+ *
+ *   schedsim --interval 5 --min 2 --max 15 $(find /sdcard/2024/03 -name "*.csv" | sort)
+ *
+ * pio run -e schedsim && .pio/build/schedsim/program [options] <day.csv>...
+ */
+
+#include <Arduino.h>
+
+#include <algorithm>
+#include <vector>
+
+#include "record.h"
+#include "scheduler.h"
+
+#define CHANNEL_COUNT 3
+
+static const char *CHANNEL_NAMES[CHANNEL_COUNT] = {"Temperature", "Pressure", "PM2.5"};
+
+static float channel(const SensorRecord &record, int c)
+{
+  return c == 0 ? record.temperature : c == 1 ? record.pressure : record.pm2_5;
+}
+
+/* Logged row a with the channels and the battery interpolated towards row b at time t */
+static SensorRecord interpolate(const SensorRecord &a, const SensorRecord &b, uint32_t t)
+{
+  SensorRecord record = a;
+  record.timestamp = t;
+  if (b.timestamp <= a.timestamp || t <= a.timestamp)
+    return record;
+  float w = (float)(t - a.timestamp) / (b.timestamp - a.timestamp);
+  record.temperature += w * (b.temperature - a.temperature);
+  record.pressure += w * (b.pressure - a.pressure);
+  record.pm2_5 = round(a.pm2_5 + w * ((float)b.pm2_5 - a.pm2_5));
+  record.battery += w * (b.battery - a.battery);
+  return record;
+}
+
+/* Position of a label in RECORD_FIELDS, or -1 */
+static int fieldIndex(const char *label)
+{
+  for (size_t i = 0; i < RECORD_FIELD_COUNT; i++)
+  {
+    if (strcmp(RECORD_FIELDS[i].label, label) == 0)
+      return i;
+  }
+  return -1;
+}
+
+/* Append the rows of a daily CSV file, columns are matched by label */
+static bool readCSV(const char *path, std::vector<SensorRecord> &rows)
+{
+  FILE *f = fopen(path, "r");
+  if (!f)
+    return false;
+
+  char line[CSV_BUFFER_SIZE];
+  int columns[RECORD_FIELD_COUNT + 16];
+  size_t columnCount = RECORD_FIELD_COUNT;
+  for (size_t i = 0; i < columnCount; i++)
+    columns[i] = i;
+
+  while (fgets(line, sizeof(line), f))
+  {
+    line[strcspn(line, "\r\n")] = 0;
+    if (line[0] == '"')
+    {
+      columnCount = 0;
+      char *cell = strtok(line, ",");
+      while ((cell = strtok(NULL, ",")) != NULL && columnCount < sizeof(columns) / sizeof(columns[0]))
+      {
+        size_t len = strlen(cell);
+        if (len >= 2 && cell[0] == '"' && cell[len - 1] == '"')
+        {
+          cell[len - 1] = 0;
+          cell++;
+        }
+        columns[columnCount++] = fieldIndex(cell);
+      }
+      continue;
+    }
+
+    SensorRecord record = {};
+    if (!parseTimestamp(line, record.timestamp))
+      continue;
+    for (size_t i = 0; i < RECORD_FIELD_COUNT; i++)
+    {
+      if (RECORD_FIELDS[i].type == FIELD_FLOAT)
+        setField(record, RECORD_FIELDS[i], NAN);
+    }
+    char *cell = strchr(line, ',');
+    for (size_t i = 0; cell != NULL && i < columnCount; i++)
+    {
+      if (columns[i] >= 0)
+        setField(record, RECORD_FIELDS[columns[i]], strtod(cell + 1, NULL));
+      cell = strchr(cell + 1, ',');
+    }
+    rows.push_back(record);
+  }
+  fclose(f);
+  return true;
+}
+
+struct EnergyModel
+{
+  float wakeSeconds;
+  float wakeMilliamps;
+  float sleepMilliamps;
+  float battery; // V, NaN to use the logged voltage
+};
+
+struct Result
+{
+  size_t readings;
+  double milliampHours;
+  double rms[CHANNEL_COUNT];
+  double maxError[CHANNEL_COUNT];
+};
+
+/* Sample the rows with the policy and compare the readings with all rows */
+static Result simulate(const std::vector<SensorRecord> &rows, const SchedulePolicy &policy, const EnergyModel &energy)
+{
+  std::vector<SensorRecord> readings;
+  scheduleReset();
+
+  size_t row = 0;
+  uint32_t end = rows.back().timestamp;
+  for (uint32_t t = rows.front().timestamp; t <= end;)
+  {
+    while (row + 1 < rows.size() && rows[row + 1].timestamp <= t)
+      row++;
+    SensorRecord reading = interpolate(rows[row], rows[row + 1 < rows.size() ? row + 1 : row], t);
+    if (!isnan(energy.battery))
+      reading.battery = energy.battery;
+    readings.push_back(reading);
+
+    ScheduleReason reason;
+    t += scheduleNext(policy, reading, reason);
+  }
+
+  Result result = {};
+  result.readings = readings.size();
+  double span = end - rows.front().timestamp;
+  double wakeHours = readings.size() * energy.wakeSeconds / 3600.0;
+  result.milliampHours = wakeHours * energy.wakeMilliamps + (span / 3600.0 - wakeHours) * energy.sleepMilliamps;
+
+  for (int c = 0; c < CHANNEL_COUNT; c++)
+  {
+    double sum = 0;
+    size_t n = 0;
+    size_t r = 0;
+    for (size_t i = 0; i < rows.size(); i++)
+    {
+      float truth = channel(rows[i], c);
+      while (r + 2 < readings.size() && readings[r + 1].timestamp <= rows[i].timestamp)
+        r++;
+      const SensorRecord &a = readings[r];
+      const SensorRecord &b = readings[r + 1 < readings.size() ? r + 1 : r];
+      float estimate = channel(a, c);
+      if (b.timestamp > a.timestamp && rows[i].timestamp > a.timestamp)
+      {
+        float w = (float)(rows[i].timestamp - a.timestamp) / (b.timestamp - a.timestamp);
+        estimate += w * (channel(b, c) - channel(a, c));
+      }
+      if (isnan(truth) || isnan(estimate))
+        continue;
+      double error = fabs(truth - estimate);
+      sum += error * error;
+      n++;
+      if (error > result.maxError[c])
+        result.maxError[c] = error;
+    }
+    result.rms[c] = n > 0 ? sqrt(sum / n) : NAN;
+  }
+  return result;
+}
+
+static void printResult(const char *name, const Result &result, double days)
+{
+  printf("%-22s %9.1f %9.2f", name, result.readings / days, result.milliampHours / days);
+  for (int c = 0; c < CHANNEL_COUNT; c++)
+    printf(" %8.3f %8.3f", result.rms[c], result.maxError[c]);
+  printf("\n");
+}
+
+static SchedulePolicy fixedPolicy(uint32_t interval)
+{
+  SchedulePolicy policy = {interval, interval, interval, 0, 0, 0, 0};
+  return policy;
+}
+
+int main(int argc, char **argv)
+{
+  SchedulePolicy policy = {5 * 60, 2 * 60, 15 * 60, 1.0f, 10.0f, 3.6f, 3.4f};
+  EnergyModel energy = {35.0f, 110.0f, 0.15f, NAN};
+  std::vector<SensorRecord> rows;
+
+  for (int a = 1; a < argc; a++)
+  {
+    bool value = a + 1 < argc;
+    if (value && strcmp(argv[a], "--interval") == 0)
+      policy.interval = atof(argv[++a]) * 60;
+    else if (value && strcmp(argv[a], "--min") == 0)
+      policy.minInterval = atof(argv[++a]) * 60;
+    else if (value && strcmp(argv[a], "--max") == 0)
+      policy.maxInterval = atof(argv[++a]) * 60;
+    else if (value && strcmp(argv[a], "--pressure-rate") == 0)
+      policy.pressureRate = atof(argv[++a]);
+    else if (value && strcmp(argv[a], "--pm-step") == 0)
+      policy.pmStep = atof(argv[++a]);
+    else if (value && strcmp(argv[a], "--battery-low") == 0)
+      policy.batteryLow = atof(argv[++a]);
+    else if (value && strcmp(argv[a], "--battery-critical") == 0)
+      policy.batteryCritical = atof(argv[++a]);
+    else if (value && strcmp(argv[a], "--battery") == 0)
+      energy.battery = atof(argv[++a]);
+    else if (value && strcmp(argv[a], "--wake-seconds") == 0)
+      energy.wakeSeconds = atof(argv[++a]);
+    else if (value && strcmp(argv[a], "--wake-ma") == 0)
+      energy.wakeMilliamps = atof(argv[++a]);
+    else if (value && strcmp(argv[a], "--sleep-ma") == 0)
+      energy.sleepMilliamps = atof(argv[++a]);
+    else if (!readCSV(argv[a], rows))
+      fprintf(stderr, "%s: cannot read file\n", argv[a]);
+  }
+
+  if (rows.size() < 2 || policy.interval == 0 || policy.minInterval == 0)
+  {
+    fprintf(stderr, "usage: schedsim [--interval m] [--min m] [--max m] [--pressure-rate hPa/h] [--pm-step ug/m3]\n"
+                    "                [--battery-low V] [--battery-critical V] [--battery V]\n"
+                    "                [--wake-seconds s] [--wake-ma mA] [--sleep-ma mA] <day.csv>...\n");
+    return 2;
+  }
+
+  // Files may be given in any order
+  std::sort(rows.begin(), rows.end(), [](const SensorRecord &a, const SensorRecord &b)
+            { return a.timestamp < b.timestamp; });
+  double days = (rows.back().timestamp - rows.front().timestamp) / 86400.0;
+  if (days <= 0)
+    days = 1;
+
+  printf("%u logged rows over %.1f days, errors of the interpolated readings against all rows\n",
+         (unsigned)rows.size(), days);
+  printf("%-22s %9s %9s", "Policy", "reads/day", "mAh/day");
+  for (int c = 0; c < CHANNEL_COUNT; c++)
+    printf(" %8.8s %8s", CHANNEL_NAMES[c], "max");
+  printf("\n");
+
+  char name[32];
+  const uint32_t fixed[] = {policy.minInterval, policy.interval, policy.maxInterval};
+  for (size_t i = 0; i < sizeof(fixed) / sizeof(fixed[0]); i++)
+  {
+    snprintf(name, sizeof(name), "fixed %.1f min", fixed[i] / 60.0);
+    printResult(name, simulate(rows, fixedPolicy(fixed[i]), energy), days);
+  }
+  snprintf(name, sizeof(name), "adaptive %.0f-%.0f min", policy.minInterval / 60.0, policy.maxInterval / 60.0);
+  printResult(name, simulate(rows, policy, energy), days);
+  return 0;
+}
@@ -0,0 +1,98 @@
+#!/usr/bin/env python3
+"""
+TLS Stand-in Server
+
+Accepts the uploads of the station over HTTPS with keep-alive and logs for
+every connection whether the TLS session was resumed, how many requests it
+carried and the TLS version and cipher. Request bodies are appended to
+outbox.jsonl (MessagePack bodies to outbox.msgpack) like the native
+network does. TLS 1.2 is used, session IDs and
+tickets are enabled.
+
+  openssl req -x509 -newkey ec -pkeyopt ec_paramgen_curve:prime256v1 -nodes \
+    -keyout key.pem -out cert.pem -days 365 -subj /CN=weatherstation
+  python3 tools/tlsserver/tlsserver.py --cert cert.pem --key key.pem [--port 8443]
+
+The SHA-256 fingerprint of the certificate is printed on start, use it as
+"serverFingerprint" and "https://<host>:<port>/" as "server" in the
+settings of the station.
+"""
+
+import argparse
+import hashlib
+import http.server
+import os
+import ssl
+import sys
+import time
+
+
+class UploadHandler(http.server.BaseHTTPRequestHandler):
+    protocol_version = "HTTP/1.1"  # keep-alive
+
+    def setup(self):
+        super().setup()
+        self.requests = 0
+        self.opened = time.monotonic()
+        conn = self.connection
+        self.tls = "%s %s %s" % ("resumed" if conn.session_reused else "full handshake",
+                                 conn.version(), conn.cipher()[0])
+
+    def do_POST(self):
+        length = int(self.headers.get("Content-Length", 0))
+        body = self.rfile.read(length)
+        self.requests += 1
+        if "msgpack" in self.headers.get("Content-Type", ""):
+            with open(os.path.splitext(self.server.outbox)[0] + ".msgpack", "ab") as f:
+                f.write(body)
+        else:
+            with open(self.server.outbox, "ab") as f:
+                f.write(body + b"\n")
+
+        response = b'{"status":"ok"}'
+        self.send_response(200)
+        self.send_header("Content-Type", "application/json")
+        self.send_header("Content-Length", str(len(response)))
+        self.end_headers()
+        self.wfile.write(response)
+
+    def finish(self):
+        super().finish()
+        print("%s %s, %d requests, %.0f ms" % (
+            self.client_address[0], self.tls, self.requests,
+            (time.monotonic() - self.opened) * 1000), flush=True)
+
+    def log_message(self, format, *args):
+        pass
+
+
+def main():
+    parser = argparse.ArgumentParser(description="TLS stand-in server for the weather station")
+    parser.add_argument("--cert", required=True, help="certificate (PEM)")
+    parser.add_argument("--key", required=True, help="private key (PEM)")
+    parser.add_argument("--port", type=int, default=8443)
+    parser.add_argument("--outbox", default="outbox.jsonl", help="file for the request bodies")
+    args = parser.parse_args()
+
+    context = ssl.SSLContext(ssl.PROTOCOL_TLS_SERVER)
+    context.minimum_version = ssl.TLSVersion.TLSv1_2
+    context.maximum_version = ssl.TLSVersion.TLSv1_2
+    context.load_cert_chain(args.cert, args.key)
+
+    with open(args.cert) as f:
+        der = ssl.PEM_cert_to_DER_cert(f.read())
+    print("serverFingerprint: " + hashlib.sha256(der).hexdigest(), flush=True)
+
+    server = http.server.ThreadingHTTPServer(("", args.port), UploadHandler)
+    server.outbox = args.outbox
+    server.socket = context.wrap_socket(server.socket, server_side=True)
+    print("Listening on port %d" % args.port, flush=True)
+    try:
+        server.serve_forever()
+    except KeyboardInterrupt:
+        pass
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())